@@ -0,0 +1,166 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host benchmark of the control path against simulated transports.
+//
+//   cmd_vel:  subscription_callback -> sendMotorCommands -> MotorController::sendCommand
+//             measured until the last byte of the velocity frame reaches motorSerial
+//   feedback: wheel_callback -> readSpeedData -> rcl_publish of the velocity message
+//
+// Each rate is run for --count iterations, paced on CLOCK_MONOTONIC. Iterations
+// that wrote no frame or published nothing are not timed and are reported as
+// missed. One JSON object per line is printed so results can be collected per commit:
+//
+//   pio run -e native_bench && .pio/build/native_bench/program > bench_output.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static int64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepUntil(int64_t deadline_ns) {
+    struct timespec ts = {(time_t)(deadline_ns / 1000000000LL), (long)(deadline_ns % 1000000000LL)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, int pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (sorted.size() * pct) / 100;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Prints one result line; rate_hz 0 means back-to-back
+static void report(const char *path, int rate_hz, std::vector<int64_t> &samples, int missed, int64_t elapsed_ns) {
+    std::sort(samples.begin(), samples.end());
+    int64_t sum = 0;
+    for (int64_t sample : samples) {
+        sum += sample;
+    }
+    double throughput = elapsed_ns > 0 ? samples.size() * 1e9 / elapsed_ns : 0.0;
+    printf("{\"path\":\"%s\",\"rate_hz\":%d,\"count\":%zu,\"missed\":%d,\"min_ns\":%lld,\"mean_ns\":%lld,"
+           "\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld,\"throughput_per_s\":%.1f}\n",
+           path, rate_hz, samples.size(), missed, (long long)(samples.empty() ? 0 : samples.front()),
+           (long long)(samples.empty() ? 0 : sum / (int64_t)samples.size()), (long long)percentile(samples, 50),
+           (long long)percentile(samples, 90), (long long)percentile(samples, 99),
+           (long long)(samples.empty() ? 0 : samples.back()), throughput);
+    fflush(stdout);
+}
+
+// Runs fn count times at rate_hz and records the latency it returns, a negative value is a missed sample
+template <typename Fn>
+static void run(const char *path, int rate_hz, int count, Fn fn) {
+    std::vector<int64_t> samples;
+    samples.reserve(count);
+    int missed = 0;
+    int64_t period_ns = rate_hz > 0 ? 1000000000LL / rate_hz : 0;
+    int64_t start = nowNanos();
+    int64_t next = start;
+    for (int i = 0; i < count; i++) {
+        if (period_ns > 0) {
+            sleepUntil(next);
+            next += period_ns;
+        }
+        int64_t latency = fn(i);
+        if (latency < 0) {
+            missed++;
+        } else {
+            samples.push_back(latency);
+        }
+    }
+    report(path, rate_hz, samples, missed, nowNanos() - start);
+}
+
+int main(int argc, char **argv) {
+    int count = 2000;
+    std::vector<int> rates = {50, 100, 200, 500, 1000, 0};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (arg == "--rates" && i + 1 < argc) {
+            rates.clear();
+            for (char *tok = strtok(argv[++i], ","); tok; tok = strtok(NULL, ",")) {
+                rates.push_back(atoi(tok));
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--count N] [--rates 50,100,0]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    SimMotorDriver driver(motorSerial);
+    initializeUART();
+    setupMicroROS();
+
+    // Timestamp each write that completes a frame to the motor, partial writes are
+    // collected until MOTOR_FRAME_SIZE bytes arrived
+    int64_t frame_done_ns = 0;
+    size_t partial_bytes = 0;
+    auto driverWrite = motorSerial.onWrite;
+    motorSerial.onWrite = [&](const uint8_t *buf, size_t len) {
+        partial_bytes += len;
+        if (partial_bytes >= MOTOR_FRAME_SIZE) {
+            partial_bytes %= MOTOR_FRAME_SIZE;
+            frame_done_ns = nowNanos();
+        }
+        driverWrite(buf, len);
+    };
+
+    // Timestamp the velocity publish of the feedback path
+    int64_t vel_publish_ns = 0;
+    nativePublishHook = [&](const rcl_publisher_t *publisher, const void *msg) {
+        if (publisher == &vel_publisher) {
+            vel_publish_ns = nowNanos();
+        }
+    };
+
+    geometry_msgs__msg__TwistStamped cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    for (int rate : rates) {
+        run("cmd_vel_to_uart", rate, count, [&](int i) {
+            cmd.twist.linear.x = 0.5 * ((i % 20) - 10) / 10.0;
+            cmd.twist.angular.z = 0.2;
+            frame_done_ns = 0;
+            partial_bytes = 0;
+            int64_t start = nowNanos();
+            subscription_callback(&cmd);
+            return frame_done_ns != 0 ? frame_done_ns - start : -1;
+        });
+        run("wheel_to_publish", rate, count, [&](int i) {
+            vel_publish_ns = 0;
+            int64_t start = nowNanos();
+            wheel_callback();
+            return vel_publish_ns != 0 ? vel_publish_ns - start : -1;
+        });
+    }
+    return 0;
+}
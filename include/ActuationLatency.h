@@ -0,0 +1,109 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ACTUATION_LATENCY_H
+#define ACTUATION_LATENCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ACTUATION_SAMPLES 64 // Latest samples per stage kept for the rolling distributions
+#define ACTUATION_TIMEOUT 500 // A target change not confirmed and followed within this is dropped, in milliseconds
+#define ACTUATION_MIN_MOVE 0.02f // Speed change toward the new target counted as a response in m/s
+#define ACTUATION_BUFFER_SIZE 384 // Size of the published summary string
+
+// Stages of one command, each measured from the end of the previous one
+enum ActuationStage : uint8_t {
+    ACTUATION_DISPATCH = 0,  // cmd_vel ready in the executor to subscription_callback
+    ACTUATION_WRITE = 1,     // subscription_callback to the velocity frame written to the UART
+    ACTUATION_ACK = 2,       // Frame written to the read-back of the new target
+    ACTUATION_RESPONSE = 3,  // Read-back to the first speed sample moving toward the target
+    ACTUATION_TOTAL = 4,     // cmd_vel ready to that speed sample
+    ACTUATION_STAGES = 5,
+};
+
+// Rolling distribution of one stage in microseconds
+struct ActuationDistribution {
+    uint32_t count;  // Samples behind the percentiles, at most ACTUATION_SAMPLES
+    uint32_t min_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t max_us;
+};
+
+// Counters since boot
+struct ActuationStats {
+    uint32_t commands;    // Commands written to the driver
+    uint32_t changes;     // Commands that changed the target
+    uint32_t completed;   // Target changes followed through to the response, or to the
+                          // read-back when the change is below ACTUATION_MIN_MOVE
+    uint32_t superseded;  // Target changes replaced by the next one before completing
+    uint32_t timeouts;    // Target changes dropped after ACTUATION_TIMEOUT
+};
+
+// Follows the latest target change of cmd_vel through the driver. Every
+// command gives dispatch and write samples; a command changing the target is
+// tracked until the driver reads it back and the wheel speed moves toward it.
+// The read-back and the speed are observed by the wheel stream, so these
+// stages resolve to its period. Not locked; the control task calls all methods.
+class ActuationLatency {
+public:
+    ActuationLatency();  // Constructor
+
+    // Records a command that became ready at ready_us, entered the callback at
+    // callback_us and whose target_dec (target_speed in m/s) was written at write_us
+    void onCommand(uint32_t ready_us, uint32_t callback_us, uint32_t write_us,
+                   int32_t target_dec, float target_speed);
+
+    // True while a target change waits for its read-back
+    bool awaitingAck() const { return state == TRACK_ACK; }
+
+    // A read-back of the target velocity register
+    void onReadBack(int32_t target_dec, uint32_t now_us);
+
+    // A wheel speed sample in m/s, driver direction
+    void onFeedback(float speed, uint32_t now_us);
+
+    const ActuationStats &stats() const { return counters; }
+
+    // Distribution of the latest samples of stage
+    ActuationDistribution distribution(ActuationStage stage) const;
+
+    // Writes the counters and the distribution of every stage as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    enum TrackState : uint8_t { TRACK_IDLE, TRACK_ACK, TRACK_RESPONSE };
+
+    void record(ActuationStage stage, uint32_t latency_us);
+    void expire(uint32_t now_us);
+
+    uint32_t samples[ACTUATION_STAGES][ACTUATION_SAMPLES]; // Ring of the latest samples per stage
+    uint32_t sample_count[ACTUATION_STAGES];               // Samples recorded per stage since boot
+    ActuationStats counters;   // Counters since boot
+    TrackState state;          // Stage the tracked change waits for
+    int32_t last_target_dec;   // Target of the last command
+    int32_t target_dec;        // Target of the tracked change
+    float target_speed;        // The same in m/s
+    float start_speed;         // Wheel speed when the change was written
+    float last_speed;          // Latest wheel speed sample
+    uint32_t ready_us;         // Tracked change ready in the executor
+    uint32_t write_us;         // Tracked change written
+    uint32_t ack_us;           // Tracked change read back
+};
+
+extern ActuationLatency actuationLatency;
+
+#endif // ACTUATION_LATENCY_H
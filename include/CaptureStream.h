@@ -0,0 +1,118 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAPTURE_STREAM_H
+#define CAPTURE_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CAPTURE_BUFFER_SIZE 8192 // Encoded bytes buffered for the capture task, a power of two for the index wrap
+#define CAPTURE_MAX_PAYLOAD 48 // Largest record payload in bytes
+#define CAPTURE_HEADER_SIZE 9 // type, seq and timestamp_us before the payload
+#define CAPTURE_CRC_SIZE 2 // CRC-16 after the payload
+#define CAPTURE_MAX_FRAME (CAPTURE_HEADER_SIZE + CAPTURE_MAX_PAYLOAD + CAPTURE_CRC_SIZE + 2) // COBS overhead and delimiter
+#define CAPTURE_BAUD_RATE 2000000 // Baud rate of the capture port
+#define CAPTURE_TX_PIN 26 // TX pin of the second UART carrying the capture stream
+#define CAPTURE_RX_PIN 36 // RX pin of the second UART, unused by the stream
+#define CAPTURE_TASK_PRIORITY 1 // FreeRTOS priority, below both executor tasks
+#define CAPTURE_TASK_CORE 0 // Core running the capture task
+#define CAPTURE_TASK_STACK_SIZE 3072 // Stack size in bytes of the capture task
+#define CAPTURE_DRAIN_PERIOD 2 // Interval between writes to the capture port in milliseconds
+#define CAPTURE_CHUNK_SIZE 256 // Bytes written to the port per call
+
+// Record kinds
+enum CaptureRecordType : uint8_t {
+    CAPTURE_IMU = 1,           // payload: float input[6], float filtered[6] (ax, ay, az in g, gx, gy, gz in deg/s)
+    CAPTURE_MOTOR_TX = 2,      // payload: the 10-byte frame written to motorSerial
+    CAPTURE_MOTOR_RX = 3,      // payload: the 10-byte frame read from motorSerial
+    CAPTURE_CONTROL_TICK = 4,  // payload: uint8 stream, marks a run of a control stream
+};
+
+#define CAPTURE_MASK_IMU 0x01 // capture_mask bit of the IMU samples
+#define CAPTURE_MASK_MOTOR 0x02 // capture_mask bit of the motor frames in both directions
+#define CAPTURE_MASK_TICK 0x04 // capture_mask bit of the control ticks
+#define CAPTURE_MASK_ALL (CAPTURE_MASK_IMU | CAPTURE_MASK_MOTOR | CAPTURE_MASK_TICK)
+#define CAPTURE_MASK 0 // Default capture_mask, the capture is off until enabled at runtime
+
+// COBS-encodes len bytes into out and appends the 0x00 delimiter. out needs
+// len + len / 254 + 2 bytes. Returns the encoded length including the delimiter.
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+
+// Decodes one COBS frame without its delimiter, returns 0 when malformed
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out);
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+uint16_t captureCrc16(const uint8_t *data, size_t len);
+
+// Returns the capture_mask bit selecting a record kind
+inline uint8_t captureMaskOf(uint8_t type) {
+    switch (type) {
+    case CAPTURE_IMU: return CAPTURE_MASK_IMU;
+    case CAPTURE_MOTOR_TX:
+    case CAPTURE_MOTOR_RX: return CAPTURE_MASK_MOTOR;
+    case CAPTURE_CONTROL_TICK: return CAPTURE_MASK_TICK;
+    default: return 0;
+    }
+}
+
+// Binary capture of raw control data at the full sample rate, streamed to a
+// sideband port because micro-ROS cannot carry it. Each record is
+// [type][seq u32][timestamp_us u32][payload][crc16], little-endian and
+// COBS-framed. seq counts every offered record, including the ones dropped
+// when the buffer is full, so the host sees every gap. Producers run on the
+// executor tasks and, with MOTOR_BUS, on the bus task outside the micro-ROS
+// session lock, so record() serializes them with a mutex created by
+// startCaptureTask(); the capture task is the only reader.
+class CaptureStream {
+public:
+    CaptureStream();  // Constructor
+
+    // Selects the captured record kinds, 0 stops the capture
+    void setMask(uint8_t mask) { enabled_mask = mask; }
+    uint8_t mask() const { return enabled_mask; }
+    bool isEnabled(uint8_t type) const { return (enabled_mask & captureMaskOf(type)) != 0; }
+
+    // Encodes one record into the buffer, returns false when disabled or dropped
+    bool record(uint8_t type, const void *payload, uint8_t size, uint32_t timestamp_us);
+
+    void recordIMU(const float input[6], const float filtered[6]);
+    void recordMotorFrame(uint8_t type, const uint8_t *frame);
+    void recordTick(uint8_t stream);
+
+    // Moves up to max encoded bytes out of the buffer, returns the count
+    size_t read(uint8_t *out, size_t max);
+
+    size_t pending() const { return head - tail; }       // Encoded bytes not read yet
+    uint32_t sequence() const { return seq; }            // Records offered so far
+    uint32_t dropped() const { return dropped_count; }   // Records lost to a full buffer
+
+private:
+    uint8_t ring[CAPTURE_BUFFER_SIZE];  // Encoded frames
+    volatile uint32_t head;             // Bytes written, advanced by the producer
+    volatile uint32_t tail;             // Bytes read, advanced by the capture task
+    volatile uint8_t enabled_mask;      // CAPTURE_MASK_* bits
+    uint32_t seq;                       // Sequence number of the next record
+    uint32_t dropped_count;             // Records that did not fit
+};
+
+extern CaptureStream captureStream;
+
+// Applies the capture_mask parameter and starts the task writing the stream
+// to USB when micro-ROS uses WiFi, otherwise to the second UART
+void startCaptureTask();
+void captureTask(void *param);
+
+#endif // CAPTURE_STREAM_H
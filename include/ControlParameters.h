@@ -0,0 +1,125 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONTROL_PARAMETERS_H
+#define CONTROL_PARAMETERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Parameter names exposed through the micro-ROS parameter server
+#define PARAM_IMU_SAMPLE_PERIOD "imu_sample_period_ms"
+#define PARAM_IMU_PUBLISH_PERIOD "imu_publish_period_ms"
+#define PARAM_WHEEL_PERIOD "wheel_period_ms"
+#define PARAM_DIAGNOSTICS_PERIOD "diagnostics_period_ms"
+#define PARAM_MOTOR_REPLY_TIMEOUT "motor_reply_timeout_ms"
+#define PARAM_ACCEL_CUTOFF "accel_cutoff_hz"
+#define PARAM_GYRO_CUTOFF "gyro_cutoff_hz"
+#define PARAM_NOTCH_FREQUENCY "notch_hz"
+#define PARAM_NOTCH_Q "notch_q"
+#define PARAM_WHEEL_RADIUS "wheel_radius"
+#define PARAM_WHEEL_DISTANCE "wheel_distance"
+#define PARAM_GYRO_COVARIANCE "gyro_covariance"
+#define PARAM_ACCEL_COVARIANCE "accel_covariance"
+#define PARAM_TRANSPORT "transport"
+#define PARAM_VELOCITY_SOURCE "velocity_source"
+#define PARAM_VELOCITY_PROCESS_NOISE "velocity_process_noise"
+#define PARAM_LINK_MAX_RTT "link_max_rtt_ms"
+#define PARAM_LINK_MAX_LOSS "link_max_loss_pct"
+#define PARAM_LINK_TIMEOUT "link_timeout_ms"
+#define PARAM_CMD_VEL_MAX_AGE "cmd_vel_max_age_ms"
+#define PARAM_CMD_VEL_TIMEOUT "cmd_vel_timeout_ms"
+#define PARAM_CAPTURE_MASK "capture_mask"
+#define PARAM_MOTOR_STATUS_PERIOD "motor_status_period_ms"
+#define PARAM_MOTOR_RETRY_MAX "motor_retry_max_ms"
+#define PARAM_IMU_FORMAT "imu_format"
+#define PARAM_AUTO_RATES "auto_rates"
+#define PARAM_RATE_CPU_BUDGET "rate_cpu_budget_pct"
+#define PARAM_RATE_LINK_BUDGET "rate_link_budget_pct"
+#define PARAM_SLIP_YAW_TOLERANCE "slip_yaw_tolerance"
+#define PARAM_SLIP_ACCEL_LIMIT "slip_accel_limit"
+
+#define CONTROL_PREFS_NAMESPACE "control" // NVS namespace holding accepted values
+
+// Control values that can be tuned at runtime. Defaults come from the
+// compile-time constants in RosCommunications.h and MotorController.h.
+struct ControlParameters {
+    uint32_t imu_sample_period_ms;   // IMU sampling stream period in milliseconds
+    uint32_t imu_publish_period_ms;  // IMU publish stream period in milliseconds
+    uint32_t wheel_period_ms;        // Wheel speed stream period in milliseconds
+    uint32_t diagnostics_period_ms;  // Diagnostics stream period in milliseconds
+    uint32_t motor_reply_timeout_ms; // Wait for a motor driver reply in milliseconds
+    uint32_t transport;              // TransportType used from the next boot
+    uint32_t velocity_source;        // VELOCITY_SOURCE_* of the published wheel speed
+    uint32_t link_max_rtt_ms;        // Link RTT p99 limit in milliseconds, 0 disables it
+    uint32_t link_max_loss_pct;      // Link ping loss limit in percent, 0 disables it
+    uint32_t link_timeout_ms;        // Time without pings before the link is degraded, 0 disables it
+    uint32_t cmd_vel_max_age_ms;     // Age above which cmd_vel is rejected as stale, 0 disables it
+    uint32_t cmd_vel_timeout_ms;     // Time without an accepted cmd_vel before the wheel stops, 0 disables it
+    uint32_t capture_mask;           // CAPTURE_MASK_* bits of the raw data capture, 0 stops it
+    uint32_t motor_status_period_ms; // Driver status poll period in milliseconds
+    uint32_t motor_retry_max_ms;     // Longest delay between motor recovery attempts in milliseconds
+    uint32_t imu_format;             // ImuFormat of the IMU publish stream
+    uint32_t auto_rates;             // 1 selects the stream periods by the boot calibration
+    uint32_t rate_cpu_budget_pct;    // Control task share the calibrated streams may use in percent
+    uint32_t rate_link_budget_pct;   // Link and motor UART share the calibrated streams may use in percent
+    float accel_cutoff_hz;           // IMU accelerometer low-pass cutoff in Hz
+    float gyro_cutoff_hz;            // IMU gyroscope low-pass cutoff in Hz
+    float notch_hz;                  // IMU vibration notch frequency in Hz, 0 disables it
+    float notch_q;                   // Quality factor of the IMU notch
+    float wheel_radius;              // Radius of the wheel in meters
+    float wheel_distance;            // Distance between wheels in meters
+    float gyro_covariance;           // Diagonal angular velocity covariance of the IMU message
+    float accel_covariance;          // Diagonal linear acceleration covariance of the IMU message
+    float velocity_process_noise;    // Velocity estimator variance growth in (m/s)^2 per second
+    float slip_yaw_tolerance;        // Yaw rate difference counted as wheel slip in rad/s
+    float slip_accel_limit;          // Wheel acceleration limit while slipping in m/s^2, 0 disables it
+};
+
+// Describes one tunable parameter and its bounds
+struct ControlParameterInfo {
+    const char *name;  // Parameter server name
+    const char *key;   // NVS key, at most 15 characters
+    uint32_t *integer; // Field in controlParams of an integer parameter, NULL otherwise
+    float *real;       // Field in controlParams of a double parameter, NULL otherwise
+    double min;        // Smallest accepted value
+    double max;        // Largest accepted value
+};
+
+extern ControlParameters controlParams;
+
+// Number of entries returned by controlParameterInfo()
+size_t controlParameterCount();
+
+// Returns the description of parameter index, index < controlParameterCount()
+const ControlParameterInfo &controlParameterInfo(size_t index);
+
+// Returns the current value of a parameter as a double
+double controlParameterValue(size_t index);
+
+// Restores accepted values from NVS, keeping defaults for missing keys
+void loadControlParameters();
+
+// Returns the index of parameter name, or -1 for unknown names
+int controlParameterIndex(const char *name);
+
+// Validates and applies a new value. Returns false for unknown names and
+// out-of-range values. The value is kept in RAM until saveControlParameter().
+bool setControlParameter(const char *name, double value);
+
+// Writes the current value of parameter index to NVS, index < controlParameterCount()
+void saveControlParameter(size_t index);
+
+#endif // CONTROL_PARAMETERS_H
@@ -0,0 +1,39 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEBUG_OUTPUT_H
+#define DEBUG_OUTPUT_H
+
+#include <M5Stack.h>
+
+// Console and LCD output for bring-up and debugging. The headless build
+// (-DHEADLESS) compiles both out, its board is sealed inside the chassis.
+#ifdef HEADLESS
+// Never called, sizeof keeps the arguments referenced without evaluating them
+inline int debugDiscard(...) { return 0; }
+#define DEBUG_PRINT(...) ((void)sizeof(debugDiscard(__VA_ARGS__)))
+#define DEBUG_PRINTLN(...) ((void)sizeof(debugDiscard(__VA_ARGS__)))
+#define DEBUG_PRINTF(...) ((void)sizeof(debugDiscard(__VA_ARGS__)))
+#define LCD_PRINT(...) ((void)sizeof(debugDiscard(__VA_ARGS__)))
+#define LCD_PRINTF(...) ((void)sizeof(debugDiscard(__VA_ARGS__)))
+#else
+#define DEBUG_PRINT(...) Serial.print(__VA_ARGS__)
+#define DEBUG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#define DEBUG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#define LCD_PRINT(...) M5.Lcd.print(__VA_ARGS__)
+#define LCD_PRINTF(...) M5.Lcd.printf(__VA_ARGS__)
+#endif
+
+#endif // DEBUG_OUTPUT_H
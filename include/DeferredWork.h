@@ -0,0 +1,79 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEFERRED_WORK_H
+#define DEFERRED_WORK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEFERRED_QUEUE_SIZE 8 // Pending actions, requests beyond this are refused
+#define DEFERRED_TASK_PRIORITY 1 // FreeRTOS priority, below both executor tasks
+#define DEFERRED_TASK_CORE 0 // Core running the deferred work task
+#define DEFERRED_TASK_STACK_SIZE 4096 // Stack size in bytes of the deferred work task
+#define DEFERRED_POLL_PERIOD 10 // Interval between queue checks in milliseconds
+#define MOTOR_STOP_SETTLE_TIME 300 // Wait after the stop command for the wheels to halt in milliseconds
+#define REBOOT_DELAY 500 // Time for the reboot service response to reach the agent in milliseconds
+#define EXECUTOR_STALL_BUDGET 2000 // Longest acceptable housekeeping spin in microseconds
+
+// Slow part of a request, run on the deferred work task with arg
+typedef void (*DeferredFunction)(uint32_t arg);
+
+// One queued action
+struct DeferredAction {
+    const char *name;        // Name for logs, a string literal
+    DeferredFunction fn;     // Function to run
+    uint32_t arg;            // Argument passed to fn
+    bool stop_motors;        // Stop the wheels and ignore cmd_vel while fn runs
+};
+
+// Fixed-size FIFO of deferred actions. Not locked; deferWork() and
+// runDeferredWork() serialize access between the executor and worker tasks.
+class DeferredWorkQueue {
+public:
+    DeferredWorkQueue();  // Constructor
+
+    // Appends an action. An identical action that is still pending is not
+    // queued twice. Returns false when the queue is full.
+    bool push(const DeferredAction &action);
+
+    // Removes the oldest action, returns false when empty
+    bool pop(DeferredAction &action);
+
+    size_t size() const { return count; }
+    uint32_t refused() const { return refused_count; }
+
+private:
+    DeferredAction actions[DEFERRED_QUEUE_SIZE]; // Ring storage
+    size_t head;                                 // Index of the oldest action
+    size_t count;                                // Pending actions
+    uint32_t refused_count;                      // Pushes rejected because the queue was full
+};
+
+extern DeferredWorkQueue deferredWork;
+
+// Queues fn(arg) for the deferred work task. Safe to call from executor
+// callbacks; returns false when the queue is full.
+bool deferWork(const char *name, DeferredFunction fn, uint32_t arg, bool stop_motors);
+
+// Runs the oldest pending action, stopping the motors first when requested.
+// Returns false when nothing was pending.
+bool runDeferredWork();
+
+// Creates the queue lock and starts the deferred work task
+void startDeferredWorkTask();
+void deferredWorkTask(void *param);
+
+#endif // DEFERRED_WORK_H
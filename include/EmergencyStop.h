@@ -0,0 +1,127 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EMERGENCY_STOP_H
+#define EMERGENCY_STOP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Inputs, override with build flags
+#ifndef ESTOP_BUTTONS
+#define ESTOP_BUTTONS 1 // 1 trips the stop on any of the three front buttons, 0 ignores them
+#endif
+#ifndef ESTOP_EXTERNAL_PIN
+#define ESTOP_EXTERNAL_PIN -1 // GPIO of a normally closed e-stop loop to ground, -1 without external input
+#endif
+#define ESTOP_BUTTON_A_PIN 39 // Front button A, active low with an external pull-up
+#define ESTOP_BUTTON_B_PIN 38 // Front button B, active low with an external pull-up
+#define ESTOP_BUTTON_C_PIN 37 // Front button C, active low with an external pull-up
+#define ESTOP_CONFIRM_SAMPLES 4 // Reads of a GPIO36/39 input that must all be active before its edge trips
+#define ESTOP_CONFIRM_INTERVAL_US 25 // Time between those reads in microseconds
+
+#define ESTOP_TASK_PRIORITY 20 // FreeRTOS priority, above every other task of the firmware
+#define ESTOP_TASK_CORE 1 // Core running the stop task
+#define ESTOP_TASK_STACK_SIZE 2048 // Stack size in bytes of the stop task
+#define ESTOP_BUFFER_SIZE 256 // Size of the published e-stop summary
+
+// Input that tripped the stop
+enum EstopSource : uint8_t {
+    ESTOP_SOURCE_NONE = 0,      // Not tripped since boot
+    ESTOP_SOURCE_BUTTON_A = 1,  // Front button A
+    ESTOP_SOURCE_BUTTON_B = 2,  // Front button B
+    ESTOP_SOURCE_BUTTON_C = 3,  // Front button C
+    ESTOP_SOURCE_EXTERNAL = 4,  // External e-stop loop opened
+};
+
+// Latch state
+enum EstopState : uint8_t {
+    ESTOP_ARMED = 0,            // Wheels follow cmd_vel
+    ESTOP_TRIPPED = 1,          // Stopped and latched until a re-arm request
+    ESTOP_REARMING = 2,         // Re-arm accepted, the control task enables the driver
+};
+
+// Counters since boot
+struct EstopStats {
+    uint32_t trips;             // Trips that latched the stop
+    uint32_t triggers;          // Input edges, including those while already latched
+    uint32_t ignored;           // GPIO36/39 edges the input did not confirm
+    uint32_t rearms;            // Completed re-arms
+    uint32_t last_latency_us;   // Input edge to the stop frames written to the motor UART, last trip
+    uint32_t max_latency_us;    // Longest latency since boot
+    EstopSource source;         // Input of the last trip
+};
+
+// Latch and statistics of the hardware e-stop. Not locked; the stop task,
+// the re-arm service and the control task serialize access through
+// the functions below.
+class EmergencyStop {
+public:
+    EmergencyStop();  // Constructor
+
+    // Records an input edge from source at trip_us whose stop frames were
+    // written at stopped_us. Returns true when this latched the stop.
+    bool onTrip(EstopSource source, uint32_t trip_us, uint32_t stopped_us);
+
+    // Records an edge that was not confirmed by re-reading the input
+    void onIgnored() { counters.ignored++; }
+
+    // Accepts a re-arm request if tripped and no input is active anymore
+    bool requestRearm(bool input_active);
+
+    // Completes an accepted re-arm, returns false if the stop tripped again meanwhile
+    bool onRearmed();
+
+    bool isLatched() const { return latch != ESTOP_ARMED; }
+    bool rearmPending() const { return latch == ESTOP_REARMING; }
+    EstopState state() const { return latch; }
+    const EstopStats &stats() const { return counters; }
+
+    // Returns true once after each trip and re-arm
+    bool takeEvent();
+
+    // Writes the state and counters as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    volatile EstopState latch;  // Current state
+    EstopStats counters;        // Counters since boot
+    bool event;                 // Trip or re-arm not yet taken
+};
+
+extern EmergencyStop emergencyStop;
+
+// Attaches the input interrupts and starts the stop task. The interrupt only
+// stamps the edge and wakes the task, which writes the pre-encoded zero
+// velocity and disable frames to motorSerial without waiting for the executors.
+// GPIO36 and GPIO39 raise false falling edges (ESP32 errata 3.11), so an edge
+// of such an input only trips if the input still reads active over
+// ESTOP_CONFIRM_SAMPLES reads.
+void startEmergencyStopTask();
+void emergencyStopTask(void *param);
+
+// True while a button is held or the external loop is open
+bool emergencyStopInputActive();
+
+// Accepts a re-arm, the following wheel stream ticks enable the driver again.
+// Returns false if not tripped or an input is still active.
+bool requestEmergencyStopRearm();
+
+// Run by the wheel stream: advances a pending re-arm by one register of the
+// enable sequence and completes it once every driver read back enabled.
+// Returns true when a trip or re-arm is waiting to be published.
+bool serviceEmergencyStop();
+
+#endif // EMERGENCY_STOP_H
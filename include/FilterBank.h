@@ -0,0 +1,73 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILTER_BANK_H
+#define FILTER_BANK_H
+
+#include <stdint.h>
+
+#define FILTER_AXES 6 // Accelerometer x, y, z followed by gyroscope x, y, z
+#define FILTER_MAX_STAGES 4 // Maximum number of cascaded biquad sections
+
+// Normalized biquad coefficients (a0 = 1)
+struct BiquadCoefficients {
+    float b0, b1, b2; // Feed-forward coefficients
+    float a1, a2;     // Feedback coefficients
+};
+
+// Second-order low-pass section with quality factor q
+BiquadCoefficients designLowPass(float cutoff_hz, float sample_hz, float q);
+
+// Second-order notch at center_hz; larger q gives a narrower notch
+BiquadCoefficients designNotch(float center_hz, float sample_hz, float q);
+
+// Section that passes the input through unchanged
+BiquadCoefficients identityBiquad();
+
+// Cascaded biquad filters for all six IMU axes. Coefficients and state are
+// stored as [stage][axis] arrays so each stage runs as one loop over the axes.
+// Axes may use different coefficients; unused sections are identity.
+class FilterBank {
+public:
+    FilterBank();  // Constructor, all sections identity
+
+    // Sets the coefficients of one section for one axis
+    void setStage(int stage, int axis, const BiquadCoefficients &coeffs);
+
+    // Replaces the sections of an axis with a Butterworth low-pass of order 2 or 4,
+    // followed by a notch when notch_hz is between 0 and the Nyquist frequency
+    void configureAxis(int axis, float sample_hz, float cutoff_hz, int order, float notch_hz, float notch_q);
+
+    // Clears the filter state
+    void reset();
+
+    // Sets the state so a constant input of value in[] produces no transient
+    void prime(const float in[FILTER_AXES]);
+
+    // Filters one sample of every axis
+    void process(const float in[FILTER_AXES], float out[FILTER_AXES]);
+
+private:
+    float b0[FILTER_MAX_STAGES][FILTER_AXES];
+    float b1[FILTER_MAX_STAGES][FILTER_AXES];
+    float b2[FILTER_MAX_STAGES][FILTER_AXES];
+    float a1[FILTER_MAX_STAGES][FILTER_AXES];
+    float a2[FILTER_MAX_STAGES][FILTER_AXES];
+    float z1[FILTER_MAX_STAGES][FILTER_AXES]; // Transposed direct form II state
+    float z2[FILTER_MAX_STAGES][FILTER_AXES];
+    int stages; // Number of sections in use by any axis
+};
+
+#endif // FILTER_BANK_H
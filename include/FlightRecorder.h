@@ -0,0 +1,103 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLIGHT_RECORDER_CAPACITY 1024 // Number of records kept in RAM
+#define FLIGHT_RECORD_DATA_SIZE 12 // Payload bytes per record
+#define FLIGHT_DUMP_MAGIC 0x31435246 // "FRC1" in little-endian order
+#define FLIGHT_DUMP_VERSION 2 // Layout version of FlightRecord and FlightDumpHeader
+
+// Kinds of events stored in the flight recorder
+enum FlightRecordType : uint8_t {
+    FLIGHT_CMD_VEL = 1,      // data: float linear_x, float angular_z
+    FLIGHT_MOTOR_TX = 2,     // data: first 10 bytes of the frame written to motorSerial
+    FLIGHT_MOTOR_RX = 3,     // data: 10 bytes read from motorSerial
+    FLIGHT_IMU = 4,          // data: int16 accel[3] in mg, int16 gyro[3] in 0.1 deg/s
+    FLIGHT_EXEC_ERROR = 5,   // data: uint8 source, int32 return code
+    FLIGHT_CONTROL_TICK = 6, // data: uint8 stream, marks a run of a recorded control stream
+};
+
+// One compact timestamped record, 20 bytes
+struct FlightRecord {
+    uint32_t timestamp_us;                  // micros() when the event was recorded
+    uint8_t type;                           // FlightRecordType
+    uint8_t size;                           // Valid bytes in data
+    uint16_t seq;                           // Low 16 bits of the record sequence number
+    uint8_t data[FLIGHT_RECORD_DATA_SIZE];  // Event payload
+};
+
+// Header written before the records in a dump
+struct FlightDumpHeader {
+    uint32_t magic;         // FLIGHT_DUMP_MAGIC
+    uint16_t version;       // FLIGHT_DUMP_VERSION
+    uint16_t record_size;   // sizeof(FlightRecord)
+    uint32_t record_count;  // Number of records following the header
+};
+
+// Fixed-size RAM ring of the most recent control events. Recording is a
+// timestamp, an atomic index increment and a 20-byte copy, so it stays on in
+// production. recordFault() and freeze() stop recording so the history before
+// a fault is kept until it has been dumped.
+class FlightRecorder {
+public:
+    FlightRecorder();  // Constructor
+
+    // Stores one event, ignored while frozen
+    void record(uint8_t type, const void *data, uint8_t size);
+
+    void recordCmdVel(float linear_x, float angular_z);
+    void recordMotorFrame(uint8_t type, const uint8_t *frame);
+    void recordIMU(float ax, float ay, float az, float gx, float gy, float gz);
+    void recordError(uint8_t source, int32_t code);
+    void recordFault(uint8_t source, int32_t code);  // Records the error and freezes
+    void recordTick(uint8_t stream);
+
+    void freeze();  // Stops recording, the history stays in RAM until resume()
+    void resume();  // Restarts recording with an empty ring
+    bool isFrozen() const { return frozen; }
+
+    // Number of records available, at most FLIGHT_RECORDER_CAPACITY
+    uint32_t recordCount() const;
+
+    // Copies up to max records in chronological order starting at index first
+    size_t copyRecords(uint32_t first, FlightRecord *out, size_t max) const;
+
+    // Fills a dump header for the current contents
+    FlightDumpHeader header() const;
+
+private:
+    FlightRecord records[FLIGHT_RECORDER_CAPACITY]; // Ring storage
+    volatile uint32_t next;                          // Total records written, wraps the ring
+    volatile bool frozen;                            // True while recording is stopped
+};
+
+// Sources reported in FLIGHT_EXEC_ERROR records
+constexpr uint8_t FLIGHT_SOURCE_CONTROL_EXECUTOR = 1;
+constexpr uint8_t FLIGHT_SOURCE_HOUSEKEEPING_EXECUTOR = 2;
+constexpr uint8_t FLIGHT_SOURCE_DATA_TIMEOUT = 3;
+constexpr uint8_t FLIGHT_SOURCE_MOTOR_INIT = 4;  // code: MotorInitError
+constexpr uint8_t FLIGHT_SOURCE_EXECUTOR_STALL = 5;  // code: time the housekeeping task held the session in microseconds
+constexpr uint8_t FLIGHT_SOURCE_LINK = 6;  // code: 1 when the link became degraded, 0 when it recovered
+constexpr uint8_t FLIGHT_SOURCE_MOTOR_FAULT = 7;  // code: MotorHealth after the change
+constexpr uint8_t FLIGHT_SOURCE_ESTOP = 8;  // code: EstopSource of a trip, 0 when re-armed
+
+extern FlightRecorder flightRecorder;
+
+#endif // FLIGHT_RECORDER_H
@@ -17,6 +17,14 @@
 #define IMU_MANAGER_H
 
 #include <M5Stack.h>
+#include "FilterBank.h"
+
+// Default filter configuration, tunable through ControlParameters
+constexpr float ACCEL_CUTOFF_HZ = 5.0f;  // Low-pass cutoff of the accelerometer axes
+constexpr float GYRO_CUTOFF_HZ = 10.0f;  // Low-pass cutoff of the gyroscope axes
+constexpr float NOTCH_HZ = 0.0f;         // Motor vibration notch frequency, 0 disables it
+constexpr float NOTCH_Q = 2.0f;          // Quality factor of the notch
+constexpr int FILTER_ORDER = 4;          // Butterworth order of the low-pass, 2 or 4
 
 // Manages interactions with the IMU sensors on the M5Stack, including initialization,
 // data updates, and sensor calibration. It provides both raw and calibrated data access
@@ -31,17 +39,29 @@ public:
     // This function assumes that calibration offsets are already applied.
     void getCalibratedData(float &ax, float &ay, float &az, float &gx, float &gy, float &gz);
 
+    // Recomputes the filter coefficients from controlParams before the next update
+    void requestFilterUpdate() { filter_update_pending = true; }
+
+    // Counts of the last update (ax, ay, az, gx, gy, gz) before calibration and filtering
+    const int16_t *rawSample() const { return raw; }
+
+    // Calibration offsets in counts and full-scale ranges of the raw samples
+    void getRawCalibration(int16_t offset[6], uint16_t &accel_range_g, uint16_t &gyro_range_dps) const;
+
 private:
     float ax, ay, az; // Accelerometer data
     float gx, gy, gz; // Gyroscope data
+    int16_t raw[6]; // Counts read from the sensor by the last update
     float accOffset[3], gyroOffset[3]; // Calibration offsets for accelerometer and gyroscope
 
-    float lpf_beta; // Coefficient for the low-pass filter
-    float accX_filtered, accY_filtered, accZ_filtered; // Low-pass filtered accelerometer data
-    float gyroX_filtered, gyroY_filtered, gyroZ_filtered; // Low-pass filtered gyroscope data
+    FilterBank filters; // Low-pass and notch filters for all six axes
+    float filtered[FILTER_AXES]; // Filtered accelerometer and gyroscope data
+    bool primed; // True once the filter state has been set from a first sample
+    volatile bool filter_update_pending; // Set when the filter parameters have changed
 
     void calibrateSensors(); // Calibrates the sensors to adjust for drift and bias
-    void applyLowPassFilter(); // Applies a low-pass filter to smooth out sensor data
+    void configureFilters(); // Computes filter coefficients from controlParams
+    void applyFilterBank(); // Filters the sensor data to reduce noise and vibration
 };
 
 #endif // IMU_MANAGER_H
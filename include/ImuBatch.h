@@ -0,0 +1,90 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMU_BATCH_H
+#define IMU_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IMU_BATCH_VERSION 1 // Layout version of ImuBatchHeader and ImuBatchSample
+#define IMU_BATCH_MAX_SAMPLES 24 // Samples per batch, keeps a batch below one best-effort micro-ROS fragment
+#define IMU_BATCH_FULL_SCALE_COUNTS 32768 // Counts of the full-scale range of the raw samples
+
+// Selects what the IMU publish stream sends, the imu_format parameter
+enum ImuFormat : uint8_t {
+    IMU_FORMAT_FILTERED = 0,   // Filtered sensor_msgs/Imu on /imu/data_raw
+    IMU_FORMAT_RAW_BATCH = 1,  // Raw counts of every sample since the last publish on /imu/raw_batch
+};
+
+#define IMU_FORMAT IMU_FORMAT_FILTERED // Default imu_format
+
+// Start of a batch, little-endian without padding
+struct ImuBatchHeader {
+    uint8_t version;          // IMU_BATCH_VERSION
+    uint8_t count;            // Samples following the header
+    uint16_t dropped;         // Samples lost since the previous batch because this one was full
+    uint16_t accel_range_g;   // Accelerometer full scale, g = counts * accel_range_g / 32768
+    uint16_t gyro_range_dps;  // Gyroscope full scale, deg/s = counts * gyro_range_dps / 32768
+    uint32_t seq;             // Batch sequence number
+    uint32_t period_us;       // Nominal sampling period
+    int64_t stamp_ns;         // ROS time of the publish, a sample was taken at stamp_ns - age_us * 1000
+    int16_t offset[6];        // Calibration offsets in counts (ax, ay, az, gx, gy, gz), gravity stays on z
+    uint32_t reserved;        // Zero
+};
+
+// One sample, little-endian without padding
+struct ImuBatchSample {
+    uint32_t age_us;          // Time from the sample to the publish in microseconds
+    int16_t raw[6];           // Counts of ax, ay, az, gx, gy, gz
+};
+
+static_assert(sizeof(ImuBatchHeader) == 40, "ImuBatchHeader layout");
+static_assert(sizeof(ImuBatchSample) == 16, "ImuBatchSample layout");
+
+#define IMU_BATCH_BUFFER_SIZE (sizeof(ImuBatchHeader) + IMU_BATCH_MAX_SAMPLES * sizeof(ImuBatchSample)) // Largest batch in bytes
+
+// Collects raw IMU samples between two publishes. A filtered sensor_msgs/Imu
+// is over 300 bytes per sample, a batched sample is 16 bytes, so the same link
+// carries every sample instead of one per publish. Filled by the sampling
+// stream and emptied by the publish stream, both run by the control task.
+class ImuBatch {
+public:
+    ImuBatch();  // Constructor
+
+    // Sets the full-scale ranges and calibration offsets sent with every batch
+    void configure(uint16_t accel_range_g, uint16_t gyro_range_dps, const int16_t offset[6]);
+
+    // Sets the nominal sampling period sent with every batch
+    void setPeriod(uint32_t period_us) { header.period_us = period_us; }
+
+    // Adds a sample taken at sample_us, counted as dropped when the batch is full
+    void add(const int16_t raw[6], uint32_t sample_us);
+
+    // Writes the header and samples into buf and starts the next batch.
+    // Returns the bytes written, 0 when len is below IMU_BATCH_BUFFER_SIZE.
+    size_t serialize(uint8_t *buf, size_t len, int64_t stamp_ns, uint32_t now_us);
+
+    void clear();  // Discards the collected samples
+    uint8_t count() const { return samples; }
+
+private:
+    ImuBatchHeader header;                        // Ranges, offsets and counters of the next batch
+    uint32_t sample_us[IMU_BATCH_MAX_SAMPLES];    // micros() of each sample
+    int16_t raw[IMU_BATCH_MAX_SAMPLES][6];        // Counts of each sample
+    uint8_t samples;                              // Samples collected
+};
+
+#endif // IMU_BATCH_H
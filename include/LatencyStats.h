@@ -0,0 +1,36 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+// Accumulates min/max/average of latency samples in microseconds.
+// Samples are recorded from the control path, so recording is kept to a few
+// integer operations and the statistics are reset after each report.
+struct LatencyStats {
+    uint32_t count;   // Number of recorded samples
+    uint32_t min_us;  // Smallest sample in microseconds
+    uint32_t max_us;  // Largest sample in microseconds
+    uint64_t sum_us;  // Sum of all samples for the average
+
+    LatencyStats();  // Constructor
+    void record(uint32_t latency_us);  // Adds one sample
+    void reset();  // Clears all samples
+    uint32_t average() const;  // Returns the average latency, 0 if empty
+};
+
+#endif // LATENCY_STATS_H
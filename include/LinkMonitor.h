@@ -0,0 +1,111 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Ping fields sent by the host on /<wheel>/heartbeat (std_msgs/Int32MultiArray)
+#define LINK_PING_SEQ 0 // Sequence number, incremented for every ping
+#define LINK_PING_HOST_STAMP 1 // Host send time in microseconds, echoed back unchanged
+#define LINK_PING_BOARD_STAMP 2 // board_stamp of the latest echo the host received
+#define LINK_PING_HOLD 3 // Host time between receiving that echo and sending this ping in microseconds
+#define LINK_PING_FIELDS 4 // Number of ping fields
+
+// Echo fields published on /<wheel>/heartbeat_response
+#define LINK_ECHO_SEQ 0 // Sequence number of the ping
+#define LINK_ECHO_HOST_STAMP 1 // host_stamp of the ping
+#define LINK_ECHO_BOARD_STAMP 2 // Board receive time of the ping in microseconds
+#define LINK_ECHO_FIELDS 3 // Number of echo fields
+
+#define LINK_NO_ECHO 0xFFFFFFFFu // hold value of pings sent before any echo arrived
+#define LINK_WINDOW 1000 // Statistics window in milliseconds
+#define LINK_MAX_RTT_SAMPLES 128 // RTT samples kept per window for the percentile
+#define LINK_MAX_SEQ_JUMP 1000 // Larger sequence jumps are a host restart, not loss
+#define LINK_MAX_RTT 200 // Default RTT p99 above which the link is degraded in milliseconds
+#define LINK_MAX_LOSS 20 // Default ping loss above which the link is degraded in percent
+#define LINK_TIMEOUT 1000 // Default time without pings after which the link is degraded in milliseconds
+#define CMD_VEL_GAP 200 // cmd_vel intervals longer than this are counted as gaps in milliseconds
+#define LINK_BUFFER_SIZE 512 // Size of the published link quality and subscription summary
+
+// Statistics of one closed window
+struct LinkWindowStats {
+    uint32_t pings;              // Pings received
+    uint32_t lost;               // Pings missing from the sequence
+    uint32_t reordered;          // Pings older than an already received one
+    uint16_t loss_permille;      // lost / (pings + lost)
+    uint32_t rtt_count;          // RTT samples
+    uint32_t rtt_min_us;         // Smallest RTT
+    uint32_t rtt_avg_us;         // Average RTT
+    uint32_t rtt_p99_us;         // 99th percentile RTT
+    uint32_t late;               // RTT samples above the RTT limit
+    uint32_t cmd_vel_count;      // cmd_vel messages received
+    uint32_t cmd_vel_gaps;       // cmd_vel intervals longer than CMD_VEL_GAP
+    uint32_t cmd_vel_gap_max_us; // Longest cmd_vel interval
+};
+
+// Tracks link quality from host pings echoed by the board. The board measures
+// the round trip on its own clock: an echo carries the board receive time,
+// the host returns it in its next ping together with how long it held it, so
+// RTT = now - board_stamp - hold without synchronized clocks. The link is
+// degraded while the loss or RTT p99 of the last window exceeds its limit,
+// or when pings stop after they have been seen once.
+class LinkMonitor {
+public:
+    LinkMonitor();  // Constructor
+
+    // Sets the degradation limits, 0 disables the respective check
+    void configure(uint32_t max_rtt_us, uint16_t max_loss_permille, uint32_t timeout_us);
+
+    // Records a ping received at now_us
+    void onPing(uint32_t seq, uint32_t board_stamp, uint32_t hold_us, uint32_t now_us);
+
+    // Records a cmd_vel received at now_us
+    void onCmdVel(uint32_t now_us);
+
+    // Checks the ping timeout and closes the window every LINK_WINDOW, the
+    // first call opens the first window. Returns true when stats() changed.
+    bool evaluate(uint32_t now_us);
+
+    bool isActive() const { return active; }      // True once a ping was received
+    bool isDegraded() const { return degraded; }  // True while the link is below the limits
+    const LinkWindowStats &stats() const { return last; }
+
+    // Writes the last window as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    void closeWindow(uint32_t now_us);
+
+    uint32_t max_rtt_us;                       // Degradation limit of the RTT p99
+    uint16_t max_loss_permille;                // Degradation limit of the loss
+    uint32_t timeout_us;                       // Ping timeout
+    bool active;                               // A ping has been received
+    bool degraded;                             // Current verdict
+    uint32_t last_seq;                         // Highest sequence number received
+    uint32_t last_ping_us;                     // Time of the last ping
+    uint32_t last_cmd_vel_us;                  // Time of the last cmd_vel
+    bool has_cmd_vel;                          // last_cmd_vel_us is valid
+    bool window_open;                          // window_start_us is valid
+    uint32_t window_start_us;                  // Start of the open window
+    LinkWindowStats current;                   // Open window
+    uint64_t rtt_sum_us;                       // Sum of the RTTs of the open window
+    uint32_t rtt[LINK_MAX_RTT_SAMPLES];        // RTT samples of the open window
+    LinkWindowStats last;                      // Last closed window
+};
+
+#endif // LINK_MONITOR_H
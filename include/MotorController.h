@@ -18,6 +18,8 @@
 
 #include <M5Stack.h>
 #include <HardwareSerial.h>
+#include "MotorProtocol.h"
+#include "MotorSupervisor.h"
 
 // Class to manage motor commands through UART
 class MotorController {
@@ -28,8 +30,11 @@ public:
     // Constructor to initialize the motor controller with a specific serial port
     MotorController(HardwareSerial& serial) : motorSerial(serial) {}
 
-    // Sends a command to the motor controller
+    // Encodes and sends a command to the motor controller
     void sendCommand(byte motorID, uint16_t address, byte command, uint32_t data);
+
+    // Sends an encoded frame with a single UART write
+    void sendFrame(const MotorFrame& frame);
 };
 
 // Structure to store velocity commands with linear and angular components
@@ -38,6 +43,74 @@ struct VelocityCommand {
     float angular_z; // Angular velocity in radians per second
 };
 
+// Failure causes of the motor initialization
+enum MotorInitError : uint8_t {
+    MOTOR_INIT_OK = 0,        // Every register read back the written value
+    MOTOR_INIT_TIMEOUT = 1,   // No read-back reply within the reply timeout
+    MOTOR_INIT_MISMATCH = 2,  // The register read back a different value
+};
+
+// Outcome of the last initMotor() or enableMotor() call
+struct MotorInitResult {
+    MotorInitError error;     // Cause of the failure, MOTOR_INIT_OK on success
+    uint16_t address;         // Register of the failing step
+    uint8_t attempts;         // Attempts used by the last step run
+    int32_t read_value;       // Value read back by the failing step
+    uint32_t duration_us;     // Duration of the whole sequence in microseconds
+};
+
+// Progress of a MotorRecovery sequence
+enum MotorRecoveryStatus : uint8_t {
+    MOTOR_RECOVERY_RUNNING = 0,  // Waiting for a read-back or the next step
+    MOTOR_RECOVERY_DONE = 1,     // Every register read back the written value
+    MOTOR_RECOVERY_FAILED = 2,   // A step failed MOTOR_INIT_ATTEMPTS times, details in motorInitResult
+};
+
+// Runs the steps of enableMotor() or initMotor() without waiting for the driver,
+// so a recovery does not hold the control task and the micro-ROS session. Each
+// step() writes at most one register and requests its read-back; the reply is
+// passed to onReply() by the speed and position reads of the next wheel tick.
+class MotorRecovery {
+public:
+    MotorRecovery();  // Constructor
+
+    // Starts the enable sequence, or the complete initialization if full
+    void begin(byte motorID, bool full, uint32_t now_us);
+
+    // Checks the reply of the current step and writes the next one
+    MotorRecoveryStatus step(uint32_t now_us);
+
+    // Takes the read-back of the current step, returns false for other frames
+    bool onReply(const uint8_t* frame);
+
+    bool active() const { return running; }
+    void cancel() { running = false; }
+
+private:
+    // One register write, verified by reading it back unless decode is NULL
+    struct Step {
+        MotorFrame write;
+        MotorFrame read;
+        uint16_t address;
+        uint32_t expected;
+        bool (*decode)(const uint8_t*, uint8_t, uint32_t&);
+    };
+
+    MotorRecoveryStatus fail(MotorInitError error, uint32_t now_us);
+
+    Step steps[3];          // Sequence being run
+    uint8_t count;          // Steps in the sequence
+    uint8_t index;          // Current step
+    uint8_t attempt;        // Attempt of the current step, from 1
+    byte motor_id;          // Driver being recovered
+    bool running;           // A sequence is in progress
+    bool awaiting;          // The current step was written and waits for its read-back
+    bool replied;           // The read-back of the current step arrived
+    uint32_t reply_value;   // Value of that read-back
+    uint32_t sent_us;       // Time the current step was written
+    uint32_t start_us;      // Time begin() was called
+};
+
 // Global variables for system state tracking
 extern HardwareSerial motorSerial;           // Global instance of hardware serial for motor communications
 extern MotorController motorController;      // Global instance of the motor controller
@@ -49,16 +122,32 @@ extern double theta;                         // Current orientation of the robot
 extern bool initial_data_received;           // Flag to check if initial data has been received
 extern unsigned long last_receive_time;      // Timestamp of the last received data
 
-extern VelocityCommand currentCommand;       // Current velocity command being processed
+extern VelocityCommand currentCommand;       // Last twist sent to the driver, zero while inhibited
+extern float commandedWheelSpeed;            // Last wheel speed sent to the driver in m/s, driver direction
+extern volatile uint8_t motorInhibit;        // MOTOR_INHIBIT_* bits, while any is set velocity commands are replaced by zero
+extern MotorInitResult motorInitResult;      // Outcome of the last motor initialization
+extern MotorSupervisor motorSupervisor;      // Detects driver faults and re-enables the driver
+extern MotorRecovery motorRecovery;          // Re-enable sequence started by the supervisor or an e-stop re-arm
 
 // Function prototypes for UART and motor initialization and command transmission
 void initializeUART();                                   // Initializes UART for communication
-void initMotor(HardwareSerial& serial, byte motorID);    // Initializes motor controller settings
+bool initMotor(HardwareSerial& serial, byte motorID);    // Initializes and verifies motor controller settings
+bool enableMotor(HardwareSerial& serial, byte motorID);  // Resets a driver fault and repeats the enable steps of initMotor()
+void pollMotorStatus(byte motorID);                       // Requests the status word and fault code, replies are read by the wheel stream
+void readMotorReplies(HardwareSerial& serial, byte motorID); // Passes the queued replies to the recovery and the supervisor
+bool superviseMotor(HardwareSerial& serial, byte motorID); // Runs the due supervisor action, returns true when the health changed
+bool receiveMotorFrame(HardwareSerial& serial, uint8_t* frame, uint32_t timeoutMs); // Waits for a frame with a valid checksum
+size_t describeMotorInit(char* buf, size_t len);         // Writes a key=value summary of motorInitResult
 void sendMotorCommands(float linearVelocity, float angularVelocity);  // Sends velocity commands to the motor
+void inhibitMotors(uint8_t reason);                       // Stops the wheels and holds them stopped for reason
+void releaseMotors(uint8_t reason);                       // Clears reason, the wheels move again with the next command
 uint32_t velocityToDEC(float velocityMPS);                // Converts velocity from m/s to a DEC value
 void sendVelocityDEC(HardwareSerial& serial, int velocityDec, byte motorID); // Sends velocity in DEC format
 
-float readSpeedData(HardwareSerial& serial, byte motorID);    // Reads speed data from motor
+bool readSpeedData(HardwareSerial& serial, byte motorID, float& speed); // Reads the wheel speed in m/s, false if no reply arrived
+bool readPositionData(HardwareSerial& serial, byte motorID, int32_t& position, uint32_t& sampleTime); // Reads the encoder position
+float speedRegisterVariance();                               // Variance of readSpeedData() from its RPM quantization
+float metersPerCount();                                      // Wheel travel per encoder count in meters
 uint32_t reverseBytes(uint32_t value);                       // Utility function to reverse byte order
 float calculateVelocityMPS(int32_t dec);                     // Calculates velocity in m/s from DEC value
 
@@ -75,36 +164,72 @@ constexpr uint16_t EMERGENCY_STOP_ADDRESS = 0x701F;
 constexpr uint16_t CONTROL_WORD_ADDRESS = 0x7019;
 constexpr uint16_t TARGET_VELOCITY_DEC_ADDRESS = 0x70B2;
 constexpr uint16_t ACTUAL_SPEED_DEC_ADDRESS = 0x7077;
+constexpr uint16_t ACTUAL_POSITION_ADDRESS = 0x7071;
+constexpr uint16_t STATUS_WORD_ADDRESS = 0x7041;
+constexpr uint16_t FAULT_CODE_ADDRESS = 0x703F;
+
+// Reasons for holding the wheels stopped, bits of motorInhibit
+constexpr uint8_t MOTOR_INHIBIT_DEFERRED = 1 << 0;  // Deferred work that needs the robot still
+constexpr uint8_t MOTOR_INHIBIT_LINK = 1 << 1;      // Link quality below the configured limits
+constexpr uint8_t MOTOR_INHIBIT_FAULT = 1 << 2;     // Driver faulted or stopped, until the supervisor re-enabled it
+constexpr uint8_t MOTOR_INHIBIT_ESTOP = 1 << 3;     // Hardware e-stop latched, until it is re-armed
 
 // Command definitions for motor control
 constexpr byte MOTOR_SETUP_COMMAND = 0x51;
 constexpr byte MOTOR_ENABLE_COMMAND = 0x52;
 constexpr byte VEL_SEND_COMMAND = 0x54;
 constexpr byte READ_COMMAND = 0x52;
-constexpr byte READ_DEC_COMMAND = 0xA0;
-constexpr byte READ_DEC_SUCCESS = 0xA4;
+constexpr byte READ_DEC_COMMAND = MOTOR_READ_REQUEST;
+constexpr byte READ_DEC_SUCCESS = MOTOR_READ_REPLY;
 
 // Default values for motor operations
 constexpr uint32_t OPERATION_MODE_SPEED_CONTROL = 0x00000003;
 constexpr uint32_t DISABLE_EMERGENCY_STOP = 0x00000000;
 constexpr uint32_t ENABLE_MOTOR = 0x0000000F;
+constexpr uint32_t FAULT_RESET = 0x00000080;
+constexpr uint32_t DISABLE_MOTOR = 0x00000006;
 constexpr uint32_t NO_DATA = 0x00000000;
 
+// Typed register map of the motor driver
+typedef MotorRegister<OPERATION_MODE_ADDRESS, MOTOR_READ_WRITE, uint32_t, MOTOR_SETUP_COMMAND> OperationModeRegister;
+typedef MotorRegister<EMERGENCY_STOP_ADDRESS, MOTOR_READ_WRITE, uint32_t, MOTOR_SETUP_COMMAND> EmergencyStopRegister;
+typedef MotorRegister<CONTROL_WORD_ADDRESS, MOTOR_READ_WRITE, uint32_t, MOTOR_ENABLE_COMMAND> ControlWordRegister;
+typedef MotorRegister<TARGET_VELOCITY_DEC_ADDRESS, MOTOR_READ_WRITE, int32_t, VEL_SEND_COMMAND> TargetVelocityRegister;
+typedef MotorRegister<ACTUAL_SPEED_DEC_ADDRESS, MOTOR_READ_ONLY, int32_t, MOTOR_NO_WRITE> ActualSpeedRegister;
+typedef MotorRegister<ACTUAL_POSITION_ADDRESS, MOTOR_READ_ONLY, int32_t, MOTOR_NO_WRITE> ActualPositionRegister;
+typedef MotorRegister<STATUS_WORD_ADDRESS, MOTOR_READ_ONLY, uint32_t, MOTOR_NO_WRITE> StatusWordRegister;
+typedef MotorRegister<FAULT_CODE_ADDRESS, MOTOR_READ_ONLY, uint32_t, MOTOR_NO_WRITE> FaultCodeRegister;
+
+// Frames that never change, encoded with their checksums at compile time
+constexpr MotorFrame OPERATION_MODE_FRAME = motorWriteFrame<OperationModeRegister>(MOTOR_ID, OPERATION_MODE_SPEED_CONTROL);
+constexpr MotorFrame EMERGENCY_STOP_FRAME = motorWriteFrame<EmergencyStopRegister>(MOTOR_ID, DISABLE_EMERGENCY_STOP);
+constexpr MotorFrame ENABLE_MOTOR_FRAME = motorWriteFrame<ControlWordRegister>(MOTOR_ID, ENABLE_MOTOR);
+constexpr MotorFrame SPEED_READ_FRAME = motorReadFrame<ActualSpeedRegister>(MOTOR_ID);
+constexpr MotorFrame POSITION_READ_FRAME = motorReadFrame<ActualPositionRegister>(MOTOR_ID);
+constexpr MotorFrame FAULT_RESET_FRAME = motorWriteFrame<ControlWordRegister>(MOTOR_ID, FAULT_RESET);
+constexpr MotorFrame STATUS_READ_FRAME = motorReadFrame<StatusWordRegister>(MOTOR_ID);
+constexpr MotorFrame FAULT_CODE_READ_FRAME = motorReadFrame<FaultCodeRegister>(MOTOR_ID);
+constexpr MotorFrame TARGET_VELOCITY_READ_FRAME = motorReadFrame<TargetVelocityRegister>(MOTOR_ID);
+constexpr MotorFrame STOP_VELOCITY_FRAME = motorWriteFrame<TargetVelocityRegister>(MOTOR_ID, 0);
+constexpr MotorFrame DISABLE_MOTOR_FRAME = motorWriteFrame<ControlWordRegister>(MOTOR_ID, DISABLE_MOTOR);
+
 // Communication settings
 constexpr int BAUD_RATE = 115200;  // UART baud rate
-constexpr byte ERROR_BYTE = 0x00;  // Default error byte, adjust as needed
+constexpr byte ERROR_BYTE = MOTOR_FRAME_ERROR_BYTE;  // Default error byte, adjust as needed
+constexpr uint32_t MOTOR_FRAME_TX_US = MOTOR_FRAME_SIZE * 10 * 1000000UL / BAUD_RATE; // Time on the wire of one frame (8N1)
 
 // Timing settings for motor commands
-constexpr uint16_t COMMAND_DELAY = 100;           // Delay between commands in milliseconds
+constexpr uint16_t MOTOR_REPLY_TIMEOUT = 10;      // Default wait for a driver reply in milliseconds
+constexpr uint8_t MOTOR_INIT_ATTEMPTS = 3;        // Attempts per initialization step before giving up
 constexpr uint32_t SEND_INTERVAL = 1000;          // Interval for sending speed commands in milliseconds
 
 // Motor specifications
+// Defaults, the values in use are controlParams.wheel_radius and controlParams.wheel_distance
 constexpr float WHEEL_RADIUS = 0.055;            // Radius of the wheel in meters
 constexpr float WHEEL_DISTANCE = 0.202;          // Distance between wheels in meters
+constexpr uint32_t ENCODER_COUNTS_PER_REV = 4096; // Position register counts per wheel revolution
 
 #define RECEIVE_TIMEOUT 5000 // Timeout value in milliseconds for receiving data
 #define SCALE_FACTOR 1000    // Factor to scale values for integer calculations
 
-const float WHEEL_CIRCUMFERENCE = WHEEL_RADIUS * 2 * PI / 60.0 * SCALE_FACTOR; // Calculates wheel circumference
-
 #endif // MOTOR_CONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,156 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOTOR_GROUP_H
+#define MOTOR_GROUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class HardwareSerial;
+
+// Bus layout, override with build flags. The group only drives the bus in
+// builds with -DMOTOR_BUS, otherwise the board drives the single MOTOR_ID.
+#define MOTOR_LAYOUT_SKID4 0 // Four wheels with fixed axles, IDs 1-4 front left, front right, rear left, rear right
+#define MOTOR_LAYOUT_MECANUM4 1 // Four mecanum wheels with 45 degree rollers, same IDs and order
+#ifndef MOTOR_BUS_LAYOUT
+#define MOTOR_BUS_LAYOUT MOTOR_LAYOUT_SKID4 // Layout configured by initMotorGroup()
+#endif
+#ifndef MOTOR_BUS_WHEELBASE
+#define MOTOR_BUS_WHEELBASE 0.2f // Distance between the front and rear axles in meters
+#endif
+
+#define MOTOR_GROUP_MAX 8 // Maximum number of drivers on one bus
+#define MOTOR_BUS_REPLY_LATENCY_US 1000 // Worst-case time a driver takes to start its reply
+#define MOTOR_BUS_GUARD_US 100 // Idle time after each slot for the RS485 direction turnaround
+#define MOTOR_BUS_TASK_PRIORITY 6 // FreeRTOS priority, above the control executor task
+#define MOTOR_BUS_TASK_CORE 0 // Core running the bus task, the control task keeps core 1
+#define MOTOR_BUS_TASK_STACK_SIZE 4096 // Stack size in bytes of the bus task
+#define MOTOR_GROUP_BUFFER_SIZE 256 // Size of the group summary string
+
+// One driver on the bus and where its wheel sits on the base
+struct MotorConfig {
+    uint8_t id;       // Motor ID byte of the frames
+    float x;          // Wheel contact point ahead of the base center in meters
+    float y;          // Wheel contact point left of the base center in meters
+    float drive_x;    // Base x velocity per m/s of positive driver speed, -1 for mirrored mounts
+    float drive_y;    // Base y velocity per m/s of positive driver speed, non-zero for mecanum and omni wheels
+};
+
+// Latest speed reply of one driver
+struct MotorFeedback {
+    float speed;          // Wheel speed in m/s, driver direction
+    uint32_t sample_us;   // Time the reply was received
+    uint32_t replies;     // Read slots answered since configure()
+    uint32_t misses;      // Read slots without a valid reply since configure()
+    bool valid;           // True if the last read slot was answered
+};
+
+// Use of a slot of the bus cycle
+enum MotorSlotType : uint8_t {
+    MOTOR_SLOT_WRITE = 0,  // Target velocity frame, the driver does not reply
+    MOTOR_SLOT_READ = 1,   // Speed request and its reply
+};
+
+// Reserved window of the bus cycle, relative to the cycle start
+struct MotorSlot {
+    MotorSlotType type;   // Frames exchanged in the slot
+    uint8_t motor;        // Index of the driver in the group
+    uint32_t offset_us;   // Start of the slot
+    uint32_t length_us;   // Duration including the guard time
+};
+
+// Maps a base twist to the target speed of every driver of configs, in m/s and driver direction
+typedef void (*MotorKinematics)(const MotorConfig *configs, uint8_t count,
+                                float vx, float vy, float wz, float *targets);
+
+// Rigid-base kinematics: each wheel drives along (drive_x, drive_y) at its
+// contact point, which covers differential, skid-steer, mecanum and omni bases
+void planarKinematics(const MotorConfig *configs, uint8_t count,
+                      float vx, float vy, float wz, float *targets);
+
+// Several drivers sharing one half-duplex UART. The bus cycle gives every
+// driver a write slot followed by a read slot, each sized for its frames on
+// the wire, so a request is never sent while another driver replies. Not
+// locked; the bus task writes the feedback and the control task reads it.
+class MotorGroup {
+public:
+    MotorGroup();  // Constructor
+
+    // Sets the drivers and builds the slot plan for frames of frame_us on the
+    // wire. Returns false, keeping no drivers, for zero or more than MOTOR_GROUP_MAX.
+    bool configure(const MotorConfig *configs, uint8_t count, uint32_t frame_us);
+
+    // Replaces the kinematics, nullptr restores planarKinematics
+    void setKinematics(MotorKinematics kinematics);
+
+    // Sets the targets of every driver from a base twist
+    void setTwist(float vx, float vy, float wz);
+
+    // Least-squares base twist from the answered drivers, false without any.
+    // A component the layout cannot observe, such as vy of a skid-steer base, is zero.
+    bool estimateTwist(float &vx, float &vy, float &wz) const;
+
+    // Records the outcome of the read slot of a driver
+    void onReply(uint8_t motor, float speed, uint32_t now_us);
+    void onMiss(uint8_t motor);
+
+    uint8_t count() const { return motors; }
+    const MotorConfig &config(uint8_t motor) const { return configs[motor]; }
+    float target(uint8_t motor) const { return targets[motor]; }
+    const MotorFeedback &feedback(uint8_t motor) const { return feedbacks[motor]; }
+
+    uint8_t slotCount() const { return (uint8_t)(2 * motors); }
+    const MotorSlot &slot(uint8_t index) const { return slots[index]; }
+    uint32_t cycleLength() const { return cycle_us; }
+
+    // True if the whole cycle fits in period_us
+    bool fits(uint32_t period_us) const { return cycle_us <= period_us; }
+
+    // Writes the plan and the feedback counters as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    MotorConfig configs[MOTOR_GROUP_MAX];        // Drivers in bus order
+    MotorFeedback feedbacks[MOTOR_GROUP_MAX];    // Latest reply of each driver
+    volatile float targets[MOTOR_GROUP_MAX];     // Target speed of each driver in m/s
+    MotorSlot slots[2 * MOTOR_GROUP_MAX];        // Write and read slot of each driver
+    MotorKinematics kinematics;                  // Twist to driver targets
+    uint32_t cycle_us;                           // Length of the whole cycle
+    uint8_t motors;                              // Number of configured drivers
+};
+
+extern MotorGroup motorGroup;
+
+// Configures motorGroup with MOTOR_BUS_LAYOUT and initializes every driver
+// with initMotor(). Returns false if any driver failed.
+bool initMotorGroup(HardwareSerial &serial);
+
+// Sets the group targets from a base twist, zero while motorInhibit is set
+void sendMotorTwist(float vx, float vy, float wz);
+
+// Runs one bus cycle starting at start_us, returns once its last slot ended.
+// Waits for a reply block on the UART and gaps of a tick or more sleep, so
+// the tasks of lower priority on the core keep running during the cycle.
+// While motorInhibit is set the write slots send zero.
+void runMotorBusCycle(HardwareSerial &serial, uint32_t start_us);
+
+// Starts the task running a bus cycle every wheel period, paced from the
+// previous wake so the cycle time does not add to the period. The cycle pauses
+// while the e-stop is latched so the re-arm can enable the drivers.
+void startMotorBusTask();
+void motorBusTask(void *param);
+
+#endif // MOTOR_GROUP_H
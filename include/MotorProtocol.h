@@ -0,0 +1,103 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOTOR_PROTOCOL_H
+#define MOTOR_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Frame layout: id, command, address high, address low, error byte,
+// big-endian 32-bit data and an 8-bit sum of the first nine bytes
+constexpr size_t MOTOR_FRAME_SIZE = 10;
+constexpr size_t MOTOR_CHECKSUM_INDEX = MOTOR_FRAME_SIZE - 1;
+constexpr uint8_t MOTOR_FRAME_ERROR_BYTE = 0x00;  // Error byte of frames sent to the driver
+constexpr uint8_t MOTOR_READ_REQUEST = 0xA0;      // Command of a register read request
+constexpr uint8_t MOTOR_READ_REPLY = 0xA4;        // Command of a successful read reply
+constexpr uint8_t MOTOR_NO_WRITE = 0x00;          // Write command of read-only registers
+
+// One encoded frame, ready to be written to the UART in a single call
+struct MotorFrame {
+    uint8_t bytes[MOTOR_FRAME_SIZE];
+};
+
+// Allowed directions of a register
+enum MotorRegisterAccess : uint8_t {
+    MOTOR_READ_ONLY,
+    MOTOR_WRITE_ONLY,
+    MOTOR_READ_WRITE,
+};
+
+// Describes a driver register: its object address, the access it allows,
+// the C++ type of its value and the command byte used to write it
+template <uint16_t Address, MotorRegisterAccess Access, typename Value, uint8_t WriteCommand>
+struct MotorRegister {
+    typedef Value value_type;
+    static constexpr uint16_t address = Address;
+    static constexpr MotorRegisterAccess access = Access;
+    static constexpr uint8_t write_command = WriteCommand;
+};
+
+// Sum of the first nine bytes, written as the last byte of a frame
+constexpr uint8_t motorFrameChecksum(uint8_t motorID, uint8_t command, uint16_t address, uint32_t data) {
+    return (uint8_t)(motorID + command + (address >> 8) + (address & 0xFF) + MOTOR_FRAME_ERROR_BYTE +
+                     (data >> 24) + ((data >> 16) & 0xFF) + ((data >> 8) & 0xFF) + (data & 0xFF));
+}
+
+// Encodes any frame; a single expression so it also evaluates at compile time under C++11
+constexpr MotorFrame encodeMotorFrame(uint8_t motorID, uint8_t command, uint16_t address, uint32_t data) {
+    return MotorFrame{{motorID, command, (uint8_t)(address >> 8), (uint8_t)(address & 0xFF), MOTOR_FRAME_ERROR_BYTE,
+                       (uint8_t)(data >> 24), (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)data,
+                       motorFrameChecksum(motorID, command, address, data)}};
+}
+
+// Encodes a write of value to register Reg
+template <typename Reg>
+constexpr MotorFrame motorWriteFrame(uint8_t motorID, typename Reg::value_type value) {
+    static_assert(Reg::access != MOTOR_READ_ONLY, "register is read-only");
+    return encodeMotorFrame(motorID, Reg::write_command, Reg::address, (uint32_t)value);
+}
+
+// Encodes a read request of register Reg
+template <typename Reg>
+constexpr MotorFrame motorReadFrame(uint8_t motorID) {
+    static_assert(Reg::access != MOTOR_WRITE_ONLY, "register is write-only");
+    return encodeMotorFrame(motorID, MOTOR_READ_REQUEST, Reg::address, 0);
+}
+
+// True if the last byte of frame is the sum of the first nine
+inline bool motorFrameChecksumValid(const uint8_t *frame) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < MOTOR_CHECKSUM_INDEX; i++) {
+        sum += frame[i];
+    }
+    return sum == frame[MOTOR_CHECKSUM_INDEX];
+}
+
+// Decodes the read reply of register Reg from motorID.
+// Returns false if the frame is a reply of another motor, command or register.
+template <typename Reg>
+bool decodeMotorReadReply(const uint8_t *frame, uint8_t motorID, typename Reg::value_type &value) {
+    static_assert(Reg::access != MOTOR_WRITE_ONLY, "register is write-only");
+    uint16_t address = ((uint16_t)frame[2] << 8) | frame[3];
+    if (frame[0] != motorID || frame[1] != MOTOR_READ_REPLY || address != Reg::address) {
+        return false;
+    }
+    uint32_t raw = ((uint32_t)frame[5] << 24) | ((uint32_t)frame[6] << 16) | ((uint32_t)frame[7] << 8) | frame[8];
+    value = (typename Reg::value_type)raw;
+    return true;
+}
+
+#endif // MOTOR_PROTOCOL_H
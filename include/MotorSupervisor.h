@@ -0,0 +1,135 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOTOR_SUPERVISOR_H
+#define MOTOR_SUPERVISOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bits of the driver status word (STATUS_WORD_ADDRESS)
+#define MOTOR_STATUS_ENABLED 0x0004 // Operation enabled, the driver follows the target velocity
+#define MOTOR_STATUS_FAULT 0x0008 // Fault latched, the code is in FAULT_CODE_ADDRESS
+#define MOTOR_STATUS_EMERGENCY_STOP 0x0020 // Emergency stop active
+
+// Bits of the driver fault code (FAULT_CODE_ADDRESS)
+#define MOTOR_FAULT_OVERCURRENT 0x0001 // Phase overcurrent
+#define MOTOR_FAULT_OVERVOLTAGE 0x0002 // Bus overvoltage, e.g. from regenerative braking
+#define MOTOR_FAULT_UNDERVOLTAGE 0x0004 // Bus undervoltage
+#define MOTOR_FAULT_OVERTEMPERATURE 0x0008 // Driver or motor overtemperature
+#define MOTOR_FAULT_OVERLOAD 0x0010 // Sustained overload
+#define MOTOR_FAULT_ENCODER 0x0020 // Encoder signal lost
+#define MOTOR_FAULT_HALL 0x0040 // Hall sensor error
+#define MOTOR_FAULT_PERMANENT (MOTOR_FAULT_ENCODER | MOTOR_FAULT_HALL) // Faults a re-enable cannot clear
+
+#define MOTOR_STATUS_PERIOD 100 // Default status poll period of the wheel stream in milliseconds
+#define MOTOR_STATUS_TIMEOUT_POLLS 5 // Unanswered status polls before the driver counts as lost
+#define MOTOR_RETRY_MIN 10 // Delay before the second recovery attempt in milliseconds
+#define MOTOR_RETRY_MAX 1000 // Default upper bound of the doubling recovery delay in milliseconds
+#define MOTOR_EVENT_BUFFER_SIZE 256 // Size of the published motor event summary
+
+// Supervision state of the driver
+enum MotorHealth : uint8_t {
+    MOTOR_HEALTH_OK = 0,         // Enabled and without fault
+    MOTOR_HEALTH_FAULT = 1,      // Faulted or stopped, waiting for the next recovery attempt
+    MOTOR_HEALTH_CONFIRM = 2,    // Re-enabled, waiting for a status reply to confirm it
+    MOTOR_HEALTH_FAILED = 3,     // Permanent fault, the wheel stays stopped until a reboot
+};
+
+// Cause of the current or last fault
+enum MotorFaultCause : uint8_t {
+    MOTOR_CAUSE_NONE = 0,        // No fault seen yet
+    MOTOR_CAUSE_FAULT = 1,       // Status word reported a fault
+    MOTOR_CAUSE_STOPPED = 2,     // Driver left the enabled state, e.g. emergency stop
+    MOTOR_CAUSE_LOST = 3,        // No status reply within the timeout
+    MOTOR_CAUSE_INIT = 4,        // Initialization at boot failed
+};
+
+// Work the supervisor asks its caller to do now
+enum MotorAction : uint8_t {
+    MOTOR_ACTION_NONE = 0,       // Nothing to do
+    MOTOR_ACTION_POLL = 1,       // Request the status word and fault code
+    MOTOR_ACTION_ENABLE = 2,     // Reset the fault and run the enable sequence
+    MOTOR_ACTION_INIT = 3,       // Run the complete initialization, the driver may have restarted
+};
+
+// Counters since boot and the last fault
+struct MotorSupervisorStats {
+    uint32_t faults;             // Faults detected
+    uint32_t recoveries;         // Faults recovered without a reboot
+    uint32_t attempts;           // Recovery attempts, successful or not
+    uint32_t last_status;        // Last status word received
+    uint32_t last_fault_code;    // Last nonzero fault code received
+    uint32_t last_downtime_us;   // Fault detection to confirmed recovery of the last fault
+    uint32_t max_downtime_us;    // Longest downtime since boot
+    MotorFaultCause cause;       // Cause of the current or last fault
+};
+
+// Watches the status word and fault code of the motor driver and decides
+// when to re-enable it. A fault is retried at once, so a transient trip such
+// as an overcurrent costs one enable sequence; each failed attempt doubles
+// the delay to the next one up to the configured maximum. The wheel is
+// released only after a status reply confirms the driver is enabled again.
+class MotorSupervisor {
+public:
+    MotorSupervisor();  // Constructor
+
+    // Sets the poll period, the status timeout and the longest retry delay, 0 disables the timeout
+    void configure(uint32_t poll_period_us, uint32_t status_timeout_us, uint32_t retry_max_us);
+
+    // Starts supervision after the boot initialization, a failed one is retried like a lost driver
+    void start(bool initialized, uint32_t now_us);
+
+    // Records a status word or fault code reply received at now_us
+    void onStatus(uint32_t status, uint32_t now_us);
+    void onFaultCode(uint32_t code, uint32_t now_us);
+
+    // Records the outcome of a MOTOR_ACTION_ENABLE or MOTOR_ACTION_INIT finished at now_us
+    void onRecovery(bool ok, uint32_t now_us);
+
+    // Returns the work due at now_us, MOTOR_ACTION_POLL is counted as sent
+    MotorAction next(uint32_t now_us);
+
+    MotorHealth health() const { return state; }
+    bool isStopped() const { return state != MOTOR_HEALTH_OK; }  // True while the wheel must be held
+    const MotorSupervisorStats &stats() const { return counters; }
+
+    // Returns true once per change of health(), for publishing events
+    bool takeEvent();
+
+    // Writes the health and counters as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    void enterFault(MotorFaultCause cause, uint32_t now_us);
+    void retryLater(uint32_t now_us);
+    void setState(MotorHealth next_state);
+
+    uint32_t poll_period_us;     // Interval between status polls
+    uint32_t status_timeout_us;  // Silence after which the driver is lost
+    uint32_t retry_max_us;       // Longest recovery delay
+    bool started;                // start() was called
+    MotorHealth state;           // Current health
+    bool event;                  // health() changed since takeEvent()
+    bool confirm_polled;         // The confirming poll was sent
+    uint32_t last_poll_us;       // Time of the last poll
+    uint32_t last_reply_us;      // Time of the last status reply
+    uint32_t fault_start_us;     // Detection time of the current fault
+    uint32_t retry_at_us;        // Time of the next recovery attempt
+    uint32_t retry_delay_us;     // Delay after the next failed attempt
+    MotorSupervisorStats counters;
+};
+
+#endif // MOTOR_SUPERVISOR_H
@@ -0,0 +1,109 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RATE_CALIBRATION_H
+#define RATE_CALIBRATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AUTO_RATES 1 // Default of the auto_rates parameter, 1 selects the stream periods at boot
+#define RATE_CPU_BUDGET 60 // Default share of the control task the streams may use in percent
+#define RATE_LINK_BUDGET 50 // Default share of the agent link and motor UART the streams may use in percent
+#define RATE_CALIBRATION_SAMPLES 20 // Motor reads, IMU reads and publishes measured at boot
+#define RATE_CALIBRATION_PINGS 5 // Agent pings measured at boot, the fastest is kept
+#define RATE_PING_TIMEOUT 100 // Wait for one agent ping reply in milliseconds
+#define RATE_MOTOR_RTT_MARGIN 2 // The wheel period must exceed the motor round trip this many times
+#define RATE_MOTOR_FRAMES_PER_TICK 4 // Frames on the motor UART per wheel tick: speed read, velocity write and replies
+#define RATE_LEVEL_COUNT 5 // Entries of the rate ladder
+#define RATE_BUFFER_SIZE 320 // Size of the published rate selection summary
+
+// One step of the rate ladder, fastest first. The streams move together so
+// the IMU keeps its oversampling and the phase offsets stay valid.
+struct RateLevel {
+    uint16_t wheel_ms;        // Wheel stream period
+    uint16_t imu_sample_ms;   // IMU sampling stream period
+    uint16_t imu_publish_ms;  // IMU publish stream period
+};
+
+// Boot measurements, 0 marks a measurement that failed
+struct RateMeasurements {
+    uint32_t motor_rtt_us;    // Longest speed read round trip to the driver
+    uint32_t imu_read_us;     // Longest IMU read and filter update, 0 without IMU
+    uint32_t agent_rtt_us;    // Fastest agent ping round trip
+    uint32_t wheel_cpu_us;    // Control task time spent publishing one wheel tick
+    uint32_t wheel_link_us;   // Link time of one wheel tick, from the publish until the agent has it
+    uint32_t imu_cpu_us;      // Control task time spent publishing one IMU message
+    uint32_t imu_link_us;     // Link time of one IMU message
+};
+
+// Budget that ruled out the next faster level
+enum RateLimit : uint8_t {
+    RATE_LIMIT_NONE = 0,       // The fastest level fits
+    RATE_LIMIT_MOTOR_RTT = 1,  // Motor replies would not arrive before the next wheel tick
+    RATE_LIMIT_MOTOR_BUS = 2,  // Motor UART utilization over the link budget
+    RATE_LIMIT_CPU = 3,        // Control task utilization over the CPU budget
+    RATE_LIMIT_LINK = 4,       // Agent link utilization over the link budget
+    RATE_LIMIT_UNMEASURED = 5, // The driver or the agent did not reply, nothing was selected
+};
+
+// Outcome of select()
+struct RateSelection {
+    bool selected;             // False if measurements were missing, the periods are then unchanged
+    bool within_budget;        // False if even the slowest level exceeds a budget
+    uint8_t level;             // Index into the rate ladder
+    RateLevel rates;           // Chosen periods
+    RateLimit limit;           // Why no faster level was chosen
+    uint16_t cpu_permille;     // Control task utilization at the chosen level
+    uint16_t link_permille;    // Agent link utilization at the chosen level
+    uint16_t motor_permille;   // Motor UART utilization at the chosen level
+};
+
+// Picks the fastest stream periods the measured hardware sustains. A level
+// fits when the wheel period leaves RATE_MOTOR_RTT_MARGIN motor round trips,
+// the motor UART and the agent link stay within the link budget and the
+// control task stays within the CPU budget.
+class RateCalibration {
+public:
+    RateCalibration();  // Constructor
+
+    // Sets the budgets in percent, the wire time of one motor frame and
+    // whether the IMU streams run on this board
+    void configure(uint8_t cpu_budget_pct, uint8_t link_budget_pct, uint32_t motor_frame_us, bool has_imu);
+
+    // Evaluates the ladder for m, returns true if a level was selected
+    bool select(const RateMeasurements &m);
+
+    const RateMeasurements &measurements() const { return measured; }
+    const RateSelection &selection() const { return result; }
+
+    // Writes the measurements and the selection as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+    static const RateLevel LEVELS[RATE_LEVEL_COUNT];  // The rate ladder
+
+private:
+    // Checks level against the budgets, fills the utilizations of sel
+    RateLimit evaluate(const RateLevel &level, RateSelection &sel) const;
+
+    uint16_t cpu_budget_permille;   // Control task budget
+    uint16_t link_budget_permille;  // Agent link and motor UART budget
+    uint32_t motor_frame_us;        // Wire time of one motor frame
+    bool has_imu;                   // IMU streams are counted
+    RateMeasurements measured;      // Input of the last select()
+    RateSelection result;           // Output of the last select()
+};
+
+#endif // RATE_CALIBRATION_H
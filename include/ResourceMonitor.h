@@ -0,0 +1,110 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RESOURCE_MONITOR_H
+#define RESOURCE_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MONITOR_MAX_TASKS 32 // Task slots per sample, must exceed the number of running tasks
+#define MONITOR_TASK_NAME_SIZE 16 // configMAX_TASK_NAME_LEN of ESP-IDF
+#define MONITOR_CORES 2 // Cores of the ESP32
+#define MONITOR_PERIOD 5000 // Interval between samples and published summaries in milliseconds
+#define MONITOR_BUFFER_SIZE 512 // Size of the published summary string
+#define STACK_WARN_BYTES 512 // Warn when a task has less unused stack than this
+#define HEAP_WARN_BYTES 16384 // Warn when the lowest free heap since boot drops below this
+#define IDLE_WARN_PERMILLE 200 // Warn when a core is idle less than this (20.0 %)
+#define MONITOR_CORE_UNKNOWN 0xFF // Core of tasks that are not pinned or not reported
+
+// Bits of ResourceMonitor::warnings()
+constexpr uint32_t RESOURCE_WARN_STACK = 1u << 0; // A task is close to overflowing its stack
+constexpr uint32_t RESOURCE_WARN_HEAP = 1u << 1;  // The heap low-water mark is below HEAP_WARN_BYTES
+constexpr uint32_t RESOURCE_WARN_IDLE = 1u << 2;  // A core has less than IDLE_WARN_PERMILLE idle time
+
+// State of one task as read from FreeRTOS
+struct TaskSnapshot {
+    uint32_t id;                 // xTaskNumber, unique for the lifetime of the task
+    const char *name;            // Task name
+    uint8_t core;                // Pinned core or MONITOR_CORE_UNKNOWN
+    bool idle;                   // True for the idle task of core
+    uint32_t runtime;            // Run time counter
+    uint32_t stack_free_bytes;   // Stack high-water mark in bytes
+};
+
+// Heap statistics in bytes
+struct HeapSnapshot {
+    uint32_t free_bytes;     // Currently free
+    uint32_t min_free_bytes; // Lowest free since boot
+    uint32_t largest_block;  // Largest allocatable block
+};
+
+// Tracks CPU load per task and idle time per core from the FreeRTOS run time
+// counters, stack high-water marks and heap statistics. Loads are the change
+// of each counter between two samples relative to the change of the total,
+// so they describe the last sampling period.
+class ResourceMonitor {
+public:
+    ResourceMonitor();  // Constructor
+
+    // Reads the FreeRTOS task list and heap, then calls update().
+    // Task data needs configUSE_TRACE_FACILITY, loads need configGENERATE_RUN_TIME_STATS.
+    void sample();
+
+    // Computes loads against the previous snapshot and re-evaluates the warnings
+    void update(const TaskSnapshot *tasks, size_t count, uint32_t total_runtime, const HeapSnapshot &heap);
+
+    // Results per task of the last sample, loads in permille of one core, index < taskCount()
+    size_t taskCount() const { return task_count; }
+    const char *taskName(size_t index) const { return tasks[index].name; }
+    uint16_t taskLoad(size_t index) const { return tasks[index].load_permille; }
+    uint32_t taskStackFree(size_t index) const { return tasks[index].stack_free_bytes; }
+
+    // Idle time of core in permille, 0 until two samples with run time stats exist
+    uint16_t idleLoad(uint8_t core) const { return idle_permille[core]; }
+
+    // Records the duration of setup(), reported from then on
+    void setBootTime(uint32_t boot_ms) { boot_time_ms = boot_ms; }
+
+    bool hasLoads() const { return loads_valid; }
+    uint32_t warnings() const { return warn; }
+
+    // Writes a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    struct TaskState {
+        uint32_t id;                          // xTaskNumber
+        char name[MONITOR_TASK_NAME_SIZE];    // Copy of the task name
+        uint8_t core;                         // Pinned core or MONITOR_CORE_UNKNOWN
+        uint32_t runtime;                     // Run time counter at the last sample
+        uint16_t load_permille;               // Load over the last period
+        uint32_t stack_free_bytes;            // Stack high-water mark in bytes
+    };
+
+    TaskState tasks[MONITOR_MAX_TASKS];  // Tasks of the last sample
+    size_t task_count;                   // Valid entries in tasks
+    uint32_t last_total;                 // Total run time at the last sample
+    bool has_sample;                     // True once a previous sample exists
+    bool loads_valid;                    // True when loads cover a full period
+    uint16_t idle_permille[MONITOR_CORES]; // Idle time per core
+    HeapSnapshot heap;                   // Heap statistics of the last sample
+    uint32_t warn;                       // RESOURCE_WARN_* bits
+    uint32_t boot_time_ms;               // Duration of setup(), 0 until set
+};
+
+extern ResourceMonitor resourceMonitor;
+
+#endif // RESOURCE_MONITOR_H
@@ -22,18 +22,65 @@
 #include <rcl/error_handling.h>
 #include <rclc/rclc.h>
 #include <rclc/executor.h>
+#include <rclc_parameter/rclc_parameter.h>
 #include "rcutils/time.h"
 #include <geometry_msgs/msg/twist.h>
 #include <geometry_msgs/msg/twist_stamped.h>
+#include <geometry_msgs/msg/twist_with_covariance_stamped.h>
 #include <sensor_msgs/msg/imu.h>
 #include <std_msgs/msg/int32.h>
+#include <std_msgs/msg/int32_multi_array.h>
 #include <std_msgs/msg/string.h>
+#include <std_msgs/msg/u_int8_multi_array.h>
 #include <std_srvs/srv/trigger.h>
+#include "LatencyStats.h"
+#include "StreamScheduler.h"
+#include "ResourceMonitor.h"
+#include "VelocityEstimator.h"
+#include "DeferredWork.h"
+#include "LinkMonitor.h"
+#include "SubscriptionStats.h"
+#include "ImuBatch.h"
+#include "RateCalibration.h"
+#include "DebugOutput.h"
 
 // Constants for system-wide parameters
-#define TIMER_INTERVAL 20 // Timer callback interval in milliseconds
 #define GRAVITY 9.81f // Earth's gravity in m/s^2
 #define DEG2RAD 0.0174533f // Degrees to radians conversion factor
+#define GYRO_COVARIANCE 0.05 // Default angular velocity variance of the IMU message
+#define ACCEL_COVARIANCE 0.2 // Default linear acceleration variance of the IMU message
+
+// Control stream settings, periods are defaults of the runtime parameters
+#define IMU_SAMPLE_PERIOD 5 // IMU sampling and filtering period in milliseconds (200 Hz)
+#define IMU_PUBLISH_PERIOD 20 // IMU message publish period in milliseconds
+#define WHEEL_PERIOD 10 // Wheel speed read and publish period in milliseconds (100 Hz)
+#define DIAGNOSTICS_PERIOD 1000 // Stream statistics publish period in milliseconds
+#define IMU_SAMPLE_PHASE 0 // Offset of the IMU sampling stream in microseconds
+#define IMU_PUBLISH_PHASE 1000 // Offset of the IMU publish stream in microseconds
+#define WHEEL_PHASE 2500 // Offset of the wheel stream, between two I2C reads, in microseconds
+#define DIAGNOSTICS_PHASE 3500 // Offset of the diagnostics stream in microseconds
+#define DIAGNOSTICS_BUFFER_SIZE 512 // Size of the diagnostics summary string
+#define CMD_VEL_FRAME_ID_SIZE 32 // Capacity of the received cmd_vel frame ID
+
+// Slots of the control streams in controlStreams
+enum ControlStream : uint8_t {
+    STREAM_IMU_SAMPLE = 0,   // Reads and filters the IMU (left wheel only)
+    STREAM_IMU_PUBLISH = 1,  // Publishes the filtered IMU sample (left wheel only)
+    STREAM_WHEEL = 2,        // Reads and publishes the wheel speed
+    STREAM_DIAGNOSTICS = 3,  // Publishes the achieved rate and jitter of every stream
+};
+
+// Executor task settings
+#define CONTROL_TASK_PRIORITY 5 // FreeRTOS priority of the cmd_vel/control stream task
+#define HOUSEKEEPING_TASK_PRIORITY 2 // FreeRTOS priority of the service executor task
+#define CONTROL_TASK_CORE 1 // Core running the control executor task
+#define HOUSEKEEPING_TASK_CORE 0 // Core running the housekeeping executor task
+#define EXECUTOR_TASK_STACK_SIZE 8192 // Stack size in bytes for each executor task
+#define CONTROL_SPIN_TIMEOUT 5 // Maximum wait for new control data in milliseconds
+#define HOUSEKEEPING_SPIN_PERIOD 20 // Interval between housekeeping spins in milliseconds
+#define FLIGHT_DUMP_CHUNK_RECORDS 16 // Flight recorder records per published dump chunk
+#define FLIGHT_DUMP_PUBLISH_TIMEOUT 5 // Wait for a dump chunk acknowledgement in milliseconds
+#define LATENCY_REPORT_INTERVAL 5000 // Interval for printing latency statistics in milliseconds
 
 // ROS 2 Communication Interfaces
 extern rcl_subscription_t com_check_subscriber;  // Handles incoming communication check requests
@@ -46,27 +93,71 @@ extern std_srvs__srv__Trigger_Request request;   // Stores incoming reboot reque
 extern std_srvs__srv__Trigger_Response response; // Stores outgoing reboot response data
 
 extern rcl_subscription_t cmd_vel_subscriber;    // Receives velocity commands for the robot
-extern geometry_msgs__msg__Twist msg_sub;        // Stores subscribed velocity command data
+extern geometry_msgs__msg__TwistStamped msg_sub; // Stores subscribed velocity command data
+extern SubscriptionStats cmdVelStats;            // Counts received, out-of-order and stale cmd_vel
+extern SubscriptionStats heartbeatStats;         // Counts received, lost and slow link pings
 
 extern rcl_publisher_t vel_publisher;            // Publishes velocity data as stamped messages
 extern geometry_msgs__msg__TwistStamped vel_msg; // Stores velocity data to be published
+extern rcl_publisher_t vel_cov_publisher;        // Publishes the velocity with its variance
+extern geometry_msgs__msg__TwistWithCovarianceStamped vel_cov_msg; // Stores the velocity and variance to be published
 
 extern rcl_publisher_t imu_publisher;            // Publishes IMU data for system components
 extern sensor_msgs__msg__Imu imu_msg;            // Stores IMU data to be published
+extern rcl_publisher_t imu_batch_publisher;      // Publishes batches of raw IMU samples
+extern std_msgs__msg__UInt8MultiArray imu_batch_msg; // Stores the batch to be published
+extern ImuBatch imuBatch;                        // Collects raw IMU samples between publishes
 
-extern rcl_publisher_t heartbeat_publisher;     // Publishes heartbeat messages for system monitoring
-extern rcl_subscription_t heartbeat_subscriber; // Receives heartbeat messages for system monitoring
-extern std_msgs__msg__Int32 heartbeat_msg;     // Stores heartbeat data to be published
+extern rcl_publisher_t diagnostics_publisher;    // Publishes the control stream statistics
+extern std_msgs__msg__String diagnostics_msg;    // Stores the statistics summary to be published
+
+extern rcl_publisher_t resource_publisher;       // Publishes the resource monitor summary
+extern std_msgs__msg__String resource_msg;       // Stores the resource summary to be published
+
+extern rcl_publisher_t motor_status_publisher;   // Publishes driver faults and recoveries
+extern std_msgs__msg__String motor_status_msg;   // Stores the motor supervisor summary to be published
+
+extern rcl_publisher_t rate_selection_publisher; // Publishes the boot rate calibration
+extern std_msgs__msg__String rate_selection_msg; // Stores the rate calibration summary to be published
+extern RateCalibration rateCalibration;          // Picks the stream periods at boot
+
+extern rcl_publisher_t actuation_publisher;      // Publishes the actuation latency distributions
+extern std_msgs__msg__String actuation_msg;      // Stores the actuation latency summary to be published
+
+#ifdef LEFT_WHEEL
+extern rcl_publisher_t slip_publisher;           // Publishes slip and stall events
+extern std_msgs__msg__String slip_msg;           // Stores the slip detector summary to be published
+#endif
+
+extern rcl_publisher_t heartbeat_publisher;     // Echoes link pings back to the host
+extern rcl_subscription_t heartbeat_subscriber; // Receives sequence-numbered link pings
+extern std_msgs__msg__Int32MultiArray heartbeat_ping_msg; // Stores the received ping
+extern std_msgs__msg__Int32MultiArray heartbeat_msg;      // Stores the echo to be published
+
+extern rcl_publisher_t link_quality_publisher;  // Publishes the link quality of each window
+extern std_msgs__msg__String link_quality_msg;  // Stores the link quality summary to be published
+extern rcl_publisher_t flight_dump_publisher;   // Publishes the flight recorder dump chunks
 
 // Timing and Scheduling Interfaces
-extern rcl_timer_t timer;                        // Manages timing for regular system updates
+extern StreamScheduler controlStreams;           // Runs the periodic control streams
+extern VelocityEstimator velocityEstimator;      // Estimates the wheel speed from encoder positions
+extern LinkMonitor linkMonitor;                  // Tracks RTT, ping loss and cmd_vel gaps
 extern rcl_time_point_value_t current_time;      // Stores the current system time point
 extern rcl_clock_t ros_clock;                    // Provides ROS system time
 
-extern rclc_executor_t executor;                 // Manages callback execution for ROS nodes
+extern rclc_executor_t control_executor;         // Executes cmd_vel and heartbeat
+extern rclc_executor_t housekeeping_executor;    // Executes com_check, services and parameters
 extern rclc_support_t support;                   // Provides context support for the ROS node
 extern rcl_allocator_t allocator;                // Allocates memory for node operations
 extern rcl_node_t node;                          // Represents the micro-ROS node
+extern rclc_parameter_server_t param_server;     // Serves the runtime-tunable control parameters
+
+// Latency from cmd_vel becoming ready in the executor to the motor UART write
+extern LatencyStats cmdVelLatency;
+
+// Duration of each housekeeping spin, which holds the session lock the control task needs
+extern LatencyStats housekeepingSpinTime;
+extern uint32_t housekeepingStallCount;          // Session holds longer than EXECUTOR_STALL_BUDGET
 
 //rcl_init_options_t init_options; // Humble
 //size_t domain_id = 117;
@@ -75,7 +166,7 @@ extern rcl_node_t node;                          // Represents the micro-ROS nod
 #define RCCHECK(fn) { \
     rcl_ret_t temp_rc = fn; \
     if ((temp_rc != RCL_RET_OK)) { \
-        Serial.println("Error in " #fn); \
+        DEBUG_PRINTLN("Error in " #fn); \
         return; \
     } \
 }
@@ -93,16 +184,55 @@ void initializeServices(rcl_node_t *node);
 #ifdef LEFT_WHEEL
 void initializeIMU(rcl_node_t *node);
 #endif
-void initializeTimer(rcl_timer_t *timer, rclc_support_t *support);
-void initializeExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator);
+void initializeStreams();
+void calibrateRates();
+void initializeParameterServer(rcl_node_t *node);
+void declareParameters();
+bool on_parameter_changed(const Parameter * old_param, const Parameter * new_param, void * context);
+void applyControlParameter(const char *name);
+void applyImuCovariances();
+#ifdef TRANSPORT_BENCHMARK
+void initializeTransportBenchmark(rcl_node_t *node, rclc_support_t *support);
+void bench_timer_callback(rcl_timer_t *timer, int64_t last_call_time);
+void bench_echo_callback(const void * msgin);
+#endif
+void initializeControlExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator);
+void initializeHousekeepingExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator);
+void startExecutorTasks();
+bool cmd_vel_trigger(rclc_executor_handle_t *handles, unsigned int size, void *obj);
 
 void com_check_callback(const void * msgin);
 void heartbeat_callback(const void * msgin);
 void reboot_callback(const void * request, void * response);
+void rebootNow(uint32_t arg);
+void saveParameterNow(uint32_t arg);
+void stopMotors();
+void resumeMotors();
+void flight_dump_callback(const void * request, void * response);
+void estop_rearm_callback(const void * request, void * response);
+void publishFlightDumpChunk();
 void subscription_callback(const void * msgin);
-void timer_callback(rcl_timer_t *timer, int64_t last_call_time);
+void stopCmdVel();
+void checkCmdVelTimeout();
+void imu_sample_callback();
+void imu_publish_callback();
+void wheel_callback();
+void diagnostics_callback();
+bool updateCurrentTime();
 void updateIMUData();
 void updateWheelSpeed();
-void handleExecutorSpin();
+void handleExecutorSpin(rclc_executor_t *executor, uint32_t timeout_ms);
+void controlExecutorTask(void *param);
+void housekeepingExecutorTask(void *param);
+void reportLatencyStats();
+void publishResourceUsage();
+void publishMotorStatus();
+void publishEmergencyStop();
+#ifdef LEFT_WHEEL
+void checkSlip();
+void publishSlipEvent();
+#endif
+void updateLinkQuality();
+void syncAgentTime();
 
 #endif // ROS_COMMUNICATIONS_H
\ No newline at end of file
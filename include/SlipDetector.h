@@ -0,0 +1,110 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SLIP_DETECTOR_H
+#define SLIP_DETECTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SLIP_YAW_TOLERANCE 0.3f // Default yaw rate difference counted as slip in rad/s
+#define SLIP_ACCEL_LIMIT 0.0f // Default wheel acceleration limit while slipping in m/s^2, 0 disables it
+#define SLIP_MIN_SPEED 0.05f // Expected wheel speed below which a stall is not judged in m/s
+#define SLIP_STALL_RATIO 0.2f // Share of the expected wheel speed below which the wheel counts as stalled
+#define SLIP_DETECT_TICKS 3 // Consecutive inconsistent ticks before an event
+#define SLIP_CLEAR_TICKS 10 // Consecutive consistent ticks before the event clears
+#define SLIP_EVENT_BUFFER_SIZE 256 // Size of the published slip event summary
+
+// Consistency of the command, the wheel and the gyro
+enum SlipState : uint8_t {
+    SLIP_NONE = 0,   // Wheel and yaw rate follow the command
+    SLIP_YAW = 1,    // Yaw rate of the wheels differs from the gyro, a wheel slips or the base skids
+    SLIP_STALL = 2,  // Wheel is commanded to turn but does not
+};
+
+// Counters since boot
+struct SlipStats {
+    uint32_t ticks;      // Checked ticks
+    uint32_t slips;      // SLIP_YAW events
+    uint32_t stalls;     // SLIP_STALL events
+    uint32_t clamped;    // Wheel targets limited by the acceleration limit
+};
+
+// Signals of the tick that raised or cleared the last event
+struct SlipSnapshot {
+    float yaw_command;   // Commanded yaw rate after the response lag in rad/s
+    float yaw_wheels;    // Yaw rate of this wheel and the expected other wheel in rad/s
+    float yaw_gyro;      // Gyro yaw rate in rad/s
+    float wheel_target;  // Expected speed of this wheel in m/s
+    float wheel_speed;   // Measured speed of this wheel in m/s
+};
+
+// Checks the left wheel board's command, wheel speed and gyro Z against
+// differential drive kinematics on every wheel tick. The command is passed
+// through the first-order response of the wheels, so a step does not read
+// as slip. The other wheel is not measured on this board; it is assumed to
+// follow its command, so its slip shows as a yaw difference as well. While
+// an event is active, an enabled acceleration limit ramps the wheel target.
+// Not locked; the control task calls all methods.
+class SlipDetector {
+public:
+    SlipDetector();  // Constructor
+
+    // Sets the wheel distance in meters, the yaw tolerance in rad/s and the acceleration limit in m/s^2
+    void configure(float wheel_distance, float yaw_tolerance, float accel_limit);
+
+    // Checks one tick: the command, the forward speed of this (left) wheel and the gyro Z rate
+    SlipState update(float linear, float angular, float wheel_speed, float gyro_z, uint32_t now_us);
+
+    // Returns the wheel target to send instead of requested, ramped from applied while an event is active
+    float limitTarget(float applied, float requested, uint32_t now_us);
+
+    // True while the last requested target is not reached because of the limit
+    bool rampPending(float applied) const { return applied != requested_target; }
+    float requestedTarget() const { return requested_target; }
+
+    SlipState state() const { return current; }
+    const SlipStats &stats() const { return counters; }
+
+    // Returns true once per change of state(), for publishing events
+    bool takeEvent();
+
+    // Writes the state, the signals of the last event and the counters as a one-line key=value summary into buf
+    size_t summarize(char *buf, size_t len) const;
+
+    void reset();  // Forgets the response lag, the state and the pending ramp
+
+private:
+    float wheel_distance;     // Distance between the wheels in meters
+    float yaw_tolerance;      // Yaw rate difference counted as slip in rad/s
+    float accel_limit;        // Wheel acceleration limit while an event is active, 0 disables it
+    bool started;             // The lag model holds a sample
+    float expected_linear;    // Command after the response lag in m/s
+    float expected_angular;   // Command after the response lag in rad/s
+    uint32_t last_update_us;  // Time of the last update()
+    uint32_t last_limit_us;   // Time of the last limitTarget()
+    float requested_target;   // Last requested wheel target in m/s, driver direction
+    SlipState current;        // Reported state
+    SlipState candidate;      // Inconsistency of the latest ticks
+    uint8_t candidate_ticks;  // Consecutive ticks of candidate
+    uint8_t clear_ticks;      // Consecutive consistent ticks while an event is active
+    bool event;               // state() changed since takeEvent()
+    SlipSnapshot snapshot;    // Signals of the last event
+    SlipStats counters;
+};
+
+extern SlipDetector slipDetector;
+
+#endif // SLIP_DETECTOR_H
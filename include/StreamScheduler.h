@@ -0,0 +1,90 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_SCHEDULER_H
+#define STREAM_SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAX_STREAMS 8 // Number of stream slots in a scheduler
+#define STREAM_IDLE_WAIT 0xFFFFFFFFu // poll() result when no stream is configured
+
+typedef void (*StreamCallback)();
+
+// Timing statistics of one stream since the last resetStats()
+struct StreamStats {
+    uint32_t runs;           // Callbacks run in the window
+    uint32_t missed;         // Periods skipped because the stream ran too late
+    uint32_t jitter_max_us;  // Largest |interval - period|
+    uint64_t jitter_sum_us;  // Sum of |interval - period| over runs with an interval
+    uint32_t intervals;      // Runs that had a previous run to measure against
+};
+
+// Runs periodic streams with independent periods and phase offsets from one
+// polling loop. Each stream is due at start + phase + n * period; a stream
+// that falls more than a period behind skips the missed slots instead of
+// bursting. Time is passed in so the scheduler can be driven without hardware.
+class StreamScheduler {
+public:
+    StreamScheduler();  // Constructor
+
+    // Configures slot id, replacing any previous stream there; returns false for a bad id or period
+    bool configureStream(uint8_t id, const char *name, uint32_t period_us, uint32_t phase_us,
+                         StreamCallback callback);
+
+    // Changes the period of a configured stream, taking effect after its next run
+    void setPeriod(uint8_t id, uint32_t period_us);
+
+    // Aligns every stream to its phase relative to now_us and clears the statistics
+    void start(uint32_t now_us);
+
+    // Runs every stream that is due; returns the time in microseconds until the next one is
+    uint32_t poll(uint32_t now_us);
+
+    // Runs one stream immediately without touching its schedule or statistics
+    void run(uint8_t id);
+
+    bool isConfigured(uint8_t id) const { return id < MAX_STREAMS && streams[id].callback != NULL; }
+    const char *name(uint8_t id) const { return streams[id].name; }
+    uint32_t period(uint8_t id) const { return streams[id].period_us; }
+    const StreamStats &stats(uint8_t id) const { return streams[id].stats; }
+
+    // Achieved rate of a stream in Hz over the current window
+    float achievedRate(uint8_t id, uint32_t now_us) const;
+
+    // Writes a one-line key=value summary of every stream into buf
+    size_t summarize(char *buf, size_t len, uint32_t now_us) const;
+
+    // Starts a new statistics window
+    void resetStats(uint32_t now_us);
+
+private:
+    struct Stream {
+        const char *name;         // Name used in the summary
+        StreamCallback callback;  // NULL for an unused slot
+        uint32_t period_us;       // Interval between runs
+        uint32_t phase_us;        // Offset of the first run after start()
+        uint32_t next_due_us;     // Time the stream is due next
+        uint32_t last_run_us;     // Time of the previous run
+        bool has_run;             // True once last_run_us is valid
+        StreamStats stats;        // Statistics of the current window
+    };
+
+    Stream streams[MAX_STREAMS];  // Stream slots indexed by id
+    uint32_t window_start_us;     // Start of the statistics window
+};
+
+#endif // STREAM_SCHEDULER_H
@@ -0,0 +1,68 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUBSCRIPTION_STATS_H
+#define SUBSCRIPTION_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CMD_VEL_MAX_AGE 200 // Default age above which cmd_vel is rejected as stale in milliseconds, 0 disables it
+#define CMD_VEL_TIMEOUT 1000 // Default time without an accepted cmd_vel before the wheel stops in milliseconds, 0 disables it
+#define TIME_SYNC_PERIOD 60000 // Interval between clock synchronizations with the agent in milliseconds
+#define TIME_SYNC_TIMEOUT 10 // Wait for the agent's time reply in milliseconds
+
+// Outcome of checking the header stamp of a received message
+enum StampCheck : uint8_t {
+    STAMP_ACCEPTED = 0,      // Fresh, or not checkable: zero stamp or clock not synchronized
+    STAMP_LATE = 1,          // Older than the staleness bound
+    STAMP_OUT_OF_ORDER = 2,  // Not newer than the last accepted message
+};
+
+// Counts what happened to the messages of one subscription. received counts
+// every message the executor handed over, dropped the ones lost in transport
+// or discarded as out of order, and late the ones that arrived past their
+// bound. Counters run from boot so a lost summary loses no information.
+class SubscriptionStats {
+public:
+    explicit SubscriptionStats(const char *name);  // Constructor, name prefixes the summary keys
+
+    // Adds counts of messages checked elsewhere, e.g. from sequence numbers
+    void add(uint32_t received, uint32_t dropped, uint32_t late);
+
+    // Counts a stamped message and checks it. now_ns is 0 while the clock is
+    // not synchronized with the agent, max_age_ns 0 disables the bound.
+    StampCheck checkStamp(int64_t stamp_ns, int64_t now_ns, int64_t max_age_ns);
+
+    uint32_t received() const { return received_count; }
+    uint32_t dropped() const { return dropped_count; }
+    uint32_t late() const { return late_count; }
+    bool hasAge() const { return has_age; }            // True once a stamp was checked against the clock
+    int64_t lastAgeNs() const { return last_age_ns; }  // Age of the last checked message, negative when ahead
+
+    // Writes the counters as key=value pairs into buf
+    size_t summarize(char *buf, size_t len) const;
+
+private:
+    const char *name;          // Prefix of the summary keys
+    uint32_t received_count;   // Messages handed over by the executor
+    uint32_t dropped_count;    // Messages lost or discarded as out of order
+    uint32_t late_count;       // Messages past their bound
+    int64_t last_stamp_ns;     // Stamp of the last accepted message, 0 if none
+    bool has_age;              // last_age_ns is valid
+    int64_t last_age_ns;       // Age of the last checked message
+};
+
+#endif // SUBSCRIPTION_STATS_H
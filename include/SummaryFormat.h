@@ -0,0 +1,26 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUMMARY_FORMAT_H
+#define SUMMARY_FORMAT_H
+
+#include <stddef.h>
+
+// snprintf at buf + *used, keeping *used within the buffer on truncation.
+// The summarize() functions build their key=value lines with it; the result
+// is always terminated and *used is the length of the truncated line.
+void appendf(char *buf, size_t len, size_t *used, const char *format, ...);
+
+#endif // SUMMARY_FORMAT_H
@@ -0,0 +1,37 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOPIC_QOS_H
+#define TOPIC_QOS_H
+
+#include <rcl/rcl.h>
+
+// QoS classes assigned to the topics in RosCommunications.cpp
+enum TopicQos : uint8_t {
+    QOS_COMMAND = 0,  // Reliable, keep last COMMAND_QOS_DEPTH: only the newest command matters, but it must arrive
+    QOS_SENSOR = 1,   // Best effort, keep last SENSOR_QOS_DEPTH: a retransmitted sample is already stale
+    QOS_STATUS = 2,   // Best effort, keep last STATUS_QOS_DEPTH: summaries, events and connection checks
+    QOS_SERVICE = 3,  // Reliable services
+    QOS_TRANSFER = 4, // Reliable, keep last STATUS_QOS_DEPTH: dumps that are useless with a chunk missing
+};
+
+#define COMMAND_QOS_DEPTH 1 // History depth of QOS_COMMAND
+#define SENSOR_QOS_DEPTH 5 // History depth of QOS_SENSOR
+#define STATUS_QOS_DEPTH 10 // History depth of QOS_STATUS and QOS_TRANSFER
+
+// Returns the profile of a QoS class
+const rmw_qos_profile_t *qosProfile(TopicQos qos);
+
+#endif // TOPIC_QOS_H
@@ -0,0 +1,59 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRANSPORT_BENCHMARK_H
+#define TRANSPORT_BENCHMARK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BENCH_WINDOW 256 // Number of outstanding pings and RTT samples kept per report
+#define BENCH_PING_PERIOD 5 // Interval between ping bursts in milliseconds
+#define BENCH_BURST 4 // Number of pings published per burst
+#define BENCH_REPORT_INTERVAL 5000 // Interval between benchmark reports in milliseconds
+
+// Measures publish-to-echo round trip and throughput of the micro-ROS transport.
+// The board publishes sequence-numbered pings, a host node echoes them back and
+// onEcho() matches the echo to its send time. Timestamps are passed in so the
+// statistics can be exercised without hardware.
+class TransportBenchmark {
+public:
+    TransportBenchmark();  // Constructor
+
+    // Returns the sequence number for a new ping and records its send time
+    uint32_t nextPing(uint32_t now_us);
+
+    // Records the echo of a ping, returns false for unknown or duplicate sequences
+    bool onEcho(uint32_t seq, uint32_t now_us);
+
+    // Writes a one-line key=value summary of the current window into buf
+    size_t summarize(char *buf, size_t len, const char *transport, uint32_t now_us);
+
+    // Starts a new measurement window
+    void reset(uint32_t now_us);
+
+private:
+    uint32_t send_time_us[BENCH_WINDOW]; // Send time of each outstanding ping, indexed by seq
+    uint32_t send_seq[BENCH_WINDOW];     // Sequence stored in each send slot
+    bool pending[BENCH_WINDOW];          // True while a ping is waiting for its echo
+    uint32_t rtt_us[BENCH_WINDOW];       // RTT samples of the current window
+    uint32_t rtt_count;                  // Number of RTT samples in the window
+    uint32_t next_seq;                   // Sequence number of the next ping
+    uint32_t sent;                       // Pings sent in the current window
+    uint32_t received;                   // Echoes received in the current window
+    uint32_t window_start_us;            // Start of the current window
+};
+
+#endif // TRANSPORT_BENCHMARK_H
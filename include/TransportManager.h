@@ -0,0 +1,56 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRANSPORT_MANAGER_H
+#define TRANSPORT_MANAGER_H
+
+#include <M5Stack.h>
+#include <micro_ros_arduino.h>
+
+// Transports available between the board and the micro-ROS agent
+enum TransportType : uint8_t {
+    TRANSPORT_SERIAL = 0,         // Default micro_ros_arduino USB serial transport
+    TRANSPORT_UDP = 1,            // UDP over the WiFi connection set up in setupM5stack()
+    TRANSPORT_FRAMED_SERIAL = 2,  // Framed custom transport on USB serial at FRAMED_BAUD_RATE
+};
+
+// Build-time default transport, override with -DMICRO_ROS_TRANSPORT=<value>
+#ifndef MICRO_ROS_TRANSPORT
+#define MICRO_ROS_TRANSPORT TRANSPORT_SERIAL
+#endif
+
+// Agent address for the UDP transport, override in config.h or with build flags
+#ifndef AGENT_IP
+#define AGENT_IP 192, 168, 1, 100
+#endif
+#ifndef AGENT_PORT
+#define AGENT_PORT 8888
+#endif
+
+#define FRAMED_BAUD_RATE 921600 // Baud rate of the framed serial transport
+// Returns the transport to use: the "transport" parameter restored from NVS
+// by loadControlParameters(), which defaults to MICRO_ROS_TRANSPORT
+TransportType selectTransport();
+
+// Registers the given transport with micro-ROS. Must be called before rclc_support_init.
+void setupTransport(TransportType type);
+
+// Returns a short name for logs and benchmark reports
+const char* transportName(TransportType type);
+
+// Transport in use since setupTransport()
+extern TransportType activeTransport;
+
+#endif // TRANSPORT_MANAGER_H
@@ -0,0 +1,73 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VELOCITY_ESTIMATOR_H
+#define VELOCITY_ESTIMATOR_H
+
+#include <stdint.h>
+
+// Sources of the published wheel speed, selected by the velocity_source parameter
+#define VELOCITY_SOURCE_SPEED_REGISTER 0 // ACTUAL_SPEED_DEC register, whole RPM resolution
+#define VELOCITY_SOURCE_POSITION 1 // Encoder position deltas fused by VelocityEstimator
+#define VELOCITY_SOURCE VELOCITY_SOURCE_SPEED_REGISTER // Default velocity source
+
+#define VELOCITY_PROCESS_NOISE 0.0001f // Default growth of the velocity variance in (m/s)^2 per second
+#define MOTOR_RESPONSE_TIME 0.05f // Time constant of the wheel following a command in seconds
+#define ESTIMATOR_RESET_GAP 200000 // Gap between samples in microseconds that restarts the estimator
+#define ESTIMATOR_INITIAL_VARIANCE 1.0f // Velocity variance before the first measurement in (m/s)^2
+
+// Scalar Kalman filter on the wheel velocity. The prediction assumes the
+// wheel follows the commanded velocity as a first-order lag, with a variance
+// that grows with the predicted change so a wheel that does not follow the
+// command is not hidden by the prior. Each encoder
+// position sample contributes the average velocity since the previous sample,
+// with a variance given by the quantization of both positions. At creep speeds
+// the position advances less than one count per sample, so single measurements
+// are coarse but unbiased and the filter averages them into a usable estimate.
+class VelocityEstimator {
+public:
+    VelocityEstimator();  // Constructor
+
+    // Sets the encoder resolution and the filter tuning
+    void configure(float meters_per_count, float process_noise, float response_time);
+
+    // Forgets the state, the next sample only sets the reference position
+    void reset();
+
+    // Advances the estimate to time_us assuming the wheel follows commanded (m/s)
+    void predict(uint32_t time_us, float commanded);
+
+    // Fuses an encoder position latched by the driver at sample_us. Returns
+    // false when the sample only served as the reference of the next one.
+    bool update(int32_t position, uint32_t sample_us, float commanded);
+
+    float velocity() const { return v; }     // Estimated velocity in m/s
+    float variance() const { return p; }     // Variance of the estimate in (m/s)^2
+    bool isValid() const { return valid; }   // True once a measurement was fused
+
+private:
+    float meters_per_count;  // Wheel travel per encoder count
+    float process_noise;     // Variance growth per second
+    float response_time;     // Time constant of the command prior
+    bool has_reference;      // True when last_position is usable
+    bool valid;              // True once a measurement was fused
+    int32_t last_position;   // Position of the previous sample
+    uint32_t last_sample_us; // Time of the previous sample
+    uint32_t state_us;       // Time the estimate refers to
+    float v;                 // Velocity estimate
+    float p;                 // Variance of the estimate
+};
+
+#endif // VELOCITY_ESTIMATOR_H
@@ -0,0 +1,81 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_HARDWARE_SERIAL_H
+#define NATIVE_HARDWARE_SERIAL_H
+
+#include <deque>
+#include <functional>
+#include "Arduino.h"
+
+#define SERIAL_8N1 0x800001c
+
+// In-memory serial port. Written bytes go to onWrite (a simulated device or a
+// console), received bytes are queued with injectRx().
+class HardwareSerial : public Print {
+public:
+    explicit HardwareSerial(int uart_nr) : uart_nr(uart_nr) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {}
+    void end() {}
+    void flush() {}
+    void setTimeout(unsigned long timeout) { timeout_ms = timeout; }
+    operator bool() const { return true; }
+
+    using Print::write;
+    size_t write(const uint8_t *buf, size_t len) override {
+        if (onWrite) {
+            onWrite(buf, len);
+        }
+        return len;
+    }
+
+    int available() { return (int)rx.size(); }
+    int read() {
+        if (rx.empty()) {
+            return -1;
+        }
+        uint8_t b = rx.front();
+        rx.pop_front();
+        return b;
+    }
+    // Waits up to the timeout for missing bytes, as the ESP32 UART driver does
+    size_t readBytes(uint8_t *buf, size_t len) {
+        unsigned long start = millis();
+        while (rx.size() < len && millis() - start < timeout_ms) {
+            delay(1);
+        }
+        size_t n = 0;
+        while (n < len && !rx.empty()) {
+            buf[n++] = (uint8_t)read();
+        }
+        return n;
+    }
+    size_t readBytes(char *buf, size_t len) { return readBytes((uint8_t *)buf, len); }
+
+    // Host-side hooks
+    void injectRx(const uint8_t *data, size_t len) { rx.insert(rx.end(), data, data + len); }
+    void clearRx() { rx.clear(); }
+    std::function<void(const uint8_t *, size_t)> onWrite;
+
+private:
+    int uart_nr;
+    std::deque<uint8_t> rx;
+    unsigned long timeout_ms = 1000; // Stream default of the Arduino core
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_HARDWARE_SERIAL_H
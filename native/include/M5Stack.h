@@ -0,0 +1,76 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_M5STACK_H
+#define NATIVE_M5STACK_H
+
+// M5Stack stand-in for native builds: the LCD discards output and the IMU
+// returns values set through NativeIMU.
+
+#include "Arduino.h"
+#include "HardwareSerial.h"
+
+class NativeLcd : public Print {
+public:
+    using Print::write;
+    size_t write(const uint8_t *buf, size_t len) override { return len; }
+    void clear() {}
+    void fillScreen(uint32_t color) {}
+    void setCursor(int16_t x, int16_t y) {}
+    void setTextSize(uint8_t size) {}
+};
+
+class NativeIMU {
+public:
+    int Init() { return 0; }
+    void getAccelData(float *x, float *y, float *z) { *x = accel[0]; *y = accel[1]; *z = accel[2]; }
+    void getGyroData(float *x, float *y, float *z) { *x = gyro[0]; *y = gyro[1]; *z = gyro[2]; }
+    void getAccelAdc(int16_t *x, int16_t *y, int16_t *z) { *x = adc(accel[0], aRes); *y = adc(accel[1], aRes); *z = adc(accel[2], aRes); }
+    void getGyroAdc(int16_t *x, int16_t *y, int16_t *z) { *x = adc(gyro[0], gRes); *y = adc(gyro[1], gRes); *z = adc(gyro[2], gRes); }
+    void getAres() {}
+    void getGres() {}
+
+    float accel[3] = {0.0f, 0.0f, 1.0f}; // Acceleration in g returned to the firmware
+    float gyro[3] = {0.0f, 0.0f, 0.0f};  // Angular rate in deg/s returned to the firmware
+    float aRes = 8.0f / 32768.0f;        // g per count, the MPU6886 default of +-8 g
+    float gRes = 2000.0f / 32768.0f;     // deg/s per count, the MPU6886 default of +-2000 deg/s
+
+private:
+    static int16_t adc(float value, float res) {
+        float counts = value / res + (value >= 0.0f ? 0.5f : -0.5f);
+        return counts > 32767.0f ? 32767 : counts < -32768.0f ? -32768 : (int16_t)counts;
+    }
+};
+
+class NativeM5 {
+public:
+    void begin(bool lcd = true, bool sd = true, bool serial = true, bool i2c = false) {}
+    void update() {}
+    NativeLcd Lcd;
+    NativeIMU IMU;
+};
+
+class NativeESP {
+public:
+    void restart();
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+
+extern NativeM5 M5;
+extern NativeESP ESP;
+
+#endif // NATIVE_M5STACK_H
@@ -0,0 +1,53 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+// NVS stand-in for native builds, values live in memory for the process lifetime.
+
+#include <map>
+#include <string>
+#include "Arduino.h"
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) { ns = name; return true; }
+    void end() {}
+    bool isKey(const char *key) { return store().count(ns + "/" + key) != 0; }
+    uint8_t getUChar(const char *key, uint8_t def = 0) { return (uint8_t)get(key, def); }
+    size_t putUChar(const char *key, uint8_t value) { return put(key, value); }
+    uint32_t getUInt(const char *key, uint32_t def = 0) { return (uint32_t)get(key, def); }
+    size_t putUInt(const char *key, uint32_t value) { return put(key, value); }
+    float getFloat(const char *key, float def = 0.0f) { return (float)get(key, def); }
+    size_t putFloat(const char *key, float value) { return put(key, value); }
+
+private:
+    std::string ns;
+    static std::map<std::string, double> &store() {
+        static std::map<std::string, double> values;
+        return values;
+    }
+    double get(const char *key, double def) {
+        auto it = store().find(ns + "/" + key);
+        return it == store().end() ? def : it->second;
+    }
+    size_t put(const char *key, double value) {
+        store()[ns + "/" + key] = value;
+        return sizeof(value);
+    }
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,81 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIM_MOTOR_DRIVER_H
+#define SIM_MOTOR_DRIVER_H
+
+#include <map>
+#include <vector>
+#include "HardwareSerial.h"
+
+// Simulated hub motor driver on a native HardwareSerial. It decodes the
+// 10-byte frames written by MotorController, keeps a register file per motor ID
+// and answers speed reads with a first-order response to the target velocity.
+// Position reads return the integral of that speed in encoder counts. The
+// status word is derived from the fault code, emergency stop and control word.
+class SimMotorDriver {
+public:
+    explicit SimMotorDriver(HardwareSerial &serial);
+
+    // Time constant of the simulated wheel speed response in seconds
+    void setTimeConstant(float seconds) { time_constant = seconds; }
+
+    // Register access for tests and benchmarks
+    int32_t registerValue(uint8_t motorID, uint16_t address);
+    void setRegister(uint8_t motorID, uint16_t address, int32_t value);
+
+    // Fault injection: ignore the next count frames, ignore every frame while
+    // offline or only those of one motor, and keep a register at its value
+    // regardless of writes
+    void dropNextFrames(uint32_t count) { drop_frames = count; }
+    void setOnline(bool online) { this->online = online; }
+    void setOnline(uint8_t motorID, bool online) { motors[motorID].offline = !online; }
+    void lockRegister(uint8_t motorID, uint16_t address) { motors[motorID].locked[address] = true; }
+
+    // Trips the driver: latches the fault code, disables it and stops the wheel.
+    // FAULT_RESET clears the code unless it has MOTOR_FAULT_PERMANENT bits.
+    void injectFault(uint8_t motorID, uint32_t code);
+
+    uint32_t framesReceived() const { return frames_received; }
+    uint32_t checksumErrors() const { return checksum_errors; }
+
+private:
+    struct MotorState {
+        std::map<uint16_t, int32_t> registers; // Register file
+        std::map<uint16_t, bool> locked;       // Registers that ignore writes
+        float actual_dec;                      // Simulated actual speed in DEC units
+        double position;                       // Simulated encoder position in counts
+        unsigned long last_update_us;          // Time of the last speed update
+        bool offline;                          // Ignores every frame addressed to it
+    };
+
+    void onBytes(const uint8_t *buf, size_t len);
+    void handleFrame(const uint8_t *frame);
+    void updateSpeed(MotorState &motor);
+    void writeControlWord(MotorState &motor, int32_t value);
+    int32_t statusWord(MotorState &motor);
+    void reply(uint8_t motorID, uint8_t command, uint16_t address, int32_t value);
+
+    HardwareSerial &serial;
+    std::vector<uint8_t> pending;             // Bytes of a partially received frame
+    std::map<uint8_t, MotorState> motors;     // State per motor ID
+    float time_constant;
+    uint32_t drop_frames;                     // Frames still to be ignored
+    bool online;                              // False while every frame is ignored
+    uint32_t frames_received;
+    uint32_t checksum_errors;
+};
+
+#endif // SIM_MOTOR_DRIVER_H
@@ -0,0 +1,71 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_MICRO_ROS_ARDUINO_H
+#define NATIVE_MICRO_ROS_ARDUINO_H
+
+// micro_ros_arduino transport API for native builds. Transports are accepted
+// and ignored; entities are served by micro_ros_stub.h.
+
+#include "Arduino.h"
+#include "micro_ros_stub.h"
+
+struct uxrCustomTransport { void *args; };
+
+typedef bool (*open_custom_func)(struct uxrCustomTransport *);
+typedef bool (*close_custom_func)(struct uxrCustomTransport *);
+typedef size_t (*write_custom_func)(struct uxrCustomTransport *, const uint8_t *, size_t, uint8_t *);
+typedef size_t (*read_custom_func)(struct uxrCustomTransport *, uint8_t *, size_t, int, uint8_t *);
+
+typedef int rmw_ret_t;
+#define RMW_RET_OK 0
+#define RMW_RET_ERROR 1
+
+rmw_ret_t rmw_uros_set_custom_transport(bool framing, void *args, open_custom_func open_cb,
+                                        close_custom_func close_cb, write_custom_func write_cb,
+                                        read_custom_func read_cb);
+void set_microros_transports();
+
+// Time synchronization with the agent
+rmw_ret_t rmw_uros_sync_session(int timeout_ms);
+bool rmw_uros_epoch_synchronized();
+int64_t rmw_uros_epoch_nanos();
+rmw_ret_t rmw_uros_ping_agent(int timeout_ms, uint8_t attempts);
+
+// Wait of a reliable publish for its acknowledgement
+rmw_ret_t rmw_uros_set_publisher_session_timeout(rcl_publisher_t *publisher, int session_timeout);
+
+// Host-side agent clock in nanoseconds read by rmw_uros_sync_session() and
+// rmw_uros_ping_agent(), 0 makes the agent unreachable
+extern int64_t nativeAgentEpochNanos;
+
+class IPAddress {
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    uint8_t octets[4];
+};
+
+struct micro_ros_agent_locator {
+    IPAddress address;
+    int port;
+};
+
+bool arduino_wifi_transport_open(struct uxrCustomTransport *transport);
+bool arduino_wifi_transport_close(struct uxrCustomTransport *transport);
+size_t arduino_wifi_transport_write(struct uxrCustomTransport *transport, const uint8_t *buf, size_t len, uint8_t *err);
+size_t arduino_wifi_transport_read(struct uxrCustomTransport *transport, uint8_t *buf, size_t len, int timeout, uint8_t *err);
+
+#endif // NATIVE_MICRO_ROS_ARDUINO_H
@@ -0,0 +1,221 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_MICRO_ROS_STUB_H
+#define NATIVE_MICRO_ROS_STUB_H
+
+// Subset of the rcl/rclc C API and message types used by the firmware.
+// Entities only record their topic name; rcl_publish() forwards to
+// nativePublishHook so host programs can observe what the firmware publishes.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <functional>
+
+typedef int rcl_ret_t;
+#define RCL_RET_OK 0
+#define RCL_RET_ERROR 1
+#define RCL_RET_INVALID_ARGUMENT 11
+
+typedef int64_t rcl_time_point_value_t;
+#define RCL_MS_TO_NS(ms) ((int64_t)(ms) * 1000000LL)
+#define RCL_NS_TO_MS(ns) ((ns) / 1000000LL)
+#define RCUTILS_MS_TO_NS RCL_MS_TO_NS
+#define RCLC_UNUSED(x) (void)(x)
+
+// Messages
+typedef struct { char *data; size_t size; size_t capacity; } rosidl_runtime_c__String;
+typedef struct { int32_t sec; uint32_t nanosec; } builtin_interfaces__msg__Time;
+typedef struct { builtin_interfaces__msg__Time stamp; rosidl_runtime_c__String frame_id; } std_msgs__msg__Header;
+typedef struct { double x, y, z; } geometry_msgs__msg__Vector3;
+typedef struct { double x, y, z, w; } geometry_msgs__msg__Quaternion;
+typedef struct { geometry_msgs__msg__Vector3 linear, angular; } geometry_msgs__msg__Twist;
+typedef struct { std_msgs__msg__Header header; geometry_msgs__msg__Twist twist; } geometry_msgs__msg__TwistStamped;
+typedef struct { geometry_msgs__msg__Twist twist; double covariance[36]; } geometry_msgs__msg__TwistWithCovariance;
+typedef struct { std_msgs__msg__Header header; geometry_msgs__msg__TwistWithCovariance twist; } geometry_msgs__msg__TwistWithCovarianceStamped;
+typedef struct {
+    std_msgs__msg__Header header;
+    geometry_msgs__msg__Quaternion orientation;
+    double orientation_covariance[9];
+    geometry_msgs__msg__Vector3 angular_velocity;
+    double angular_velocity_covariance[9];
+    geometry_msgs__msg__Vector3 linear_acceleration;
+    double linear_acceleration_covariance[9];
+} sensor_msgs__msg__Imu;
+typedef struct { int32_t data; } std_msgs__msg__Int32;
+typedef struct { rosidl_runtime_c__String data; } std_msgs__msg__String;
+typedef struct { uint8_t *data; size_t size; size_t capacity; } rosidl_runtime_c__uint8__Sequence;
+typedef struct { int32_t *data; size_t size; size_t capacity; } rosidl_runtime_c__int32__Sequence;
+typedef struct { struct { void *data; size_t size; size_t capacity; } dim; uint32_t data_offset; } std_msgs__msg__MultiArrayLayout;
+typedef struct { std_msgs__msg__MultiArrayLayout layout; rosidl_runtime_c__uint8__Sequence data; } std_msgs__msg__UInt8MultiArray;
+typedef struct { std_msgs__msg__MultiArrayLayout layout; rosidl_runtime_c__int32__Sequence data; } std_msgs__msg__Int32MultiArray;
+typedef struct { uint8_t structure_needs_at_least_one_member; } std_srvs__srv__Trigger_Request;
+typedef struct { bool success; rosidl_runtime_c__String message; } std_srvs__srv__Trigger_Response;
+
+// QoS profiles
+typedef enum { RMW_QOS_POLICY_HISTORY_KEEP_LAST, RMW_QOS_POLICY_HISTORY_KEEP_ALL } rmw_qos_history_policy_t;
+typedef enum { RMW_QOS_POLICY_RELIABILITY_RELIABLE, RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT } rmw_qos_reliability_policy_t;
+typedef enum { RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL, RMW_QOS_POLICY_DURABILITY_VOLATILE } rmw_qos_durability_policy_t;
+typedef struct {
+    rmw_qos_history_policy_t history;
+    size_t depth;
+    rmw_qos_reliability_policy_t reliability;
+    rmw_qos_durability_policy_t durability;
+} rmw_qos_profile_t;
+extern const rmw_qos_profile_t rmw_qos_profile_default;
+extern const rmw_qos_profile_t rmw_qos_profile_sensor_data;
+extern const rmw_qos_profile_t rmw_qos_profile_services_default;
+
+#define ROSIDL_GET_MSG_TYPE_SUPPORT(pkg, sub, msg) NULL
+#define ROSIDL_GET_SRV_TYPE_SUPPORT(pkg, sub, srv) NULL
+
+// Entities: publishers and subscriptions remember their topic for the host hooks
+typedef struct { const char *topic; rmw_qos_profile_t qos; int session_timeout; } rcl_publisher_t;
+typedef struct { const char *topic; rmw_qos_profile_t qos; } rcl_subscription_t;
+typedef struct { const char *name; rmw_qos_profile_t qos; } rcl_service_t;
+typedef struct { const char *name; const char *namespace_; } rcl_node_t;
+typedef struct { int unused; } rcl_clock_t;
+typedef struct { int unused; } rcl_context_t;
+typedef struct { int unused; } rcl_allocator_t;
+typedef struct { rcl_context_t context; } rclc_support_t;
+typedef struct rcl_timer_s rcl_timer_t;
+typedef void (*rcl_timer_callback_t)(rcl_timer_t *, int64_t);
+struct rcl_timer_s { int64_t period_ns; int64_t last_call_ns; rcl_timer_callback_t callback; };
+typedef enum { RCL_ROS_TIME, RCL_SYSTEM_TIME, RCL_STEADY_TIME } rcl_clock_type_t;
+
+typedef void (*rclc_subscription_callback_t)(const void *);
+typedef void (*rclc_service_callback_t)(const void *, void *);
+typedef enum { ON_NEW_DATA, ALWAYS } rclc_executor_handle_invocation_t;
+typedef enum { RCLC_SUBSCRIPTION, RCLC_TIMER, RCLC_SERVICE, RCLC_NONE } rclc_executor_handle_type_t;
+
+typedef struct {
+    rclc_executor_handle_type_t type;
+    union {
+        rcl_subscription_t *subscription;
+        rcl_timer_t *timer;
+        rcl_service_t *service;
+    };
+    void *data;
+    void *response;
+    rclc_subscription_callback_t subscription_callback;
+    rclc_service_callback_t service_callback;
+    bool initialized;
+    bool data_available;
+} rclc_executor_handle_t;
+
+typedef bool (*rclc_executor_trigger_t)(rclc_executor_handle_t *, unsigned int, void *);
+
+typedef struct {
+    rclc_executor_handle_t handles[16];
+    unsigned int max_handles;
+    unsigned int index;
+    rclc_executor_trigger_t trigger_function;
+    void *trigger_object;
+} rclc_executor_t;
+
+typedef struct { const char *str; } rcutils_error_string_t;
+
+rcutils_error_string_t rcl_get_error_string();
+void rcl_reset_error();
+rcl_allocator_t rcl_get_default_allocator();
+rcl_ret_t rcl_clock_init(rcl_clock_type_t type, rcl_clock_t *clock, rcl_allocator_t *allocator);
+rcl_ret_t rcl_clock_get_now(rcl_clock_t *clock, rcl_time_point_value_t *now);
+rcl_ret_t rcl_publish(const rcl_publisher_t *publisher, const void *msg, void *allocation);
+rcl_ret_t rcl_timer_exchange_period(const rcl_timer_t *timer, int64_t new_period, int64_t *old_period);
+rcl_ret_t rcl_send_response(const rcl_service_t *service, void *header, void *response);
+
+rcl_ret_t rclc_support_init(rclc_support_t *support, int argc, const char *const *argv, rcl_allocator_t *allocator);
+rcl_ret_t rclc_node_init_default(rcl_node_t *node, const char *name, const char *ns, rclc_support_t *support);
+rcl_ret_t rclc_publisher_init_default(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic);
+rcl_ret_t rclc_publisher_init_best_effort(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic);
+rcl_ret_t rclc_subscription_init_default(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic);
+rcl_ret_t rclc_subscription_init_best_effort(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic);
+rcl_ret_t rclc_service_init_default(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name);
+rcl_ret_t rclc_service_init_best_effort(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name);
+rcl_ret_t rclc_publisher_init(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic,
+                              const rmw_qos_profile_t *qos);
+rcl_ret_t rclc_subscription_init(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic,
+                                 const rmw_qos_profile_t *qos);
+rcl_ret_t rclc_service_init(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name,
+                            const rmw_qos_profile_t *qos);
+rcl_ret_t rclc_timer_init_default(rcl_timer_t *timer, rclc_support_t *support, int64_t period_ns, rcl_timer_callback_t callback);
+
+rclc_executor_t rclc_executor_get_zero_initialized_executor();
+rcl_ret_t rclc_executor_init(rclc_executor_t *executor, rcl_context_t *context, size_t handles, const rcl_allocator_t *allocator);
+rcl_ret_t rclc_executor_add_subscription(rclc_executor_t *executor, rcl_subscription_t *sub, void *msg,
+                                         rclc_subscription_callback_t callback, rclc_executor_handle_invocation_t invocation);
+rcl_ret_t rclc_executor_add_service(rclc_executor_t *executor, rcl_service_t *srv, void *request, void *response,
+                                    rclc_service_callback_t callback);
+rcl_ret_t rclc_executor_add_timer(rclc_executor_t *executor, rcl_timer_t *timer);
+rcl_ret_t rclc_executor_set_trigger(rclc_executor_t *executor, rclc_executor_trigger_t trigger, void *obj);
+rcl_ret_t rclc_executor_spin_some(rclc_executor_t *executor, int64_t timeout_ns);
+bool rclc_executor_trigger_any(rclc_executor_handle_t *handles, unsigned int size, void *obj);
+
+// Parameter server
+typedef enum { RCLC_PARAMETER_NOT_SET, RCLC_PARAMETER_BOOL, RCLC_PARAMETER_INT, RCLC_PARAMETER_DOUBLE } rclc_parameter_type_t;
+typedef struct {
+    uint8_t type;
+    bool bool_value;
+    int64_t integer_value;
+    double double_value;
+} rcl_interfaces__msg__ParameterValue;
+typedef struct { rosidl_runtime_c__String name; rcl_interfaces__msg__ParameterValue value; } Parameter;
+typedef bool (*rclc_parameter_callback_t)(const Parameter *, const Parameter *, void *);
+typedef struct {
+    bool notify_changed_over_dds;
+    size_t max_params;
+    bool allow_undeclared_parameters;
+    bool low_mem_mode;
+} rclc_parameter_options_t;
+typedef struct {
+    rclc_parameter_callback_t on_modification;
+    void *context;
+} rclc_parameter_server_t;
+#define RCLC_EXECUTOR_PARAMETER_SERVER_HANDLES 5
+
+rcl_ret_t rclc_parameter_server_init_with_option(rclc_parameter_server_t *server, rcl_node_t *node,
+                                                 const rclc_parameter_options_t *options);
+rcl_ret_t rclc_executor_add_parameter_server_with_context(rclc_executor_t *executor, rclc_parameter_server_t *server,
+                                                          rclc_parameter_callback_t callback, void *context);
+rcl_ret_t rclc_add_parameter(rclc_parameter_server_t *server, const char *name, rclc_parameter_type_t type);
+rcl_ret_t rclc_parameter_set_int(rclc_parameter_server_t *server, const char *name, int64_t value);
+rcl_ret_t rclc_parameter_set_double(rclc_parameter_server_t *server, const char *name, double value);
+
+// Host-side helper emulating a remote "ros2 param set"; returns the callback's verdict
+bool nativeSetParameter(rclc_parameter_server_t *server, const char *name, rclc_parameter_type_t type, double value);
+
+// Entities created through the rclc init calls, compared with the RMW_UXRCE_MAX_* limits
+struct NativeEntityCounts {
+    int publishers;
+    int subscriptions;
+    int services;
+};
+extern NativeEntityCounts nativeEntities;
+
+// Host-side namespace given to every node instead of the one the firmware passes, NULL keeps it
+extern const char *nativeNodeNamespace;
+
+// Host-side hook called for every rcl_publish()
+extern std::function<void(const rcl_publisher_t *, const void *)> nativePublishHook;
+
+// Host-side hook asked by rclc_executor_spin_some() for new subscription or
+// service request data; fills msg and returns true when data is available
+extern std::function<bool(const char *topic, void *msg)> nativeTakeHook;
+
+// Host-side hook called for every rcl_send_response()
+extern std::function<void(const rcl_service_t *, const void *)> nativeResponseHook;
+
+#endif // NATIVE_MICRO_ROS_STUB_H
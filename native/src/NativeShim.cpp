@@ -0,0 +1,523 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Implementation of the native stand-ins declared in native/include.
+
+#include <stdio.h>
+#include <time.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "M5Stack.h"
+#include "micro_ros_arduino.h"
+
+HardwareSerial Serial(0);
+NativeM5 M5;
+NativeESP ESP;
+
+std::function<void(const rcl_publisher_t *, const void *)> nativePublishHook;
+std::function<bool(const char *, void *)> nativeTakeHook;
+std::function<void(const rcl_service_t *, const void *)> nativeResponseHook;
+const char *nativeNodeNamespace = NULL;
+NativeEntityCounts nativeEntities;
+
+static int64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepNanos(int64_t ns) {
+    if (ns <= 0) {
+        return;
+    }
+    struct timespec ts = {(time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL)};
+    nanosleep(&ts, NULL);
+}
+
+// Arduino timing, 32 bits wide like on the ESP32
+unsigned long millis() { return (uint32_t)(monotonicNanos() / 1000000LL); }
+unsigned long micros() { return (uint32_t)(monotonicNanos() / 1000LL); }
+void delay(unsigned long ms) { sleepNanos((int64_t)ms * 1000000LL); }
+void delayMicroseconds(unsigned int us) { sleepNanos((int64_t)us * 1000LL); }
+
+void NativeESP::restart() {
+    fprintf(stderr, "ESP.restart() called\n");
+    exit(1);
+}
+
+// Print
+size_t Print::print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(double v, int digits) { return printf("%.*f", digits, v); }
+size_t Print::print(long long v) { return printf("%lld", v); }
+size_t Print::print(unsigned long long v) { return printf("%llu", v); }
+size_t Print::println() { return print("\r\n"); }
+
+size_t Print::printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+}
+
+// FreeRTOS
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::recursive_mutex(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    static_cast<std::recursive_mutex *>(sem)->lock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    static_cast<std::recursive_mutex *>(sem)->unlock();
+    return pdTRUE;
+}
+
+// Notification state of a task, the task handle points to it
+struct NativeTask {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t count = 0;
+};
+static thread_local NativeTask *current_task = NULL;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *param, UBaseType_t priority, TaskHandle_t *handle, int core) {
+    NativeTask *task = new NativeTask();
+    if (handle != NULL) {
+        *handle = task;
+    }
+    std::thread([fn, param, task]() {
+        current_task = task;
+        fn(param);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    *previous_wake += increment;
+    int32_t remaining = (int32_t)(*previous_wake - xTaskGetTickCount());
+    if (remaining > 0) {
+        delay((unsigned long)remaining);
+    }
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t *higher_priority_task_woken) {
+    NativeTask *task = static_cast<NativeTask *>(handle);
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->count++;
+    }
+    task->notified.notify_one();
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    NativeTask *task = current_task;
+    std::unique_lock<std::mutex> guard(task->lock);
+    if (ticks == portMAX_DELAY) {
+        task->notified.wait(guard, [task]() { return task->count > 0; });
+    } else {
+        task->notified.wait_for(guard, std::chrono::milliseconds(ticks), [task]() { return task->count > 0; });
+    }
+    uint32_t value = task->count;
+    if (value > 0) {
+        task->count = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+// GPIO
+struct NativePin {
+    int level = HIGH;
+    void (*handler)(void) = NULL;
+    int mode = 0;
+};
+static std::map<uint8_t, NativePin> native_pins;
+static std::mutex native_pins_lock;
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+int digitalRead(uint8_t pin) {
+    std::lock_guard<std::mutex> guard(native_pins_lock);
+    return native_pins[pin].level;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    std::lock_guard<std::mutex> guard(native_pins_lock);
+    native_pins[pin].handler = handler;
+    native_pins[pin].mode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+    std::lock_guard<std::mutex> guard(native_pins_lock);
+    native_pins[pin].handler = NULL;
+}
+
+void nativeSetPin(uint8_t pin, int level) {
+    void (*handler)(void) = NULL;
+    {
+        std::lock_guard<std::mutex> guard(native_pins_lock);
+        NativePin &p = native_pins[pin];
+        bool rising = p.level == LOW && level == HIGH;
+        bool falling = p.level == HIGH && level == LOW;
+        if ((rising && (p.mode & RISING)) || (falling && (p.mode & FALLING))) {
+            handler = p.handler;
+        }
+        p.level = level;
+    }
+    if (handler != NULL) {
+        handler();  // Runs on the calling thread like an interrupt on the current core
+    }
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_runtime) {
+    *total_runtime = micros();
+    return 0;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu) { return NULL; }
+
+// micro_ros_arduino transports
+rmw_ret_t rmw_uros_set_custom_transport(bool framing, void *args, open_custom_func open_cb,
+                                        close_custom_func close_cb, write_custom_func write_cb,
+                                        read_custom_func read_cb) {
+    return RMW_RET_OK;
+}
+void set_microros_transports() {}
+int64_t nativeAgentEpochNanos = 0;
+static bool epoch_synchronized = false;
+static int64_t epoch_offset_ns = 0;
+rmw_ret_t rmw_uros_sync_session(int timeout_ms) {
+    if (nativeAgentEpochNanos == 0) {
+        return RMW_RET_ERROR;
+    }
+    epoch_offset_ns = nativeAgentEpochNanos - monotonicNanos();
+    epoch_synchronized = true;
+    return RMW_RET_OK;
+}
+bool rmw_uros_epoch_synchronized() { return epoch_synchronized; }
+int64_t rmw_uros_epoch_nanos() { return epoch_synchronized ? monotonicNanos() + epoch_offset_ns : 0; }
+rmw_ret_t rmw_uros_ping_agent(int timeout_ms, uint8_t attempts) {
+    return nativeAgentEpochNanos != 0 ? RMW_RET_OK : RMW_RET_ERROR;
+}
+rmw_ret_t rmw_uros_set_publisher_session_timeout(rcl_publisher_t *publisher, int session_timeout) {
+    publisher->session_timeout = session_timeout;
+    return RMW_RET_OK;
+}
+bool arduino_wifi_transport_open(struct uxrCustomTransport *transport) { return true; }
+bool arduino_wifi_transport_close(struct uxrCustomTransport *transport) { return true; }
+size_t arduino_wifi_transport_write(struct uxrCustomTransport *transport, const uint8_t *buf, size_t len, uint8_t *err) { return len; }
+size_t arduino_wifi_transport_read(struct uxrCustomTransport *transport, uint8_t *buf, size_t len, int timeout, uint8_t *err) { return 0; }
+
+// rcl
+rcutils_error_string_t rcl_get_error_string() { return {"native stub error"}; }
+void rcl_reset_error() {}
+rcl_allocator_t rcl_get_default_allocator() { return {0}; }
+rcl_ret_t rcl_clock_init(rcl_clock_type_t type, rcl_clock_t *clock, rcl_allocator_t *allocator) { return RCL_RET_OK; }
+
+rcl_ret_t rcl_clock_get_now(rcl_clock_t *clock, rcl_time_point_value_t *now) {
+    *now = monotonicNanos();
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rcl_publish(const rcl_publisher_t *publisher, const void *msg, void *allocation) {
+    if (nativePublishHook) {
+        nativePublishHook(publisher, msg);
+    }
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rcl_timer_exchange_period(const rcl_timer_t *timer, int64_t new_period, int64_t *old_period) {
+    *old_period = timer->period_ns;
+    const_cast<rcl_timer_t *>(timer)->period_ns = new_period;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rcl_send_response(const rcl_service_t *service, void *header, void *response) {
+    if (nativeResponseHook) {
+        nativeResponseHook(service, response);
+    }
+    return RCL_RET_OK;
+}
+
+// rclc
+rcl_ret_t rclc_support_init(rclc_support_t *support, int argc, const char *const *argv, rcl_allocator_t *allocator) { return RCL_RET_OK; }
+rcl_ret_t rclc_node_init_default(rcl_node_t *node, const char *name, const char *ns, rclc_support_t *support) {
+    node->name = name;
+    node->namespace_ = nativeNodeNamespace != NULL ? nativeNodeNamespace : ns;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_publisher_init_default(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic) {
+    nativeEntities.publishers++;
+    pub->topic = topic;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_publisher_init_best_effort(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic) {
+    nativeEntities.publishers++;
+    pub->topic = topic;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_subscription_init_default(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic) {
+    nativeEntities.subscriptions++;
+    sub->topic = topic;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_subscription_init_best_effort(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic) {
+    nativeEntities.subscriptions++;
+    sub->topic = topic;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_service_init_default(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name) {
+    nativeEntities.services++;
+    srv->name = name;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_service_init_best_effort(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name) {
+    nativeEntities.services++;
+    srv->name = name;
+    return RCL_RET_OK;
+}
+const rmw_qos_profile_t rmw_qos_profile_default = {
+    RMW_QOS_POLICY_HISTORY_KEEP_LAST, 10, RMW_QOS_POLICY_RELIABILITY_RELIABLE, RMW_QOS_POLICY_DURABILITY_VOLATILE};
+const rmw_qos_profile_t rmw_qos_profile_sensor_data = {
+    RMW_QOS_POLICY_HISTORY_KEEP_LAST, 5, RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, RMW_QOS_POLICY_DURABILITY_VOLATILE};
+const rmw_qos_profile_t rmw_qos_profile_services_default = {
+    RMW_QOS_POLICY_HISTORY_KEEP_LAST, 10, RMW_QOS_POLICY_RELIABILITY_RELIABLE, RMW_QOS_POLICY_DURABILITY_VOLATILE};
+rcl_ret_t rclc_publisher_init(rcl_publisher_t *pub, const rcl_node_t *node, const void *type, const char *topic,
+                              const rmw_qos_profile_t *qos) {
+    nativeEntities.publishers++;
+    pub->topic = topic;
+    pub->qos = *qos;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_subscription_init(rcl_subscription_t *sub, const rcl_node_t *node, const void *type, const char *topic,
+                                 const rmw_qos_profile_t *qos) {
+    nativeEntities.subscriptions++;
+    sub->topic = topic;
+    sub->qos = *qos;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_service_init(rcl_service_t *srv, const rcl_node_t *node, const void *type, const char *name,
+                            const rmw_qos_profile_t *qos) {
+    nativeEntities.services++;
+    srv->name = name;
+    srv->qos = *qos;
+    return RCL_RET_OK;
+}
+rcl_ret_t rclc_timer_init_default(rcl_timer_t *timer, rclc_support_t *support, int64_t period_ns, rcl_timer_callback_t callback) {
+    timer->period_ns = period_ns;
+    timer->last_call_ns = monotonicNanos();
+    timer->callback = callback;
+    return RCL_RET_OK;
+}
+
+rclc_executor_t rclc_executor_get_zero_initialized_executor() {
+    rclc_executor_t executor;
+    memset(&executor, 0, sizeof(executor));
+    return executor;
+}
+
+rcl_ret_t rclc_executor_init(rclc_executor_t *executor, rcl_context_t *context, size_t handles, const rcl_allocator_t *allocator) {
+    if (handles > sizeof(executor->handles) / sizeof(executor->handles[0])) {
+        return RCL_RET_INVALID_ARGUMENT;
+    }
+    *executor = rclc_executor_get_zero_initialized_executor();
+    executor->max_handles = (unsigned int)handles;
+    executor->trigger_function = rclc_executor_trigger_any;
+    return RCL_RET_OK;
+}
+
+static rclc_executor_handle_t *nextHandle(rclc_executor_t *executor) {
+    if (executor->index >= executor->max_handles) {
+        return NULL;
+    }
+    rclc_executor_handle_t *handle = &executor->handles[executor->index++];
+    handle->initialized = true;
+    return handle;
+}
+
+rcl_ret_t rclc_executor_add_subscription(rclc_executor_t *executor, rcl_subscription_t *sub, void *msg,
+                                         rclc_subscription_callback_t callback, rclc_executor_handle_invocation_t invocation) {
+    rclc_executor_handle_t *handle = nextHandle(executor);
+    if (handle == NULL) {
+        return RCL_RET_ERROR;
+    }
+    handle->type = RCLC_SUBSCRIPTION;
+    handle->subscription = sub;
+    handle->data = msg;
+    handle->subscription_callback = callback;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rclc_executor_add_service(rclc_executor_t *executor, rcl_service_t *srv, void *request, void *response,
+                                    rclc_service_callback_t callback) {
+    rclc_executor_handle_t *handle = nextHandle(executor);
+    if (handle == NULL) {
+        return RCL_RET_ERROR;
+    }
+    handle->type = RCLC_SERVICE;
+    handle->service = srv;
+    handle->data = request;
+    handle->response = response;
+    handle->service_callback = callback;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rclc_executor_add_timer(rclc_executor_t *executor, rcl_timer_t *timer) {
+    rclc_executor_handle_t *handle = nextHandle(executor);
+    if (handle == NULL) {
+        return RCL_RET_ERROR;
+    }
+    handle->type = RCLC_TIMER;
+    handle->timer = timer;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rclc_executor_set_trigger(rclc_executor_t *executor, rclc_executor_trigger_t trigger, void *obj) {
+    executor->trigger_function = trigger;
+    executor->trigger_object = obj;
+    return RCL_RET_OK;
+}
+
+bool rclc_executor_trigger_any(rclc_executor_handle_t *handles, unsigned int size, void *obj) {
+    for (unsigned int i = 0; i < size && handles[i].initialized; i++) {
+        if (handles[i].data_available) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Checks every handle once, like rcl_wait followed by rclc's default scheduling
+static bool collectReadyHandles(rclc_executor_t *executor) {
+    bool any = false;
+    int64_t now = monotonicNanos();
+    for (unsigned int i = 0; i < executor->index; i++) {
+        rclc_executor_handle_t *handle = &executor->handles[i];
+        switch (handle->type) {
+        case RCLC_TIMER:
+            handle->data_available = now - handle->timer->last_call_ns >= handle->timer->period_ns;
+            break;
+        case RCLC_SUBSCRIPTION:
+            handle->data_available = nativeTakeHook && nativeTakeHook(handle->subscription->topic, handle->data);
+            break;
+        case RCLC_SERVICE:
+            handle->data_available = nativeTakeHook && nativeTakeHook(handle->service->name, handle->data);
+            break;
+        default:
+            handle->data_available = false;
+            break;
+        }
+        any = any || handle->data_available;
+    }
+    return any;
+}
+
+rcl_ret_t rclc_executor_spin_some(rclc_executor_t *executor, int64_t timeout_ns) {
+    int64_t deadline = monotonicNanos() + timeout_ns;
+    while (!collectReadyHandles(executor)) {
+        if (monotonicNanos() >= deadline) {
+            return RCL_RET_OK;
+        }
+        sleepNanos(100000);
+    }
+
+    if (!executor->trigger_function(executor->handles, executor->index, executor->trigger_object)) {
+        return RCL_RET_OK;
+    }
+
+    for (unsigned int i = 0; i < executor->index; i++) {
+        rclc_executor_handle_t *handle = &executor->handles[i];
+        if (!handle->data_available) {
+            continue;
+        }
+        switch (handle->type) {
+        case RCLC_TIMER: {
+            int64_t now = monotonicNanos();
+            int64_t last_call = now - handle->timer->last_call_ns;
+            handle->timer->last_call_ns = now;
+            handle->timer->callback(handle->timer, last_call);
+            break;
+        }
+        case RCLC_SUBSCRIPTION:
+            handle->subscription_callback(handle->data);
+            break;
+        case RCLC_SERVICE:
+            handle->service_callback(handle->data, handle->response);
+            rcl_send_response(handle->service, NULL, handle->response);
+            break;
+        default:
+            break;
+        }
+    }
+    return RCL_RET_OK;
+}
+
+// rclc_parameter
+rcl_ret_t rclc_parameter_server_init_with_option(rclc_parameter_server_t *server, rcl_node_t *node,
+                                                 const rclc_parameter_options_t *options) {
+    // One service per executor handle, plus the parameter event publisher
+    nativeEntities.services += RCLC_EXECUTOR_PARAMETER_SERVER_HANDLES;
+    if (options->notify_changed_over_dds) {
+        nativeEntities.publishers++;
+    }
+    server->on_modification = NULL;
+    server->context = NULL;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rclc_executor_add_parameter_server_with_context(rclc_executor_t *executor, rclc_parameter_server_t *server,
+                                                          rclc_parameter_callback_t callback, void *context) {
+    // The parameter services are not modelled, so only the handle budget is checked
+    if (executor->max_handles - executor->index < RCLC_EXECUTOR_PARAMETER_SERVER_HANDLES) {
+        return RCL_RET_ERROR;
+    }
+    server->on_modification = callback;
+    server->context = context;
+    return RCL_RET_OK;
+}
+
+rcl_ret_t rclc_add_parameter(rclc_parameter_server_t *server, const char *name, rclc_parameter_type_t type) { return RCL_RET_OK; }
+rcl_ret_t rclc_parameter_set_int(rclc_parameter_server_t *server, const char *name, int64_t value) { return RCL_RET_OK; }
+rcl_ret_t rclc_parameter_set_double(rclc_parameter_server_t *server, const char *name, double value) { return RCL_RET_OK; }
+
+bool nativeSetParameter(rclc_parameter_server_t *server, const char *name, rclc_parameter_type_t type, double value) {
+    if (server->on_modification == NULL) {
+        return false;
+    }
+    Parameter param;
+    memset(&param, 0, sizeof(param));
+    param.name.data = const_cast<char *>(name);
+    param.name.size = strlen(name);
+    param.value.type = type;
+    param.value.integer_value = (int64_t)value;
+    param.value.double_value = value;
+    return server->on_modification(NULL, &param, server->context);
+}
@@ -0,0 +1,142 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "SimMotorDriver.h"
+#include "MotorController.h"
+
+static const size_t FRAME_LENGTH = 10; // Nine payload bytes and one checksum
+
+SimMotorDriver::SimMotorDriver(HardwareSerial &serial)
+    : serial(serial), time_constant(0.05f), drop_frames(0), online(true), frames_received(0), checksum_errors(0) {
+    serial.onWrite = [this](const uint8_t *buf, size_t len) { onBytes(buf, len); };
+}
+
+int32_t SimMotorDriver::registerValue(uint8_t motorID, uint16_t address) {
+    return motors[motorID].registers[address];
+}
+
+void SimMotorDriver::setRegister(uint8_t motorID, uint16_t address, int32_t value) {
+    motors[motorID].registers[address] = value;
+}
+
+void SimMotorDriver::injectFault(uint8_t motorID, uint32_t code) {
+    MotorState &motor = motors[motorID];
+    motor.registers[FAULT_CODE_ADDRESS] = (int32_t)code;
+    motor.registers[CONTROL_WORD_ADDRESS] = 0;
+}
+
+void SimMotorDriver::onBytes(const uint8_t *buf, size_t len) {
+    pending.insert(pending.end(), buf, buf + len);
+    while (pending.size() >= FRAME_LENGTH) {
+        handleFrame(pending.data());
+        pending.erase(pending.begin(), pending.begin() + FRAME_LENGTH);
+    }
+}
+
+void SimMotorDriver::handleFrame(const uint8_t *frame) {
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < FRAME_LENGTH - 1; i++) {
+        checksum += frame[i];
+    }
+    if (checksum != frame[FRAME_LENGTH - 1]) {
+        checksum_errors++;
+        return;
+    }
+    frames_received++;
+    if (!online) {
+        return;
+    }
+    if (drop_frames > 0) {
+        drop_frames--;
+        return;
+    }
+
+    uint8_t motorID = frame[0];
+    uint8_t command = frame[1];
+    uint16_t address = ((uint16_t)frame[2] << 8) | frame[3];
+    int32_t value = (int32_t)(((uint32_t)frame[5] << 24) | ((uint32_t)frame[6] << 16) |
+                              ((uint32_t)frame[7] << 8) | frame[8]);
+    MotorState &motor = motors[motorID];
+    if (motor.offline) {
+        return;
+    }
+    updateSpeed(motor);
+
+    if (command == READ_DEC_COMMAND) {
+        int32_t result = address == ACTUAL_SPEED_DEC_ADDRESS ? (int32_t)motor.actual_dec :
+                         address == ACTUAL_POSITION_ADDRESS ? (int32_t)(int64_t)floor(motor.position) :
+                         address == STATUS_WORD_ADDRESS ? statusWord(motor) :
+                         motor.registers[address];
+        reply(motorID, READ_DEC_SUCCESS, address, result);
+    } else if (address == CONTROL_WORD_ADDRESS && !motor.locked[address]) {
+        writeControlWord(motor, value);
+    } else if (!motor.locked[address]) {
+        motor.registers[address] = value;
+    }
+}
+
+void SimMotorDriver::writeControlWord(MotorState &motor, int32_t value) {
+    int32_t &fault = motor.registers[FAULT_CODE_ADDRESS];
+    if ((uint32_t)value == FAULT_RESET) {
+        if ((fault & MOTOR_FAULT_PERMANENT) == 0) {
+            fault = 0;
+        }
+    } else if (fault != 0) {
+        return; // A faulted driver refuses to be enabled
+    }
+    motor.registers[CONTROL_WORD_ADDRESS] = value;
+}
+
+int32_t SimMotorDriver::statusWord(MotorState &motor) {
+    int32_t status = 0;
+    bool faulted = motor.registers[FAULT_CODE_ADDRESS] != 0;
+    bool stopped = motor.registers[EMERGENCY_STOP_ADDRESS] != DISABLE_EMERGENCY_STOP;
+    if (faulted) {
+        status |= MOTOR_STATUS_FAULT;
+    }
+    if (stopped) {
+        status |= MOTOR_STATUS_EMERGENCY_STOP;
+    }
+    if (!faulted && !stopped && (uint32_t)motor.registers[CONTROL_WORD_ADDRESS] == ENABLE_MOTOR) {
+        status |= MOTOR_STATUS_ENABLED;
+    }
+    return status;
+}
+
+void SimMotorDriver::updateSpeed(MotorState &motor) {
+    unsigned long now = micros();
+    if (motor.last_update_us != 0) {
+        float dt = (now - motor.last_update_us) / 1000000.0f;
+        float alpha = time_constant > 0.0f ? dt / (time_constant + dt) : 1.0f;
+        // A tripped driver lets the wheel coast down regardless of the target
+        bool tripped = motor.registers[FAULT_CODE_ADDRESS] != 0 ||
+                       motor.registers[EMERGENCY_STOP_ADDRESS] != DISABLE_EMERGENCY_STOP;
+        float target = tripped ? 0.0f : (float)motor.registers[TARGET_VELOCITY_DEC_ADDRESS];
+        motor.actual_dec += alpha * (target - motor.actual_dec);
+        // DEC = RPM * 512 * 4096 / 1875, so counts per second = DEC * 1875 / (512 * 60)
+        motor.position += motor.actual_dec * (1875.0 / (512.0 * 60.0)) * dt;
+    }
+    motor.last_update_us = now;
+}
+
+void SimMotorDriver::reply(uint8_t motorID, uint8_t command, uint16_t address, int32_t value) {
+    uint8_t frame[FRAME_LENGTH] = {motorID, command, highByte(address), lowByte(address), ERROR_BYTE,
+                                   (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value, 0};
+    for (size_t i = 0; i < FRAME_LENGTH - 1; i++) {
+        frame[FRAME_LENGTH - 1] += frame[i];
+    }
+    serial.injectRx(frame, FRAME_LENGTH);
+}
@@ -0,0 +1,140 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "ActuationLatency.h"
+#include "SummaryFormat.h"
+
+ActuationLatency actuationLatency;
+
+ActuationLatency::ActuationLatency()
+    : state(TRACK_IDLE), last_target_dec(0), target_dec(0), target_speed(0.0f), start_speed(0.0f),
+      last_speed(0.0f), ready_us(0), write_us(0), ack_us(0) {
+    memset(samples, 0, sizeof(samples));
+    memset(sample_count, 0, sizeof(sample_count));
+    memset(&counters, 0, sizeof(counters));
+}
+
+void ActuationLatency::onCommand(uint32_t ready_us, uint32_t callback_us, uint32_t write_us,
+                                 int32_t target_dec, float target_speed) {
+    counters.commands++;
+    record(ACTUATION_DISPATCH, callback_us - ready_us);
+    record(ACTUATION_WRITE, write_us - callback_us);
+    expire(write_us);
+    // Repeats of the current target keep a pending change tracked
+    if (target_dec == last_target_dec) {
+        return;
+    }
+    last_target_dec = target_dec;
+    counters.changes++;
+    if (state != TRACK_IDLE) {
+        counters.superseded++;
+    }
+    state = TRACK_ACK;
+    this->target_dec = target_dec;
+    this->target_speed = target_speed;
+    start_speed = last_speed;
+    this->ready_us = ready_us;
+    this->write_us = write_us;
+}
+
+void ActuationLatency::onReadBack(int32_t target_dec, uint32_t now_us) {
+    expire(now_us);
+    // A read-back of an earlier target answers an older request
+    if (state != TRACK_ACK || target_dec != this->target_dec) {
+        return;
+    }
+    record(ACTUATION_ACK, now_us - write_us);
+    ack_us = now_us;
+    if (fabsf(target_speed - start_speed) < ACTUATION_MIN_MOVE) {
+        counters.completed++;  // Too small to see in the speed
+        state = TRACK_IDLE;
+        return;
+    }
+    state = TRACK_RESPONSE;
+}
+
+void ActuationLatency::onFeedback(float speed, uint32_t now_us) {
+    last_speed = speed;
+    expire(now_us);
+    if (state != TRACK_RESPONSE) {
+        return;
+    }
+    float step = target_speed - start_speed;
+    float moved = step > 0.0f ? speed - start_speed : start_speed - speed;
+    if (moved < ACTUATION_MIN_MOVE) {
+        return;
+    }
+    record(ACTUATION_RESPONSE, now_us - ack_us);
+    record(ACTUATION_TOTAL, now_us - ready_us);
+    counters.completed++;
+    state = TRACK_IDLE;
+}
+
+ActuationDistribution ActuationLatency::distribution(ActuationStage stage) const {
+    ActuationDistribution d;
+    memset(&d, 0, sizeof(d));
+    uint32_t n = sample_count[stage] < ACTUATION_SAMPLES ? sample_count[stage] : ACTUATION_SAMPLES;
+    if (n == 0) {
+        return d;
+    }
+    // Insertion sort of a copy, the summary is built at the diagnostics rate
+    uint32_t sorted[ACTUATION_SAMPLES];
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t value = samples[stage][i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    d.count = n;
+    d.min_us = sorted[0];
+    d.p50_us = sorted[(n - 1) / 2];
+    d.p90_us = sorted[(n * 9) / 10 < n ? (n * 9) / 10 : n - 1];
+    d.max_us = sorted[n - 1];
+    return d;
+}
+
+size_t ActuationLatency::summarize(char *buf, size_t len) const {
+    static const char *const names[ACTUATION_STAGES] = {"dispatch", "write", "ack", "response", "total"};
+    size_t used = 0;
+    appendf(buf, len, &used, "commands=%u changes=%u completed=%u superseded=%u timeouts=%u",
+            (unsigned)counters.commands, (unsigned)counters.changes,
+            (unsigned)counters.completed, (unsigned)counters.superseded,
+            (unsigned)counters.timeouts);
+    // stage_us=count:min/p50/p90/max
+    for (uint8_t stage = 0; stage < ACTUATION_STAGES && used + 1 < len; stage++) {
+        ActuationDistribution d = distribution((ActuationStage)stage);
+        appendf(buf, len, &used, " %s_us=%u:%u/%u/%u/%u", names[stage],
+                (unsigned)d.count, (unsigned)d.min_us, (unsigned)d.p50_us,
+                (unsigned)d.p90_us, (unsigned)d.max_us);
+    }
+    return used;
+}
+
+void ActuationLatency::record(ActuationStage stage, uint32_t latency_us) {
+    samples[stage][sample_count[stage] % ACTUATION_SAMPLES] = latency_us;
+    sample_count[stage]++;
+}
+
+void ActuationLatency::expire(uint32_t now_us) {
+    if (state != TRACK_IDLE && now_us - write_us > ACTUATION_TIMEOUT * 1000UL) {
+        counters.timeouts++;
+        state = TRACK_IDLE;
+    }
+}
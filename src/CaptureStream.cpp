@@ -0,0 +1,195 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <M5Stack.h>
+#include <string.h>
+#include "CaptureStream.h"
+#include "ControlParameters.h"
+#include "TransportManager.h"
+
+CaptureStream captureStream;
+HardwareSerial captureSerial(1); // Second UART, used when micro-ROS runs on USB serial
+static SemaphoreHandle_t capture_mutex = NULL; // Serializes the producers, created before the capture is enabled
+
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_index = 0;  // Position of the current block's length byte
+    size_t out_len = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[out_len++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_index] = code;
+            code_index = out_len++;
+            code = 1;
+        }
+    }
+    out[code_index] = code;
+    out[out_len++] = 0;  // Frame delimiter
+    return out_len;
+}
+
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t out_len = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t j = 1; j < code; j++) {
+            if (in[i] == 0) {
+                return 0;
+            }
+            out[out_len++] = in[i++];
+        }
+        if (code != 0xFF && i < len) {
+            out[out_len++] = 0;
+        }
+    }
+    return out_len;
+}
+
+uint16_t captureCrc16(const uint8_t *data, size_t len) {
+    // Nibble table keeps the cost low at 1 kHz without a 512-byte table
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 4) ^ table[((crc >> 12) ^ (data[i] >> 4)) & 0x0F]);
+        crc = (uint16_t)((crc << 4) ^ table[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F]);
+    }
+    return crc;
+}
+
+CaptureStream::CaptureStream() : head(0), tail(0), enabled_mask(0), seq(0), dropped_count(0) {}
+
+static void lockCapture() {
+    if (capture_mutex != NULL) {
+        xSemaphoreTake(capture_mutex, portMAX_DELAY);
+    }
+}
+
+static void unlockCapture() {
+    if (capture_mutex != NULL) {
+        xSemaphoreGive(capture_mutex);
+    }
+}
+
+bool CaptureStream::record(uint8_t type, const void *payload, uint8_t size, uint32_t timestamp_us) {
+    if (!isEnabled(type) || size > CAPTURE_MAX_PAYLOAD) {
+        return false;
+    }
+    // Held until the frame is in the ring, so sequence numbers follow the stream order
+    lockCapture();
+    uint8_t raw[CAPTURE_HEADER_SIZE + CAPTURE_MAX_PAYLOAD + CAPTURE_CRC_SIZE];
+    uint32_t record_seq = seq++;
+    raw[0] = type;
+    memcpy(&raw[1], &record_seq, sizeof(record_seq));
+    memcpy(&raw[5], &timestamp_us, sizeof(timestamp_us));
+    memcpy(&raw[CAPTURE_HEADER_SIZE], payload, size);
+    size_t raw_len = CAPTURE_HEADER_SIZE + size;
+    uint16_t crc = captureCrc16(raw, raw_len);
+    memcpy(&raw[raw_len], &crc, sizeof(crc));
+    raw_len += sizeof(crc);
+
+    uint8_t frame[CAPTURE_MAX_FRAME];
+    size_t frame_len = cobsEncode(raw, raw_len, frame);
+    if (frame_len > CAPTURE_BUFFER_SIZE - pending()) {
+        dropped_count++;
+        unlockCapture();
+        return false;
+    }
+    uint32_t at = head;
+    for (size_t i = 0; i < frame_len; i++) {
+        ring[(at + i) % CAPTURE_BUFFER_SIZE] = frame[i];
+    }
+    head = at + frame_len;  // Publish the frame only once it is complete
+    unlockCapture();
+    return true;
+}
+
+void CaptureStream::recordIMU(const float input[6], const float filtered[6]) {
+    if (!isEnabled(CAPTURE_IMU)) {
+        return;
+    }
+    float data[12];
+    memcpy(data, input, 6 * sizeof(float));
+    memcpy(data + 6, filtered, 6 * sizeof(float));
+    record(CAPTURE_IMU, data, sizeof(data), micros());
+}
+
+void CaptureStream::recordMotorFrame(uint8_t type, const uint8_t *frame) {
+    record(type, frame, 10, micros());
+}
+
+void CaptureStream::recordTick(uint8_t stream) {
+    record(CAPTURE_CONTROL_TICK, &stream, sizeof(stream), micros());
+}
+
+size_t CaptureStream::read(uint8_t *out, size_t max) {
+    uint32_t at = tail;
+    size_t n = head - at;
+    if (n > max) {
+        n = max;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ring[(at + i) % CAPTURE_BUFFER_SIZE];
+    }
+    tail = at + n;
+    return n;
+}
+
+// USB carries the stream only when micro-ROS does not use it
+static Print &openCapturePort() {
+    if (activeTransport == TRANSPORT_UDP) {
+        Serial.end();
+        Serial.begin(CAPTURE_BAUD_RATE);
+        return Serial;
+    }
+    captureSerial.begin(CAPTURE_BAUD_RATE, SERIAL_8N1, CAPTURE_RX_PIN, CAPTURE_TX_PIN);
+    return captureSerial;
+}
+
+void startCaptureTask() {
+    capture_mutex = xSemaphoreCreateMutex();
+    if (capture_mutex == NULL) {
+        return;  // The capture stays off, unserialized producers would corrupt the ring
+    }
+    captureStream.setMask((uint8_t)controlParams.capture_mask);
+    xTaskCreatePinnedToCore(captureTask, "capture", CAPTURE_TASK_STACK_SIZE,
+                            NULL, CAPTURE_TASK_PRIORITY, NULL, CAPTURE_TASK_CORE);
+}
+
+// Lowest-priority task: opens the port on the first capture and writes the buffered frames
+void captureTask(void *param) {
+    (void)param;
+    Print *port = NULL;
+    uint8_t chunk[CAPTURE_CHUNK_SIZE];
+    for (;;) {
+        if (port == NULL && captureStream.mask() != 0) {
+            port = &openCapturePort();
+        }
+        size_t n;
+        while (port != NULL && (n = captureStream.read(chunk, sizeof(chunk))) > 0) {
+            port->write(chunk, n);
+        }
+        vTaskDelay(pdMS_TO_TICKS(CAPTURE_DRAIN_PERIOD));
+    }
+}
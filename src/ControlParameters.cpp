@@ -0,0 +1,170 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <Preferences.h>
+#include <string.h>
+#include "ControlParameters.h"
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "TransportManager.h"
+#include "IMUManager.h"
+#include "VelocityEstimator.h"
+#include "LinkMonitor.h"
+#include "SubscriptionStats.h"
+#include "CaptureStream.h"
+#include "MotorSupervisor.h"
+#include "ImuBatch.h"
+#include "RateCalibration.h"
+#include "SlipDetector.h"
+
+ControlParameters controlParams = {
+    IMU_SAMPLE_PERIOD,
+    IMU_PUBLISH_PERIOD,
+    WHEEL_PERIOD,
+    DIAGNOSTICS_PERIOD,
+    MOTOR_REPLY_TIMEOUT,
+    MICRO_ROS_TRANSPORT,
+    VELOCITY_SOURCE,
+    LINK_MAX_RTT,
+    LINK_MAX_LOSS,
+    LINK_TIMEOUT,
+    CMD_VEL_MAX_AGE,
+    CMD_VEL_TIMEOUT,
+    CAPTURE_MASK,
+    MOTOR_STATUS_PERIOD,
+    MOTOR_RETRY_MAX,
+    IMU_FORMAT,
+    AUTO_RATES,
+    RATE_CPU_BUDGET,
+    RATE_LINK_BUDGET,
+    ACCEL_CUTOFF_HZ,
+    GYRO_CUTOFF_HZ,
+    NOTCH_HZ,
+    NOTCH_Q,
+    WHEEL_RADIUS,
+    WHEEL_DISTANCE,
+    GYRO_COVARIANCE,
+    ACCEL_COVARIANCE,
+    VELOCITY_PROCESS_NOISE,
+    SLIP_YAW_TOLERANCE,
+    SLIP_ACCEL_LIMIT,
+};
+
+static const ControlParameterInfo PARAMETERS[] = {
+    {PARAM_IMU_SAMPLE_PERIOD, "imu_sample_ms", &controlParams.imu_sample_period_ms, NULL, 1, 100},
+    {PARAM_IMU_PUBLISH_PERIOD, "imu_publish_ms", &controlParams.imu_publish_period_ms, NULL, 5, 1000},
+    {PARAM_WHEEL_PERIOD, "wheel_ms", &controlParams.wheel_period_ms, NULL, 5, 1000},
+    {PARAM_DIAGNOSTICS_PERIOD, "diag_ms", &controlParams.diagnostics_period_ms, NULL, 100, 60000},
+    {PARAM_MOTOR_REPLY_TIMEOUT, "motor_reply_ms", &controlParams.motor_reply_timeout_ms, NULL, 1, 1000},
+    {PARAM_TRANSPORT, "transport", &controlParams.transport, NULL, TRANSPORT_SERIAL, TRANSPORT_FRAMED_SERIAL},
+    {PARAM_ACCEL_CUTOFF, "accel_cut_hz", NULL, &controlParams.accel_cutoff_hz, 0.0, 500.0},
+    {PARAM_GYRO_CUTOFF, "gyro_cut_hz", NULL, &controlParams.gyro_cutoff_hz, 0.0, 500.0},
+    {PARAM_NOTCH_FREQUENCY, "notch_hz", NULL, &controlParams.notch_hz, 0.0, 500.0},
+    {PARAM_NOTCH_Q, "notch_q", NULL, &controlParams.notch_q, 0.1, 50.0},
+    {PARAM_WHEEL_RADIUS, "wheel_radius", NULL, &controlParams.wheel_radius, 0.01, 0.5},
+    {PARAM_WHEEL_DISTANCE, "wheel_dist", NULL, &controlParams.wheel_distance, 0.05, 2.0},
+    {PARAM_GYRO_COVARIANCE, "gyro_cov", NULL, &controlParams.gyro_covariance, 0.0, 10.0},
+    {PARAM_ACCEL_COVARIANCE, "accel_cov", NULL, &controlParams.accel_covariance, 0.0, 10.0},
+    {PARAM_VELOCITY_SOURCE, "vel_source", &controlParams.velocity_source, NULL, VELOCITY_SOURCE_SPEED_REGISTER, VELOCITY_SOURCE_POSITION},
+    {PARAM_VELOCITY_PROCESS_NOISE, "vel_noise", NULL, &controlParams.velocity_process_noise, 0.000001, 10.0},
+    {PARAM_LINK_MAX_RTT, "link_rtt_ms", &controlParams.link_max_rtt_ms, NULL, 0, 10000},
+    {PARAM_LINK_MAX_LOSS, "link_loss_pct", &controlParams.link_max_loss_pct, NULL, 0, 100},
+    {PARAM_LINK_TIMEOUT, "link_timeout_ms", &controlParams.link_timeout_ms, NULL, 0, 60000},
+    {PARAM_CMD_VEL_MAX_AGE, "cmd_max_age_ms", &controlParams.cmd_vel_max_age_ms, NULL, 0, 10000},
+    {PARAM_CMD_VEL_TIMEOUT, "cmd_timeout_ms", &controlParams.cmd_vel_timeout_ms, NULL, 0, 60000},
+    {PARAM_CAPTURE_MASK, "capture_mask", &controlParams.capture_mask, NULL, 0, CAPTURE_MASK_ALL},
+    {PARAM_MOTOR_STATUS_PERIOD, "motor_status_ms", &controlParams.motor_status_period_ms, NULL, 10, 10000},
+    {PARAM_MOTOR_RETRY_MAX, "motor_retry_ms", &controlParams.motor_retry_max_ms, NULL, MOTOR_RETRY_MIN, 60000},
+    {PARAM_IMU_FORMAT, "imu_format", &controlParams.imu_format, NULL, IMU_FORMAT_FILTERED, IMU_FORMAT_RAW_BATCH},
+    {PARAM_AUTO_RATES, "auto_rates", &controlParams.auto_rates, NULL, 0, 1},
+    {PARAM_RATE_CPU_BUDGET, "rate_cpu_pct", &controlParams.rate_cpu_budget_pct, NULL, 10, 100},
+    {PARAM_RATE_LINK_BUDGET, "rate_link_pct", &controlParams.rate_link_budget_pct, NULL, 10, 100},
+    {PARAM_SLIP_YAW_TOLERANCE, "slip_yaw_tol", NULL, &controlParams.slip_yaw_tolerance, 0.01, 10.0},
+    {PARAM_SLIP_ACCEL_LIMIT, "slip_accel", NULL, &controlParams.slip_accel_limit, 0.0, 20.0},
+};
+static const size_t PARAMETER_COUNT = sizeof(PARAMETERS) / sizeof(PARAMETERS[0]);
+
+size_t controlParameterCount() {
+    return PARAMETER_COUNT;
+}
+
+const ControlParameterInfo &controlParameterInfo(size_t index) {
+    return PARAMETERS[index];
+}
+
+double controlParameterValue(size_t index) {
+    const ControlParameterInfo &info = PARAMETERS[index];
+    return info.integer ? (double)*info.integer : (double)*info.real;
+}
+
+void loadControlParameters() {
+    Preferences prefs;
+    prefs.begin(CONTROL_PREFS_NAMESPACE, true);
+    for (size_t i = 0; i < PARAMETER_COUNT; i++) {
+        const ControlParameterInfo &info = PARAMETERS[i];
+        if (!prefs.isKey(info.key)) {
+            continue;
+        }
+        double value = info.integer ? (double)prefs.getUInt(info.key) : (double)prefs.getFloat(info.key);
+        // Ignore stored values that no longer pass the bounds check
+        if (value < info.min || value > info.max) {
+            continue;
+        }
+        if (info.integer) {
+            *info.integer = (uint32_t)value;
+        } else {
+            *info.real = (float)value;
+        }
+    }
+    prefs.end();
+}
+
+int controlParameterIndex(const char *name) {
+    for (size_t i = 0; i < PARAMETER_COUNT; i++) {
+        if (strcmp(PARAMETERS[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+bool setControlParameter(const char *name, double value) {
+    int index = controlParameterIndex(name);
+    if (index < 0) {
+        return false;
+    }
+    const ControlParameterInfo &info = PARAMETERS[index];
+    if (value < info.min || value > info.max) {
+        return false;
+    }
+    if (info.integer) {
+        *info.integer = (uint32_t)value;
+    } else {
+        *info.real = (float)value;
+    }
+    return true;
+}
+
+void saveControlParameter(size_t index) {
+    const ControlParameterInfo &info = PARAMETERS[index];
+    Preferences prefs;
+    prefs.begin(CONTROL_PREFS_NAMESPACE, false);
+    if (info.integer) {
+        prefs.putUInt(info.key, *info.integer);
+    } else {
+        prefs.putFloat(info.key, *info.real);
+    }
+    prefs.end();
+}
@@ -0,0 +1,111 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <M5Stack.h>
+#include "DeferredWork.h"
+#include "RosCommunications.h"
+
+DeferredWorkQueue deferredWork;
+static SemaphoreHandle_t deferred_mutex = NULL; // Guards deferredWork once the task runs
+
+DeferredWorkQueue::DeferredWorkQueue() : head(0), count(0), refused_count(0) {}
+
+bool DeferredWorkQueue::push(const DeferredAction &action) {
+    for (size_t i = 0; i < count; i++) {
+        const DeferredAction &pending = actions[(head + i) % DEFERRED_QUEUE_SIZE];
+        if (pending.fn == action.fn && pending.arg == action.arg) {
+            return true; // Repeated requests collapse into the pending one
+        }
+    }
+    if (count == DEFERRED_QUEUE_SIZE) {
+        refused_count++;
+        return false;
+    }
+    actions[(head + count) % DEFERRED_QUEUE_SIZE] = action;
+    count++;
+    return true;
+}
+
+bool DeferredWorkQueue::pop(DeferredAction &action) {
+    if (count == 0) {
+        return false;
+    }
+    action = actions[head];
+    head = (head + 1) % DEFERRED_QUEUE_SIZE;
+    count--;
+    return true;
+}
+
+bool deferWork(const char *name, DeferredFunction fn, uint32_t arg, bool stop_motors) {
+    DeferredAction action = {name, fn, arg, stop_motors};
+    if (deferred_mutex != NULL) {
+        xSemaphoreTake(deferred_mutex, portMAX_DELAY);
+    }
+    bool queued = deferredWork.push(action);
+    if (deferred_mutex != NULL) {
+        xSemaphoreGive(deferred_mutex);
+    }
+    if (!queued) {
+        DEBUG_PRINTF("Deferred work queue full, refused %s\n", name);
+    }
+    return queued;
+}
+
+bool runDeferredWork() {
+    DeferredAction action;
+    if (deferred_mutex != NULL) {
+        xSemaphoreTake(deferred_mutex, portMAX_DELAY);
+    }
+    bool pending = deferredWork.pop(action);
+    if (deferred_mutex != NULL) {
+        xSemaphoreGive(deferred_mutex);
+    }
+    if (!pending) {
+        return false;
+    }
+
+    // The lock is released, so callbacks can queue more work while this runs
+    unsigned long start = micros();
+    if (action.stop_motors) {
+        stopMotors();
+        delay(MOTOR_STOP_SETTLE_TIME);
+    }
+    action.fn(action.arg);
+    if (action.stop_motors) {
+        resumeMotors();
+    }
+    DEBUG_PRINTF("Deferred %s done in %u us\n", action.name, (unsigned)(micros() - start));
+    return true;
+}
+
+void startDeferredWorkTask() {
+    deferred_mutex = xSemaphoreCreateMutex();
+    if (deferred_mutex == NULL) {
+        DEBUG_PRINTLN("Failed to create deferred work mutex");
+        return;
+    }
+    xTaskCreatePinnedToCore(deferredWorkTask, "deferred_work", DEFERRED_TASK_STACK_SIZE,
+                            NULL, DEFERRED_TASK_PRIORITY, NULL, DEFERRED_TASK_CORE);
+}
+
+// Lowest-priority task: runs queued actions one after another
+void deferredWorkTask(void *param) {
+    RCLC_UNUSED(param);
+    for (;;) {
+        while (runDeferredWork()) {
+        }
+        vTaskDelay(pdMS_TO_TICKS(DEFERRED_POLL_PERIOD));
+    }
+}
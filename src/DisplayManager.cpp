@@ -18,6 +18,9 @@
 
 // Updates the M5Stack display with twist message data
 void updateDisplay(const geometry_msgs__msg__Twist* msg) {
+#ifdef HEADLESS
+    (void)msg; // The headless build does not initialize the LCD
+#else
     // Clear the display to prepare for new data
     M5.Lcd.clear();
     M5.Lcd.setCursor(0, 20);  // Set cursor for title
@@ -32,4 +35,5 @@ void updateDisplay(const geometry_msgs__msg__Twist* msg) {
     M5.Lcd.setCursor(0, 60);  // Set cursor for linear z data
     M5.Lcd.print("Angular.z: ");
     M5.Lcd.println(msg->angular.z);
+#endif
 }
\ No newline at end of file
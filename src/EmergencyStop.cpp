@@ -0,0 +1,338 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <M5Stack.h>
+#include "EmergencyStop.h"
+#include "SummaryFormat.h"
+#include "MotorController.h"
+#include "FlightRecorder.h"
+#include "MotorGroup.h"
+#include "DebugOutput.h"
+
+EmergencyStop emergencyStop;
+static SemaphoreHandle_t estop_mutex = NULL;         // Guards emergencyStop once the task runs
+static TaskHandle_t estop_task = NULL;               // Woken by the input interrupts
+static volatile uint32_t estop_edge_us = 0;          // Time of the first edge not yet handled by the task
+static volatile uint8_t estop_edge_source = ESTOP_SOURCE_NONE; // Input of that edge
+
+// Zero target velocity followed by the disable control word, written with a
+// single write() so the UART lock keeps frames of other tasks out of between
+#ifdef MOTOR_BUS
+static uint8_t stop_frames[2 * MOTOR_FRAME_SIZE * MOTOR_GROUP_MAX]; // Both frames for every driver of the bus
+static size_t stop_frames_size = 0;
+#else
+static uint8_t stop_frames[2 * MOTOR_FRAME_SIZE];
+static const size_t stop_frames_size = sizeof(stop_frames);
+#endif
+
+static bool rearm_running = false;                   // The control task runs the enable sequence of a re-arm
+#ifdef MOTOR_BUS
+static uint8_t rearm_motor = 0;                      // Index in motorGroup of the driver being enabled
+#endif
+
+EmergencyStop::EmergencyStop() : latch(ESTOP_ARMED), event(false) {
+    memset(&counters, 0, sizeof(counters));
+}
+
+bool EmergencyStop::onTrip(EstopSource source, uint32_t trip_us, uint32_t stopped_us) {
+    counters.triggers++;
+    if (latch == ESTOP_TRIPPED) {
+        return false;
+    }
+    // A trip during a re-arm cancels it
+    latch = ESTOP_TRIPPED;
+    counters.trips++;
+    counters.source = source;
+    counters.last_latency_us = stopped_us - trip_us;
+    if (counters.last_latency_us > counters.max_latency_us) {
+        counters.max_latency_us = counters.last_latency_us;
+    }
+    event = true;
+    return true;
+}
+
+bool EmergencyStop::requestRearm(bool input_active) {
+    if (latch != ESTOP_TRIPPED || input_active) {
+        return false;
+    }
+    latch = ESTOP_REARMING;
+    return true;
+}
+
+bool EmergencyStop::onRearmed() {
+    if (latch != ESTOP_REARMING) {
+        return false;
+    }
+    latch = ESTOP_ARMED;
+    counters.rearms++;
+    event = true;
+    return true;
+}
+
+bool EmergencyStop::takeEvent() {
+    bool pending = event;
+    event = false;
+    return pending;
+}
+
+size_t EmergencyStop::summarize(char *buf, size_t len) const {
+    static const char *const states[] = {"armed", "tripped", "rearming"};
+    static const char *const sources[] = {"none", "button_a", "button_b", "button_c", "external"};
+    size_t used = 0;
+    appendf(buf, len, &used, "estop=%s source=%s trips=%u triggers=%u ignored=%u rearms=%u "
+            "latency_us=%u max_latency_us=%u",
+            states[latch], sources[counters.source], (unsigned)counters.trips,
+            (unsigned)counters.triggers, (unsigned)counters.ignored, (unsigned)counters.rearms,
+            (unsigned)counters.last_latency_us, (unsigned)counters.max_latency_us);
+    return used;
+}
+
+static void lockEmergencyStop() {
+    if (estop_mutex != NULL) {
+        xSemaphoreTake(estop_mutex, portMAX_DELAY);
+    }
+}
+
+static void unlockEmergencyStop() {
+    if (estop_mutex != NULL) {
+        xSemaphoreGive(estop_mutex);
+    }
+}
+
+// Interrupt half: keeps the time of the first edge and wakes the stop task
+static void IRAM_ATTR tripFromISR(uint8_t source) {
+    if (estop_edge_source == ESTOP_SOURCE_NONE) {
+        estop_edge_us = micros();
+        estop_edge_source = source;
+    }
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(estop_task, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+#if ESTOP_BUTTONS
+static void IRAM_ATTR onButtonA() { tripFromISR(ESTOP_SOURCE_BUTTON_A); }
+static void IRAM_ATTR onButtonB() { tripFromISR(ESTOP_SOURCE_BUTTON_B); }
+static void IRAM_ATTR onButtonC() { tripFromISR(ESTOP_SOURCE_BUTTON_C); }
+#endif
+#if ESTOP_EXTERNAL_PIN >= 0
+static void IRAM_ATTR onExternal() { tripFromISR(ESTOP_SOURCE_EXTERNAL); }
+#endif
+
+bool emergencyStopInputActive() {
+#if ESTOP_BUTTONS
+    if (digitalRead(ESTOP_BUTTON_A_PIN) == LOW || digitalRead(ESTOP_BUTTON_B_PIN) == LOW ||
+        digitalRead(ESTOP_BUTTON_C_PIN) == LOW) {
+        return true;
+    }
+#endif
+#if ESTOP_EXTERNAL_PIN >= 0
+    if (digitalRead(ESTOP_EXTERNAL_PIN) == HIGH) {
+        return true;  // Loop open or cut
+    }
+#endif
+    return false;
+}
+
+// True if the input of source reads active now
+static bool sourceActive(EstopSource source) {
+    switch (source) {
+    case ESTOP_SOURCE_BUTTON_A: return digitalRead(ESTOP_BUTTON_A_PIN) == LOW;
+    case ESTOP_SOURCE_BUTTON_B: return digitalRead(ESTOP_BUTTON_B_PIN) == LOW;
+    case ESTOP_SOURCE_BUTTON_C: return digitalRead(ESTOP_BUTTON_C_PIN) == LOW;
+#if ESTOP_EXTERNAL_PIN >= 0
+    case ESTOP_SOURCE_EXTERNAL: return digitalRead(ESTOP_EXTERNAL_PIN) == HIGH;
+#endif
+    default: return true;
+    }
+}
+
+// GPIO36 and GPIO39 may report edges that never happened
+static bool sourceGlitches(EstopSource source) {
+    int pin = -1;
+    switch (source) {
+    case ESTOP_SOURCE_BUTTON_A: pin = ESTOP_BUTTON_A_PIN; break;
+    case ESTOP_SOURCE_BUTTON_B: pin = ESTOP_BUTTON_B_PIN; break;
+    case ESTOP_SOURCE_BUTTON_C: pin = ESTOP_BUTTON_C_PIN; break;
+    case ESTOP_SOURCE_EXTERNAL: pin = ESTOP_EXTERNAL_PIN; break;
+    default: break;
+    }
+    return pin == 36 || pin == 39;
+}
+
+// Re-reads the input of an edge from a glitching pin, true if it stayed active
+static bool confirmEdge(EstopSource source) {
+    if (!sourceGlitches(source)) {
+        return true;
+    }
+    for (int i = 0; i < ESTOP_CONFIRM_SAMPLES; i++) {
+        if (!sourceActive(source)) {
+            return false;
+        }
+        delayMicroseconds(ESTOP_CONFIRM_INTERVAL_US);
+    }
+    return true;
+}
+
+void startEmergencyStopTask() {
+#ifdef MOTOR_BUS
+    // initializeUART() configured the group
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        byte id = motorGroup.config(i).id;
+        memcpy(stop_frames + stop_frames_size, motorWriteFrame<TargetVelocityRegister>(id, 0).bytes, MOTOR_FRAME_SIZE);
+        stop_frames_size += MOTOR_FRAME_SIZE;
+        memcpy(stop_frames + stop_frames_size, motorWriteFrame<ControlWordRegister>(id, DISABLE_MOTOR).bytes, MOTOR_FRAME_SIZE);
+        stop_frames_size += MOTOR_FRAME_SIZE;
+    }
+#else
+    memcpy(stop_frames, STOP_VELOCITY_FRAME.bytes, MOTOR_FRAME_SIZE);
+    memcpy(stop_frames + MOTOR_FRAME_SIZE, DISABLE_MOTOR_FRAME.bytes, MOTOR_FRAME_SIZE);
+#endif
+    estop_mutex = xSemaphoreCreateMutex();
+    if (estop_mutex == NULL) {
+        DEBUG_PRINTLN("Failed to create e-stop mutex");
+        return;
+    }
+    xTaskCreatePinnedToCore(emergencyStopTask, "estop", ESTOP_TASK_STACK_SIZE,
+                            NULL, ESTOP_TASK_PRIORITY, &estop_task, ESTOP_TASK_CORE);
+
+#if ESTOP_BUTTONS
+    pinMode(ESTOP_BUTTON_A_PIN, INPUT);
+    pinMode(ESTOP_BUTTON_B_PIN, INPUT);
+    pinMode(ESTOP_BUTTON_C_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(ESTOP_BUTTON_A_PIN), onButtonA, FALLING);
+    attachInterrupt(digitalPinToInterrupt(ESTOP_BUTTON_B_PIN), onButtonB, FALLING);
+    attachInterrupt(digitalPinToInterrupt(ESTOP_BUTTON_C_PIN), onButtonC, FALLING);
+#endif
+#if ESTOP_EXTERNAL_PIN >= 0
+    pinMode(ESTOP_EXTERNAL_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(ESTOP_EXTERNAL_PIN), onExternal, RISING);
+    if (digitalRead(ESTOP_EXTERNAL_PIN) == HIGH) {
+        onExternal();  // Already open at boot, no edge will come
+    }
+#endif
+}
+
+// Highest-priority task: stops the wheel first, bookkeeping follows. The
+// frames are not recorded, replay cannot reproduce an input edge.
+void emergencyStopTask(void *param) {
+    (void)param;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        EstopSource source = (EstopSource)estop_edge_source;
+        uint32_t edge_us = estop_edge_us;
+        if (!confirmEdge(source)) {
+            estop_edge_source = ESTOP_SOURCE_NONE;
+            lockEmergencyStop();
+            emergencyStop.onIgnored();
+            unlockEmergencyStop();
+            continue;
+        }
+        __atomic_fetch_or(&motorInhibit, MOTOR_INHIBIT_ESTOP, __ATOMIC_RELAXED);
+        motorSerial.write(stop_frames, stop_frames_size);
+        uint32_t stopped_us = micros();
+        estop_edge_source = ESTOP_SOURCE_NONE;
+        lockEmergencyStop();
+        bool latched = emergencyStop.onTrip(source, edge_us, stopped_us);
+        unlockEmergencyStop();
+        if (latched) {
+            flightRecorder.recordFault(FLIGHT_SOURCE_ESTOP, source);
+        }
+    }
+}
+
+bool requestEmergencyStopRearm() {
+    bool input_active = emergencyStopInputActive();
+    lockEmergencyStop();
+    bool accepted = emergencyStop.requestRearm(input_active);
+    unlockEmergencyStop();
+    return accepted;
+}
+
+#ifdef MOTOR_BUS
+// Id of the driver the re-arm enables
+static byte rearmMotorId() {
+    return motorGroup.config(rearm_motor).id;
+}
+#else
+static byte rearmMotorId() {
+    return MOTOR_ID;
+}
+#endif
+
+// Writes at most one register of the re-arm, true once every driver read back enabled.
+// A failed sequence is started again, only a new trip ends the re-arm without it.
+static bool stepRearm(uint32_t now_us) {
+    if (!rearm_running) {
+        // The control task may have written a target after the stop frames
+        motorController.sendFrame(STOP_VELOCITY_FRAME);
+#ifdef MOTOR_BUS
+        rearm_motor = 0;
+#endif
+        motorRecovery.begin(rearmMotorId(), false, now_us);
+        rearm_running = true;
+    }
+#ifdef MOTOR_BUS
+    // The bus task pauses while the stop is latched, its replies are read here
+    readMotorReplies(motorSerial, rearmMotorId());
+#endif
+    MotorRecoveryStatus status = motorRecovery.step(now_us);
+    if (status == MOTOR_RECOVERY_FAILED) {
+        motorRecovery.begin(rearmMotorId(), false, now_us);
+        return false;
+    }
+    if (status == MOTOR_RECOVERY_RUNNING) {
+        return false;
+    }
+#ifdef MOTOR_BUS
+    if (++rearm_motor < motorGroup.count()) {
+        motorRecovery.begin(rearmMotorId(), false, now_us);
+        motorRecovery.step(now_us);
+        return false;
+    }
+#endif
+    rearm_running = false;
+    return true;
+}
+
+bool serviceEmergencyStop() {
+    if (emergencyStop.rearmPending()) {
+        if (stepRearm(micros())) {
+            lockEmergencyStop();
+            bool rearmed = emergencyStop.onRearmed();
+            unlockEmergencyStop();
+            if (rearmed) {
+                // Supervision restarts from now
+                motorSupervisor.start(true, micros());
+                releaseMotors(MOTOR_INHIBIT_ESTOP);
+                flightRecorder.recordError(FLIGHT_SOURCE_ESTOP, ESTOP_SOURCE_NONE);
+            } else {
+                // Tripped again after the last check, the enable may have overtaken the stop frames
+                motorSerial.write(stop_frames, stop_frames_size);
+            }
+        }
+    } else if (rearm_running) {
+        // Tripped again while enabling
+        motorRecovery.cancel();
+        rearm_running = false;
+        motorSerial.write(stop_frames, stop_frames_size);
+    }
+    lockEmergencyStop();
+    bool event = emergencyStop.takeEvent();
+    unlockEmergencyStop();
+    return event;
+}
@@ -0,0 +1,142 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include "FilterBank.h"
+
+// Quality factors of the biquad sections of Butterworth low-pass filters
+static const float BUTTERWORTH2_Q[] = {0.70710678f};
+static const float BUTTERWORTH4_Q[] = {0.54119610f, 1.30656296f};
+
+BiquadCoefficients designLowPass(float cutoff_hz, float sample_hz, float q) {
+    // Bilinear-transform low-pass from the RBJ audio EQ cookbook
+    float w0 = 2.0f * (float)M_PI * cutoff_hz / sample_hz;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    BiquadCoefficients c;
+    c.b0 = (1.0f - cosw) / 2.0f / a0;
+    c.b1 = (1.0f - cosw) / a0;
+    c.b2 = c.b0;
+    c.a1 = -2.0f * cosw / a0;
+    c.a2 = (1.0f - alpha) / a0;
+    return c;
+}
+
+BiquadCoefficients designNotch(float center_hz, float sample_hz, float q) {
+    float w0 = 2.0f * (float)M_PI * center_hz / sample_hz;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+    BiquadCoefficients c;
+    c.b0 = 1.0f / a0;
+    c.b1 = -2.0f * cosw / a0;
+    c.b2 = c.b0;
+    c.a1 = c.b1;
+    c.a2 = (1.0f - alpha) / a0;
+    return c;
+}
+
+BiquadCoefficients identityBiquad() {
+    BiquadCoefficients c = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    return c;
+}
+
+FilterBank::FilterBank() : stages(0) {
+    for (int s = 0; s < FILTER_MAX_STAGES; s++) {
+        for (int axis = 0; axis < FILTER_AXES; axis++) {
+            setStage(s, axis, identityBiquad());
+        }
+    }
+    stages = 0;
+    reset();
+}
+
+void FilterBank::setStage(int stage, int axis, const BiquadCoefficients &coeffs) {
+    if (stage < 0 || stage >= FILTER_MAX_STAGES || axis < 0 || axis >= FILTER_AXES) {
+        return;
+    }
+    b0[stage][axis] = coeffs.b0;
+    b1[stage][axis] = coeffs.b1;
+    b2[stage][axis] = coeffs.b2;
+    a1[stage][axis] = coeffs.a1;
+    a2[stage][axis] = coeffs.a2;
+    if (stage >= stages) {
+        stages = stage + 1;
+    }
+}
+
+void FilterBank::configureAxis(int axis, float sample_hz, float cutoff_hz, int order, float notch_hz, float notch_q) {
+    const float *qs = order >= 4 ? BUTTERWORTH4_Q : BUTTERWORTH2_Q;
+    int sections = order >= 4 ? 2 : 1;
+    int stage = 0;
+
+    // Low-pass sections, skipped when the cutoff is not below Nyquist
+    if (cutoff_hz > 0.0f && cutoff_hz < sample_hz / 2.0f) {
+        for (int i = 0; i < sections; i++) {
+            setStage(stage++, axis, designLowPass(cutoff_hz, sample_hz, qs[i]));
+        }
+    }
+    if (notch_hz > 0.0f && notch_hz < sample_hz / 2.0f && notch_q > 0.0f) {
+        setStage(stage++, axis, designNotch(notch_hz, sample_hz, notch_q));
+    }
+    while (stage < FILTER_MAX_STAGES) {
+        setStage(stage++, axis, identityBiquad());
+    }
+}
+
+void FilterBank::reset() {
+    for (int s = 0; s < FILTER_MAX_STAGES; s++) {
+        for (int axis = 0; axis < FILTER_AXES; axis++) {
+            z1[s][axis] = 0.0f;
+            z2[s][axis] = 0.0f;
+        }
+    }
+}
+
+void FilterBank::prime(const float in[FILTER_AXES]) {
+    float x[FILTER_AXES];
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        x[axis] = in[axis];
+    }
+    for (int s = 0; s < stages; s++) {
+        for (int axis = 0; axis < FILTER_AXES; axis++) {
+            // Steady state of one section for a constant input, y = x * DC gain
+            float gain = (b0[s][axis] + b1[s][axis] + b2[s][axis]) / (1.0f + a1[s][axis] + a2[s][axis]);
+            float y = x[axis] * gain;
+            z2[s][axis] = b2[s][axis] * x[axis] - a2[s][axis] * y;
+            z1[s][axis] = y - b0[s][axis] * x[axis];
+            x[axis] = y;
+        }
+    }
+}
+
+void FilterBank::process(const float in[FILTER_AXES], float out[FILTER_AXES]) {
+    float x[FILTER_AXES];
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        x[axis] = in[axis];
+    }
+    for (int s = 0; s < stages; s++) {
+        for (int axis = 0; axis < FILTER_AXES; axis++) {
+            float y = b0[s][axis] * x[axis] + z1[s][axis];
+            z1[s][axis] = b1[s][axis] * x[axis] - a1[s][axis] * y + z2[s][axis];
+            z2[s][axis] = b2[s][axis] * x[axis] - a2[s][axis] * y;
+            x[axis] = y;
+        }
+    }
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        out[axis] = x[axis];
+    }
+}
@@ -0,0 +1,105 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <Arduino.h>
+#include <string.h>
+#include "FlightRecorder.h"
+
+FlightRecorder flightRecorder;
+
+FlightRecorder::FlightRecorder() : next(0), frozen(false) {
+}
+
+void FlightRecorder::record(uint8_t type, const void *data, uint8_t size) {
+    if (frozen) {
+        return;
+    }
+    // Claim a slot atomically so the control and housekeeping tasks can both record
+    uint32_t seq = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+    FlightRecord &rec = records[seq % FLIGHT_RECORDER_CAPACITY];
+    rec.timestamp_us = micros();
+    rec.type = type;
+    rec.size = size > FLIGHT_RECORD_DATA_SIZE ? FLIGHT_RECORD_DATA_SIZE : size;
+    rec.seq = (uint16_t)seq;
+    memcpy(rec.data, data, rec.size);
+}
+
+void FlightRecorder::recordCmdVel(float linear_x, float angular_z) {
+    float data[2] = {linear_x, angular_z};
+    record(FLIGHT_CMD_VEL, data, sizeof(data));
+}
+
+void FlightRecorder::recordMotorFrame(uint8_t type, const uint8_t *frame) {
+    record(type, frame, 10);
+}
+
+void FlightRecorder::recordIMU(float ax, float ay, float az, float gx, float gy, float gz) {
+    int16_t data[6] = {
+        (int16_t)(ax * 1000.0f), (int16_t)(ay * 1000.0f), (int16_t)(az * 1000.0f),
+        (int16_t)(gx * 10.0f), (int16_t)(gy * 10.0f), (int16_t)(gz * 10.0f)
+    };
+    record(FLIGHT_IMU, data, sizeof(data));
+}
+
+void FlightRecorder::recordError(uint8_t source, int32_t code) {
+    uint8_t data[5];
+    data[0] = source;
+    memcpy(&data[1], &code, sizeof(code));
+    record(FLIGHT_EXEC_ERROR, data, sizeof(data));
+}
+
+void FlightRecorder::recordFault(uint8_t source, int32_t code) {
+    recordError(source, code);
+    freeze();
+}
+
+void FlightRecorder::recordTick(uint8_t stream) {
+    record(FLIGHT_CONTROL_TICK, &stream, sizeof(stream));
+}
+
+void FlightRecorder::freeze() {
+    if (frozen) {
+        return;
+    }
+    frozen = true;
+}
+
+void FlightRecorder::resume() {
+    next = 0;
+    frozen = false;
+}
+
+uint32_t FlightRecorder::recordCount() const {
+    return next < FLIGHT_RECORDER_CAPACITY ? next : FLIGHT_RECORDER_CAPACITY;
+}
+
+size_t FlightRecorder::copyRecords(uint32_t first, FlightRecord *out, size_t max) const {
+    uint32_t count = recordCount();
+    uint32_t oldest = next - count;
+    size_t copied = 0;
+    for (uint32_t i = first; i < count && copied < max; i++) {
+        out[copied++] = records[(oldest + i) % FLIGHT_RECORDER_CAPACITY];
+    }
+    return copied;
+}
+
+FlightDumpHeader FlightRecorder::header() const {
+    FlightDumpHeader hdr;
+    hdr.magic = FLIGHT_DUMP_MAGIC;
+    hdr.version = FLIGHT_DUMP_VERSION;
+    hdr.record_size = sizeof(FlightRecord);
+    hdr.record_count = recordCount();
+    return hdr;
+}
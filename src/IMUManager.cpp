@@ -14,22 +14,34 @@
  */
 
 #include "IMUManager.h"
+#include "FlightRecorder.h"
+#include "CaptureStream.h"
+#include "ControlParameters.h"
+#include "ImuBatch.h"
 
 const float sampleFreq = 256.0f;  // Sampling rate in Hz
 
-IMUManager::IMUManager() : lpf_beta(0.1), accX_filtered(0.0), gyroX_filtered(0.0) {
-    // Initial setup for IMUManager with default low-pass filter coefficients
+IMUManager::IMUManager() : raw(), filtered(), primed(false), filter_update_pending(true) {
+    // Filter coefficients are computed on the first update
 }
 
 void IMUManager::initialize() {
     M5.IMU.Init();  // Initialize the IMU hardware
+    M5.IMU.getAres();  // Resolutions used to scale the raw counts
+    M5.IMU.getGres();
     calibrateSensors();  // Calibrate sensors to remove initial bias
 }
 
 bool IMUManager::update() {
-    // Fetch the latest data from the IMU
-    M5.IMU.getAccelData(&ax, &ay, &az);
-    M5.IMU.getGyroData(&gx, &gy, &gz);
+    // Fetch the latest counts from the IMU and scale them as getAccelData() and getGyroData() do
+    M5.IMU.getAccelAdc(&raw[0], &raw[1], &raw[2]);
+    M5.IMU.getGyroAdc(&raw[3], &raw[4], &raw[5]);
+    ax = raw[0] * M5.IMU.aRes;
+    ay = raw[1] * M5.IMU.aRes;
+    az = raw[2] * M5.IMU.aRes;
+    gx = raw[3] * M5.IMU.gRes;
+    gy = raw[4] * M5.IMU.gRes;
+    gz = raw[5] * M5.IMU.gRes;
 
     // Apply the calibration offsets to raw data
     ax -= accOffset[0];
@@ -40,29 +52,59 @@ bool IMUManager::update() {
     gy -= gyroOffset[1];
     gz -= gyroOffset[2];
 
-    applyLowPassFilter();  // Apply a low-pass filter to smooth the sensor data
+    flightRecorder.recordIMU(ax, ay, az, gx, gy, gz);  // Record the filter input
+
+    applyFilterBank();  // Filter the sensor data
+
+    const float input[FILTER_AXES] = {ax, ay, az, gx, gy, gz};
+    captureStream.recordIMU(input, filtered);  // Full-rate filter input and output for offline tuning
   
     return true;  // Always returns true - consider adding error handling
 }
 
-void IMUManager::applyLowPassFilter() {
-    // Low-pass filter the accelerometer and gyroscope data to reduce noise
-    accX_filtered = accX_filtered + lpf_beta * (ax - accX_filtered);
-    accY_filtered = accY_filtered + lpf_beta * (ay - accY_filtered);
-    accZ_filtered = accZ_filtered + lpf_beta * (az - accZ_filtered);    
-    gyroX_filtered = gyroX_filtered + lpf_beta * (gx - gyroX_filtered);
-    gyroY_filtered = gyroY_filtered + lpf_beta * (gy - gyroY_filtered);
-    gyroZ_filtered = gyroZ_filtered + lpf_beta * (gz - gyroZ_filtered);
+void IMUManager::configureFilters() {
+    // The IMU is sampled once per run of the IMU sampling stream
+    float sample_hz = 1000.0f / controlParams.imu_sample_period_ms;
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        float cutoff = axis < 3 ? controlParams.accel_cutoff_hz : controlParams.gyro_cutoff_hz;
+        filters.configureAxis(axis, sample_hz, cutoff, FILTER_ORDER, controlParams.notch_hz, controlParams.notch_q);
+    }
+}
+
+void IMUManager::applyFilterBank() {
+    float in[FILTER_AXES] = {ax, ay, az, gx, gy, gz};
+
+    // Coefficients are swapped here, on the sampling task, so a change never
+    // lands in the middle of a sample
+    if (filter_update_pending) {
+        filter_update_pending = false;
+        configureFilters();
+        primed = false;
+    }
+    if (!primed) {
+        filters.prime(in);  // Start from the current sample instead of zero
+        primed = true;
+    }
+    filters.process(in, filtered);
 }
 
 void IMUManager::getCalibratedData(float &aX, float &aY, float &aZ, float &gX, float &gY, float &gZ) {
     // Return the filtered and calibrated sensor data
-    aX = accX_filtered;
-    aY = accY_filtered;
-    aZ = accZ_filtered;
-    gX = gyroX_filtered;
-    gY = gyroY_filtered;
-    gZ = gyroZ_filtered;
+    aX = filtered[0];
+    aY = filtered[1];
+    aZ = filtered[2];
+    gX = filtered[3];
+    gY = filtered[4];
+    gZ = filtered[5];
+}
+
+void IMUManager::getRawCalibration(int16_t offset[6], uint16_t &accel_range_g, uint16_t &gyro_range_dps) const {
+    for (int axis = 0; axis < 3; axis++) {
+        offset[axis] = (int16_t)lroundf(accOffset[axis] / M5.IMU.aRes);
+        offset[axis + 3] = (int16_t)lroundf(gyroOffset[axis] / M5.IMU.gRes);
+    }
+    accel_range_g = (uint16_t)lroundf(M5.IMU.aRes * IMU_BATCH_FULL_SCALE_COUNTS);
+    gyro_range_dps = (uint16_t)lroundf(M5.IMU.gRes * IMU_BATCH_FULL_SCALE_COUNTS);
 }
 
 void IMUManager::calibrateSensors() {
@@ -0,0 +1,66 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "ImuBatch.h"
+
+ImuBatch::ImuBatch() : samples(0) {
+    memset(&header, 0, sizeof(header));
+    header.version = IMU_BATCH_VERSION;
+}
+
+void ImuBatch::configure(uint16_t accel_range_g, uint16_t gyro_range_dps, const int16_t offset[6]) {
+    header.accel_range_g = accel_range_g;
+    header.gyro_range_dps = gyro_range_dps;
+    memcpy(header.offset, offset, sizeof(header.offset));
+}
+
+void ImuBatch::add(const int16_t sample[6], uint32_t now_us) {
+    if (samples >= IMU_BATCH_MAX_SAMPLES) {
+        if (header.dropped < UINT16_MAX) {
+            header.dropped++;
+        }
+        return;
+    }
+    sample_us[samples] = now_us;
+    memcpy(raw[samples], sample, sizeof(raw[samples]));
+    samples++;
+}
+
+size_t ImuBatch::serialize(uint8_t *buf, size_t len, int64_t stamp_ns, uint32_t now_us) {
+    if (len < IMU_BATCH_BUFFER_SIZE) {
+        return 0;
+    }
+    header.count = samples;
+    header.stamp_ns = stamp_ns;
+    memcpy(buf, &header, sizeof(header));  // The ESP32 is little-endian like the wire layout
+    size_t used = sizeof(header);
+    for (uint8_t i = 0; i < samples; i++) {
+        ImuBatchSample out;
+        out.age_us = now_us - sample_us[i];
+        memcpy(out.raw, raw[i], sizeof(out.raw));
+        memcpy(buf + used, &out, sizeof(out));
+        used += sizeof(out);
+    }
+    header.seq++;
+    header.dropped = 0;
+    samples = 0;
+    return used;
+}
+
+void ImuBatch::clear() {
+    samples = 0;
+    header.dropped = 0;
+}
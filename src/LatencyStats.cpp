@@ -0,0 +1,43 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyStats.h"
+
+LatencyStats::LatencyStats() {
+    reset();
+}
+
+void LatencyStats::record(uint32_t latency_us) {
+    if (count == 0 || latency_us < min_us) {
+        min_us = latency_us;
+    }
+    if (latency_us > max_us) {
+        max_us = latency_us;
+    }
+    sum_us += latency_us;
+    count++;
+}
+
+void LatencyStats::reset() {
+    count = 0;
+    min_us = 0;
+    max_us = 0;
+    sum_us = 0;
+}
+
+uint32_t LatencyStats::average() const {
+    // Avoid division by zero when no samples have been recorded
+    return count ? (uint32_t)(sum_us / count) : 0;
+}
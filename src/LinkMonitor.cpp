@@ -0,0 +1,155 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "LinkMonitor.h"
+#include "SummaryFormat.h"
+
+LinkMonitor::LinkMonitor()
+    : max_rtt_us(LINK_MAX_RTT * 1000UL), max_loss_permille(LINK_MAX_LOSS * 10), timeout_us(LINK_TIMEOUT * 1000UL),
+      active(false), degraded(false), last_seq(0), last_ping_us(0), last_cmd_vel_us(0), has_cmd_vel(false),
+      window_open(false), window_start_us(0), rtt_sum_us(0) {
+    memset(&current, 0, sizeof(current));
+    memset(&last, 0, sizeof(last));
+}
+
+void LinkMonitor::configure(uint32_t max_rtt_us, uint16_t max_loss_permille, uint32_t timeout_us) {
+    this->max_rtt_us = max_rtt_us;
+    this->max_loss_permille = max_loss_permille;
+    this->timeout_us = timeout_us;
+}
+
+void LinkMonitor::onPing(uint32_t seq, uint32_t board_stamp, uint32_t hold_us, uint32_t now_us) {
+    if (!active) {
+        active = true;
+        last_seq = seq - 1;  // The first ping is not preceded by losses
+    }
+    last_ping_us = now_us;
+    current.pings++;
+
+    // Signed difference so the sequence may wrap
+    int32_t step = (int32_t)(seq - last_seq);
+    if (step > 0 && step <= LINK_MAX_SEQ_JUMP) {
+        current.lost += step - 1;
+        last_seq = seq;
+    } else if (step <= 0 && step > -LINK_MAX_SEQ_JUMP) {
+        current.reordered++;
+        if (current.lost > 0) {
+            current.lost--;  // Counted as lost when the gap was seen
+        }
+    } else {
+        last_seq = seq;  // Host restarted its sequence
+    }
+
+    if (hold_us == LINK_NO_ECHO) {
+        return;
+    }
+    // Board time from the echo to this ping, minus what the host spent holding it
+    int32_t rtt_us = (int32_t)(now_us - board_stamp - hold_us);
+    if (rtt_us < 0) {
+        return;
+    }
+    if (current.rtt_count < LINK_MAX_RTT_SAMPLES) {
+        rtt[current.rtt_count] = (uint32_t)rtt_us;
+    } else {
+        // Keep the largest samples so the percentile is not underestimated
+        uint32_t *smallest = std::min_element(rtt, rtt + LINK_MAX_RTT_SAMPLES);
+        if ((uint32_t)rtt_us > *smallest) {
+            *smallest = (uint32_t)rtt_us;
+        }
+    }
+    if (current.rtt_count == 0 || (uint32_t)rtt_us < current.rtt_min_us) {
+        current.rtt_min_us = (uint32_t)rtt_us;
+    }
+    current.rtt_count++;
+    rtt_sum_us += (uint32_t)rtt_us;
+    if (max_rtt_us > 0 && (uint32_t)rtt_us > max_rtt_us) {
+        current.late++;
+    }
+}
+
+void LinkMonitor::onCmdVel(uint32_t now_us) {
+    if (has_cmd_vel) {
+        uint32_t gap_us = now_us - last_cmd_vel_us;
+        if (gap_us > CMD_VEL_GAP * 1000UL) {
+            current.cmd_vel_gaps++;
+        }
+        if (gap_us > current.cmd_vel_gap_max_us) {
+            current.cmd_vel_gap_max_us = gap_us;
+        }
+    }
+    has_cmd_vel = true;
+    last_cmd_vel_us = now_us;
+    current.cmd_vel_count++;
+}
+
+bool LinkMonitor::evaluate(uint32_t now_us) {
+    if (!window_open) {
+        window_open = true;
+        window_start_us = now_us;
+        return false;
+    }
+    if (active && timeout_us > 0 && now_us - last_ping_us > timeout_us) {
+        degraded = true;
+    }
+    if (now_us - window_start_us < LINK_WINDOW * 1000UL) {
+        return false;
+    }
+    closeWindow(now_us);
+    return true;
+}
+
+void LinkMonitor::closeWindow(uint32_t now_us) {
+    LinkWindowStats &w = current;
+    uint32_t expected = w.pings + w.lost;
+    w.loss_permille = expected > 0 ? (uint16_t)((uint64_t)w.lost * 1000 / expected) : 0;
+    if (w.rtt_count > 0) {
+        w.rtt_avg_us = (uint32_t)(rtt_sum_us / w.rtt_count);
+        size_t stored = w.rtt_count < LINK_MAX_RTT_SAMPLES ? w.rtt_count : LINK_MAX_RTT_SAMPLES;
+        // Rank of the 99th percentile among all samples, counted from the top of the stored ones
+        size_t from_top = (w.rtt_count - 1) - (size_t)((uint64_t)(w.rtt_count - 1) * 99 / 100);
+        size_t rank = from_top < stored ? stored - 1 - from_top : 0;
+        std::nth_element(rtt, rtt + rank, rtt + stored);
+        w.rtt_p99_us = rtt[rank];
+    }
+
+    bool timed_out = timeout_us > 0 && now_us - last_ping_us > timeout_us;
+    bool lossy = max_loss_permille > 0 && w.loss_permille > max_loss_permille;
+    bool slow = max_rtt_us > 0 && w.rtt_count > 0 && w.rtt_p99_us > max_rtt_us;
+    // Without a pinging host the link is never degraded, cmd_vel is still tracked
+    degraded = active && (timed_out || lossy || slow);
+
+    last = w;
+    memset(&current, 0, sizeof(current));
+    rtt_sum_us = 0;
+    window_start_us = now_us;
+}
+
+size_t LinkMonitor::summarize(char *buf, size_t len) const {
+    const LinkWindowStats &w = last;
+    size_t used = 0;
+    appendf(buf, len, &used,
+            "link=%s pings=%u lost=%u reordered=%u loss_pct=%u.%u "
+            "rtt_n=%u rtt_min_us=%u rtt_avg_us=%u rtt_p99_us=%u rtt_late=%u "
+            "cmd_vel=%u cmd_vel_gaps=%u cmd_vel_gap_max_us=%u",
+            !active ? "inactive" : degraded ? "degraded" : "ok",
+            (unsigned)w.pings, (unsigned)w.lost, (unsigned)w.reordered,
+            w.loss_permille / 10, w.loss_permille % 10,
+            (unsigned)w.rtt_count, (unsigned)w.rtt_min_us, (unsigned)w.rtt_avg_us,
+            (unsigned)w.rtt_p99_us, (unsigned)w.late, (unsigned)w.cmd_vel_count, (unsigned)w.cmd_vel_gaps,
+            (unsigned)w.cmd_vel_gap_max_us);
+    return used;
+}
@@ -14,6 +14,14 @@
  */
 
 #include "MotorController.h"
+#include "SummaryFormat.h"
+#include "FlightRecorder.h"
+#include "CaptureStream.h"
+#include "ControlParameters.h"
+#include "MotorGroup.h"
+#include "ActuationLatency.h"
+#include "SlipDetector.h"
+#include "DebugOutput.h"
 
 HardwareSerial motorSerial(2); // Using the second hardware serial interface
 MotorController motorController(motorSerial); // Initializing the motor controller
@@ -24,83 +32,450 @@ double theta = 0.0; // Orientation angle in radians
 bool initial_data_received = false; // Flag to track if initial data has been received
 unsigned long last_receive_time = 0; // Timestamp of the last data received
 VelocityCommand currentCommand; // Struct to hold the current velocity command
+float commandedWheelSpeed = 0.0f; // Wheel speed of the last velocity command
+volatile uint8_t motorInhibit = 0; // Reasons for holding the wheels stopped
+MotorInitResult motorInitResult = {MOTOR_INIT_TIMEOUT, 0, 0, 0, 0}; // Not initialized yet
+MotorSupervisor motorSupervisor; // Started once the boot initialization is done
+MotorRecovery motorRecovery; // Idle until the supervisor asks for a recovery
 
 void initializeUART() {
     motorSerial.begin(BAUD_RATE, SERIAL_8N1, RX_PIN, TX_PIN); // Start UART with defined pins and baud rate
-    Serial.println("Setup complete. Ready to read high resolution speed data.");
-    initMotor(motorSerial, MOTOR_ID); // Initialize motor with settings
-    M5.Lcd.print("micro ROS2 M5Stack START\n"); // Display initialization message on M5Stack    
+    DEBUG_PRINTLN("Setup complete. Ready to read high resolution speed data.");
+    // Initialize motor with settings and report the outcome
+#ifdef MOTOR_BUS
+    bool ready = initMotorGroup(motorSerial); // Every driver of the bus, motorInitResult holds the last one
+#else
+    bool ready = initMotor(motorSerial, MOTOR_ID);
+#endif
+    motorSupervisor.start(ready, micros()); // A failed initialization is retried in place
+    char summary[128];
+    describeMotorInit(summary, sizeof(summary));
+    DEBUG_PRINTLN(summary);
+    if (ready) {
+        LCD_PRINTF("Motor ready in %u us\n", (unsigned)motorInitResult.duration_us);
+    } else {
+        LCD_PRINTF("MOTOR INIT FAILED\n%s\n", summary);
+    }
+    LCD_PRINT("micro ROS2 M5Stack START\n"); // Display initialization message on M5Stack    
 }
 
-void initMotor(HardwareSerial& serial, byte motorID) {
-    // Sending a series of setup commands to the motor
-    motorController.sendCommand(motorID, OPERATION_MODE_ADDRESS, MOTOR_SETUP_COMMAND, OPERATION_MODE_SPEED_CONTROL);
-    delay(COMMAND_DELAY);
-    motorController.sendCommand(motorID, EMERGENCY_STOP_ADDRESS, MOTOR_SETUP_COMMAND, DISABLE_EMERGENCY_STOP);
-    delay(COMMAND_DELAY);
-    motorController.sendCommand(motorID, CONTROL_WORD_ADDRESS, MOTOR_ENABLE_COMMAND, ENABLE_MOTOR);
-    delay(COMMAND_DELAY);
+// Writes one register and reads it back until the driver reports the written
+// value. The read-back doubles as the acknowledgement, so stray replies such
+// as write echoes are skipped rather than mistaken for it.
+template <typename Reg>
+static bool writeVerified(HardwareSerial& serial, byte motorID, const MotorFrame& write,
+                          typename Reg::value_type expected) {
+    const MotorFrame read = motorReadFrame<Reg>(motorID);
+    motorInitResult.address = Reg::address;
+    for (uint8_t attempt = 1; attempt <= MOTOR_INIT_ATTEMPTS; attempt++) {
+        motorInitResult.attempts = attempt;
+        motorInitResult.read_value = 0;
+        motorInitResult.error = MOTOR_INIT_TIMEOUT;
+        motorController.sendFrame(write);
+        motorController.sendFrame(read);
+
+        const uint32_t timeout = controlParams.motor_reply_timeout_ms;
+        unsigned long start = millis();
+        uint8_t reply[MOTOR_FRAME_SIZE];
+        for (uint32_t elapsed = 0; elapsed < timeout && receiveMotorFrame(serial, reply, timeout - elapsed);
+             elapsed = millis() - start) {
+            flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, reply);
+            captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, reply);
+            typename Reg::value_type value;
+            if (!decodeMotorReadReply<Reg>(reply, motorID, value)) {
+                continue;
+            }
+            motorInitResult.read_value = (int32_t)value;
+            motorInitResult.error = value == expected ? MOTOR_INIT_OK : MOTOR_INIT_MISMATCH;
+            break;
+        }
+        if (motorInitResult.error == MOTOR_INIT_OK) {
+            return true;
+        }
+    }
+    flightRecorder.recordError(FLIGHT_SOURCE_MOTOR_INIT, motorInitResult.error);
+    return false;
 }
 
-void MotorController::sendCommand(byte motorID, uint16_t address, byte command, uint32_t data) {
-    byte packet[] = {motorID, command, highByte(address), lowByte(address), ERROR_BYTE, (byte)(data >> 24), (byte)(data >> 16), (byte)(data >> 8), (byte)data};
-    byte checksum = 0; // Calculate checksum for error checking
-    for (int i = 0; i < sizeof(packet); i++) {
-        checksum += packet[i];
-    }
-    
-    // Display the entire packet on the LCD only if specific conditions are met
-    if ((packet[1] == 0xA4 && packet[3] == 0x77)) {
-        M5.Lcd.setCursor(0, 80);
-        M5.Lcd.print("Packet: ");
-        for (int i = 0; i < sizeof(packet); i++) {
-            M5.Lcd.printf("%02X ", packet[i]);
+bool initMotor(HardwareSerial& serial, byte motorID) {
+    unsigned long start = micros();
+    while (serial.available() > 0) {
+        serial.read(); // Drop stale bytes so they are not taken for replies
+    }
+
+    // Sending a series of setup commands to the motor, precomputed for the default ID
+    bool precomputed = motorID == MOTOR_ID;
+    bool ok = writeVerified<OperationModeRegister>(serial, motorID, precomputed ? OPERATION_MODE_FRAME :
+                  motorWriteFrame<OperationModeRegister>(motorID, OPERATION_MODE_SPEED_CONTROL),
+                  OPERATION_MODE_SPEED_CONTROL) &&
+              writeVerified<EmergencyStopRegister>(serial, motorID, precomputed ? EMERGENCY_STOP_FRAME :
+                  motorWriteFrame<EmergencyStopRegister>(motorID, DISABLE_EMERGENCY_STOP),
+                  DISABLE_EMERGENCY_STOP) &&
+              writeVerified<ControlWordRegister>(serial, motorID, precomputed ? ENABLE_MOTOR_FRAME :
+                  motorWriteFrame<ControlWordRegister>(motorID, ENABLE_MOTOR),
+                  ENABLE_MOTOR);
+    motorInitResult.duration_us = micros() - start;
+    return ok;
+}
+
+bool enableMotor(HardwareSerial& serial, byte motorID) {
+    unsigned long start = micros();
+    while (serial.available() > 0) {
+        serial.read();
+    }
+
+    // Clear a latched fault, then leave the emergency stop and enable as initMotor() does
+    bool precomputed = motorID == MOTOR_ID;
+    motorController.sendFrame(precomputed ? FAULT_RESET_FRAME : motorWriteFrame<ControlWordRegister>(motorID, FAULT_RESET));
+    bool ok = writeVerified<EmergencyStopRegister>(serial, motorID, precomputed ? EMERGENCY_STOP_FRAME :
+                  motorWriteFrame<EmergencyStopRegister>(motorID, DISABLE_EMERGENCY_STOP),
+                  DISABLE_EMERGENCY_STOP) &&
+              writeVerified<ControlWordRegister>(serial, motorID, precomputed ? ENABLE_MOTOR_FRAME :
+                  motorWriteFrame<ControlWordRegister>(motorID, ENABLE_MOTOR),
+                  ENABLE_MOTOR);
+    motorInitResult.duration_us = micros() - start;
+    return ok;
+}
+
+MotorRecovery::MotorRecovery()
+    : count(0), index(0), attempt(0), motor_id(MOTOR_ID), running(false), awaiting(false), replied(false),
+      reply_value(0), sent_us(0), start_us(0) {
+}
+
+void MotorRecovery::begin(byte motorID, bool full, uint32_t now_us) {
+    // Same registers and order as initMotor() and enableMotor()
+    count = 0;
+    if (full) {
+        steps[count++] = {motorWriteFrame<OperationModeRegister>(motorID, OPERATION_MODE_SPEED_CONTROL),
+                          motorReadFrame<OperationModeRegister>(motorID), OPERATION_MODE_ADDRESS,
+                          OPERATION_MODE_SPEED_CONTROL, &decodeMotorReadReply<OperationModeRegister>};
+    } else {
+        steps[count++] = {motorWriteFrame<ControlWordRegister>(motorID, FAULT_RESET),
+                          motorReadFrame<ControlWordRegister>(motorID), CONTROL_WORD_ADDRESS, FAULT_RESET, NULL};
+    }
+    steps[count++] = {motorWriteFrame<EmergencyStopRegister>(motorID, DISABLE_EMERGENCY_STOP),
+                      motorReadFrame<EmergencyStopRegister>(motorID), EMERGENCY_STOP_ADDRESS,
+                      DISABLE_EMERGENCY_STOP, &decodeMotorReadReply<EmergencyStopRegister>};
+    steps[count++] = {motorWriteFrame<ControlWordRegister>(motorID, ENABLE_MOTOR),
+                      motorReadFrame<ControlWordRegister>(motorID), CONTROL_WORD_ADDRESS,
+                      ENABLE_MOTOR, &decodeMotorReadReply<ControlWordRegister>};
+    motor_id = motorID;
+    index = 0;
+    attempt = 0;
+    awaiting = false;
+    replied = false;
+    start_us = now_us;
+    running = true;
+}
+
+MotorRecoveryStatus MotorRecovery::step(uint32_t now_us) {
+    if (!running) {
+        return MOTOR_RECOVERY_FAILED;
+    }
+    if (awaiting) {
+        const Step &current = steps[index];
+        if (!replied && now_us - sent_us < controlParams.motor_reply_timeout_ms * 1000UL) {
+            return MOTOR_RECOVERY_RUNNING;  // Check again on the next tick
+        }
+        motorInitResult.address = current.address;
+        motorInitResult.attempts = attempt;
+        motorInitResult.read_value = replied ? (int32_t)reply_value : 0;
+        awaiting = false;
+        if (!replied || reply_value != current.expected) {
+            MotorInitError error = replied ? MOTOR_INIT_MISMATCH : MOTOR_INIT_TIMEOUT;
+            if (attempt >= MOTOR_INIT_ATTEMPTS) {
+                return fail(error, now_us);
+            }
+        } else {
+            index++;
+            attempt = 0;
+            if (index == count) {
+                running = false;
+                motorInitResult.error = MOTOR_INIT_OK;
+                motorInitResult.duration_us = now_us - start_us;
+                return MOTOR_RECOVERY_DONE;
+            }
+        }
+    }
+
+    // Write the current step, a step without read-back is done once written
+    const Step &current = steps[index];
+    motorController.sendFrame(current.write);
+    if (current.decode == NULL) {
+        index++;
+        return MOTOR_RECOVERY_RUNNING;
+    }
+    motorController.sendFrame(current.read);
+    attempt++;
+    awaiting = true;
+    replied = false;
+    sent_us = now_us;
+    return MOTOR_RECOVERY_RUNNING;
+}
+
+bool MotorRecovery::onReply(const uint8_t* frame) {
+    if (!running || !awaiting) {
+        return false;
+    }
+    uint32_t value;
+    if (!steps[index].decode(frame, motor_id, value)) {
+        return false;
+    }
+    reply_value = value;
+    replied = true;
+    return true;
+}
+
+MotorRecoveryStatus MotorRecovery::fail(MotorInitError error, uint32_t now_us) {
+    running = false;
+    motorInitResult.error = error;
+    motorInitResult.duration_us = now_us - start_us;
+    flightRecorder.recordError(FLIGHT_SOURCE_MOTOR_INIT, error);
+    return MOTOR_RECOVERY_FAILED;
+}
+
+void pollMotorStatus(byte motorID) {
+    bool precomputed = motorID == MOTOR_ID;
+    motorController.sendFrame(precomputed ? STATUS_READ_FRAME : motorReadFrame<StatusWordRegister>(motorID));
+    motorController.sendFrame(precomputed ? FAULT_CODE_READ_FRAME : motorReadFrame<FaultCodeRegister>(motorID));
+}
+
+// Passes status word and fault code replies to the supervisor and target read-backs to
+// the actuation latency tracker, returns false for other frames.
+// Status replies arriving while the e-stop holds the driver disabled are dropped.
+static bool handleStatusReply(const uint8_t* frame, byte motorID) {
+    uint32_t value;
+    bool paused = (motorInhibit & MOTOR_INHIBIT_ESTOP) != 0;
+    int32_t target;
+    if (motorRecovery.onReply(frame)) {
+        return true;
+    }
+    if (decodeMotorReadReply<TargetVelocityRegister>(frame, motorID, target)) {
+        actuationLatency.onReadBack(target, micros());
+        return true;
+    }
+    if (decodeMotorReadReply<StatusWordRegister>(frame, motorID, value)) {
+        if (!paused) {
+            motorSupervisor.onStatus(value, micros());
+        }
+        return true;
+    }
+    if (decodeMotorReadReply<FaultCodeRegister>(frame, motorID, value)) {
+        if (!paused) {
+            motorSupervisor.onFaultCode(value, micros());
+        }
+        return true;
+    }
+    return false;
+}
+
+bool superviseMotor(HardwareSerial& serial, byte motorID) {
+    // The e-stop disabled the driver on purpose, supervision restarts with the re-arm,
+    // which runs its own recovery
+    if ((motorInhibit & MOTOR_INHIBIT_ESTOP) != 0) {
+        return false;
+    }
+    uint32_t period_us = controlParams.motor_status_period_ms * 1000;
+    motorSupervisor.configure(period_us, period_us * MOTOR_STATUS_TIMEOUT_POLLS, controlParams.motor_retry_max_ms * 1000);
+    uint32_t now_us = micros();
+    if (motorRecovery.active() && motorSupervisor.health() != MOTOR_HEALTH_FAULT) {
+        motorRecovery.cancel();  // A status reply showed the driver enabled meanwhile
+    }
+    if (motorRecovery.active()) {
+        MotorRecoveryStatus status = motorRecovery.step(now_us);
+        if (status != MOTOR_RECOVERY_RUNNING) {
+            motorSupervisor.onRecovery(status == MOTOR_RECOVERY_DONE, now_us);
+        }
+    } else {
+        MotorAction action = motorSupervisor.next(now_us);
+        switch (action) {
+        case MOTOR_ACTION_POLL:
+            pollMotorStatus(motorID);
+            break;
+        case MOTOR_ACTION_ENABLE:
+        case MOTOR_ACTION_INIT:
+            // One register per tick, the control task does not wait for the driver
+            motorRecovery.begin(motorID, action == MOTOR_ACTION_INIT, now_us);
+            motorRecovery.step(now_us);
+            break;
+        case MOTOR_ACTION_NONE:
+            break;
         }
-        M5.Lcd.println();
-        M5.Lcd.setCursor(0, 120);
-        M5.Lcd.printf("Checksum: %02X", checksum);
-        M5.Lcd.println();
     }
 
-    motorSerial.write(packet, sizeof(packet)); // Send the packet over serial
-    motorSerial.write(checksum); // Send the calculated checksum
+    // Hold the wheel from detection until a status reply confirms the recovery
+    bool stopped = motorSupervisor.isStopped();
+    if (stopped && (motorInhibit & MOTOR_INHIBIT_FAULT) == 0) {
+        inhibitMotors(MOTOR_INHIBIT_FAULT);
+    } else if (!stopped && (motorInhibit & MOTOR_INHIBIT_FAULT) != 0) {
+        releaseMotors(MOTOR_INHIBIT_FAULT);
+    }
+    if (!motorSupervisor.takeEvent()) {
+        return false;
+    }
+    MotorHealth health = motorSupervisor.health();
+    if (health == MOTOR_HEALTH_FAULT || health == MOTOR_HEALTH_FAILED) {
+        flightRecorder.recordFault(FLIGHT_SOURCE_MOTOR_FAULT, health);
+    } else {
+        flightRecorder.recordError(FLIGHT_SOURCE_MOTOR_FAULT, health);
+    }
+    return true;
+}
+
+bool receiveMotorFrame(HardwareSerial& serial, uint8_t* frame, uint32_t timeoutMs) {
+    unsigned long start = millis();
+    size_t received = 0;
+    for (;;) {
+        while (received < MOTOR_FRAME_SIZE && serial.available() > 0) {
+            frame[received++] = (uint8_t)serial.read();
+        }
+        if (received == MOTOR_FRAME_SIZE) {
+            if (motorFrameChecksumValid(frame)) {
+                return true;
+            }
+            // Out of step with the frame boundaries, resynchronize one byte later
+            memmove(frame, frame + 1, --received);
+            continue;
+        }
+        if (millis() - start >= timeoutMs) {
+            return false;
+        }
+        delay(1);
+    }
+}
+
+size_t describeMotorInit(char* buf, size_t len) {
+    static const char *const causes[] = {"ok", "timeout", "mismatch"};
+    size_t used = 0;
+    appendf(buf, len, &used, "motor_init=%s motor_init_us=%u motor_init_register=0x%04X "
+            "motor_init_attempts=%u motor_init_read=%d",
+            causes[motorInitResult.error], (unsigned)motorInitResult.duration_us,
+            (unsigned)motorInitResult.address, (unsigned)motorInitResult.attempts,
+            (int)motorInitResult.read_value);
+    return used;
+}
+
+void MotorController::sendCommand(byte motorID, uint16_t address, byte command, uint32_t data) {
+    sendFrame(encodeMotorFrame(motorID, command, address, data));
+}
+
+void MotorController::sendFrame(const MotorFrame& frame) {
+    motorSerial.write(frame.bytes, MOTOR_FRAME_SIZE); // Send the frame and its checksum at once
+    flightRecorder.recordMotorFrame(FLIGHT_MOTOR_TX, frame.bytes); // Record the complete frame
+    captureStream.recordMotorFrame(CAPTURE_MOTOR_TX, frame.bytes);
 }
 
 void sendMotorCommands(float linearVelocity, float angularVelocity) {
+#ifdef MOTOR_BUS
+    sendMotorTwist(linearVelocity, 0.0f, angularVelocity); // The bus task writes the targets
+#else
+    if (motorInhibit != 0) {
+        linearVelocity = 0.0f; // Keep the wheels stopped until the deferred work is done
+        angularVelocity = 0.0f;
+    }
+    currentCommand.linear_x = linearVelocity; // Reference of the slip detector
+    currentCommand.angular_z = angularVelocity;
     float wheelSpeed;
 #ifdef LEFT_WHEEL
-    wheelSpeed = (-1) * (linearVelocity - (WHEEL_DISTANCE * angularVelocity / 2)); // Calculate speed for left wheel
+    wheelSpeed = (-1) * (linearVelocity - (controlParams.wheel_distance * angularVelocity / 2)); // Calculate speed for left wheel
+    if (motorInhibit == 0) {
+        wheelSpeed = slipDetector.limitTarget(commandedWheelSpeed, wheelSpeed, micros()); // Ramped while slipping
+    }
 #elif defined(RIGHT_WHEEL)
-    wheelSpeed = linearVelocity + (WHEEL_DISTANCE * angularVelocity / 2); // Calculate speed for right wheel
+    wheelSpeed = linearVelocity + (controlParams.wheel_distance * angularVelocity / 2); // Calculate speed for right wheel
 #endif
+    commandedWheelSpeed = wheelSpeed; // Prior of the velocity estimator
     int wheelDec = velocityToDEC(wheelSpeed); // Convert speed to DEC
     sendVelocityDEC(motorSerial, wheelDec, MOTOR_ID); // Send DEC speed to motor
+#endif
+}
+
+void inhibitMotors(uint8_t reason) {
+    // Atomic, the e-stop task sets its bit from another core
+    __atomic_fetch_or(&motorInhibit, reason, __ATOMIC_RELAXED);
+    sendMotorCommands(0.0f, 0.0f);
+}
+
+void releaseMotors(uint8_t reason) {
+    __atomic_fetch_and(&motorInhibit, (uint8_t)~reason, __ATOMIC_RELAXED);
 }
 
 uint32_t velocityToDEC(float velocityMPS) {
-    float wheelCircumference = WHEEL_RADIUS * 2 * PI;
+    float wheelCircumference = controlParams.wheel_radius * 2 * PI;
     float rpm = (velocityMPS * 60.0) / wheelCircumference; // Convert m/s to RPM
     return static_cast<uint32_t>((rpm * 512.0 * 4096.0) / 1875.0); // Convert RPM to DEC format
 }
 
 void sendVelocityDEC(HardwareSerial& serial, int velocityDec, byte motorID) {
-    motorController.sendCommand(motorID, TARGET_VELOCITY_DEC_ADDRESS, VEL_SEND_COMMAND, velocityDec); // Send velocity command to motor
-}
-
-float readSpeedData(HardwareSerial& serial, byte motorID) {
-    motorController.sendCommand(motorID, ACTUAL_SPEED_DEC_ADDRESS, READ_DEC_COMMAND, NO_DATA); // Request current speed data
-    if (serial.available() >= 10) { // Check if enough data is available
-        uint8_t response[10];
-        serial.readBytes(response, 10); // Read the response from the motor
-        uint16_t responseAddress = ((uint16_t)response[2] << 8) | response[3];
-        if (response[0] == motorID && response[1] == READ_DEC_SUCCESS && responseAddress == ACTUAL_SPEED_DEC_ADDRESS) {
-            int32_t receivedDec;
-            memcpy(&receivedDec, &response[5], sizeof(receivedDec));
-            receivedDec = reverseBytes(receivedDec); // Correct the byte order
-            return calculateVelocityMPS(receivedDec); // Convert DEC to m/s and return
+    motorController.sendFrame(motorWriteFrame<TargetVelocityRegister>(motorID, velocityDec)); // Send velocity command to motor
+}
+
+bool readSpeedData(HardwareSerial& serial, byte motorID, float& speed) {
+    // Request current speed data
+    motorController.sendFrame(motorID == MOTOR_ID ? SPEED_READ_FRAME : motorReadFrame<ActualSpeedRegister>(motorID));
+    // Status replies of the supervisor may be queued ahead of the speed reply
+    while (serial.available() >= (int)MOTOR_FRAME_SIZE) { // Check if enough data is available
+        uint8_t response[MOTOR_FRAME_SIZE];
+        serial.readBytes(response, MOTOR_FRAME_SIZE); // Read the response from the motor
+        flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, response);
+        captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, response);
+        int32_t receivedDec;
+        if (decodeMotorReadReply<ActualSpeedRegister>(response, motorID, receivedDec)) {
+            speed = calculateVelocityMPS(receivedDec); // Convert DEC to m/s
+            return true;
         }
+        handleStatusReply(response, motorID);
     }
-    return 0.0; // Return zero if no valid data received
+    return false; // No speed reply, speed is left unchanged
+}
+
+void readMotorReplies(HardwareSerial& serial, byte motorID) {
+    while (serial.available() >= (int)MOTOR_FRAME_SIZE) {
+        uint8_t response[MOTOR_FRAME_SIZE];
+        serial.readBytes(response, MOTOR_FRAME_SIZE);
+        flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, response);
+        captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, response);
+        handleStatusReply(response, motorID);
+    }
+}
+
+bool readPositionData(HardwareSerial& serial, byte motorID, int32_t& position, uint32_t& sampleTime) {
+    static uint32_t request_us = 0;      // Time the last position request was queued
+    static bool request_pending = false; // True until the reply to that request is read
+    bool received = false;
+    // The reply answers the request of the previous tick; the driver latches the
+    // position once the request has been shifted out, MOTOR_FRAME_TX_US after queuing
+    while (serial.available() >= (int)MOTOR_FRAME_SIZE) {
+        uint8_t response[MOTOR_FRAME_SIZE];
+        serial.readBytes(response, MOTOR_FRAME_SIZE);
+        flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, response);
+        captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, response);
+        int32_t value;
+        if (request_pending && decodeMotorReadReply<ActualPositionRegister>(response, motorID, value)) {
+            position = value;
+            sampleTime = request_us + MOTOR_FRAME_TX_US;
+            request_pending = false;
+            received = true;
+        } else {
+            handleStatusReply(response, motorID);
+        }
+    }
+
+    // Request the position for the next tick
+    request_us = micros();
+    request_pending = true;
+    motorController.sendFrame(motorID == MOTOR_ID ? POSITION_READ_FRAME : motorReadFrame<ActualPositionRegister>(motorID));
+    return received;
+}
+
+float speedRegisterVariance() {
+    // calculateVelocityMPS() resolves whole RPM, uniform error of variance step^2 / 12
+    float step = controlParams.wheel_radius * 2 * PI / 60.0f;
+    return step * step / 12.0f;
+}
+
+float metersPerCount() {
+    return controlParams.wheel_radius * 2 * PI / ENCODER_COUNTS_PER_REV;
 }
 
 uint32_t reverseBytes(uint32_t value) {
@@ -113,5 +488,6 @@ uint32_t reverseBytes(uint32_t value) {
 
 float calculateVelocityMPS(int32_t dec) {
     int scaledRPM = (dec * 1875) / (512 * 4096); // Convert DEC to RPM
-    return (scaledRPM * WHEEL_CIRCUMFERENCE) / SCALE_FACTOR; // Convert RPM to m/s and return
+    float wheelCircumference = controlParams.wheel_radius * 2 * PI / 60.0 * SCALE_FACTOR; // Scaled circumference per minute
+    return (scaledRPM * wheelCircumference) / SCALE_FACTOR; // Convert RPM to m/s and return
 }
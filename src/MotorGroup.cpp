@@ -0,0 +1,295 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <M5Stack.h>
+#include "MotorGroup.h"
+#include "SummaryFormat.h"
+#include "MotorController.h"
+#include "ControlParameters.h"
+#include "FlightRecorder.h"
+#include "CaptureStream.h"
+#include "DebugOutput.h"
+
+MotorGroup motorGroup;
+static TaskHandle_t motor_bus_task = NULL;
+
+// Added to the diagonal of the normal equations, pins components the layout cannot observe to zero
+static const float ESTIMATE_REGULARIZATION = 1e-6f;
+
+void planarKinematics(const MotorConfig *configs, uint8_t count,
+                      float vx, float vy, float wz, float *targets) {
+    for (uint8_t i = 0; i < count; i++) {
+        const MotorConfig &c = configs[i];
+        // Velocity of the contact point projected on the drive direction
+        targets[i] = c.drive_x * (vx - wz * c.y) + c.drive_y * (vy + wz * c.x);
+    }
+}
+
+MotorGroup::MotorGroup() : kinematics(planarKinematics), cycle_us(0), motors(0) {
+    memset(configs, 0, sizeof(configs));
+    memset(feedbacks, 0, sizeof(feedbacks));
+    memset(slots, 0, sizeof(slots));
+    for (uint8_t i = 0; i < MOTOR_GROUP_MAX; i++) {
+        targets[i] = 0.0f;
+    }
+}
+
+bool MotorGroup::configure(const MotorConfig *configs, uint8_t count, uint32_t frame_us) {
+    motors = 0;
+    cycle_us = 0;
+    if (count == 0 || count > MOTOR_GROUP_MAX) {
+        return false;
+    }
+    uint32_t write_us = frame_us + MOTOR_BUS_GUARD_US;
+    uint32_t read_us = 2 * frame_us + MOTOR_BUS_REPLY_LATENCY_US + MOTOR_BUS_GUARD_US;
+    for (uint8_t i = 0; i < count; i++) {
+        this->configs[i] = configs[i];
+        memset(&feedbacks[i], 0, sizeof(feedbacks[i]));
+        targets[i] = 0.0f;
+        // Each driver gets its target right before its speed is sampled
+        MotorSlot &write = slots[2 * i];
+        write.type = MOTOR_SLOT_WRITE;
+        write.motor = i;
+        write.offset_us = cycle_us;
+        write.length_us = write_us;
+        cycle_us += write_us;
+        MotorSlot &read = slots[2 * i + 1];
+        read.type = MOTOR_SLOT_READ;
+        read.motor = i;
+        read.offset_us = cycle_us;
+        read.length_us = read_us;
+        cycle_us += read_us;
+    }
+    motors = count;
+    return true;
+}
+
+void MotorGroup::setKinematics(MotorKinematics kinematics) {
+    this->kinematics = kinematics != nullptr ? kinematics : planarKinematics;
+}
+
+void MotorGroup::setTwist(float vx, float vy, float wz) {
+    float computed[MOTOR_GROUP_MAX];
+    kinematics(configs, motors, vx, vy, wz, computed);
+    for (uint8_t i = 0; i < motors; i++) {
+        targets[i] = computed[i];
+    }
+}
+
+bool MotorGroup::estimateTwist(float &vx, float &vy, float &wz) const {
+    // Normal equations J^T J t = J^T w of the planar kinematics rows
+    float a[3][4];
+    memset(a, 0, sizeof(a));
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < motors; i++) {
+        if (!feedbacks[i].valid) {
+            continue;
+        }
+        const MotorConfig &c = configs[i];
+        float row[3] = {c.drive_x, c.drive_y, c.drive_y * c.x - c.drive_x * c.y};
+        for (int r = 0; r < 3; r++) {
+            for (int k = 0; k < 3; k++) {
+                a[r][k] += row[r] * row[k];
+            }
+            a[r][3] += row[r] * feedbacks[i].speed;
+        }
+        used++;
+    }
+    if (used == 0) {
+        return false;
+    }
+    // Gaussian elimination, the regularized matrix is positive definite
+    for (int r = 0; r < 3; r++) {
+        a[r][r] += ESTIMATE_REGULARIZATION;
+    }
+    for (int p = 0; p < 3; p++) {
+        for (int r = p + 1; r < 3; r++) {
+            float f = a[r][p] / a[p][p];
+            for (int k = p; k < 4; k++) {
+                a[r][k] -= f * a[p][k];
+            }
+        }
+    }
+    float t[3];
+    for (int r = 2; r >= 0; r--) {
+        float sum = a[r][3];
+        for (int k = r + 1; k < 3; k++) {
+            sum -= a[r][k] * t[k];
+        }
+        t[r] = sum / a[r][r];
+    }
+    vx = t[0];
+    vy = t[1];
+    wz = t[2];
+    return true;
+}
+
+void MotorGroup::onReply(uint8_t motor, float speed, uint32_t now_us) {
+    MotorFeedback &f = feedbacks[motor];
+    f.speed = speed;
+    f.sample_us = now_us;
+    f.replies++;
+    f.valid = true;
+}
+
+void MotorGroup::onMiss(uint8_t motor) {
+    feedbacks[motor].misses++;
+    feedbacks[motor].valid = false;
+}
+
+size_t MotorGroup::summarize(char *buf, size_t len) const {
+    size_t used = 0;
+    appendf(buf, len, &used, "motors=%u cycle_us=%u", (unsigned)motors, (unsigned)cycle_us);
+    for (uint8_t i = 0; i < motors && used + 1 < len; i++) {
+        appendf(buf, len, &used, " id%u=%u/%u",
+                (unsigned)configs[i].id, (unsigned)feedbacks[i].replies,
+                (unsigned)feedbacks[i].misses);
+    }
+    return used;
+}
+
+bool initMotorGroup(HardwareSerial &serial) {
+    // Wheel order front left, front right, rear left, rear right; the left
+    // drivers are mounted mirrored like the left wheel board
+    const float x = MOTOR_BUS_WHEELBASE / 2;
+    const float y = controlParams.wheel_distance / 2;
+#if MOTOR_BUS_LAYOUT == MOTOR_LAYOUT_MECANUM4
+    const MotorConfig layout[] = {
+        {1, x, y, -1.0f, 1.0f},
+        {2, x, -y, 1.0f, 1.0f},
+        {3, -x, y, -1.0f, -1.0f},
+        {4, -x, -y, 1.0f, -1.0f},
+    };
+#else
+    const MotorConfig layout[] = {
+        {1, x, y, -1.0f, 0.0f},
+        {2, x, -y, 1.0f, 0.0f},
+        {3, -x, y, -1.0f, 0.0f},
+        {4, -x, -y, 1.0f, 0.0f},
+    };
+#endif
+    motorGroup.configure(layout, sizeof(layout) / sizeof(layout[0]), MOTOR_FRAME_TX_US);
+    bool ready = true;
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        if (!initMotor(serial, motorGroup.config(i).id)) {
+            DEBUG_PRINTF("Motor %u init failed\n", (unsigned)motorGroup.config(i).id);
+            ready = false;
+        }
+    }
+    return ready;
+}
+
+void sendMotorTwist(float vx, float vy, float wz) {
+    if (motorInhibit != 0) {
+        vx = vy = wz = 0.0f;
+    }
+    motorGroup.setTwist(vx, vy, wz);
+}
+
+// Sleeps the whole ticks before deadline_us, only the rest is busy-waited
+static void waitUntil(uint32_t deadline_us) {
+    int32_t remaining = (int32_t)(deadline_us - micros());
+    if (remaining >= 1000) {
+        vTaskDelay(pdMS_TO_TICKS(remaining / 1000)); // Wakes up to one tick early, never late
+        remaining = (int32_t)(deadline_us - micros());
+    }
+    if (remaining > 0) {
+        delayMicroseconds((unsigned int)remaining);
+    }
+}
+
+void runMotorBusCycle(HardwareSerial &serial, uint32_t start_us) {
+    if (motorInhibit != 0) {
+        motorGroup.setTwist(0.0f, 0.0f, 0.0f); // Wheels stay stopped once released, until the next command
+    }
+    for (uint8_t s = 0; s < motorGroup.slotCount(); s++) {
+        const MotorSlot &slot = motorGroup.slot(s);
+        byte id = motorGroup.config(slot.motor).id;
+        waitUntil(start_us + slot.offset_us);
+        if (slot.type == MOTOR_SLOT_WRITE) {
+            float speed = motorInhibit != 0 ? 0.0f : motorGroup.target(slot.motor);
+            sendVelocityDEC(serial, velocityToDEC(speed), id);
+            continue;
+        }
+
+        while (serial.available() > 0) {
+            serial.read(); // Drop late replies of earlier slots
+        }
+        motorController.sendFrame(motorReadFrame<ActualSpeedRegister>(id));
+        // Timed from the request, a late slot still waits for its whole reply and the next slots catch up
+        uint32_t end_us = micros() + slot.length_us - MOTOR_BUS_GUARD_US;
+        uint8_t response[MOTOR_FRAME_SIZE];
+        size_t received = 0;
+        bool answered = false;
+        while (!answered) {
+            int32_t remaining_us = (int32_t)(end_us - micros());
+            if (remaining_us <= 0) {
+                break;
+            }
+            // Blocks in the UART driver until the frame is complete or the slot ends,
+            // the millisecond timeout rounds up by less than one tick
+            serial.setTimeout((remaining_us + 999) / 1000);
+            received += serial.readBytes(response + received, MOTOR_FRAME_SIZE - received);
+            if (received < MOTOR_FRAME_SIZE) {
+                continue;
+            }
+            received = 0;
+            flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, response);
+            captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, response);
+            int32_t dec;
+            if (decodeMotorReadReply<ActualSpeedRegister>(response, id, dec)) {
+                motorGroup.onReply(slot.motor, calculateVelocityMPS(dec), micros());
+                answered = true;
+            }
+        }
+        if (!answered) {
+            motorGroup.onMiss(slot.motor);
+        }
+    }
+    waitUntil(start_us + motorGroup.cycleLength());
+}
+
+void startMotorBusTask() {
+    char summary[MOTOR_GROUP_BUFFER_SIZE];
+    motorGroup.summarize(summary, sizeof(summary));
+    DEBUG_PRINTF("Motor bus: %s\n", summary);
+    if (!motorGroup.fits(controlParams.wheel_period_ms * 1000UL)) {
+        DEBUG_PRINTLN("Motor bus cycle longer than the wheel period, the cycle sets the rate");
+    }
+    xTaskCreatePinnedToCore(motorBusTask, "motor_bus", MOTOR_BUS_TASK_STACK_SIZE,
+                            NULL, MOTOR_BUS_TASK_PRIORITY, &motor_bus_task, MOTOR_BUS_TASK_CORE);
+}
+
+void motorBusTask(void *param) {
+    (void)param;
+    bool paused = false;
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        uint32_t start_us = micros();
+        // One cycle of zero targets after a trip, then the bus is left to the re-arm
+        bool latched = (motorInhibit & MOTOR_INHIBIT_ESTOP) != 0;
+        if (!latched || !paused) {
+            runMotorBusCycle(motorSerial, start_us);
+        }
+        paused = latched;
+        TickType_t period = pdMS_TO_TICKS(controlParams.wheel_period_ms);
+        TickType_t now = xTaskGetTickCount();
+        if ((TickType_t)(now - last_wake) >= period) {
+            // Overran, the cycle sets the rate and the lower priorities of the core get one tick
+            last_wake = now + 1 - period;
+        }
+        vTaskDelayUntil(&last_wake, period);
+    }
+}
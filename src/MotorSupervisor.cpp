@@ -0,0 +1,167 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "MotorSupervisor.h"
+#include "SummaryFormat.h"
+
+MotorSupervisor::MotorSupervisor()
+    : poll_period_us(MOTOR_STATUS_PERIOD * 1000UL),
+      status_timeout_us(MOTOR_STATUS_PERIOD * MOTOR_STATUS_TIMEOUT_POLLS * 1000UL),
+      retry_max_us(MOTOR_RETRY_MAX * 1000UL), started(false), state(MOTOR_HEALTH_OK), event(false),
+      confirm_polled(false), last_poll_us(0), last_reply_us(0), fault_start_us(0), retry_at_us(0),
+      retry_delay_us(MOTOR_RETRY_MIN * 1000UL) {
+    memset(&counters, 0, sizeof(counters));
+}
+
+void MotorSupervisor::configure(uint32_t poll_period_us, uint32_t status_timeout_us, uint32_t retry_max_us) {
+    this->poll_period_us = poll_period_us;
+    this->status_timeout_us = status_timeout_us;
+    this->retry_max_us = retry_max_us;
+}
+
+void MotorSupervisor::start(bool initialized, uint32_t now_us) {
+    started = true;
+    last_poll_us = now_us;
+    last_reply_us = now_us;
+    if (!initialized) {
+        enterFault(MOTOR_CAUSE_INIT, now_us);
+    }
+}
+
+void MotorSupervisor::onStatus(uint32_t status, uint32_t now_us) {
+    last_reply_us = now_us;
+    counters.last_status = status;
+    bool healthy = (status & MOTOR_STATUS_ENABLED) != 0 &&
+                   (status & (MOTOR_STATUS_FAULT | MOTOR_STATUS_EMERGENCY_STOP)) == 0;
+    switch (state) {
+    case MOTOR_HEALTH_OK:
+        if (!healthy) {
+            enterFault((status & MOTOR_STATUS_FAULT) ? MOTOR_CAUSE_FAULT : MOTOR_CAUSE_STOPPED, now_us);
+        }
+        break;
+    case MOTOR_HEALTH_FAULT:
+    case MOTOR_HEALTH_CONFIRM:
+        if (healthy) {
+            // Downtime ends with the reply confirming the driver follows commands again
+            counters.last_downtime_us = now_us - fault_start_us;
+            if (counters.last_downtime_us > counters.max_downtime_us) {
+                counters.max_downtime_us = counters.last_downtime_us;
+            }
+            counters.recoveries++;
+            retry_delay_us = MOTOR_RETRY_MIN * 1000UL;
+            setState(MOTOR_HEALTH_OK);
+        } else if (state == MOTOR_HEALTH_CONFIRM) {
+            retryLater(now_us);  // The enable sequence did not hold
+        }
+        break;
+    case MOTOR_HEALTH_FAILED:
+        break;
+    }
+}
+
+void MotorSupervisor::onFaultCode(uint32_t code, uint32_t now_us) {
+    (void)now_us;
+    if (code == 0) {
+        return;
+    }
+    counters.last_fault_code = code;
+    if ((code & MOTOR_FAULT_PERMANENT) != 0 && state != MOTOR_HEALTH_OK) {
+        setState(MOTOR_HEALTH_FAILED);
+    }
+}
+
+void MotorSupervisor::onRecovery(bool ok, uint32_t now_us) {
+    if (state != MOTOR_HEALTH_FAULT) {
+        return;
+    }
+    if (ok) {
+        confirm_polled = false;
+        setState(MOTOR_HEALTH_CONFIRM);
+    } else {
+        retryLater(now_us);
+    }
+}
+
+MotorAction MotorSupervisor::next(uint32_t now_us) {
+    if (!started) {
+        return MOTOR_ACTION_NONE;
+    }
+    if (state == MOTOR_HEALTH_OK && status_timeout_us > 0 && now_us - last_reply_us > status_timeout_us) {
+        enterFault(MOTOR_CAUSE_LOST, now_us);
+    }
+    if (state == MOTOR_HEALTH_FAULT && (int32_t)(now_us - retry_at_us) >= 0) {
+        counters.attempts++;
+        // A lost or never initialized driver may have restarted with its default operation mode
+        return counters.cause == MOTOR_CAUSE_LOST || counters.cause == MOTOR_CAUSE_INIT ?
+               MOTOR_ACTION_INIT : MOTOR_ACTION_ENABLE;
+    }
+    if (state == MOTOR_HEALTH_CONFIRM) {
+        if (!confirm_polled) {
+            confirm_polled = true;
+            last_poll_us = now_us;
+            return MOTOR_ACTION_POLL;
+        }
+        if (now_us - last_poll_us >= poll_period_us) {
+            retryLater(now_us);  // The confirming poll went unanswered
+        }
+    }
+    if (now_us - last_poll_us >= poll_period_us) {
+        last_poll_us = now_us;
+        return MOTOR_ACTION_POLL;
+    }
+    return MOTOR_ACTION_NONE;
+}
+
+bool MotorSupervisor::takeEvent() {
+    bool pending = event;
+    event = false;
+    return pending;
+}
+
+size_t MotorSupervisor::summarize(char *buf, size_t len) const {
+    static const char *const healths[] = {"ok", "fault", "confirm", "failed"};
+    static const char *const causes[] = {"none", "fault", "stopped", "lost", "init"};
+    size_t used = 0;
+    appendf(buf, len, &used, "motor=%s cause=%s status=0x%04X fault_code=0x%04X faults=%u "
+            "recoveries=%u attempts=%u downtime_us=%u max_downtime_us=%u",
+            healths[state], causes[counters.cause], (unsigned)counters.last_status,
+            (unsigned)counters.last_fault_code, (unsigned)counters.faults,
+            (unsigned)counters.recoveries, (unsigned)counters.attempts,
+            (unsigned)counters.last_downtime_us, (unsigned)counters.max_downtime_us);
+    return used;
+}
+
+void MotorSupervisor::enterFault(MotorFaultCause cause, uint32_t now_us) {
+    counters.faults++;
+    counters.cause = cause;
+    fault_start_us = now_us;
+    retry_at_us = now_us;  // The first attempt is immediate, most trips are transient
+    retry_delay_us = MOTOR_RETRY_MIN * 1000UL;
+    setState(MOTOR_HEALTH_FAULT);
+}
+
+void MotorSupervisor::retryLater(uint32_t now_us) {
+    retry_at_us = now_us + retry_delay_us;
+    retry_delay_us = retry_delay_us * 2 < retry_max_us ? retry_delay_us * 2 : retry_max_us;
+    setState(MOTOR_HEALTH_FAULT);
+}
+
+void MotorSupervisor::setState(MotorHealth next_state) {
+    if (next_state != state) {
+        state = next_state;
+        event = true;
+    }
+}
@@ -0,0 +1,125 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "RateCalibration.h"
+#include "SummaryFormat.h"
+
+const RateLevel RateCalibration::LEVELS[RATE_LEVEL_COUNT] = {
+    {5, 2, 10},
+    {10, 5, 20},  // Compile-time defaults
+    {20, 10, 40},
+    {50, 20, 100},
+    {100, 50, 200},
+};
+
+// Share of period_us taken by cost_us in permille, saturating
+static uint16_t permille(uint32_t cost_us, uint32_t period_us) {
+    uint64_t value = (uint64_t)cost_us * 1000 / period_us;
+    return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+RateCalibration::RateCalibration()
+    : cpu_budget_permille(RATE_CPU_BUDGET * 10), link_budget_permille(RATE_LINK_BUDGET * 10),
+      motor_frame_us(0), has_imu(false) {
+    memset(&measured, 0, sizeof(measured));
+    memset(&result, 0, sizeof(result));
+}
+
+void RateCalibration::configure(uint8_t cpu_budget_pct, uint8_t link_budget_pct, uint32_t motor_frame_us, bool has_imu) {
+    cpu_budget_permille = cpu_budget_pct * 10;
+    link_budget_permille = link_budget_pct * 10;
+    this->motor_frame_us = motor_frame_us;
+    this->has_imu = has_imu;
+}
+
+RateLimit RateCalibration::evaluate(const RateLevel &level, RateSelection &sel) const {
+    uint32_t wheel_us = level.wheel_ms * 1000UL;
+    uint32_t sample_us = level.imu_sample_ms * 1000UL;
+    uint32_t publish_us = level.imu_publish_ms * 1000UL;
+
+    sel.motor_permille = permille(RATE_MOTOR_FRAMES_PER_TICK * motor_frame_us, wheel_us);
+    sel.cpu_permille = permille(measured.wheel_cpu_us, wheel_us);
+    sel.link_permille = permille(measured.wheel_link_us, wheel_us);
+    if (has_imu) {
+        uint32_t cpu = permille(measured.imu_read_us, sample_us) + permille(measured.imu_cpu_us, publish_us);
+        uint32_t link = permille(measured.imu_link_us, publish_us);
+        sel.cpu_permille = sel.cpu_permille + cpu > 0xFFFF ? 0xFFFF : sel.cpu_permille + cpu;
+        sel.link_permille = sel.link_permille + link > 0xFFFF ? 0xFFFF : sel.link_permille + link;
+    }
+
+    if ((uint64_t)measured.motor_rtt_us * RATE_MOTOR_RTT_MARGIN > wheel_us) {
+        return RATE_LIMIT_MOTOR_RTT;
+    }
+    if (sel.motor_permille > link_budget_permille) {
+        return RATE_LIMIT_MOTOR_BUS;
+    }
+    if (sel.cpu_permille > cpu_budget_permille) {
+        return RATE_LIMIT_CPU;
+    }
+    if (sel.link_permille > link_budget_permille) {
+        return RATE_LIMIT_LINK;
+    }
+    return RATE_LIMIT_NONE;
+}
+
+bool RateCalibration::select(const RateMeasurements &m) {
+    measured = m;
+    memset(&result, 0, sizeof(result));
+    if (m.motor_rtt_us == 0 || m.agent_rtt_us == 0) {
+        result.limit = RATE_LIMIT_UNMEASURED;
+        return false;
+    }
+
+    // The first rejected level names the budget that keeps the board from going faster
+    RateLimit limit = RATE_LIMIT_NONE;
+    for (uint8_t i = 0; i < RATE_LEVEL_COUNT; i++) {
+        RateSelection candidate = result;
+        RateLimit verdict = evaluate(LEVELS[i], candidate);
+        if (verdict == RATE_LIMIT_NONE || i == RATE_LEVEL_COUNT - 1) {
+            result = candidate;
+            result.selected = true;
+            result.within_budget = verdict == RATE_LIMIT_NONE;
+            result.level = i;
+            result.rates = LEVELS[i];
+            result.limit = verdict == RATE_LIMIT_NONE ? limit : verdict;
+            return true;
+        }
+        if (limit == RATE_LIMIT_NONE) {
+            limit = verdict;
+        }
+    }
+    return true;
+}
+
+size_t RateCalibration::summarize(char *buf, size_t len) const {
+    static const char *const limits[] = {"none", "motor_rtt", "motor_bus", "cpu", "link", "unmeasured"};
+    const RateMeasurements &m = measured;
+    const RateSelection &s = result;
+    size_t used = 0;
+    appendf(buf, len, &used,
+            "rates=%s level=%u wheel_ms=%u imu_sample_ms=%u imu_publish_ms=%u limit=%s "
+            "cpu_pct=%u.%u link_pct=%u.%u motor_pct=%u.%u "
+            "motor_rtt_us=%u imu_read_us=%u agent_rtt_us=%u wheel_cpu_us=%u wheel_link_us=%u "
+            "imu_cpu_us=%u imu_link_us=%u",
+            !s.selected ? "unchanged" : s.within_budget ? "selected" : "over_budget",
+            s.level, s.rates.wheel_ms, s.rates.imu_sample_ms, s.rates.imu_publish_ms,
+            limits[s.limit], s.cpu_permille / 10, s.cpu_permille % 10,
+            s.link_permille / 10, s.link_permille % 10, s.motor_permille / 10, s.motor_permille % 10,
+            (unsigned)m.motor_rtt_us, (unsigned)m.imu_read_us, (unsigned)m.agent_rtt_us,
+            (unsigned)m.wheel_cpu_us, (unsigned)m.wheel_link_us, (unsigned)m.imu_cpu_us,
+            (unsigned)m.imu_link_us);
+    return used;
+}
@@ -0,0 +1,165 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <M5Stack.h>
+#include "ResourceMonitor.h"
+#include "SummaryFormat.h"
+
+ResourceMonitor resourceMonitor;
+
+ResourceMonitor::ResourceMonitor()
+    : task_count(0), last_total(0), has_sample(false), loads_valid(false), heap{0, 0, 0}, warn(0), boot_time_ms(0) {
+    memset(idle_permille, 0, sizeof(idle_permille));
+}
+
+void ResourceMonitor::sample() {
+    HeapSnapshot heap = {ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap()};
+    TaskSnapshot snapshots[MONITOR_MAX_TASKS];
+    size_t count = 0;
+    uint32_t total_runtime = 0;
+#if configUSE_TRACE_FACILITY
+    // Static to keep the housekeeping task stack small; only called from one task
+    static TaskStatus_t status[MONITOR_MAX_TASKS];
+    count = uxTaskGetSystemState(status, MONITOR_MAX_TASKS, &total_runtime);
+    for (size_t i = 0; i < count; i++) {
+        TaskSnapshot &snap = snapshots[i];
+        snap.id = status[i].xTaskNumber;
+        snap.name = status[i].pcTaskName;
+        snap.runtime = status[i].ulRunTimeCounter;
+        snap.stack_free_bytes = status[i].usStackHighWaterMark; // Stack is counted in bytes on the ESP32
+        snap.core = MONITOR_CORE_UNKNOWN;
+        snap.idle = false;
+#ifdef CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        if (status[i].xCoreID >= 0 && status[i].xCoreID < MONITOR_CORES) {
+            snap.core = (uint8_t)status[i].xCoreID;
+        }
+#endif
+        for (uint8_t core = 0; core < MONITOR_CORES; core++) {
+            if (status[i].xHandle == xTaskGetIdleTaskHandleForCPU(core)) {
+                snap.core = core;
+                snap.idle = true;
+            }
+        }
+    }
+#endif
+    update(snapshots, count, total_runtime, heap);
+}
+
+void ResourceMonitor::update(const TaskSnapshot *snapshots, size_t count, uint32_t total_runtime,
+                             const HeapSnapshot &heap) {
+    if (count > MONITOR_MAX_TASKS) {
+        count = MONITOR_MAX_TASKS;
+    }
+    // Counters wrap at 32 bits, unsigned differences stay valid across one wrap
+    uint32_t elapsed = total_runtime - last_total;
+    bool valid = has_sample && elapsed > 0;
+
+    TaskState next[MONITOR_MAX_TASKS];
+    uint16_t idle[MONITOR_CORES] = {0};
+    bool idle_seen[MONITOR_CORES] = {false};
+    uint32_t flags = 0;
+    for (size_t i = 0; i < count; i++) {
+        const TaskSnapshot &snap = snapshots[i];
+        TaskState &task = next[i];
+        task.id = snap.id;
+        task.core = snap.core;
+        task.runtime = snap.runtime;
+        task.stack_free_bytes = snap.stack_free_bytes;
+        task.load_permille = 0;
+
+        // Names such as "Tmr Svc" would break the key=value summary
+        size_t n = 0;
+        for (; snap.name != NULL && snap.name[n] != '\0' && n < MONITOR_TASK_NAME_SIZE - 1; n++) {
+            task.name[n] = snap.name[n] == ' ' ? '_' : snap.name[n];
+        }
+        task.name[n] = '\0';
+
+        // Tasks created since the last sample have no load until the next one
+        for (size_t j = 0; valid && j < task_count; j++) {
+            if (tasks[j].id == snap.id) {
+                uint64_t permille = (uint64_t)(snap.runtime - tasks[j].runtime) * 1000 / elapsed;
+                task.load_permille = permille > 1000 ? 1000 : (uint16_t)permille;
+                break;
+            }
+        }
+
+        if (snap.idle && snap.core < MONITOR_CORES) {
+            idle[snap.core] = task.load_permille;
+            idle_seen[snap.core] = true;
+        }
+        if (snap.stack_free_bytes < STACK_WARN_BYTES) {
+            flags |= RESOURCE_WARN_STACK;
+        }
+    }
+
+    for (uint8_t core = 0; core < MONITOR_CORES; core++) {
+        if (valid && idle_seen[core] && idle[core] < IDLE_WARN_PERMILLE) {
+            flags |= RESOURCE_WARN_IDLE;
+        }
+    }
+    if (heap.min_free_bytes < HEAP_WARN_BYTES) {
+        flags |= RESOURCE_WARN_HEAP;
+    }
+
+    memcpy(tasks, next, count * sizeof(TaskState));
+    task_count = count;
+    memcpy(idle_permille, idle, sizeof(idle_permille));
+    loads_valid = valid;
+    this->heap = heap;
+    warn = flags;
+    last_total = total_runtime;
+    has_sample = true;
+}
+
+size_t ResourceMonitor::summarize(char *buf, size_t len) const {
+    size_t used = 0;
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+    appendf(buf, len, &used, "heap_free=%u heap_min=%u heap_largest=%u",
+            (unsigned)heap.free_bytes, (unsigned)heap.min_free_bytes, (unsigned)heap.largest_block);
+    if (boot_time_ms != 0) {
+        appendf(buf, len, &used, " boot_ms=%u", (unsigned)boot_time_ms);
+    }
+    if (loads_valid) {
+        appendf(buf, len, &used, " idle_pct=");
+        for (uint8_t core = 0; core < MONITOR_CORES; core++) {
+            appendf(buf, len, &used, "%s%u.%u", core ? "," : "",
+                    idle_permille[core] / 10, idle_permille[core] % 10);
+        }
+    }
+
+    // name:cpu_pct:stack_free_bytes for each task
+    appendf(buf, len, &used, " tasks=");
+    for (size_t i = 0; i < task_count; i++) {
+        const TaskState &task = tasks[i];
+        if (loads_valid) {
+            appendf(buf, len, &used, "%s%s:%u.%u:%u", i ? "," : "", task.name,
+                    task.load_permille / 10, task.load_permille % 10, (unsigned)task.stack_free_bytes);
+        } else {
+            appendf(buf, len, &used, "%s%s:-:%u", i ? "," : "", task.name, (unsigned)task.stack_free_bytes);
+        }
+    }
+
+    appendf(buf, len, &used, " warn=%s%s%s%s", warn ? "" : "none",
+            (warn & RESOURCE_WARN_STACK) ? "stack," : "",
+            (warn & RESOURCE_WARN_HEAP) ? "heap," : "",
+            (warn & RESOURCE_WARN_IDLE) ? "idle," : "");
+    if (warn && used > 0 && buf[used - 1] == ',') {
+        buf[--used] = '\0'; // Drop the trailing separator
+    }
+    return used;
+}
@@ -19,6 +19,18 @@
 #include "SerialManager.h"
 #include "SystemManager.h"
 #include "IMUManager.h"
+#include "TransportManager.h"
+#include "FlightRecorder.h"
+#include "ControlParameters.h"
+#include "TopicQos.h"
+#include "CaptureStream.h"
+#include "EmergencyStop.h"
+#include "MotorGroup.h"
+#include "ActuationLatency.h"
+#include "SlipDetector.h"
+#ifdef TRANSPORT_BENCHMARK
+#include "TransportBenchmark.h"
+#endif
 
 // Define wheel-specific suffix based on the wheel type
 #ifdef LEFT_WHEEL
@@ -30,17 +42,68 @@
 // Define ROS2 node names based on the wheel type
 #define NODE_NAME WHEEL_SUFFIX "_micro_ros_node"
 
+// Namespace of the node, e.g. -DNODE_NAMESPACE='"/robot1"' when several robots share an agent.
+// Topic names starting with "/" are absolute and stay outside of it.
+#ifndef NODE_NAMESPACE
+#define NODE_NAMESPACE ""
+#endif
+
 // Constants for ROS 2 topic and service names
 #define REBOOT_SERVICE_NAME "/" WHEEL_SUFFIX "/reboot_service"
 #define CONNECTION_RESPONSE_TOPIC WHEEL_SUFFIX "/connection_response"
+#define HEARTBEAT_TOPIC "/" WHEEL_SUFFIX "/heartbeat"
 #define HEARTBEAT_RESPONSE_TOPIC "/" WHEEL_SUFFIX "/heartbeat_response"
+#define LINK_QUALITY_TOPIC "/" WHEEL_SUFFIX "/link_quality"
 #define VELOCITY_TOPIC "/" WHEEL_SUFFIX "/velocity"
+#define VELOCITY_COVARIANCE_TOPIC "/" WHEEL_SUFFIX "/velocity_with_covariance"
+#define DIAGNOSTICS_TOPIC "/" WHEEL_SUFFIX "/diagnostics"
+#define RESOURCE_USAGE_TOPIC "/" WHEEL_SUFFIX "/resource_usage"
+#define MOTOR_STATUS_TOPIC "/" WHEEL_SUFFIX "/motor_status"
+#define RATE_SELECTION_TOPIC "/" WHEEL_SUFFIX "/rate_selection"
+#define ACTUATION_LATENCY_TOPIC "/" WHEEL_SUFFIX "/actuation_latency"
+#define SLIP_TOPIC "/" WHEEL_SUFFIX "/slip"
+#define FLIGHT_RECORDER_SERVICE_NAME "/" WHEEL_SUFFIX "/dump_flight_recorder"
+#define ESTOP_REARM_SERVICE_NAME "/" WHEEL_SUFFIX "/rearm_estop"
+#define ESTOP_TOPIC "/" WHEEL_SUFFIX "/estop"
+#define FLIGHT_RECORDER_TOPIC "/" WHEEL_SUFFIX "/flight_recorder"
+#define BENCH_PING_TOPIC "/" WHEEL_SUFFIX "/bench_ping"
+#define BENCH_ECHO_TOPIC "/" WHEEL_SUFFIX "/bench_echo"
+#define BENCH_RESULT_TOPIC "/" WHEEL_SUFFIX "/bench_result"
 
 // Common topics not specific to any wheel
 #define CONNECTION_CHECK_TOPIC "connection_check_request"
-#define HEARTBEAT_TOPIC "heartbeat"
 #define CMD_VEL_TOPIC "/cmd_vel"
 #define IMU_DATA_TOPIC "/imu/data_raw"
+#define IMU_BATCH_TOPIC "/imu/raw_batch"
+
+// QoS of each topic, override with -D to change a topic at build time
+#ifndef CMD_VEL_QOS
+#define CMD_VEL_QOS QOS_COMMAND
+#endif
+#ifndef IMU_QOS
+#define IMU_QOS QOS_SENSOR
+#endif
+#ifndef IMU_BATCH_QOS
+#define IMU_BATCH_QOS QOS_SENSOR  // The batch sequence number shows losses to the converter
+#endif
+#ifndef VELOCITY_QOS
+#define VELOCITY_QOS QOS_SENSOR
+#endif
+#ifndef HEARTBEAT_QOS
+#define HEARTBEAT_QOS QOS_SENSOR  // Retransmissions would hide the loss and delay the link monitor measures
+#endif
+#ifndef CONNECTION_QOS
+#define CONNECTION_QOS QOS_STATUS
+#endif
+#ifndef STATUS_TOPIC_QOS
+#define STATUS_TOPIC_QOS QOS_STATUS  // A reliable publish blocks the task holding the session until acknowledged
+#endif
+#ifndef FLIGHT_DUMP_QOS
+#define FLIGHT_DUMP_QOS QOS_TRANSFER
+#endif
+#ifndef SERVICE_QOS
+#define SERVICE_QOS QOS_SERVICE
+#endif
 
 // Constants for ROS 2 frame IDs
 #define IMU_FRAME_ID "imu"
@@ -57,38 +120,120 @@ rcl_service_t reboot_service;              // Service to manage reboot requests
 std_srvs__srv__Trigger_Request request;        // Reboot request message
 std_srvs__srv__Trigger_Response response;       // Reboot response message
 
+// Flight recorder dump: Service to freeze the recorder and publisher for the dump chunks
+rcl_service_t flight_dump_service;                    // Service to request a dump
+std_srvs__srv__Trigger_Request flight_dump_request;   // Dump request message
+std_srvs__srv__Trigger_Response flight_dump_response; // Dump response message
+rcl_publisher_t flight_dump_publisher;                // Publisher for dump chunks
+std_msgs__msg__UInt8MultiArray flight_dump_msg;       // Chunk of the header and records
+static bool flight_dump_active = false;               // True while chunks remain to be published
+static uint32_t flight_dump_next = 0;                 // Index of the next record to publish
+
+// Hardware e-stop: Service to re-arm the latched stop and publisher for trips and re-arms
+rcl_service_t estop_rearm_service;                    // Service to re-arm the e-stop
+std_srvs__srv__Trigger_Request estop_rearm_request;   // Re-arm request message
+std_srvs__srv__Trigger_Response estop_rearm_response; // Re-arm response message
+rcl_publisher_t estop_publisher;                      // Publisher for the e-stop summary
+std_msgs__msg__String estop_msg;                      // E-stop summary message
+
 // cmd_vel subscriber: Subscribes to velocity commands for the robot
 rcl_subscription_t cmd_vel_subscriber;     // Subscriber for velocity commands
-geometry_msgs__msg__Twist msg_sub;         // Message type for subscribing to velocity commands
+geometry_msgs__msg__TwistStamped msg_sub;  // Message type for subscribing to velocity commands
+SubscriptionStats cmdVelStats("cmd_vel");  // Received, out-of-order and stale velocity commands
+SubscriptionStats heartbeatStats("heartbeat"); // Received, lost and slow link pings
 
 // Velocity publisher: Publishes velocity commands as stamped messages
 rcl_publisher_t vel_publisher;             // Publisher for velocity data
 geometry_msgs__msg__TwistStamped vel_msg;  // Stamped message for velocity data
+rcl_publisher_t vel_cov_publisher;         // Publisher for velocity data with variance
+geometry_msgs__msg__TwistWithCovarianceStamped vel_cov_msg; // Same velocity with its variance
 
 // IMU publisher: Publishes IMU data to other components in the system
 rcl_publisher_t imu_publisher;             // Publisher for IMU data
 sensor_msgs__msg__Imu imu_msg;             // IMU message type
+rcl_publisher_t imu_batch_publisher;       // Publisher for batches of raw IMU samples
+std_msgs__msg__UInt8MultiArray imu_batch_msg; // Batch header and samples
+ImuBatch imuBatch;                         // Raw samples collected between two IMU publishes
 
-// Heartbeat publisher and subscriber: Monitors system health and connectivity
-rcl_publisher_t heartbeat_publisher;       // Publisher for heartbeat messages
-rcl_subscription_t heartbeat_subscriber;   // Subscriber for heartbeat messages
-std_msgs__msg__Int32 heartbeat_msg;        // Heartbeat message type
+// Diagnostics publisher: Publishes the achieved rate and jitter of the control streams
+rcl_publisher_t diagnostics_publisher;     // Publisher for stream statistics
+std_msgs__msg__String diagnostics_msg;     // Statistics summary message
+
+// Resource publisher: Publishes CPU load, stack and heap usage at a low rate
+rcl_publisher_t resource_publisher;        // Publisher for the resource summary
+std_msgs__msg__String resource_msg;        // Resource summary message
+
+// Motor status publisher: Driver faults and recoveries, published when the health changes
+rcl_publisher_t motor_status_publisher;    // Publisher for the motor supervisor summary
+std_msgs__msg__String motor_status_msg;    // Motor supervisor summary message
+
+// Rate selection publisher: Boot measurements and the stream periods chosen from them
+rcl_publisher_t rate_selection_publisher;  // Publisher for the rate calibration summary
+std_msgs__msg__String rate_selection_msg;  // Rate calibration summary message
+RateCalibration rateCalibration;           // Picks the stream periods from the boot measurements
+
+// Actuation latency publisher: Stage distributions from cmd_vel to the wheel responding
+rcl_publisher_t actuation_publisher;       // Publisher for the actuation latency summary
+std_msgs__msg__String actuation_msg;       // Actuation latency summary message
+
+#ifdef LEFT_WHEEL
+// Slip publisher: Events of the on-board slip and stall detector
+rcl_publisher_t slip_publisher;            // Publisher for the slip events
+std_msgs__msg__String slip_msg;            // Slip detector summary message
+#endif
 
-// Timer callback: Manages timing for regular updates in the system
-rcl_timer_t timer;                         // Timer for periodic updates
+// Heartbeat publisher and subscriber: Monitors system health and connectivity
+rcl_publisher_t heartbeat_publisher;       // Publisher for ping echoes
+rcl_subscription_t heartbeat_subscriber;   // Subscriber for host pings
+std_msgs__msg__Int32MultiArray heartbeat_ping_msg; // Received ping
+std_msgs__msg__Int32MultiArray heartbeat_msg;      // Echo of the ping
+
+// Link quality publisher: RTT, loss and cmd_vel gaps of each window
+rcl_publisher_t link_quality_publisher;    // Publisher for the link quality summary
+std_msgs__msg__String link_quality_msg;    // Link quality summary message
+LinkMonitor linkMonitor;                   // Link statistics, updated from both executor tasks
+
+// Control streams: IMU, wheel feedback and diagnostics run at independent rates
+StreamScheduler controlStreams;            // Scheduler polled by the control task
+VelocityEstimator velocityEstimator;       // Wheel speed from encoder positions, run by the wheel stream
 rcl_time_point_value_t current_time;       // Stores the current time point
 rcl_clock_t ros_clock;                     // Clock to manage system time
 
-// microROS node and executor: Core components for managing ROS 2 nodes and callbacks
-rclc_executor_t executor;                  // Executor for managing callbacks
+// microROS node and executors: Core components for managing ROS 2 nodes and callbacks
+rclc_executor_t control_executor;          // Executor for cmd_vel
+rclc_executor_t housekeeping_executor;     // Executor for com_check, services and parameters
 rclc_support_t support;                    // Support structure for the node
 rcl_allocator_t allocator;                 // Allocator for the node's resources
 rcl_node_t node;                           // The node itself
+rclc_parameter_server_t param_server;      // Parameter server for control tuning
+
+#ifdef TRANSPORT_BENCHMARK
+// Transport benchmark: Pings echoed by tools/transport_bench.py
+rcl_publisher_t bench_ping_publisher;      // Publisher for sequence-numbered pings
+rcl_subscription_t bench_echo_subscriber;  // Subscriber for echoed pings
+rcl_publisher_t bench_result_publisher;    // Publisher for benchmark summaries
+rcl_timer_t bench_timer;                   // Timer for ping bursts and reports
+std_msgs__msg__Int32 bench_ping_msg;       // Outgoing ping message
+std_msgs__msg__Int32 bench_echo_msg;       // Incoming echo message
+std_msgs__msg__String bench_result_msg;    // Outgoing summary message
+TransportBenchmark transportBenchmark;     // RTT and throughput statistics
+#endif
+
+// Executor tasks: Both executors share one micro-ROS session, so spins are serialized
+static SemaphoreHandle_t executor_mutex = NULL; // Serializes access to the micro-ROS session
+static volatile uint32_t cmd_vel_ready_us = 0;  // Time cmd_vel was seen ready by the executor
+static uint32_t cmd_vel_accepted_us = 0;        // Time of the last accepted cmd_vel
+static bool cmd_vel_moving = false;             // The last applied cmd_vel was not zero
+static float held_wheel_speed = 0.0f;           // Last wheel speed, published again after a missed reply
+static bool wheel_speed_valid = false;          // The wheel speed of this tick was measured
+LatencyStats cmdVelLatency;                     // cmd_vel ready-to-UART-write latency
+LatencyStats housekeepingSpinTime;              // Time the housekeeping task holds the session
+uint32_t housekeepingStallCount = 0;            // Session holds over EXECUTOR_STALL_BUDGET
 
 // Initialize microROS components and setup the ROS 2 node
 void setupMicroROS() {
-    // Initialize micro-ROS transports
-    set_microros_transports();
+    // Initialize the micro-ROS transport selected at build time or stored in NVS
+    setupTransport(selectTransport());
 
     // Initialize the default allocator for memory management
     allocator = rcl_get_default_allocator();
@@ -96,7 +241,7 @@ void setupMicroROS() {
     // Initialize ROS clock with ROS time and the default allocator
     rcl_ret_t rc = rcl_clock_init(RCL_ROS_TIME, &ros_clock, &allocator);
     if (rc != RCL_RET_OK) {
-        Serial.println("Failed to initialize ROS clock");
+        DEBUG_PRINTLN("Failed to initialize ROS clock");
         return;
     }
 
@@ -109,7 +254,10 @@ void setupMicroROS() {
     //RCCHECK(rclc_support_init_with_options(&support, 0, NULL, &init_options, &allocator)); // 前のrclc_support_initは削除する
     
     // Initialize the ROS node based on the wheel type (left or right)
-    RCCHECK(rclc_node_init_default(&node, NODE_NAME, "", &support));
+    RCCHECK(rclc_node_init_default(&node, NODE_NAME, NODE_NAMESPACE, &support));
+
+    // Synchronize with the agent's clock so cmd_vel stamps can be checked for staleness
+    syncAgentTime();
 
     // Call initialization functions of the ROS executor and the components for the node
     initializePublishers(&node);
@@ -118,34 +266,66 @@ void setupMicroROS() {
     #ifdef LEFT_WHEEL
         initializeIMU(&node);
     #endif
-    initializeTimer(&timer, &support);
-    initializeExecutor(&executor, &support, &allocator);
+    initializeStreams();
+    // Measure this board before the parameters are declared with the chosen periods
+    calibrateRates();
+    initializeParameterServer(&node);
+    #ifdef TRANSPORT_BENCHMARK
+        initializeTransportBenchmark(&node, &support);
+    #endif
+    initializeControlExecutor(&control_executor, &support, &allocator);
+    initializeHousekeepingExecutor(&housekeeping_executor, &support, &allocator);
+    declareParameters();
 }
 
 // Initialize Publishers
 void initializePublishers(rcl_node_t *node) {
     // Initialize Communication Check Publisher
-    RCCHECK(rclc_publisher_init_best_effort(
+    RCCHECK(rclc_publisher_init(
         &com_check_publisher,
         node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-        CONNECTION_RESPONSE_TOPIC
+        CONNECTION_RESPONSE_TOPIC,
+        qosProfile(CONNECTION_QOS)
     ));
 
     // Initialize Heartbeat Publisher
-    RCCHECK(rclc_publisher_init_best_effort(
+    RCCHECK(rclc_publisher_init(
         &heartbeat_publisher,
         node,
-        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-        HEARTBEAT_RESPONSE_TOPIC
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32MultiArray),
+        HEARTBEAT_RESPONSE_TOPIC,
+        qosProfile(HEARTBEAT_QOS)
+    ));
+
+    // Allocate buffer for the echo fields
+    static int32_t heartbeat_buffer[LINK_ECHO_FIELDS];
+    heartbeat_msg.data.data = heartbeat_buffer;
+    heartbeat_msg.data.size = 0;
+    heartbeat_msg.data.capacity = LINK_ECHO_FIELDS;
+
+    // Initialize Link Quality Publisher
+    RCCHECK(rclc_publisher_init(
+        &link_quality_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        LINK_QUALITY_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
     ));
 
+    // Allocate buffer for the summary string
+    static char link_quality_buffer[LINK_BUFFER_SIZE];
+    link_quality_msg.data.data = link_quality_buffer;
+    link_quality_msg.data.size = 0;
+    link_quality_msg.data.capacity = sizeof(link_quality_buffer);
+
     // Initialize Velocity Publisher based on wheel type
-    RCCHECK(rclc_publisher_init_best_effort(
+    RCCHECK(rclc_publisher_init(
         &vel_publisher,
         node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, TwistStamped),
-        VELOCITY_TOPIC
+        VELOCITY_TOPIC,
+        qosProfile(VELOCITY_QOS)
     ));
 
     // Initialize Velocity Message with default values
@@ -164,55 +344,223 @@ void initializePublishers(rcl_node_t *node) {
 
     strncpy(vel_msg.header.frame_id.data, vel_frame_id, sizeof(vel_msg.header.frame_id.data));
     vel_msg.header.frame_id.size = strlen(vel_frame_id);
+
+    // Initialize Velocity Publisher carrying the variance of the estimate
+    RCCHECK(rclc_publisher_init(
+        &vel_cov_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, TwistWithCovarianceStamped),
+        VELOCITY_COVARIANCE_TOPIC,
+        qosProfile(VELOCITY_QOS)
+    ));
+
+    // Only linear.x is measured, the other axes keep zero velocity and covariance
+    memset(&vel_cov_msg.twist, 0, sizeof(vel_cov_msg.twist));
+    vel_cov_msg.header.frame_id = vel_msg.header.frame_id;
+
+    // Initialize Diagnostics Publisher for the stream statistics
+    RCCHECK(rclc_publisher_init(
+        &diagnostics_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        DIAGNOSTICS_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char diagnostics_buffer[DIAGNOSTICS_BUFFER_SIZE];
+    diagnostics_msg.data.data = diagnostics_buffer;
+    diagnostics_msg.data.size = 0;
+    diagnostics_msg.data.capacity = sizeof(diagnostics_buffer);
+
+    // Initialize Resource Usage Publisher for the resource monitor
+    RCCHECK(rclc_publisher_init(
+        &resource_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        RESOURCE_USAGE_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char resource_buffer[MONITOR_BUFFER_SIZE];
+    resource_msg.data.data = resource_buffer;
+    resource_msg.data.size = 0;
+    resource_msg.data.capacity = sizeof(resource_buffer);
+
+    // Initialize Motor Status Publisher for the fault events of the supervisor
+    RCCHECK(rclc_publisher_init(
+        &motor_status_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        MOTOR_STATUS_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char motor_status_buffer[MOTOR_EVENT_BUFFER_SIZE];
+    motor_status_msg.data.data = motor_status_buffer;
+    motor_status_msg.data.size = 0;
+    motor_status_msg.data.capacity = sizeof(motor_status_buffer);
+
+    // Initialize Rate Selection Publisher for the boot calibration
+    RCCHECK(rclc_publisher_init(
+        &rate_selection_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        RATE_SELECTION_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char rate_selection_buffer[RATE_BUFFER_SIZE];
+    rate_selection_msg.data.data = rate_selection_buffer;
+    rate_selection_msg.data.size = 0;
+    rate_selection_msg.data.capacity = sizeof(rate_selection_buffer);
+
+    // Initialize Actuation Latency Publisher, published with the diagnostics
+    RCCHECK(rclc_publisher_init(
+        &actuation_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        ACTUATION_LATENCY_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char actuation_buffer[ACTUATION_BUFFER_SIZE];
+    actuation_msg.data.data = actuation_buffer;
+    actuation_msg.data.size = 0;
+    actuation_msg.data.capacity = sizeof(actuation_buffer);
+
+#ifdef LEFT_WHEEL
+    // Initialize Slip Publisher, published when the slip state changes
+    RCCHECK(rclc_publisher_init(
+        &slip_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        SLIP_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char slip_buffer[SLIP_EVENT_BUFFER_SIZE];
+    slip_msg.data.data = slip_buffer;
+    slip_msg.data.size = 0;
+    slip_msg.data.capacity = sizeof(slip_buffer);
+#endif
 }
 
 // Initialize Subscribers
 void initializeSubscribers(rcl_node_t *node) {
     // Initialize Communication Check Subscriber
-    RCCHECK(rclc_subscription_init_best_effort(
+    RCCHECK(rclc_subscription_init(
         &com_check_subscriber,
         node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-        CONNECTION_CHECK_TOPIC
+        CONNECTION_CHECK_TOPIC,
+        qosProfile(CONNECTION_QOS)
     ));
 
     // Initialize Heartbeat Subscriber
-    RCCHECK(rclc_subscription_init_best_effort(
+    RCCHECK(rclc_subscription_init(
         &heartbeat_subscriber,
         node,
-        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-        HEARTBEAT_TOPIC
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32MultiArray),
+        HEARTBEAT_TOPIC,
+        qosProfile(HEARTBEAT_QOS)
     ));
 
+    // Allocate buffer for the ping fields, extra fields from newer hosts are ignored
+    static int32_t heartbeat_ping_buffer[2 * LINK_PING_FIELDS];
+    heartbeat_ping_msg.data.data = heartbeat_ping_buffer;
+    heartbeat_ping_msg.data.size = 0;
+    heartbeat_ping_msg.data.capacity = 2 * LINK_PING_FIELDS;
+
     // Initialize cmd_vel Subscriber for velocity commands 
-    RCCHECK(rclc_subscription_init_best_effort(
+    RCCHECK(rclc_subscription_init(
         &cmd_vel_subscriber,
         node,
-        ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, Twist),
-        CMD_VEL_TOPIC
+        ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, TwistStamped),
+        CMD_VEL_TOPIC,
+        qosProfile(CMD_VEL_QOS)
     ));
+
+    // Allocate buffer for the received frame ID, longer IDs fail to deserialize
+    static char cmd_vel_frame_id_buffer[CMD_VEL_FRAME_ID_SIZE];
+    msg_sub.header.frame_id.data = cmd_vel_frame_id_buffer;
+    msg_sub.header.frame_id.size = 0;
+    msg_sub.header.frame_id.capacity = sizeof(cmd_vel_frame_id_buffer);
 }
 
 // Initialize Reboot Service Server
 void initializeServices(rcl_node_t *node) {
     // Reboot Service Server の初期化
-    RCCHECK(rclc_service_init_best_effort(
+    RCCHECK(rclc_service_init(
         &reboot_service,
         node,
         ROSIDL_GET_SRV_TYPE_SUPPORT(std_srvs, srv, Trigger),
-        REBOOT_SERVICE_NAME
+        REBOOT_SERVICE_NAME,
+        qosProfile(SERVICE_QOS)
+    ));
+
+    // Initialize Flight Recorder dump Service and chunk Publisher
+    RCCHECK(rclc_service_init(
+        &flight_dump_service,
+        node,
+        ROSIDL_GET_SRV_TYPE_SUPPORT(std_srvs, srv, Trigger),
+        FLIGHT_RECORDER_SERVICE_NAME,
+        qosProfile(SERVICE_QOS)
     ));
+    RCCHECK(rclc_publisher_init(
+        &flight_dump_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt8MultiArray),
+        FLIGHT_RECORDER_TOPIC,
+        qosProfile(FLIGHT_DUMP_QOS)
+    ));
+    // Bound the wait for acknowledgements, unconfirmed chunks are retransmitted by later spins
+    RCCHECK(rmw_uros_set_publisher_session_timeout(&flight_dump_publisher, FLIGHT_DUMP_PUBLISH_TIMEOUT));
+
+    // Allocate buffer for one chunk, the first chunk also carries the dump header
+    static uint8_t flight_dump_buffer[sizeof(FlightDumpHeader) + FLIGHT_DUMP_CHUNK_RECORDS * sizeof(FlightRecord)];
+    flight_dump_msg.data.data = flight_dump_buffer;
+    flight_dump_msg.data.size = 0;
+    flight_dump_msg.data.capacity = sizeof(flight_dump_buffer);
+
+    // Initialize E-stop re-arm Service and event Publisher
+    RCCHECK(rclc_service_init(
+        &estop_rearm_service,
+        node,
+        ROSIDL_GET_SRV_TYPE_SUPPORT(std_srvs, srv, Trigger),
+        ESTOP_REARM_SERVICE_NAME,
+        qosProfile(SERVICE_QOS)
+    ));
+    RCCHECK(rclc_publisher_init(
+        &estop_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        ESTOP_TOPIC,
+        qosProfile(STATUS_TOPIC_QOS)
+    ));
+
+    // Allocate buffer for the summary string
+    static char estop_buffer[ESTOP_BUFFER_SIZE];
+    estop_msg.data.data = estop_buffer;
+    estop_msg.data.size = 0;
+    estop_msg.data.capacity = sizeof(estop_buffer);
 }
 
 #ifdef LEFT_WHEEL
 // Initialize IMU Publisher and IMU Message for Left Wheel
 void initializeIMU(rcl_node_t *node) {
     // Initialize IMU data publisher for left wheel
-    RCCHECK(rclc_publisher_init_best_effort(
+    RCCHECK(rclc_publisher_init(
         &imu_publisher,
         node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(sensor_msgs, msg, Imu),
-        IMU_DATA_TOPIC
+        IMU_DATA_TOPIC,
+        qosProfile(IMU_QOS)
     ));
 
     // Set default covariance values for IMU data
@@ -231,27 +579,8 @@ void initializeIMU(rcl_node_t *node) {
     imu_msg.orientation_covariance[8] = 0.0001; // Variance for z-axis
     */
 
-    // Set covariance for angular velocity
-    imu_msg.angular_velocity_covariance[0] = 0.05;  // Variance for x-axis
-    imu_msg.angular_velocity_covariance[1] = 0.0;
-    imu_msg.angular_velocity_covariance[2] = 0.0;
-    imu_msg.angular_velocity_covariance[3] = 0.0;
-    imu_msg.angular_velocity_covariance[4] = 0.05;  // Variance for y-axis
-    imu_msg.angular_velocity_covariance[5] = 0.0;
-    imu_msg.angular_velocity_covariance[6] = 0.0;
-    imu_msg.angular_velocity_covariance[7] = 0.0;
-    imu_msg.angular_velocity_covariance[8] = 0.05;  // Variance for z-axis
-
-    // Set covariance for linear acceleration
-    imu_msg.linear_acceleration_covariance[0] = 0.2;  // Variance for x-axis
-    imu_msg.linear_acceleration_covariance[1] = 0.0;
-    imu_msg.linear_acceleration_covariance[2] = 0.0;
-    imu_msg.linear_acceleration_covariance[3] = 0.0;
-    imu_msg.linear_acceleration_covariance[4] = 0.2;  // Variance for y-axis
-    imu_msg.linear_acceleration_covariance[5] = 0.0;
-    imu_msg.linear_acceleration_covariance[6] = 0.0;
-    imu_msg.linear_acceleration_covariance[7] = 0.0;
-    imu_msg.linear_acceleration_covariance[8] = 0.2;  // Variance for z-axis
+    // Set covariance for angular velocity and linear acceleration
+    applyImuCovariances();
 
     // Allocate buffer for IMU Frame ID and set it
     static char imu_frame_id_buffer[256];
@@ -260,44 +589,347 @@ void initializeIMU(rcl_node_t *node) {
     const char* imu_frame_id = IMU_FRAME_ID;
     strncpy(imu_msg.header.frame_id.data, imu_frame_id, sizeof(imu_msg.header.frame_id.data));
     imu_msg.header.frame_id.size = strlen(imu_frame_id);
+
+    // Initialize the raw batch publisher, used instead of the IMU message with imu_format 1
+    RCCHECK(rclc_publisher_init(
+        &imu_batch_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt8MultiArray),
+        IMU_BATCH_TOPIC,
+        qosProfile(IMU_BATCH_QOS)
+    ));
+
+    // Allocate buffer for the largest batch
+    static uint8_t imu_batch_buffer[IMU_BATCH_BUFFER_SIZE];
+    imu_batch_msg.data.data = imu_batch_buffer;
+    imu_batch_msg.data.size = 0;
+    imu_batch_msg.data.capacity = sizeof(imu_batch_buffer);
+
+    // The converter scales and calibrates the counts with what the sensor was set up with
+    int16_t offset[6];
+    uint16_t accel_range_g, gyro_range_dps;
+    imuManager.getRawCalibration(offset, accel_range_g, gyro_range_dps);
+    imuBatch.configure(accel_range_g, gyro_range_dps, offset);
+    imuBatch.setPeriod(controlParams.imu_sample_period_ms * 1000);
+}
+#endif
+
+// Sets the diagonal IMU covariances from the control parameters
+void applyImuCovariances() {
+    for (int i = 0; i < 9; i++) {
+        imu_msg.angular_velocity_covariance[i] = 0.0;
+        imu_msg.linear_acceleration_covariance[i] = 0.0;
+    }
+    for (int i = 0; i < 9; i += 4) {
+        imu_msg.angular_velocity_covariance[i] = controlParams.gyro_covariance;  // Variance for x, y and z axes
+        imu_msg.linear_acceleration_covariance[i] = controlParams.accel_covariance;
+    }
+}
+
+// Register the periodic control streams.
+// Phase offsets keep the I2C read of the IMU and the UART exchange with the
+// motor from landing in the same poll of the control task.
+void initializeStreams() {
+#ifdef LEFT_WHEEL
+    controlStreams.configureStream(STREAM_IMU_SAMPLE, "imu_sample",
+        controlParams.imu_sample_period_ms * 1000, IMU_SAMPLE_PHASE, imu_sample_callback);
+    controlStreams.configureStream(STREAM_IMU_PUBLISH, "imu_publish",
+        controlParams.imu_publish_period_ms * 1000, IMU_PUBLISH_PHASE, imu_publish_callback);
+#endif
+    controlStreams.configureStream(STREAM_WHEEL, "wheel",
+        controlParams.wheel_period_ms * 1000, WHEEL_PHASE, wheel_callback);
+    controlStreams.configureStream(STREAM_DIAGNOSTICS, "diagnostics",
+        controlParams.diagnostics_period_ms * 1000, DIAGNOSTICS_PHASE, diagnostics_callback);
+}
+
+// Longest round trip of a speed read to the driver in microseconds, 0 if it did not reply.
+// Busy-waits for the reply, the resolution of receiveMotorFrame() is a millisecond.
+static uint32_t measureMotorRoundTrip() {
+    uint32_t longest = 0;
+    uint32_t timeout_us = controlParams.motor_reply_timeout_ms * 1000;
+    for (int i = 0; i < RATE_CALIBRATION_SAMPLES; i++) {
+        while (motorSerial.available() > 0) {
+            motorSerial.read();  // Drop replies of earlier requests
+        }
+        uint32_t start = micros();
+        motorController.sendFrame(SPEED_READ_FRAME);
+        while (motorSerial.available() < (int)MOTOR_FRAME_SIZE) {
+            if (micros() - start > timeout_us) {
+                return 0;
+            }
+        }
+        uint32_t elapsed = micros() - start;
+        uint8_t reply[MOTOR_FRAME_SIZE];
+        motorSerial.readBytes(reply, MOTOR_FRAME_SIZE);
+        flightRecorder.recordMotorFrame(FLIGHT_MOTOR_RX, reply);
+        captureStream.recordMotorFrame(CAPTURE_MOTOR_RX, reply);
+        int32_t speed;
+        if (!decodeMotorReadReply<ActualSpeedRegister>(reply, MOTOR_ID, speed)) {
+            return 0;
+        }
+        longest = elapsed > longest ? elapsed : longest;
+    }
+    return longest > 0 ? longest : 1;  // 0 is reserved for a missing reply
+}
+
+// Fastest agent ping round trip in microseconds, 0 if the agent did not reply
+static uint32_t measureAgentRoundTrip() {
+    uint32_t fastest = 0;
+    for (int i = 0; i < RATE_CALIBRATION_PINGS; i++) {
+        uint32_t start = micros();
+        if (rmw_uros_ping_agent(RATE_PING_TIMEOUT, 1) != RMW_RET_OK) {
+            continue;
+        }
+        uint32_t elapsed = micros() - start;
+        elapsed = elapsed > 0 ? elapsed : 1;  // 0 is reserved for a missing reply
+        fastest = fastest == 0 || elapsed < fastest ? elapsed : fastest;
+    }
+    return fastest;
+}
+
+// Publishes RATE_CALIBRATION_SAMPLES messages, each after prepare() refreshed
+// it, then pings the agent. The ping reply queues behind the messages, so the
+// elapsed time minus the bare ping round trip is the link time of the messages.
+// Returns false if the agent did not answer the ping.
+static bool measurePublish(void (*prepare)(), void (*publish)(), uint32_t agent_rtt_us,
+                           uint32_t &cpu_us, uint32_t &link_us) {
+    uint32_t prepare_total = 0;
+    uint32_t publish_total = 0;
+    uint32_t start = micros();
+    for (int i = 0; i < RATE_CALIBRATION_SAMPLES; i++) {
+        uint32_t prepared = micros();
+        prepare();
+        uint32_t published = micros();
+        publish();
+        prepare_total += published - prepared;
+        publish_total += micros() - published;
+    }
+    bool delivered = rmw_uros_ping_agent(RATE_PING_TIMEOUT, 1) == RMW_RET_OK;
+    uint32_t elapsed = micros() - start - prepare_total;
+    cpu_us = publish_total / RATE_CALIBRATION_SAMPLES;
+    link_us = (elapsed > agent_rtt_us ? elapsed - agent_rtt_us : 0) / RATE_CALIBRATION_SAMPLES;
+    link_us = link_us > cpu_us ? link_us : cpu_us;
+    return delivered;
+}
+
+static void prepareWheelTick() {
+    updateCurrentTime();
+    updateWheelSpeed();
+}
+
+static void publishWheelTick() {
+    RCSOFTCHECK(rcl_publish(&vel_publisher, &vel_msg, NULL));
+    RCSOFTCHECK(rcl_publish(&vel_cov_publisher, &vel_cov_msg, NULL));
+}
+
+#ifdef LEFT_WHEEL
+static void prepareImuMessage() {
+    updateCurrentTime();
+    imuManager.update();
+    updateIMUData();
+}
+
+// The filtered message is measured in both IMU formats, a batch of the
+// default four samples is smaller
+static void publishImuMessage() {
+    RCSOFTCHECK(rcl_publish(&imu_publisher, &imu_msg, NULL));
+}
+
+// Longest IMU read and filter update in microseconds
+static uint32_t measureImuRead() {
+    uint32_t longest = 0;
+    for (int i = 0; i < RATE_CALIBRATION_SAMPLES; i++) {
+        uint32_t start = micros();
+        imuManager.update();
+        uint32_t elapsed = micros() - start;
+        longest = elapsed > longest ? elapsed : longest;
+    }
+    return longest;
 }
 #endif
 
-// Initialize Timer for periodic callbacks
-void initializeTimer(rcl_timer_t *timer, rclc_support_t *support) {
-    const unsigned int timer_timeout = TIMER_INTERVAL;
+// Applies a calibrated period through the same path as a parameter change, without saving it
+static void applyCalibratedPeriod(const char *name, uint32_t period_ms) {
+    if (setControlParameter(name, period_ms)) {
+        applyControlParameter(name);
+    }
+}
+
+// Boot-time rate calibration: measures the motor UART round trip, the IMU read
+// and the publish round trip to the agent, then runs the streams at the fastest
+// periods within the CPU and link budgets. Must run before the executor tasks start.
+void calibrateRates() {
+    if (!controlParams.auto_rates) {
+        return;
+    }
+    RateMeasurements m = {};
+    m.motor_rtt_us = measureMotorRoundTrip();
+    m.agent_rtt_us = measureAgentRoundTrip();
+    bool has_imu = false;
+    if (m.agent_rtt_us != 0 &&
+        !measurePublish(prepareWheelTick, publishWheelTick, m.agent_rtt_us, m.wheel_cpu_us, m.wheel_link_us)) {
+        m.agent_rtt_us = 0;
+    }
+#ifdef LEFT_WHEEL
+    has_imu = true;
+    m.imu_read_us = measureImuRead();
+    if (m.agent_rtt_us != 0 &&
+        !measurePublish(prepareImuMessage, publishImuMessage, m.agent_rtt_us, m.imu_cpu_us, m.imu_link_us)) {
+        m.agent_rtt_us = 0;
+    }
+#endif
+
+    rateCalibration.configure(controlParams.rate_cpu_budget_pct, controlParams.rate_link_budget_pct,
+                              MOTOR_FRAME_TX_US, has_imu);
+    if (rateCalibration.select(m)) {
+        // Kept in RAM, the stored periods remain the fallback when a measurement fails
+        const RateLevel &rates = rateCalibration.selection().rates;
+        applyCalibratedPeriod(PARAM_WHEEL_PERIOD, rates.wheel_ms);
+#ifdef LEFT_WHEEL
+        applyCalibratedPeriod(PARAM_IMU_SAMPLE_PERIOD, rates.imu_sample_ms);
+        applyCalibratedPeriod(PARAM_IMU_PUBLISH_PERIOD, rates.imu_publish_ms);
+#endif
+    }
+
+    rate_selection_msg.data.size = rateCalibration.summarize(rate_selection_msg.data.data,
+                                                             rate_selection_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&rate_selection_publisher, &rate_selection_msg, NULL));
+    DEBUG_PRINTF("Rate calibration: %s\n", rate_selection_msg.data.data);
+    LCD_PRINTF("Wheel period %u ms\n", (unsigned)controlParams.wheel_period_ms);
+#ifdef LEFT_WHEEL
+    LCD_PRINTF("IMU periods %u/%u ms\n", (unsigned)controlParams.imu_sample_period_ms,
+                  (unsigned)controlParams.imu_publish_period_ms);
+#endif
+}
+
+#ifdef TRANSPORT_BENCHMARK
+// Initialize the transport benchmark publishers, subscriber and timer
+void initializeTransportBenchmark(rcl_node_t *node, rclc_support_t *support) {
+    RCCHECK(rclc_publisher_init_best_effort(
+        &bench_ping_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
+        BENCH_PING_TOPIC
+    ));
+
+    RCCHECK(rclc_subscription_init_best_effort(
+        &bench_echo_subscriber,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
+        BENCH_ECHO_TOPIC
+    ));
+
+    RCCHECK(rclc_publisher_init_default(
+        &bench_result_publisher,
+        node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String),
+        BENCH_RESULT_TOPIC
+    ));
+
     RCCHECK(rclc_timer_init_default(
-        timer,
+        &bench_timer,
         support,
-        RCL_MS_TO_NS(timer_timeout),
-        timer_callback
+        RCL_MS_TO_NS(BENCH_PING_PERIOD),
+        bench_timer_callback
     ));
+
+    // Allocate buffer for the summary string
+    static char bench_result_buffer[256];
+    bench_result_msg.data.data = bench_result_buffer;
+    bench_result_msg.data.size = 0;
+    bench_result_msg.data.capacity = sizeof(bench_result_buffer);
+
+    transportBenchmark.reset(micros());
+}
+#endif
+
+// Initialize the parameter server for the runtime-tunable control parameters
+void initializeParameterServer(rcl_node_t *node) {
+    const rclc_parameter_options_t options = {
+        .notify_changed_over_dds = true,
+        .max_params = controlParameterCount(),
+        .allow_undeclared_parameters = false,
+        .low_mem_mode = false
+    };
+    RCCHECK(rclc_parameter_server_init_with_option(&param_server, node, &options));
+}
+
+// Declares every control parameter with its current value.
+// Must run after the parameter server has been added to an executor.
+void declareParameters() {
+    for (size_t i = 0; i < controlParameterCount(); i++) {
+        const ControlParameterInfo &info = controlParameterInfo(i);
+        if (info.integer) {
+            RCCHECK(rclc_add_parameter(&param_server, info.name, RCLC_PARAMETER_INT));
+            RCCHECK(rclc_parameter_set_int(&param_server, info.name, (int64_t)controlParameterValue(i)));
+        } else {
+            RCCHECK(rclc_add_parameter(&param_server, info.name, RCLC_PARAMETER_DOUBLE));
+            RCCHECK(rclc_parameter_set_double(&param_server, info.name, controlParameterValue(i)));
+        }
+    }
 }
 
-// Initialize the Executor with the number of callbacks
-void initializeExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator) {
-    int callback_size = 4;	// Number of callbacks to handle
+// Initialize the latency-critical executor with cmd_vel and the link pings
+void initializeControlExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator) {
+    int callback_size = 2;	// Number of callbacks to handle
+#ifdef TRANSPORT_BENCHMARK
+    callback_size += 2;	// Echo subscriber and ping timer
+#endif
     *executor = rclc_executor_get_zero_initialized_executor();
     RCCHECK(rclc_executor_init(executor, &support->context, callback_size, allocator));
 
-    // Add Communication Check Subscriber to Executor
+    // Add cmd_vel Subscriber to Executor
     RCCHECK(rclc_executor_add_subscription(
         executor,
-        &com_check_subscriber,
-        &com_req_msg,
-        &com_check_callback,
+        &cmd_vel_subscriber,
+        &msg_sub,
+        &subscription_callback,
         ON_NEW_DATA
     ));
 
-    // Add Heartbeat Subscriber to Executor
+    // Add Heartbeat Subscriber, pings then measure the same path as cmd_vel
     RCCHECK(rclc_executor_add_subscription(
         executor,
         &heartbeat_subscriber,
-        &heartbeat_msg,
+        &heartbeat_ping_msg,
         &heartbeat_callback,
         ON_NEW_DATA
     ));
 
+#ifdef TRANSPORT_BENCHMARK
+    // Add benchmark echo Subscriber and ping Timer to Executor
+    RCCHECK(rclc_executor_add_subscription(
+        executor,
+        &bench_echo_subscriber,
+        &bench_echo_msg,
+        &bench_echo_callback,
+        ON_NEW_DATA
+    ));
+    RCCHECK(rclc_executor_add_timer(
+        executor,
+        &bench_timer
+    ));
+#endif
+
+    // Fire as soon as any handle has data and timestamp cmd_vel arrival
+    RCCHECK(rclc_executor_set_trigger(executor, cmd_vel_trigger, NULL));
+}
+
+// Initialize the housekeeping executor with com_check and the services
+void initializeHousekeepingExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_allocator_t *allocator) {
+    int callback_size = 4 + RCLC_EXECUTOR_PARAMETER_SERVER_HANDLES;	// Number of callbacks to handle
+    *executor = rclc_executor_get_zero_initialized_executor();
+    RCCHECK(rclc_executor_init(executor, &support->context, callback_size, allocator));
+
+    // Add Communication Check Subscriber to Executor
+    RCCHECK(rclc_executor_add_subscription(
+        executor,
+        &com_check_subscriber,
+        &com_req_msg,
+        &com_check_callback,
+        ON_NEW_DATA
+    ));
+
     // Add Reboot Service to Executor
     RCCHECK(rclc_executor_add_service(
         executor,
@@ -307,41 +939,367 @@ void initializeExecutor(rclc_executor_t *executor, rclc_support_t *support, rcl_
         &reboot_callback
     ));
 
-    // Add cmd_vel Subscriber to Executor
-    RCCHECK(rclc_executor_add_subscription(
+    // Add Flight Recorder dump Service to Executor
+    RCCHECK(rclc_executor_add_service(
         executor,
-        &cmd_vel_subscriber,
-        &msg_sub,
-        &subscription_callback,
-        ON_NEW_DATA
+        &flight_dump_service,
+        &flight_dump_request,
+        &flight_dump_response,
+        &flight_dump_callback
     ));
 
-    // Add Timer to Executor
-    RCCHECK(rclc_executor_add_timer(
+    // Add E-stop re-arm Service to Executor
+    RCCHECK(rclc_executor_add_service(
         executor,
-        &timer
+        &estop_rearm_service,
+        &estop_rearm_request,
+        &estop_rearm_response,
+        &estop_rearm_callback
     ));
+
+    // Add Parameter Server to Executor
+    RCCHECK(rclc_executor_add_parameter_server_with_context(
+        executor,
+        &param_server,
+        on_parameter_changed,
+        NULL
+    ));
+}
+
+// Trigger condition for the control executor.
+// Behaves like rclc_executor_trigger_any, and additionally records when cmd_vel
+// became ready so the receive-to-UART latency can be measured.
+bool cmd_vel_trigger(rclc_executor_handle_t *handles, unsigned int size, void *obj) {
+    RCLC_UNUSED(obj);
+    bool triggered = false;
+    for (unsigned int i = 0; i < size && handles[i].initialized; i++) {
+        if (!handles[i].data_available) {
+            continue;
+        }
+        triggered = true;
+        if (handles[i].type == RCLC_SUBSCRIPTION && handles[i].subscription == &cmd_vel_subscriber) {
+            cmd_vel_ready_us = micros();
+        }
+    }
+    return triggered;
+}
+
+// Create the mutex and start both executor tasks
+void startExecutorTasks() {
+    executor_mutex = xSemaphoreCreateMutex();
+    if (executor_mutex == NULL) {
+        DEBUG_PRINTLN("Failed to create executor mutex");
+        return;
+    }
+
+    controlStreams.start(micros());
+    xTaskCreatePinnedToCore(controlExecutorTask, "control_exec", EXECUTOR_TASK_STACK_SIZE,
+                            NULL, CONTROL_TASK_PRIORITY, NULL, CONTROL_TASK_CORE);
+    xTaskCreatePinnedToCore(housekeepingExecutorTask, "housekeeping_exec", EXECUTOR_TASK_STACK_SIZE,
+                            NULL, HOUSEKEEPING_TASK_PRIORITY, NULL, HOUSEKEEPING_TASK_CORE);
 }
 
-// Reboot device upon receiving a reboot command
+// High-priority task: runs due control streams and waits for cmd_vel until the next one
+void controlExecutorTask(void *param) {
+    RCLC_UNUSED(param);
+    for (;;) {
+        xSemaphoreTake(executor_mutex, portMAX_DELAY);
+        uint32_t wait_ms = controlStreams.poll(micros()) / 1000;
+        handleExecutorSpin(&control_executor, wait_ms < CONTROL_SPIN_TIMEOUT ? wait_ms : CONTROL_SPIN_TIMEOUT);
+        controlStreams.poll(micros());
+        xSemaphoreGive(executor_mutex);
+
+        // Give the housekeeping task a chance to take the session
+        vTaskDelay(1);
+    }
+}
+
+// Low-priority task: processes pending housekeeping callbacks without waiting
+void housekeepingExecutorTask(void *param) {
+    RCLC_UNUSED(param);
+    unsigned long last_report_time = millis();
+    unsigned long last_monitor_time = millis();
+    unsigned long last_sync_time = millis();
+    for (;;) {
+        // Sample the task list outside the session lock, it briefly suspends the scheduler
+        bool monitor_due = millis() - last_monitor_time >= MONITOR_PERIOD;
+        if (monitor_due) {
+            resourceMonitor.sample();
+            last_monitor_time = millis();
+        }
+
+        xSemaphoreTake(executor_mutex, portMAX_DELAY);
+        // Everything up to the release blocks the control task, so all of it is measured.
+        // Service callbacks defer their slow part, so this stays within EXECUTOR_STALL_BUDGET
+        // except for the clock synchronization, which waits up to TIME_SYNC_TIMEOUT.
+        unsigned long hold_start = micros();
+        handleExecutorSpin(&housekeeping_executor, 0);
+        publishFlightDumpChunk();
+        updateLinkQuality();
+        if (millis() - last_sync_time >= TIME_SYNC_PERIOD) {
+            syncAgentTime(); // Correct the drift of the board clock
+            last_sync_time = millis();
+        }
+        if (monitor_due) {
+            publishResourceUsage();
+        }
+        uint32_t hold_us = micros() - hold_start;
+        xSemaphoreGive(executor_mutex);
+
+        housekeepingSpinTime.record(hold_us);
+        if (hold_us > EXECUTOR_STALL_BUDGET) {
+            housekeepingStallCount++;
+            flightRecorder.recordError(FLIGHT_SOURCE_EXECUTOR_STALL, (int32_t)hold_us);
+        }
+
+        // Periodically print the cmd_vel latency statistics
+        if (millis() - last_report_time >= LATENCY_REPORT_INTERVAL) {
+            reportLatencyStats();
+            last_report_time = millis();
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(HOUSEKEEPING_SPIN_PERIOD));
+    }
+}
+
+// Prints and resets the cmd_vel latency and housekeeping hold statistics
+void reportLatencyStats() {
+    if (housekeepingSpinTime.count > 0) {
+        DEBUG_PRINTF("housekeeping hold [us] n=%u avg=%u max=%u over_budget=%u\n",
+                      housekeepingSpinTime.count, housekeepingSpinTime.average(),
+                      housekeepingSpinTime.max_us, housekeepingStallCount);
+        housekeepingSpinTime.reset();
+    }
+    if (cmdVelLatency.count == 0) {
+        return;
+    }
+    DEBUG_PRINTF("cmd_vel latency [us] n=%u min=%u avg=%u max=%u\n",
+                  cmdVelLatency.count, cmdVelLatency.min_us,
+                  cmdVelLatency.average(), cmdVelLatency.max_us);
+    cmdVelLatency.reset();
+}
+
+// Closes link quality windows and holds the wheels while the link is degraded
+void updateLinkQuality() {
+    linkMonitor.configure(controlParams.link_max_rtt_ms * 1000, controlParams.link_max_loss_pct * 10,
+                          controlParams.link_timeout_ms * 1000);
+    bool was_degraded = linkMonitor.isDegraded();
+    if (linkMonitor.evaluate(micros())) {
+        const LinkWindowStats &w = linkMonitor.stats();
+        heartbeatStats.add(w.pings, w.lost, w.late);
+
+        // Link window followed by the subscription counters since boot
+        char *buf = link_quality_msg.data.data;
+        size_t len = link_quality_msg.data.capacity;
+        size_t used = linkMonitor.summarize(buf, len);
+        if (used + 1 < len) {
+            buf[used++] = ' ';
+            used += cmdVelStats.summarize(buf + used, len - used);
+        }
+        if (used + 1 < len) {
+            buf[used++] = ' ';
+            used += heartbeatStats.summarize(buf + used, len - used);
+        }
+        link_quality_msg.data.size = used;
+        RCSOFTCHECK(rcl_publish(&link_quality_publisher, &link_quality_msg, NULL));
+    }
+
+    bool degraded = linkMonitor.isDegraded();
+    if (degraded && !was_degraded) {
+        inhibitMotors(MOTOR_INHIBIT_LINK);
+        flightRecorder.recordFault(FLIGHT_SOURCE_LINK, 1);
+        DEBUG_PRINTLN("Link degraded, motors stopped");
+    } else if (!degraded && was_degraded) {
+        releaseMotors(MOTOR_INHIBIT_LINK);
+        flightRecorder.recordError(FLIGHT_SOURCE_LINK, 0);
+        DEBUG_PRINTLN("Link recovered");
+    }
+}
+
+// Synchronizes the epoch clock with the agent, cmd_vel staleness is not checked until it succeeds
+void syncAgentTime() {
+    if (rmw_uros_sync_session(TIME_SYNC_TIMEOUT) != RMW_RET_OK && !rmw_uros_epoch_synchronized()) {
+        DEBUG_PRINTLN("Agent time sync failed, cmd_vel staleness is not checked");
+    }
+}
+
+// Publishes the resource summary and prints warnings when they change
+void publishResourceUsage() {
+    static uint32_t last_warnings = 0;
+    resource_msg.data.size = resourceMonitor.summarize(resource_msg.data.data, resource_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&resource_publisher, &resource_msg, NULL));
+
+    uint32_t warnings = resourceMonitor.warnings();
+    if (warnings != last_warnings && warnings != 0) {
+        DEBUG_PRINTF("Resource warning: %s\n", resource_msg.data.data);
+    }
+    last_warnings = warnings;
+}
+
+// Reboot device upon receiving a reboot command. The response is sent when
+// this returns; the restart itself runs on the deferred work task.
 void reboot_callback(const void * request, void * response) {
-    // Cast request and response to appropriate service message types
-    std_srvs__srv__Trigger_Request *req = (std_srvs__srv__Trigger_Request *)request;
+    RCLC_UNUSED(request);
     std_srvs__srv__Trigger_Response *res = (std_srvs__srv__Trigger_Response *)response;
 
-    // Log receipt of the reboot command    
-    Serial.println("Reboot command received.");
-    
-    // Attempt to set the response message
+    // Log receipt of the reboot command
+    DEBUG_PRINTLN("Reboot command received.");
+
+    static char message_buffer[64];
+    res->success = deferWork("reboot", rebootNow, 0, true);
+    res->message.data = message_buffer;
+    res->message.size = snprintf(message_buffer, sizeof(message_buffer), "%s", res->success ?
+                                 "Stopping motors and rebooting" : "Busy, reboot not scheduled");
+    res->message.capacity = sizeof(message_buffer);
+}
+
+// Deferred part of the reboot, runs after the motors were stopped
+void rebootNow(uint32_t arg) {
+    RCLC_UNUSED(arg);
+    // Leave time for the service response to reach the agent
+    delay(REBOOT_DELAY);
+    ESP.restart(); // Perform system restart
+}
+
+// Deferred NVS write of an accepted parameter, index from controlParameterIndex()
+void saveParameterNow(uint32_t arg) {
+    saveControlParameter(arg);
+}
+
+// Commands zero velocity and ignores cmd_vel until resumeMotors()
+void stopMotors() {
+    if (executor_mutex != NULL) {
+        xSemaphoreTake(executor_mutex, portMAX_DELAY);
+    }
+    inhibitMotors(MOTOR_INHIBIT_DEFERRED);
+    if (executor_mutex != NULL) {
+        xSemaphoreGive(executor_mutex);
+    }
+}
+
+// Accepts cmd_vel again; the wheels stay stopped until the next command
+void resumeMotors() {
+    releaseMotors(MOTOR_INHIBIT_DEFERRED);
+}
+
+// Validates a parameter change, rejecting it if the value is out of bounds.
+// Accepted values are stored in NVS and applied immediately.
+bool on_parameter_changed(const Parameter * old_param, const Parameter * new_param, void * context) {
+    RCLC_UNUSED(old_param);
+    RCLC_UNUSED(context);
+
+    // Parameters cannot be deleted
+    if (new_param == NULL) {
+        return false;
+    }
+
+    double value;
+    switch (new_param->value.type) {
+    case RCLC_PARAMETER_INT:
+        value = (double)new_param->value.integer_value;
+        break;
+    case RCLC_PARAMETER_DOUBLE:
+        value = new_param->value.double_value;
+        break;
+    default:
+        return false;
+    }
+
+    if (!setControlParameter(new_param->name.data, value)) {
+        DEBUG_PRINTF("Rejected parameter %s = %f\n", new_param->name.data, value);
+        return false;
+    }
+    applyControlParameter(new_param->name.data);
+
+    // Flash writes can take milliseconds, persist from the deferred work task
+    deferWork("save_parameter", saveParameterNow, (uint32_t)controlParameterIndex(new_param->name.data), false);
+    return true;
+}
+
+// Applies side effects of a changed parameter; values read on every use need nothing here
+void applyControlParameter(const char *name) {
+    // Streams are rescheduled under the executor mutex held by the housekeeping spin
+    if (strcmp(name, PARAM_IMU_SAMPLE_PERIOD) == 0) {
+        controlStreams.setPeriod(STREAM_IMU_SAMPLE, controlParams.imu_sample_period_ms * 1000);
+        imuManager.requestFilterUpdate();  // The filters are designed for the sample rate
+        imuBatch.setPeriod(controlParams.imu_sample_period_ms * 1000);
+    } else if (strcmp(name, PARAM_IMU_PUBLISH_PERIOD) == 0) {
+        controlStreams.setPeriod(STREAM_IMU_PUBLISH, controlParams.imu_publish_period_ms * 1000);
+    } else if (strcmp(name, PARAM_WHEEL_PERIOD) == 0) {
+        controlStreams.setPeriod(STREAM_WHEEL, controlParams.wheel_period_ms * 1000);
+    } else if (strcmp(name, PARAM_DIAGNOSTICS_PERIOD) == 0) {
+        controlStreams.setPeriod(STREAM_DIAGNOSTICS, controlParams.diagnostics_period_ms * 1000);
+    } else if (strcmp(name, PARAM_ACCEL_CUTOFF) == 0 || strcmp(name, PARAM_GYRO_CUTOFF) == 0 ||
+               strcmp(name, PARAM_NOTCH_FREQUENCY) == 0 || strcmp(name, PARAM_NOTCH_Q) == 0) {
+        imuManager.requestFilterUpdate();
+    } else if (strcmp(name, PARAM_GYRO_COVARIANCE) == 0 || strcmp(name, PARAM_ACCEL_COVARIANCE) == 0) {
+        applyImuCovariances();
+    } else if (strcmp(name, PARAM_VELOCITY_SOURCE) == 0) {
+        velocityEstimator.reset();  // Restart from the next position sample
+    } else if (strcmp(name, PARAM_IMU_FORMAT) == 0) {
+        imuBatch.clear();  // Start the first batch with the next sample
+    } else if (strcmp(name, PARAM_CAPTURE_MASK) == 0) {
+        captureStream.setMask((uint8_t)controlParams.capture_mask);
+    }
+}
+
+// Re-arms a latched e-stop once every input is released. The driver is
+// enabled by the next wheel stream tick, the outcome is published on the e-stop topic.
+void estop_rearm_callback(const void * request, void * response) {
+    RCLC_UNUSED(request);
+    std_srvs__srv__Trigger_Response *res = (std_srvs__srv__Trigger_Response *)response;
+
+    static char message_buffer[64];
+    res->success = requestEmergencyStopRearm();
+    res->message.data = message_buffer;
+    res->message.size = snprintf(message_buffer, sizeof(message_buffer), "%s",
+                                 res->success ? "Re-arming" :
+                                 !emergencyStop.isLatched() ? "Not tripped" :
+                                 emergencyStop.rearmPending() ? "Re-arm pending" : "E-stop input still active");
+    res->message.capacity = sizeof(message_buffer);
+}
+
+// Freezes the flight recorder and starts publishing its contents in chunks
+void flight_dump_callback(const void * request, void * response) {
+    RCLC_UNUSED(request);
+    std_srvs__srv__Trigger_Response *res = (std_srvs__srv__Trigger_Response *)response;
+
+    // Already frozen when a fault stopped the recording, resumed once the dump is published
+    flightRecorder.freeze();
+    flight_dump_next = 0;
+    flight_dump_active = true;
+
+    static char message_buffer[64];
     res->success = true;
-    if (!ROSIDL_RUNTIME_C__STRING_H_(&res->message, "Rebooting in 5 seconds...")) {
-        Serial.println("Failed to assign reboot message.");
-        res->success = false; // Ensure the response reflects the failure
+    res->message.data = message_buffer;
+    res->message.size = snprintf(message_buffer, sizeof(message_buffer),
+                                 "Dumping %u records", (unsigned)flightRecorder.recordCount());
+    res->message.capacity = sizeof(message_buffer);
+}
+
+// Publishes the next dump chunk, called from the housekeeping task
+void publishFlightDumpChunk() {
+    if (!flight_dump_active) {
+        return;
+    }
+
+    size_t offset = 0;
+    if (flight_dump_next == 0) {
+        FlightDumpHeader hdr = flightRecorder.header();
+        memcpy(flight_dump_msg.data.data, &hdr, sizeof(hdr));
+        offset = sizeof(hdr);
+    }
+    size_t copied = flightRecorder.copyRecords(
+        flight_dump_next, (FlightRecord *)(flight_dump_msg.data.data + offset), FLIGHT_DUMP_CHUNK_RECORDS);
+    flight_dump_msg.data.size = offset + copied * sizeof(FlightRecord);
+    flight_dump_next += copied;
+
+    RCSOFTCHECK(rcl_publish(&flight_dump_publisher, &flight_dump_msg, NULL));
+
+    if (flight_dump_next >= flightRecorder.recordCount()) {
+        flight_dump_active = false;
+        flightRecorder.resume();
     }
-    
-    // Delay before reboot to allow message transmission
-    delay(5000);
-    ESP.restart(); // Perform system restart
 }
 
 // Handles the reception of connection check messages and sends a response
@@ -350,8 +1308,8 @@ void com_check_callback(const void * msgin) {
     const std_msgs__msg__Int32 * msg = (const std_msgs__msg__Int32 *)msgin;
 
     // Log the received connection check value
-    Serial.print("Received connection check: ");
-    Serial.println(msg->data);
+    DEBUG_PRINT("Received connection check: ");
+    DEBUG_PRINTLN(msg->data);
 
     // Update the last time a message was received
     last_receive_time = millis();
@@ -368,76 +1326,259 @@ void com_check_callback(const void * msgin) {
     rcl_ret_t ret = rcl_publish(&com_check_publisher, &com_res_msg, NULL);
     if (ret != RCL_RET_OK) {
         // Log any failures to publish the response
-        Serial.print("Failed to publish message: ");
-        Serial.println(rcl_get_error_string().str);
+        DEBUG_PRINT("Failed to publish message: ");
+        DEBUG_PRINTLN(rcl_get_error_string().str);
         rcl_reset_error();  // Clear the error to avoid propagation
     }
 
     // Confirm the publication of the response
-    Serial.println("Published connection response: connection_established");
+    DEBUG_PRINTLN("Published connection response: connection_established");
 }
 
-// Callback function for handling received heartbeat messages
+// Echoes a link ping and feeds it to the link monitor
 void heartbeat_callback(const void * msgin)
 {
-    const std_msgs__msg__Int32 * msg = (const std_msgs__msg__Int32 *)msgin;
-    printf("Received heartbeat signal: %d\n", msg->data);
-
-    // Prepare the response message
-    heartbeat_msg.data = 1;  // Set the data to indicate the system is active
-
-    // Attempt to publish the heartbeat response
-    rcl_ret_t ret = rcl_publish(&heartbeat_publisher, &heartbeat_msg, NULL);
-    if (ret != RCL_RET_OK) {
-        printf("Failed to publish heartbeat response: %s\n", rcl_get_error_string().str);
-        rcl_reset_error();
-    } else {
-        printf("Published heartbeat response: %d\n", heartbeat_msg.data);
+    const std_msgs__msg__Int32MultiArray * msg = (const std_msgs__msg__Int32MultiArray *)msgin;
+    uint32_t now_us = micros();
+    if (msg->data.size < LINK_PING_FIELDS) {
+        return;  // Not a link ping
     }
+    const int32_t *ping = msg->data.data;
+    linkMonitor.onPing((uint32_t)ping[LINK_PING_SEQ], (uint32_t)ping[LINK_PING_BOARD_STAMP],
+                       (uint32_t)ping[LINK_PING_HOLD], now_us);
+
+    // Echo right away so the host can measure its side of the round trip too
+    heartbeat_msg.data.data[LINK_ECHO_SEQ] = ping[LINK_PING_SEQ];
+    heartbeat_msg.data.data[LINK_ECHO_HOST_STAMP] = ping[LINK_PING_HOST_STAMP];
+    heartbeat_msg.data.data[LINK_ECHO_BOARD_STAMP] = (int32_t)now_us;
+    heartbeat_msg.data.size = LINK_ECHO_FIELDS;
+    RCSOFTCHECK(rcl_publish(&heartbeat_publisher, &heartbeat_msg, NULL));
 }
 
-// Callback function for handling received Twist messages
+// Callback function for handling received TwistStamped messages
 void subscription_callback(const void *msgin) {
     // Cast the incoming message to the appropriate message type
-    const geometry_msgs__msg__Twist * msg = (const geometry_msgs__msg__Twist *)msgin;
+    const geometry_msgs__msg__TwistStamped * stamped = (const geometry_msgs__msg__TwistStamped *)msgin;
+    const geometry_msgs__msg__Twist * msg = &stamped->twist;
+#ifndef MOTOR_BUS
+    uint32_t callback_us = micros();
+#endif
+    linkMonitor.onCmdVel(cmd_vel_ready_us);
+
+    // Reject commands delayed past the staleness bound, e.g. queued during a link hiccup
+    int64_t stamp_ns = (int64_t)stamped->header.stamp.sec * 1000000000LL + stamped->header.stamp.nanosec;
+    int64_t now_ns = rmw_uros_epoch_synchronized() ? rmw_uros_epoch_nanos() : 0;
+    if (cmdVelStats.checkStamp(stamp_ns, now_ns, RCL_MS_TO_NS(controlParams.cmd_vel_max_age_ms)) != STAMP_ACCEPTED) {
+        // Do not keep driving on the previous command either
+        stopCmdVel();
+        return;
+    }
+    cmd_vel_accepted_us = micros();
+    cmd_vel_moving = msg->linear.x != 0.0 || msg->linear.y != 0.0 || msg->angular.z != 0.0;
+    flightRecorder.recordCmdVel(msg->linear.x, msg->angular.z);
+
+    // Send commands to the motor first so display and logging do not delay them
+#ifdef MOTOR_BUS
+    sendMotorTwist(msg->linear.x, msg->linear.y, msg->angular.z);
+    cmdVelLatency.record(micros() - cmd_vel_ready_us);
+#else
+    sendMotorCommands(msg->linear.x, msg->angular.z);
+    uint32_t write_us = micros();
+    cmdVelLatency.record(write_us - cmd_vel_ready_us);
+    actuationLatency.onCommand(cmd_vel_ready_us, callback_us, write_us,
+                               (int32_t)velocityToDEC(commandedWheelSpeed), commandedWheelSpeed);
+#endif
 
     // Update the display with the new data
     updateDisplay(msg);
 
     // Log the received data for debugging and monitoring purposes
     logReceivedData(msg);
+}
 
-    // Send commands to the motor based on the received Twist message
-    sendMotorCommands(msg->linear.x, msg->angular.z);
+// Commands zero velocity in place of a rejected or expired cmd_vel
+void stopCmdVel() {
+    cmd_vel_moving = false;
+    flightRecorder.recordCmdVel(0.0f, 0.0f);
+#ifdef MOTOR_BUS
+    sendMotorTwist(0.0f, 0.0f, 0.0f);
+#else
+    sendMotorCommands(0.0f, 0.0f);
+#endif
 }
 
-// Timer callback function to handle periodic tasks
-void timer_callback(rcl_timer_t *timer, int64_t last_call_time) {
-    RCLC_UNUSED(last_call_time);
+// Stops the wheel when no cmd_vel was accepted within cmd_vel_timeout_ms
+void checkCmdVelTimeout() {
+    if (!cmd_vel_moving || controlParams.cmd_vel_timeout_ms == 0) {
+        return;
+    }
+    if (micros() - cmd_vel_accepted_us >= controlParams.cmd_vel_timeout_ms * 1000UL) {
+        stopCmdVel();
+    }
+}
 
-    // Get current time from ROS clock
+// Stores the ROS time used to stamp the published messages
+bool updateCurrentTime() {
     rcl_ret_t rc = rcl_clock_get_now(&ros_clock, &current_time);
     if (rc != RCL_RET_OK) {
-        Serial.println("Failed to get current time");
+        DEBUG_PRINTLN("Failed to get current time");
+        return false;
+    }
+    return true;
+}
+
+// IMU sampling stream: reads and filters the IMU at the full sample rate
+void imu_sample_callback() {
+    flightRecorder.recordTick(STREAM_IMU_SAMPLE);
+    captureStream.recordTick(STREAM_IMU_SAMPLE);
+    imuManager.update();
+    if (controlParams.imu_format == IMU_FORMAT_RAW_BATCH) {
+        imuBatch.add(imuManager.rawSample(), micros());
+    }
+}
+
+// IMU publish stream: publishes the latest filtered sample, or the raw batch
+void imu_publish_callback() {
+    if (!updateCurrentTime()) {
+        return;
+    }
+    if (controlParams.imu_format == IMU_FORMAT_RAW_BATCH) {
+        imu_batch_msg.data.size = imuBatch.serialize(imu_batch_msg.data.data, imu_batch_msg.data.capacity,
+                                                     current_time, micros());
+        RCSOFTCHECK(rcl_publish(&imu_batch_publisher, &imu_batch_msg, NULL));
         return;
     }
+    updateIMUData();
+    RCSOFTCHECK(rcl_publish(&imu_publisher, &imu_msg, NULL));
+}
 
-    // Update IMU data if available
-#ifdef LEFT_WHEEL
-    if (imuManager.update()) {
-        updateIMUData(); // Function to update and publish IMU data
+// Wheel stream: reads and publishes the wheel speed
+void wheel_callback() {
+    flightRecorder.recordTick(STREAM_WHEEL);
+    captureStream.recordTick(STREAM_WHEEL);
+    checkCmdVelTimeout();
+    if (!updateCurrentTime()) {
+        return;
     }
+    updateWheelSpeed();
+    RCSOFTCHECK(rcl_publish(&vel_publisher, &vel_msg, NULL));
+    RCSOFTCHECK(rcl_publish(&vel_cov_publisher, &vel_cov_msg, NULL));
+#if defined(LEFT_WHEEL) && !defined(MOTOR_BUS)
+    checkSlip();
 #endif
 
-    // Read and publish wheel speed data
-    updateWheelSpeed(); // Function to update and publish wheel speed
+    // A re-arm enables the driver here, between the UART exchanges of this task
+    if (serviceEmergencyStop()) {
+        publishEmergencyStop();
+    }
 
-    // Ensure the timer is not null before publishing data
-    if (timer != NULL) {
-      RCSOFTCHECK(rcl_publish(&imu_publisher, &imu_msg, NULL));
-      RCSOFTCHECK(rcl_publish(&vel_publisher, &vel_msg, NULL));
+#ifndef MOTOR_BUS
+    // The status replies were read with the wheel feedback, a recovery runs after it is published
+    if (superviseMotor(motorSerial, MOTOR_ID)) {
+        publishMotorStatus();
+    }
+#endif
+}
+
+#if defined(LEFT_WHEEL) && !defined(MOTOR_BUS)
+// Checks the wheel speed and the gyro against the command at the wheel stream rate
+// and continues a target ramped by the acceleration limit between commands
+void checkSlip() {
+    float ax, ay, az, gx, gy, gz;
+    imuManager.getCalibratedData(ax, ay, az, gx, gy, gz);
+    uint32_t now_us = micros();
+    slipDetector.configure(controlParams.wheel_distance, controlParams.slip_yaw_tolerance,
+                           controlParams.slip_accel_limit);
+    if (wheel_speed_valid) {
+        // A missed speed reply is no evidence of a stall
+        slipDetector.update(currentCommand.linear_x, currentCommand.angular_z,
+                            vel_msg.twist.linear.x, gz * DEG2RAD, now_us);
     }
+    if (slipDetector.takeEvent()) {
+        publishSlipEvent();
+    }
+    if (motorInhibit != 0) {
+        slipDetector.limitTarget(0.0f, 0.0f, now_us); // A held wheel waits for the next command
+    } else if (slipDetector.rampPending(commandedWheelSpeed)) {
+        commandedWheelSpeed = slipDetector.limitTarget(commandedWheelSpeed, slipDetector.requestedTarget(), now_us);
+        sendVelocityDEC(motorSerial, (int)velocityToDEC(commandedWheelSpeed), MOTOR_ID);
+    }
+}
+
+// Publishes the slip detector summary when a slip or stall starts or ends
+void publishSlipEvent() {
+    slip_msg.data.size = slipDetector.summarize(slip_msg.data.data, slip_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&slip_publisher, &slip_msg, NULL));
+    DEBUG_PRINTF("Slip: %s\n", slip_msg.data.data);
 }
+#endif
+
+// Publishes the e-stop summary after a trip or re-arm
+void publishEmergencyStop() {
+    estop_msg.data.size = emergencyStop.summarize(estop_msg.data.data, estop_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&estop_publisher, &estop_msg, NULL));
+    DEBUG_PRINTF("E-stop: %s\n", estop_msg.data.data);
+}
+
+// Publishes the motor supervisor summary after a fault or recovery
+void publishMotorStatus() {
+    motor_status_msg.data.size = motorSupervisor.summarize(motor_status_msg.data.data, motor_status_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&motor_status_publisher, &motor_status_msg, NULL));
+    DEBUG_PRINTF("Motor supervisor: %s\n", motor_status_msg.data.data);
+}
+
+// Diagnostics stream: publishes and restarts the statistics of every stream,
+// followed by the outcome of the motor initialization
+void diagnostics_callback() {
+    uint32_t now_us = micros();
+    // The first run after start() only opens the statistics window
+    if (controlStreams.stats(STREAM_DIAGNOSTICS).runs == 0) {
+        controlStreams.resetStats(now_us);
+        return;
+    }
+    size_t used = controlStreams.summarize(diagnostics_msg.data.data, diagnostics_msg.data.capacity, now_us);
+    if (used + 1 < diagnostics_msg.data.capacity) {
+        // Keep a failed motor initialization visible after boot
+        diagnostics_msg.data.data[used++] = ' ';
+        used += describeMotorInit(diagnostics_msg.data.data + used, diagnostics_msg.data.capacity - used);
+    }
+    diagnostics_msg.data.size = used;
+    RCSOFTCHECK(rcl_publish(&diagnostics_publisher, &diagnostics_msg, NULL));
+#ifndef MOTOR_BUS
+    actuation_msg.data.size = actuationLatency.summarize(actuation_msg.data.data, actuation_msg.data.capacity);
+    RCSOFTCHECK(rcl_publish(&actuation_publisher, &actuation_msg, NULL));
+#endif
+    controlStreams.resetStats(now_us);
+}
+
+#ifdef TRANSPORT_BENCHMARK
+// Publishes a burst of pings and periodically the benchmark summary
+void bench_timer_callback(rcl_timer_t *timer, int64_t last_call_time) {
+    RCLC_UNUSED(timer);
+    RCLC_UNUSED(last_call_time);
+    static unsigned long last_report_time = millis();
+
+    for (int i = 0; i < BENCH_BURST; i++) {
+        bench_ping_msg.data = (int32_t)transportBenchmark.nextPing(micros());
+        RCSOFTCHECK(rcl_publish(&bench_ping_publisher, &bench_ping_msg, NULL));
+    }
+
+    if (millis() - last_report_time >= BENCH_REPORT_INTERVAL) {
+        bench_result_msg.data.size = transportBenchmark.summarize(
+            bench_result_msg.data.data, bench_result_msg.data.capacity,
+            transportName(activeTransport), micros());
+        RCSOFTCHECK(rcl_publish(&bench_result_publisher, &bench_result_msg, NULL));
+        transportBenchmark.reset(micros());
+        last_report_time = millis();
+    }
+}
+
+// Matches an echoed ping to its send time
+void bench_echo_callback(const void *msgin) {
+    const std_msgs__msg__Int32 * msg = (const std_msgs__msg__Int32 *)msgin;
+    transportBenchmark.onEcho((uint32_t)msg->data, micros());
+}
+#endif
 
 // Function to update IMU data
 void updateIMUData() {
@@ -461,7 +1602,51 @@ void updateIMUData() {
 
 // Function to update and publish wheel speed data
 void updateWheelSpeed() {
-    float wheelSpeed = readSpeedData(motorSerial, MOTOR_ID);
+#ifdef MOTOR_BUS
+    // The bus task owns the UART, publish the base twist of its latest cycle
+    float vx = 0.0f, vy = 0.0f, wz = 0.0f;
+    motorGroup.estimateTwist(vx, vy, wz);
+    vel_msg.header.stamp.sec = current_time / 1000000000;
+    vel_msg.header.stamp.nanosec = current_time % 1000000000;
+    vel_msg.twist.linear.x = vx;
+    vel_msg.twist.linear.y = vy;
+    vel_msg.twist.angular.z = wz;
+    vel_cov_msg.header.stamp = vel_msg.header.stamp;
+    vel_cov_msg.twist.twist = vel_msg.twist;
+    vel_cov_msg.twist.covariance[0] = speedRegisterVariance();
+    return;
+#endif
+    float wheelSpeed;
+    float variance;
+    // Confirms a new target, the reply is read with the wheel feedback
+    if (actuationLatency.awaitingAck()) {
+        motorController.sendFrame(TARGET_VELOCITY_READ_FRAME);
+    }
+    if (controlParams.velocity_source == VELOCITY_SOURCE_POSITION) {
+        int32_t position;
+        uint32_t sample_us;
+        velocityEstimator.configure(metersPerCount(), controlParams.velocity_process_noise, MOTOR_RESPONSE_TIME);
+        if (readPositionData(motorSerial, MOTOR_ID, position, sample_us)) {
+            velocityEstimator.update(position, sample_us, commandedWheelSpeed);
+        } else {
+            velocityEstimator.predict(micros(), commandedWheelSpeed); // Missed reply, the variance grows
+        }
+        wheelSpeed = velocityEstimator.velocity();
+        variance = velocityEstimator.isValid() ? velocityEstimator.variance() : ESTIMATOR_INITIAL_VARIANCE;
+        wheel_speed_valid = velocityEstimator.isValid();
+    } else if (readSpeedData(motorSerial, MOTOR_ID, wheelSpeed)) {
+        variance = speedRegisterVariance();
+        wheel_speed_valid = true;
+    } else {
+        // Missed reply, hold the last speed and report it as unknown instead of a confident stop
+        wheelSpeed = held_wheel_speed;
+        variance = ESTIMATOR_INITIAL_VARIANCE;
+        wheel_speed_valid = false;
+    }
+    held_wheel_speed = wheelSpeed;
+    if (wheel_speed_valid) {
+        actuationLatency.onFeedback(wheelSpeed, micros());
+    }
     vel_msg.header.stamp.sec = current_time / 1000000000;  // seconds
     vel_msg.header.stamp.nanosec = current_time % 1000000000;  // nanoseconds
 #ifdef LEFT_WHEEL
@@ -469,15 +1654,21 @@ void updateWheelSpeed() {
 #elif defined(RIGHT_WHEEL)
     vel_msg.twist.linear.x = wheelSpeed;
 #endif
+    vel_cov_msg.header.stamp = vel_msg.header.stamp;
+    vel_cov_msg.twist.twist.linear.x = vel_msg.twist.linear.x;
+    vel_cov_msg.twist.covariance[0] = variance;
 }
 
 // Executes the ROS 2 executor for a specified duration and handles any occurring errors
-void handleExecutorSpin() {
-    // Spin the executor for 10 milliseconds
-    rcl_ret_t ret = rclc_executor_spin_some(&executor, RCL_MS_TO_NS(10));
+void handleExecutorSpin(rclc_executor_t *executor, uint32_t timeout_ms) {
+    // Spin the executor, waiting at most timeout_ms for new data
+    rcl_ret_t ret = rclc_executor_spin_some(executor, RCL_MS_TO_NS(timeout_ms));
     if (ret != RCL_RET_OK) {
+        flightRecorder.recordFault(executor == &control_executor ?
+            FLIGHT_SOURCE_CONTROL_EXECUTOR : FLIGHT_SOURCE_HOUSEKEEPING_EXECUTOR, ret);
+
         // If an error occurs, retrieve and print the error message
-        printf("Error in rclc_executor_spin_some: %s\n", rcl_get_error_string().str);
+        DEBUG_PRINTF("Error in rclc_executor_spin_some: %s\n", rcl_get_error_string().str);
         rcl_reset_error();  // Reset the error state to prevent propagation
     }
 }
\ No newline at end of file
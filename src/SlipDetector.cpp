@@ -0,0 +1,162 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "SlipDetector.h"
+#include "SummaryFormat.h"
+#include "VelocityEstimator.h"
+#include "MotorController.h"
+
+SlipDetector slipDetector;
+
+SlipDetector::SlipDetector()
+    : wheel_distance(WHEEL_DISTANCE), yaw_tolerance(SLIP_YAW_TOLERANCE), accel_limit(SLIP_ACCEL_LIMIT) {
+    memset(&counters, 0, sizeof(counters));
+    reset();
+}
+
+void SlipDetector::configure(float distance, float tolerance, float limit) {
+    wheel_distance = distance;
+    yaw_tolerance = tolerance;
+    accel_limit = limit;
+}
+
+void SlipDetector::reset() {
+    started = false;
+    expected_linear = 0.0f;
+    expected_angular = 0.0f;
+    last_update_us = 0;
+    last_limit_us = 0;
+    requested_target = 0.0f;
+    current = SLIP_NONE;
+    candidate = SLIP_NONE;
+    candidate_ticks = 0;
+    clear_ticks = 0;
+    event = false;
+    memset(&snapshot, 0, sizeof(snapshot));
+}
+
+SlipState SlipDetector::update(float linear, float angular, float wheel_speed, float gyro_z, uint32_t now_us) {
+    // The wheels follow a command with the first-order response of the drivers
+    if (!started) {
+        expected_linear = linear;
+        expected_angular = angular;
+        started = true;
+    } else {
+        float dt = (now_us - last_update_us) * 1e-6f;
+        float alpha = dt / (MOTOR_RESPONSE_TIME + dt);
+        expected_linear += alpha * (linear - expected_linear);
+        expected_angular += alpha * (angular - expected_angular);
+    }
+    last_update_us = now_us;
+    counters.ticks++;
+
+    // Differential drive with this wheel on the left, the other wheel at its expected speed
+    float half = wheel_distance / 2;
+    float wheel_target = expected_linear - expected_angular * half;
+    float other_wheel = expected_linear + expected_angular * half;
+    float yaw_wheels = (other_wheel - wheel_speed) / wheel_distance;
+
+    SlipState seen = SLIP_NONE;
+    float direction = wheel_target >= 0.0f ? 1.0f : -1.0f;
+    if (fabsf(wheel_target) >= SLIP_MIN_SPEED && wheel_speed * direction < SLIP_STALL_RATIO * fabsf(wheel_target)) {
+        seen = SLIP_STALL;
+    } else if (fabsf(yaw_wheels - gyro_z) > yaw_tolerance) {
+        seen = SLIP_YAW;
+    }
+
+    // A few consecutive ticks raise an event, a longer consistent run clears it
+    SlipState next = current;
+    if (seen == SLIP_NONE) {
+        candidate = SLIP_NONE;
+        candidate_ticks = 0;
+        if (current != SLIP_NONE && ++clear_ticks >= SLIP_CLEAR_TICKS) {
+            next = SLIP_NONE;
+        }
+    } else {
+        clear_ticks = 0;
+        if (seen != candidate) {
+            candidate = seen;
+            candidate_ticks = 0;
+        }
+        if (candidate_ticks < SLIP_DETECT_TICKS) {
+            candidate_ticks++;
+        }
+        if (candidate_ticks >= SLIP_DETECT_TICKS) {
+            next = seen;
+        }
+    }
+    if (next != current) {
+        current = next;
+        event = true;
+        clear_ticks = 0;
+        if (next == SLIP_YAW) {
+            counters.slips++;
+        } else if (next == SLIP_STALL) {
+            counters.stalls++;
+        }
+        snapshot.yaw_command = expected_angular;
+        snapshot.yaw_wheels = yaw_wheels;
+        snapshot.yaw_gyro = gyro_z;
+        snapshot.wheel_target = wheel_target;
+        snapshot.wheel_speed = wheel_speed;
+    }
+    return current;
+}
+
+float SlipDetector::limitTarget(float applied, float requested, uint32_t now_us) {
+    float dt = (now_us - last_limit_us) * 1e-6f;
+    last_limit_us = now_us;
+    requested_target = requested;
+    if (accel_limit <= 0.0f || current == SLIP_NONE) {
+        return requested;
+    }
+    // Slowing down is never delayed, a reversal ramps up from standstill
+    if (requested * applied < 0.0f) {
+        applied = 0.0f;
+    } else if (fabsf(requested) <= fabsf(applied)) {
+        return requested;
+    }
+    float step = accel_limit * dt;
+    float delta = requested - applied;
+    if (delta > step) {
+        counters.clamped++;
+        return applied + step;
+    }
+    if (delta < -step) {
+        counters.clamped++;
+        return applied - step;
+    }
+    return requested;
+}
+
+bool SlipDetector::takeEvent() {
+    bool pending = event;
+    event = false;
+    return pending;
+}
+
+size_t SlipDetector::summarize(char *buf, size_t len) const {
+    static const char *const names[] = {"ok", "slip", "stall"};
+    size_t used = 0;
+    appendf(buf, len, &used,
+        "state=%s yaw_cmd=%.2f yaw_wheels=%.2f yaw_gyro=%.2f wheel_target=%.2f wheel_speed=%.2f "
+        "slips=%u stalls=%u clamped=%u",
+        names[current], snapshot.yaw_command, snapshot.yaw_wheels, snapshot.yaw_gyro,
+        snapshot.wheel_target, snapshot.wheel_speed,
+        (unsigned)counters.slips, (unsigned)counters.stalls, (unsigned)counters.clamped);
+    return used;
+}
@@ -0,0 +1,125 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "StreamScheduler.h"
+#include "SummaryFormat.h"
+
+StreamScheduler::StreamScheduler() : window_start_us(0) {
+    memset(streams, 0, sizeof(streams));
+}
+
+bool StreamScheduler::configureStream(uint8_t id, const char *name, uint32_t period_us, uint32_t phase_us,
+                                      StreamCallback callback) {
+    if (id >= MAX_STREAMS || period_us == 0 || callback == NULL) {
+        return false;
+    }
+    Stream &s = streams[id];
+    memset(&s, 0, sizeof(s));
+    s.name = name;
+    s.callback = callback;
+    s.period_us = period_us;
+    s.phase_us = phase_us;
+    s.next_due_us = window_start_us + phase_us;
+    return true;
+}
+
+void StreamScheduler::setPeriod(uint8_t id, uint32_t period_us) {
+    if (!isConfigured(id) || period_us == 0) {
+        return;
+    }
+    streams[id].period_us = period_us;
+}
+
+void StreamScheduler::start(uint32_t now_us) {
+    for (uint8_t id = 0; id < MAX_STREAMS; id++) {
+        Stream &s = streams[id];
+        s.next_due_us = now_us + s.phase_us;
+        s.has_run = false;
+    }
+    resetStats(now_us);
+}
+
+uint32_t StreamScheduler::poll(uint32_t now_us) {
+    uint32_t wait_us = STREAM_IDLE_WAIT;
+    for (uint8_t id = 0; id < MAX_STREAMS; id++) {
+        Stream &s = streams[id];
+        if (s.callback == NULL) {
+            continue;
+        }
+
+        // Signed difference keeps the comparison valid across the micros() wrap
+        int32_t late_us = (int32_t)(now_us - s.next_due_us);
+        if (late_us >= 0) {
+            s.callback();
+
+            StreamStats &st = s.stats;
+            st.runs++;
+            if (s.has_run) {
+                uint32_t interval = now_us - s.last_run_us;
+                uint32_t jitter = interval > s.period_us ? interval - s.period_us : s.period_us - interval;
+                st.jitter_sum_us += jitter;
+                st.jitter_max_us = std::max(st.jitter_max_us, jitter);
+                st.intervals++;
+            }
+            s.last_run_us = now_us;
+            s.has_run = true;
+
+            // Stay on the phase grid, dropping the slots that were missed entirely
+            uint32_t skipped = (uint32_t)late_us / s.period_us;
+            st.missed += skipped;
+            s.next_due_us += (skipped + 1) * s.period_us;
+            late_us = (int32_t)(now_us - s.next_due_us);
+        }
+        wait_us = std::min(wait_us, (uint32_t)-late_us);
+    }
+    return wait_us;
+}
+
+void StreamScheduler::run(uint8_t id) {
+    if (isConfigured(id)) {
+        streams[id].callback();
+    }
+}
+
+float StreamScheduler::achievedRate(uint8_t id, uint32_t now_us) const {
+    uint32_t elapsed_us = now_us - window_start_us;
+    return elapsed_us ? streams[id].stats.runs * 1000000.0f / elapsed_us : 0.0f;
+}
+
+size_t StreamScheduler::summarize(char *buf, size_t len, uint32_t now_us) const {
+    size_t used = 0;
+    for (uint8_t id = 0; id < MAX_STREAMS && used + 1 < len; id++) {
+        const Stream &s = streams[id];
+        if (s.callback == NULL) {
+            continue;
+        }
+        const StreamStats &st = s.stats;
+        uint32_t jitter_avg_us = st.intervals ? (uint32_t)(st.jitter_sum_us / st.intervals) : 0;
+        appendf(buf, len, &used,
+            "%s%s.period_us=%u %s.rate_hz=%.1f %s.jitter_avg_us=%u %s.jitter_max_us=%u %s.missed=%u",
+            used ? " " : "", s.name, (unsigned)s.period_us, s.name, achievedRate(id, now_us),
+            s.name, (unsigned)jitter_avg_us, s.name, (unsigned)st.jitter_max_us, s.name, (unsigned)st.missed);
+    }
+    return used;
+}
+
+void StreamScheduler::resetStats(uint32_t now_us) {
+    for (uint8_t id = 0; id < MAX_STREAMS; id++) {
+        memset(&streams[id].stats, 0, sizeof(StreamStats));
+    }
+    window_start_us = now_us;
+}
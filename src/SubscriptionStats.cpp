@@ -0,0 +1,61 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SubscriptionStats.h"
+#include "SummaryFormat.h"
+
+SubscriptionStats::SubscriptionStats(const char *name)
+    : name(name), received_count(0), dropped_count(0), late_count(0), last_stamp_ns(0), has_age(false), last_age_ns(0) {}
+
+void SubscriptionStats::add(uint32_t received, uint32_t dropped, uint32_t late) {
+    received_count += received;
+    dropped_count += dropped;
+    late_count += late;
+}
+
+StampCheck SubscriptionStats::checkStamp(int64_t stamp_ns, int64_t now_ns, int64_t max_age_ns) {
+    received_count++;
+    if (stamp_ns == 0) {
+        return STAMP_ACCEPTED;  // Sender does not stamp its messages
+    }
+    // A reliable retransmission after a reconnect may replay an older command
+    if (last_stamp_ns != 0 && stamp_ns <= last_stamp_ns) {
+        dropped_count++;
+        return STAMP_OUT_OF_ORDER;
+    }
+    if (now_ns != 0) {
+        // Stamps slightly ahead of the board clock are sync error, not staleness
+        has_age = true;
+        last_age_ns = now_ns - stamp_ns;
+        if (max_age_ns > 0 && last_age_ns > max_age_ns) {
+            late_count++;
+            return STAMP_LATE;
+        }
+    }
+    last_stamp_ns = stamp_ns;
+    return STAMP_ACCEPTED;
+}
+
+size_t SubscriptionStats::summarize(char *buf, size_t len) const {
+    size_t used = 0;
+    appendf(buf, len, &used, "%s.rx=%u %s.dropped=%u %s.late=%u",
+            name, (unsigned)received_count, name, (unsigned)dropped_count,
+            name, (unsigned)late_count);
+    if (has_age) {
+        // Age is only known while the clock is synchronized with the agent
+        appendf(buf, len, &used, " %s.age_us=%ld", name, (long)(last_age_ns / 1000));
+    }
+    return used;
+}
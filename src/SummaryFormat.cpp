@@ -0,0 +1,31 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "SummaryFormat.h"
+
+void appendf(char *buf, size_t len, size_t *used, const char *format, ...) {
+    if (*used >= len) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buf + *used, len - *used, format, args);
+    va_end(args);
+    if (written > 0) {
+        *used = *used + written < len ? *used + written : len - 1;
+    }
+}
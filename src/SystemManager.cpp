@@ -19,6 +19,9 @@
 #include "SystemManager.h"
 #include "MotorController.h"
 #include "IMUManager.h"
+#include "FlightRecorder.h"
+#include "DebugOutput.h"
+#include "TransportManager.h"
 #include "config.h"
 
 IMUManager imuManager;
@@ -32,14 +35,26 @@ const int   daylightOffset_sec = 0;
 
 // Initializes M5Stack device, WiFi and time settings
 void setupM5stack() {
+#ifdef HEADLESS
+    // No LCD, SD or console; I2C only where the IMU needs it. The UARTs are
+    // opened by the motor, transport and capture modules.
+#ifdef LEFT_WHEEL
+    M5.begin(false, false, false, true);
+#else
+    M5.begin(false, false, false, false);
+#endif
+    M5.Speaker.mute();
+#else
     M5.begin();
     delay(500);
+#endif
 
 #ifdef LEFT_WHEEL  
     // Initialize IMU if compiling for the left wheel configuration
     imuManager.initialize();
 #endif
 
+#ifndef HEADLESS
     // Set text size and initial cursor position for LCD display
     M5.Lcd.setTextSize(2);
     M5.Lcd.setCursor(0, 0);  // Set cursor for title
@@ -47,29 +62,42 @@ void setupM5stack() {
     // Start serial communication
     Serial.begin(BAUD_RATE);
     while (!Serial);  // Wait for the serial port to connect. Needed for native USB
+#endif
+
+#ifdef HEADLESS
+    // WiFi only carries the UDP transport, the serial transports leave the radio off
+    if (selectTransport() != TRANSPORT_UDP) {
+        WiFi.mode(WIFI_OFF);
+        btStop();
+        return;
+    }
+#endif
 
     // Connect to WiFi
     WiFi.begin(ssid, password);
     while (WiFi.status() != WL_CONNECTED) {
       delay(500);
-      Serial.print(".");
+      DEBUG_PRINT(".");
     }
-    Serial.println("WiFi connected.");
+    DEBUG_PRINTLN("WiFi connected.");
 
+#ifndef HEADLESS
     // Setup and sync time with NTP server
     configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
     struct tm timeinfo;
     if (!getLocalTime(&timeinfo)) {
-      Serial.println("Failed to obtain time");
+      DEBUG_PRINTLN("Failed to obtain time");
       return;
     }
-    Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+    DEBUG_PRINTLN(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+#endif
 }
 
 // Checks if data has not been received for a specified timeout and restarts if necessary
 void checkDataTimeout() {
   if (!initial_data_received && (millis() - last_receive_time > RECEIVE_TIMEOUT)) {
-    Serial.printf("No data received for %d seconds, restarting...\n", RECEIVE_TIMEOUT / 1000);
+    DEBUG_PRINTF("No data received for %d seconds, restarting...\n", RECEIVE_TIMEOUT / 1000);
+    flightRecorder.recordError(FLIGHT_SOURCE_DATA_TIMEOUT, 0);
     ESP.restart();
   }
 }
\ No newline at end of file
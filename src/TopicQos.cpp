@@ -0,0 +1,46 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TopicQos.h"
+
+// Profiles are built once from the rmw defaults so unlisted policies keep their default values
+static rmw_qos_profile_t makeProfile(const rmw_qos_profile_t &base, rmw_qos_reliability_policy_t reliability,
+                                     size_t depth) {
+    rmw_qos_profile_t profile = base;
+    profile.history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+    profile.depth = depth;
+    profile.reliability = reliability;
+    profile.durability = RMW_QOS_POLICY_DURABILITY_VOLATILE;
+    return profile;
+}
+
+const rmw_qos_profile_t *qosProfile(TopicQos qos) {
+    static const rmw_qos_profile_t command =
+        makeProfile(rmw_qos_profile_default, RMW_QOS_POLICY_RELIABILITY_RELIABLE, COMMAND_QOS_DEPTH);
+    static const rmw_qos_profile_t sensor =
+        makeProfile(rmw_qos_profile_sensor_data, RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, SENSOR_QOS_DEPTH);
+    static const rmw_qos_profile_t status =
+        makeProfile(rmw_qos_profile_default, RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, STATUS_QOS_DEPTH);
+    static const rmw_qos_profile_t transfer =
+        makeProfile(rmw_qos_profile_default, RMW_QOS_POLICY_RELIABILITY_RELIABLE, STATUS_QOS_DEPTH);
+
+    switch (qos) {
+    case QOS_COMMAND: return &command;
+    case QOS_SENSOR: return &sensor;
+    case QOS_STATUS: return &status;
+    case QOS_TRANSFER: return &transfer;
+    default: return &rmw_qos_profile_services_default;
+    }
+}
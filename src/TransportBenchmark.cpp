@@ -0,0 +1,82 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "TransportBenchmark.h"
+#include "SummaryFormat.h"
+
+TransportBenchmark::TransportBenchmark() : next_seq(0) {
+    reset(0);
+}
+
+uint32_t TransportBenchmark::nextPing(uint32_t now_us) {
+    uint32_t seq = next_seq++;
+    uint32_t slot = seq % BENCH_WINDOW;
+    send_time_us[slot] = now_us;
+    send_seq[slot] = seq;
+    pending[slot] = true;
+    sent++;
+    return seq;
+}
+
+bool TransportBenchmark::onEcho(uint32_t seq, uint32_t now_us) {
+    uint32_t slot = seq % BENCH_WINDOW;
+    // Reject echoes whose slot was reused by a newer ping or already answered
+    if (!pending[slot] || send_seq[slot] != seq) {
+        return false;
+    }
+    pending[slot] = false;
+    received++;
+    if (rtt_count < BENCH_WINDOW) {
+        rtt_us[rtt_count++] = now_us - send_time_us[slot];
+    }
+    return true;
+}
+
+size_t TransportBenchmark::summarize(char *buf, size_t len, const char *transport, uint32_t now_us) {
+    uint32_t min_us = 0, avg_us = 0, p99_us = 0, max_us = 0;
+    if (rtt_count > 0) {
+        std::sort(rtt_us, rtt_us + rtt_count);
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < rtt_count; i++) {
+            sum += rtt_us[i];
+        }
+        min_us = rtt_us[0];
+        max_us = rtt_us[rtt_count - 1];
+        avg_us = (uint32_t)(sum / rtt_count);
+        p99_us = rtt_us[(rtt_count * 99) / 100];
+    }
+
+    // Echoes per second over the window
+    uint32_t elapsed_us = now_us - window_start_us;
+    uint32_t echo_rate = elapsed_us ? (uint32_t)(((uint64_t)received * 1000000) / elapsed_us) : 0;
+
+    size_t used = 0;
+    appendf(buf, len, &used,
+        "transport=%s sent=%u received=%u rtt_min_us=%u rtt_avg_us=%u rtt_p99_us=%u rtt_max_us=%u echo_per_s=%u",
+        transport, (unsigned)sent, (unsigned)received, (unsigned)min_us, (unsigned)avg_us,
+        (unsigned)p99_us, (unsigned)max_us, (unsigned)echo_rate);
+    return used;
+}
+
+void TransportBenchmark::reset(uint32_t now_us) {
+    for (uint32_t i = 0; i < BENCH_WINDOW; i++) {
+        pending[i] = false;
+    }
+    rtt_count = 0;
+    sent = 0;
+    received = 0;
+    window_start_us = now_us;
+}
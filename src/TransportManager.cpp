@@ -0,0 +1,98 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TransportManager.h"
+#include "ControlParameters.h"
+
+TransportType activeTransport = (TransportType)MICRO_ROS_TRANSPORT;
+
+// Agent locator for the UDP transport, read by the micro_ros_arduino WiFi callbacks
+static struct micro_ros_agent_locator agent_locator;
+
+// Framed serial transport callbacks. Framing is done by the XRCE-DDS client,
+// so these only move bytes between the client and the USB serial port.
+static bool framed_serial_open(struct uxrCustomTransport * transport) {
+    Serial.end();
+    Serial.begin(FRAMED_BAUD_RATE);
+    return true;
+}
+
+static bool framed_serial_close(struct uxrCustomTransport * transport) {
+    Serial.end();
+    return true;
+}
+
+static size_t framed_serial_write(struct uxrCustomTransport * transport, const uint8_t * buf, size_t len, uint8_t * err) {
+    return Serial.write(buf, len);
+}
+
+static size_t framed_serial_read(struct uxrCustomTransport * transport, uint8_t * buf, size_t len, int timeout, uint8_t * err) {
+    Serial.setTimeout(timeout);
+    return Serial.readBytes((char *)buf, len);
+}
+
+TransportType selectTransport() {
+    // Fall back to the build-time default if the parameter holds an unknown value
+    if (controlParams.transport > TRANSPORT_FRAMED_SERIAL) {
+        return (TransportType)MICRO_ROS_TRANSPORT;
+    }
+    return (TransportType)controlParams.transport;
+}
+
+void setupTransport(TransportType type) {
+    switch (type) {
+    case TRANSPORT_UDP:
+        // WiFi is already connected by setupM5stack(), so only the locator is registered
+        agent_locator.address = IPAddress(AGENT_IP);
+        agent_locator.port = AGENT_PORT;
+        rmw_uros_set_custom_transport(
+            false,
+            (void *) &agent_locator,
+            arduino_wifi_transport_open,
+            arduino_wifi_transport_close,
+            arduino_wifi_transport_write,
+            arduino_wifi_transport_read
+        );
+        break;
+    case TRANSPORT_FRAMED_SERIAL:
+        rmw_uros_set_custom_transport(
+            true,
+            NULL,
+            framed_serial_open,
+            framed_serial_close,
+            framed_serial_write,
+            framed_serial_read
+        );
+        break;
+    case TRANSPORT_SERIAL:
+    default:
+        set_microros_transports();
+        type = TRANSPORT_SERIAL;
+        break;
+    }
+    activeTransport = type;
+}
+
+const char* transportName(TransportType type) {
+    switch (type) {
+    case TRANSPORT_UDP:
+        return "udp";
+    case TRANSPORT_FRAMED_SERIAL:
+        return "framed_serial";
+    case TRANSPORT_SERIAL:
+    default:
+        return "serial";
+    }
+}
@@ -0,0 +1,86 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VelocityEstimator.h"
+
+VelocityEstimator::VelocityEstimator()
+    : meters_per_count(1.0f), process_noise(VELOCITY_PROCESS_NOISE), response_time(MOTOR_RESPONSE_TIME) {
+    reset();
+}
+
+void VelocityEstimator::configure(float meters_per_count, float process_noise, float response_time) {
+    this->meters_per_count = meters_per_count;
+    this->process_noise = process_noise;
+    this->response_time = response_time;
+}
+
+void VelocityEstimator::reset() {
+    has_reference = false;
+    valid = false;
+    last_position = 0;
+    last_sample_us = 0;
+    state_us = 0;
+    v = 0.0f;
+    p = ESTIMATOR_INITIAL_VARIANCE;
+}
+
+void VelocityEstimator::predict(uint32_t time_us, float commanded) {
+    // Signed difference keeps the order correct across the micros() wrap
+    int32_t dt_us = (int32_t)(time_us - state_us);
+    if (!has_reference || dt_us <= 0) {
+        return;
+    }
+    float dt = dt_us * 1e-6f;
+    float alpha = response_time > 0.0f ? dt / (response_time + dt) : 1.0f;
+    float change = alpha * (commanded - v);
+    v += change;
+    // The prior is only as certain as the change it predicts, so a wheel that
+    // does not follow the command (stall, slip, pushed by hand) is still
+    // tracked by the measurements instead of being pulled toward the command
+    p = (1.0f - alpha) * (1.0f - alpha) * p + process_noise * dt + change * change;
+    state_us = time_us;
+}
+
+bool VelocityEstimator::update(int32_t position, uint32_t sample_us, float commanded) {
+    int32_t dt_us = (int32_t)(sample_us - last_sample_us);
+    if (!has_reference || dt_us <= 0 || dt_us > ESTIMATOR_RESET_GAP) {
+        // Too far apart to trust the command prior in between, start over from this sample
+        has_reference = true;
+        valid = false;
+        last_position = position;
+        last_sample_us = sample_us;
+        state_us = sample_us;
+        v = commanded;
+        p = ESTIMATOR_INITIAL_VARIANCE;
+        return false;
+    }
+
+    predict(sample_us, commanded);
+
+    // The counter wraps at 32 bits, the signed difference stays exact across one wrap
+    float dt = dt_us * 1e-6f;
+    int32_t counts = (int32_t)((uint32_t)position - (uint32_t)last_position);
+    float measured = counts * meters_per_count / dt;
+    // Each position is truncated to a whole count, uniform error of variance 1/12
+    float r = meters_per_count * meters_per_count / 6.0f / (dt * dt);
+
+    float gain = p / (p + r);
+    v += gain * (measured - v);
+    p *= 1.0f - gain;
+    last_position = position;
+    last_sample_us = sample_us;
+    valid = true;
+    return true;
+}
@@ -17,27 +17,54 @@
 #include "SystemManager.h"
 #include "MotorController.h"
 #include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "CaptureStream.h"
+#include "EmergencyStop.h"
+#include "MotorGroup.h"
 
 // Initializes the system on startup
 void setup() {
+    // Restore tuned control parameters from NVS before anything uses them
+    loadControlParameters();
+
     // Initialize M5Stack hardware configurations
     setupM5stack();
 
     // Initialize UART communication for motors
     initializeUART();
 
+    // Arm the hardware e-stop before waiting for the agent
+    startEmergencyStopTask();
+
     // Set up micro-ROS environment and node
     setupMicroROS();
 
+    // Start the task writing the raw data capture to its sideband port, before its producers
+    startCaptureTask();
+
+    // Start the control and housekeeping executor tasks
+    startExecutorTasks();
+
+#ifdef MOTOR_BUS
+    // Start the task cycling through the drivers once boot no longer uses the UART
+    startMotorBusTask();
+#endif
+
+    // Start the task running slow service work outside the executors
+    startDeferredWorkTask();
+
     // Record the last time data was received to monitor timeouts
     last_receive_time = millis();
+
+    // Reported with the resource summary, compares the full and headless builds
+    resourceMonitor.setBootTime(last_receive_time);
 }
 
 // Main loop to handle routine operations
 void loop() {
-    // Process ROS 2 executor callbacks
-    handleExecutorSpin();
+    // ROS 2 callbacks are processed by the executor tasks started in setup()
 
     // Check for data reception timeouts and handle if necessary
     checkDataTimeout();
+    delay(10);
 }
@@ -0,0 +1,159 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "ActuationLatency.h"
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const int32_t TARGET_DEC = 50000;
+static const float TARGET_SPEED = 0.3f;
+
+void setUp() {}
+void tearDown() {}
+
+void test_stages_of_a_target_change() {
+    ActuationLatency tracker;
+    tracker.onCommand(1000, 1100, 1300, TARGET_DEC, TARGET_SPEED);
+    TEST_ASSERT_TRUE(tracker.awaitingAck());
+    tracker.onReadBack(0, 2000);             // Reply to an earlier request
+    TEST_ASSERT_TRUE(tracker.awaitingAck());
+    tracker.onReadBack(TARGET_DEC, 11300);
+    TEST_ASSERT_FALSE(tracker.awaitingAck());
+    tracker.onFeedback(0.01f, 21300);        // Below ACTUATION_MIN_MOVE
+    TEST_ASSERT_EQUAL(0, tracker.stats().completed);
+    tracker.onFeedback(0.05f, 31300);
+    TEST_ASSERT_EQUAL(1, tracker.stats().completed);
+
+    TEST_ASSERT_EQUAL(100, tracker.distribution(ACTUATION_DISPATCH).max_us);
+    TEST_ASSERT_EQUAL(200, tracker.distribution(ACTUATION_WRITE).max_us);
+    TEST_ASSERT_EQUAL(10000, tracker.distribution(ACTUATION_ACK).max_us);
+    TEST_ASSERT_EQUAL(20000, tracker.distribution(ACTUATION_RESPONSE).max_us);
+    TEST_ASSERT_EQUAL(30300, tracker.distribution(ACTUATION_TOTAL).max_us);
+}
+
+void test_repeats_keep_the_change_tracked() {
+    ActuationLatency tracker;
+    tracker.onCommand(0, 10, 20, TARGET_DEC, TARGET_SPEED);
+    tracker.onCommand(50000, 50010, 50020, TARGET_DEC, TARGET_SPEED);
+    tracker.onReadBack(TARGET_DEC, 60000);
+    TEST_ASSERT_EQUAL(2, tracker.stats().commands);
+    TEST_ASSERT_EQUAL(1, tracker.stats().changes);
+    TEST_ASSERT_EQUAL(0, tracker.stats().superseded);
+    TEST_ASSERT_EQUAL(2, tracker.distribution(ACTUATION_DISPATCH).count);
+    TEST_ASSERT_EQUAL(59980, tracker.distribution(ACTUATION_ACK).max_us); // From the first write
+}
+
+void test_new_target_supersedes_a_pending_change() {
+    ActuationLatency tracker;
+    tracker.onCommand(0, 10, 20, TARGET_DEC, TARGET_SPEED);
+    tracker.onCommand(30000, 30010, 30020, -TARGET_DEC, -TARGET_SPEED);
+    TEST_ASSERT_EQUAL(1, tracker.stats().superseded);
+    tracker.onReadBack(TARGET_DEC, 40000);
+    TEST_ASSERT_TRUE(tracker.awaitingAck());
+    tracker.onReadBack(-TARGET_DEC, 40000);
+    tracker.onFeedback(-0.1f, 50000);
+    TEST_ASSERT_EQUAL(1, tracker.stats().completed);
+    TEST_ASSERT_EQUAL(20000, tracker.distribution(ACTUATION_TOTAL).max_us);
+}
+
+void test_unconfirmed_change_times_out() {
+    ActuationLatency tracker;
+    tracker.onCommand(0, 10, 20, TARGET_DEC, TARGET_SPEED);
+    tracker.onFeedback(0.0f, ACTUATION_TIMEOUT * 1000UL);
+    TEST_ASSERT_TRUE(tracker.awaitingAck());
+    tracker.onFeedback(0.0f, ACTUATION_TIMEOUT * 1000UL + 100);
+    TEST_ASSERT_FALSE(tracker.awaitingAck());
+    TEST_ASSERT_EQUAL(1, tracker.stats().timeouts);
+    TEST_ASSERT_EQUAL(0, tracker.distribution(ACTUATION_ACK).count);
+}
+
+void test_small_change_completes_at_the_read_back() {
+    ActuationLatency tracker;
+    tracker.onCommand(0, 10, 20, 100, 0.001f);
+    tracker.onReadBack(100, 10020);
+    TEST_ASSERT_EQUAL(1, tracker.stats().completed);
+    TEST_ASSERT_EQUAL(1, tracker.distribution(ACTUATION_ACK).count);
+    TEST_ASSERT_EQUAL(0, tracker.distribution(ACTUATION_RESPONSE).count);
+}
+
+void test_distribution_keeps_the_latest_samples() {
+    ActuationLatency tracker;
+    for (uint32_t i = 1; i <= 100; i++) {
+        tracker.onCommand(0, i, i, 0, 0.0f);
+    }
+    ActuationDistribution d = tracker.distribution(ACTUATION_DISPATCH);
+    TEST_ASSERT_EQUAL(ACTUATION_SAMPLES, d.count);
+    TEST_ASSERT_EQUAL(37, d.min_us);
+    TEST_ASSERT_EQUAL(68, d.p50_us);
+    TEST_ASSERT_EQUAL(94, d.p90_us);
+    TEST_ASSERT_EQUAL(100, d.max_us);
+}
+
+void test_summary_format() {
+    ActuationLatency tracker;
+    tracker.onCommand(1000, 1100, 1300, TARGET_DEC, TARGET_SPEED);
+    tracker.onReadBack(TARGET_DEC, 11300);
+    tracker.onFeedback(0.05f, 31300);
+    char buf[ACTUATION_BUFFER_SIZE];
+    tracker.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("commands=1 changes=1 completed=1 superseded=0 timeouts=0 "
+                             "dispatch_us=1:100/100/100/100 write_us=1:200/200/200/200 "
+                             "ack_us=1:10000/10000/10000/10000 response_us=1:20000/20000/20000/20000 "
+                             "total_us=1:30300/30300/30300/30300", buf);
+}
+
+void test_command_is_followed_through_the_driver() {
+    motorSerial.clearRx();
+    SimMotorDriver driver(motorSerial);
+    driver.setTimeConstant(0.005f);
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    motorSupervisor.start(true, micros());
+
+    geometry_msgs__msg__TwistStamped cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.twist.linear.x = TARGET_SPEED;
+    subscription_callback(&cmd); // Unsynchronized agent clock, the stamp is not checked
+    TEST_ASSERT_TRUE(actuationLatency.awaitingAck());
+    for (int tick = 0; tick < 20 && actuationLatency.stats().completed == 0; tick++) {
+        wheel_callback();
+        delay(2);
+    }
+    TEST_ASSERT_EQUAL(1, actuationLatency.stats().completed);
+    TEST_ASSERT_EQUAL(1, actuationLatency.distribution(ACTUATION_ACK).count);
+    TEST_ASSERT_EQUAL(1, actuationLatency.distribution(ACTUATION_RESPONSE).count);
+    TEST_ASSERT_EQUAL(0, actuationLatency.stats().timeouts);
+    motorSerial.onWrite = nullptr;
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stages_of_a_target_change);
+    RUN_TEST(test_repeats_keep_the_change_tracked);
+    RUN_TEST(test_new_target_supersedes_a_pending_change);
+    RUN_TEST(test_unconfirmed_change_times_out);
+    RUN_TEST(test_small_change_completes_at_the_read_back);
+    RUN_TEST(test_distribution_keeps_the_latest_samples);
+    RUN_TEST(test_summary_format);
+    RUN_TEST(test_command_is_followed_through_the_driver);
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "CaptureStream.h"
+#include "MotorController.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static SimMotorDriver *driver;
+
+// Reads the next frame from the stream and returns its decoded bytes
+static size_t nextRecord(CaptureStream &stream, uint8_t *raw) {
+    uint8_t frame[CAPTURE_MAX_FRAME];
+    size_t len = 0;
+    while (len < sizeof(frame) && stream.read(&frame[len], 1) == 1) {
+        if (frame[len] == 0) {
+            return cobsDecode(frame, len, raw);
+        }
+        len++;
+    }
+    return 0;
+}
+
+static uint32_t recordSeq(const uint8_t *raw) {
+    uint32_t seq;
+    memcpy(&seq, &raw[1], sizeof(seq));
+    return seq;
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    captureStream.setMask(0);
+    uint8_t sink[CAPTURE_CHUNK_SIZE];
+    while (captureStream.read(sink, sizeof(sink)) > 0) {
+    }
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_cobs_round_trip() {
+    uint8_t in[600];
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = i < 300 ? (uint8_t)(i % 7) : 0x55; // Zeros first, then a run longer than 254 bytes
+    }
+    uint8_t encoded[sizeof(in) + sizeof(in) / 254 + 2];
+    size_t len = cobsEncode(in, sizeof(in), encoded);
+    TEST_ASSERT_EQUAL(0, encoded[len - 1]);
+    TEST_ASSERT_NULL(memchr(encoded, 0, len - 1));
+
+    uint8_t decoded[sizeof(in)];
+    TEST_ASSERT_EQUAL(sizeof(in), cobsDecode(encoded, len - 1, decoded));
+    TEST_ASSERT_EQUAL_MEMORY(in, decoded, sizeof(in));
+
+    const uint8_t zeros[2] = {0, 0};
+    len = cobsEncode(zeros, sizeof(zeros), encoded);
+    const uint8_t expected[4] = {1, 1, 1, 0};
+    TEST_ASSERT_EQUAL(4, len);
+    TEST_ASSERT_EQUAL_MEMORY(expected, encoded, 4);
+
+    const uint8_t malformed[2] = {5, 1}; // Block longer than the frame
+    TEST_ASSERT_EQUAL(0, cobsDecode(malformed, sizeof(malformed), decoded));
+}
+
+void test_crc16() {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, captureCrc16(check, sizeof(check)));
+}
+
+void test_disabled_by_default() {
+    CaptureStream stream;
+    uint8_t stream_id = 2;
+    TEST_ASSERT_FALSE(stream.record(CAPTURE_CONTROL_TICK, &stream_id, 1, 100));
+    TEST_ASSERT_EQUAL(0, stream.pending());
+    TEST_ASSERT_EQUAL(0, stream.sequence());
+}
+
+void test_record_layout() {
+    CaptureStream stream;
+    stream.setMask(CAPTURE_MASK_ALL);
+    uint8_t stream_id = 2;
+    TEST_ASSERT_TRUE(stream.record(CAPTURE_CONTROL_TICK, &stream_id, 1, 0x01020304));
+
+    uint8_t raw[CAPTURE_MAX_FRAME];
+    size_t len = nextRecord(stream, raw);
+    TEST_ASSERT_EQUAL(CAPTURE_HEADER_SIZE + 1 + CAPTURE_CRC_SIZE, len);
+    TEST_ASSERT_EQUAL(CAPTURE_CONTROL_TICK, raw[0]);
+    TEST_ASSERT_EQUAL(0, recordSeq(raw));
+    uint32_t timestamp;
+    memcpy(&timestamp, &raw[5], sizeof(timestamp));
+    TEST_ASSERT_EQUAL_HEX32(0x01020304, timestamp);
+    TEST_ASSERT_EQUAL(2, raw[CAPTURE_HEADER_SIZE]);
+    uint16_t crc;
+    memcpy(&crc, &raw[len - CAPTURE_CRC_SIZE], sizeof(crc));
+    TEST_ASSERT_EQUAL_HEX16(captureCrc16(raw, len - CAPTURE_CRC_SIZE), crc);
+}
+
+void test_mask_selects_kinds() {
+    CaptureStream stream;
+    stream.setMask(CAPTURE_MASK_MOTOR);
+    const uint8_t frame[10] = {0};
+    float imu[6] = {0};
+    stream.recordIMU(imu, imu);
+    stream.recordTick(1);
+    TEST_ASSERT_EQUAL(0, stream.pending());
+    stream.recordMotorFrame(CAPTURE_MOTOR_RX, frame);
+    TEST_ASSERT_EQUAL(1, stream.sequence());
+}
+
+void test_full_buffer_leaves_sequence_gap() {
+    CaptureStream stream;
+    stream.setMask(CAPTURE_MASK_IMU);
+    float imu[6] = {0.01f, -0.02f, 1.0f, 0.5f, -0.5f, 0.0f};
+    uint32_t offered = 0;
+    while (stream.dropped() == 0) {
+        stream.recordIMU(imu, imu);
+        offered++;
+    }
+    TEST_ASSERT_TRUE(stream.pending() <= CAPTURE_BUFFER_SIZE);
+
+    // Drain what fitted, then the next record shows the gap
+    uint8_t raw[CAPTURE_MAX_FRAME];
+    uint32_t decoded = 0;
+    while (nextRecord(stream, raw) > 0) {
+        TEST_ASSERT_EQUAL(decoded, recordSeq(raw));
+        decoded++;
+    }
+    TEST_ASSERT_EQUAL(offered - 1, decoded);
+    stream.recordIMU(imu, imu);
+    TEST_ASSERT_EQUAL(CAPTURE_HEADER_SIZE + 48 + CAPTURE_CRC_SIZE, nextRecord(stream, raw));
+    TEST_ASSERT_EQUAL(offered, recordSeq(raw));
+}
+
+void test_motor_frames_are_captured() {
+    captureStream.setMask(CAPTURE_MASK_MOTOR);
+    sendMotorCommands(0.2f, 0.0f);
+    uint8_t raw[CAPTURE_MAX_FRAME];
+    size_t len = nextRecord(captureStream, raw);
+    TEST_ASSERT_EQUAL(CAPTURE_HEADER_SIZE + MOTOR_FRAME_SIZE + CAPTURE_CRC_SIZE, len);
+    TEST_ASSERT_EQUAL(CAPTURE_MOTOR_TX, raw[0]);
+    TEST_ASSERT_EQUAL(MOTOR_ID, raw[CAPTURE_HEADER_SIZE]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cobs_round_trip);
+    RUN_TEST(test_crc16);
+    RUN_TEST(test_disabled_by_default);
+    RUN_TEST(test_record_layout);
+    RUN_TEST(test_mask_selects_kinds);
+    RUN_TEST(test_full_buffer_leaves_sequence_gap);
+    RUN_TEST(test_motor_frames_are_captured);
+    return UNITY_END();
+}
@@ -0,0 +1,178 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <Preferences.h>
+#include <unity.h>
+#include "DeferredWork.h"
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static SimMotorDriver *driver;
+static int runs;
+static uint32_t last_arg;
+static bool inhibited_during_run;
+static int32_t target_during_run;
+
+static void recordRun(uint32_t arg) {
+    runs++;
+    last_arg = arg;
+    inhibited_during_run = (motorInhibit & MOTOR_INHIBIT_DEFERRED) != 0;
+    // A cmd_vel arriving while the action runs must not move the wheels
+    sendMotorCommands(0.3f, 0.0f);
+    target_during_run = driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS);
+}
+
+static void otherRun(uint32_t arg) {
+    runs += 10;
+    last_arg = arg;
+}
+
+// Drops queued actions without running them
+static void drainQueue() {
+    DeferredAction action;
+    while (deferredWork.pop(action)) {
+    }
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    runs = 0;
+    last_arg = 0;
+    inhibited_during_run = false;
+    target_during_run = -1;
+    motorInhibit = 0;
+    drainQueue();
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_queue_is_fifo_and_collapses_duplicates() {
+    DeferredWorkQueue queue;
+    DeferredAction a = {"a", recordRun, 1, false};
+    DeferredAction b = {"b", otherRun, 2, false};
+    TEST_ASSERT_TRUE(queue.push(a));
+    TEST_ASSERT_TRUE(queue.push(b));
+    TEST_ASSERT_TRUE(queue.push(a)); // Still pending, not queued again
+    TEST_ASSERT_EQUAL(2, queue.size());
+
+    DeferredAction out;
+    TEST_ASSERT_TRUE(queue.pop(out));
+    TEST_ASSERT_EQUAL_STRING("a", out.name);
+    TEST_ASSERT_TRUE(queue.pop(out));
+    TEST_ASSERT_EQUAL_STRING("b", out.name);
+    TEST_ASSERT_FALSE(queue.pop(out));
+}
+
+void test_full_queue_refuses() {
+    DeferredWorkQueue queue;
+    for (uint32_t i = 0; i < DEFERRED_QUEUE_SIZE; i++) {
+        DeferredAction action = {"n", recordRun, i, false};
+        TEST_ASSERT_TRUE(queue.push(action));
+    }
+    DeferredAction extra = {"n", recordRun, DEFERRED_QUEUE_SIZE, false};
+    TEST_ASSERT_FALSE(queue.push(extra));
+    TEST_ASSERT_EQUAL(1, queue.refused());
+
+    // The ring wraps once the oldest entries are taken
+    DeferredAction out;
+    TEST_ASSERT_TRUE(queue.pop(out));
+    TEST_ASSERT_TRUE(queue.push(extra));
+    for (uint32_t i = 1; i <= DEFERRED_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(queue.pop(out));
+        TEST_ASSERT_EQUAL(i, out.arg);
+    }
+}
+
+void test_motor_stop_before_action() {
+    sendMotorCommands(0.5f, 0.0f);
+    TEST_ASSERT_NOT_EQUAL(0, driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS));
+
+    TEST_ASSERT_TRUE(deferWork("record", recordRun, 7, true));
+    TEST_ASSERT_TRUE(runDeferredWork());
+    TEST_ASSERT_EQUAL(1, runs);
+    TEST_ASSERT_EQUAL(7, last_arg);
+    TEST_ASSERT_TRUE(inhibited_during_run);
+    TEST_ASSERT_EQUAL(0, target_during_run);
+
+    // Commands are accepted again afterwards
+    TEST_ASSERT_EQUAL(0, motorInhibit);
+    TEST_ASSERT_FALSE(runDeferredWork());
+}
+
+void test_action_without_stop_keeps_motors() {
+    sendMotorCommands(0.5f, 0.0f);
+    int32_t target = driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS);
+    deferWork("other", otherRun, 3, false);
+    TEST_ASSERT_TRUE(runDeferredWork());
+    TEST_ASSERT_EQUAL(10, runs);
+    TEST_ASSERT_EQUAL(target, driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS));
+}
+
+void test_reboot_callback_returns_immediately() {
+    std_srvs__srv__Trigger_Request req;
+    std_srvs__srv__Trigger_Response res;
+    memset(&res, 0, sizeof(res));
+    unsigned long start = micros();
+    reboot_callback(&req, &res);
+    TEST_ASSERT_LESS_THAN_FLOAT(EXECUTOR_STALL_BUDGET, (float)(micros() - start));
+    TEST_ASSERT_TRUE(res.success);
+    TEST_ASSERT_EQUAL(strlen(res.message.data), res.message.size);
+
+    // The restart is queued with a motor stop, not run in the callback
+    DeferredAction action;
+    TEST_ASSERT_TRUE(deferredWork.pop(action));
+    TEST_ASSERT_TRUE(action.fn == rebootNow);
+    TEST_ASSERT_TRUE(action.stop_motors);
+}
+
+void test_parameter_is_persisted_by_deferred_work() {
+    Parameter param;
+    memset(&param, 0, sizeof(param));
+    param.name.data = const_cast<char *>(PARAM_WHEEL_PERIOD);
+    param.name.size = strlen(PARAM_WHEEL_PERIOD);
+    param.value.type = RCLC_PARAMETER_INT;
+    param.value.integer_value = 20;
+    TEST_ASSERT_TRUE(on_parameter_changed(NULL, &param, NULL));
+    TEST_ASSERT_EQUAL(20, controlParams.wheel_period_ms);
+
+    // Applied at once, written to NVS only by the deferred work task
+    Preferences prefs;
+    prefs.begin(CONTROL_PREFS_NAMESPACE, true);
+    TEST_ASSERT_FALSE(prefs.isKey("wheel_ms"));
+    TEST_ASSERT_TRUE(runDeferredWork());
+    TEST_ASSERT_EQUAL(20, prefs.getUInt("wheel_ms"));
+    prefs.end();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_queue_is_fifo_and_collapses_duplicates);
+    RUN_TEST(test_full_queue_refuses);
+    RUN_TEST(test_motor_stop_before_action);
+    RUN_TEST(test_action_without_stop_keeps_motors);
+    RUN_TEST(test_reboot_callback_returns_immediately);
+    RUN_TEST(test_parameter_is_persisted_by_deferred_work);
+    return UNITY_END();
+}
@@ -0,0 +1,205 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "EmergencyStop.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const uint32_t LATENCY_LIMIT_US = 1000; // Button edge to stop frames written
+
+static SimMotorDriver *driver;
+
+static int32_t target() {
+    return driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS);
+}
+
+static int32_t controlWord() {
+    return driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS);
+}
+
+// Presses a button and waits for the stop task to latch
+static bool press(uint8_t pin) {
+    uint32_t trips = emergencyStop.stats().trips;
+    nativeSetPin(pin, LOW);
+    unsigned long start = millis();
+    while (millis() - start < 100) {
+        if (emergencyStop.stats().trips != trips) {
+            return true;
+        }
+        delay(1);
+    }
+    return false;
+}
+
+// Runs wheel stream ticks until one reports the re-arm, returns the ticks it took or -1
+static int tickUntilRearmed() {
+    for (int tick = 1; tick <= 20; tick++) {
+        float speed;
+        readSpeedData(motorSerial, MOTOR_ID, speed);
+        if (serviceEmergencyStop() && !emergencyStop.isLatched()) {
+            return tick;
+        }
+    }
+    return -1;
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+    motorSupervisor = MotorSupervisor();
+    motorInhibit = 0;
+    emergencyStop = EmergencyStop();
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    motorSupervisor.start(true, micros());
+    sendMotorCommands(0.5f, 0.0f);
+    TEST_ASSERT_NOT_EQUAL(0, target());
+}
+
+void tearDown() {
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    nativeSetPin(ESTOP_BUTTON_B_PIN, HIGH);
+    nativeSetPin(ESTOP_BUTTON_C_PIN, HIGH);
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_button_stops_and_disables_the_driver() {
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_B_PIN));
+    TEST_ASSERT_EQUAL(0, target());
+    TEST_ASSERT_EQUAL(DISABLE_MOTOR, controlWord());
+    TEST_ASSERT_TRUE(emergencyStop.isLatched());
+    TEST_ASSERT_EQUAL(ESTOP_SOURCE_BUTTON_B, emergencyStop.stats().source);
+    TEST_ASSERT_NOT_EQUAL(0, motorInhibit & MOTOR_INHIBIT_ESTOP);
+    TEST_ASSERT_LESS_THAN(LATENCY_LIMIT_US, emergencyStop.stats().last_latency_us);
+    TEST_ASSERT_TRUE(serviceEmergencyStop());   // Trip event for the wheel stream
+    TEST_ASSERT_FALSE(serviceEmergencyStop());
+}
+
+void test_cmd_vel_and_supervisor_cannot_override_the_latch() {
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_A_PIN));
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    sendMotorCommands(0.5f, 0.0f);
+    TEST_ASSERT_EQUAL(0, target());
+
+    // The disabled driver reports a stop, the paused supervisor does not re-enable it
+    for (int i = 0; i < 20; i++) {
+        pollMotorStatus(MOTOR_ID);
+        float speed;
+        readSpeedData(motorSerial, MOTOR_ID, speed);
+        TEST_ASSERT_FALSE(superviseMotor(motorSerial, MOTOR_ID));
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL(DISABLE_MOTOR, controlWord());
+    TEST_ASSERT_EQUAL(MOTOR_HEALTH_OK, motorSupervisor.health());
+}
+
+void test_repeated_presses_count_as_one_trip() {
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_A_PIN));
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    nativeSetPin(ESTOP_BUTTON_C_PIN, LOW);
+    unsigned long start = millis();
+    while (emergencyStop.stats().triggers < 2 && millis() - start < 100) {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL(2, emergencyStop.stats().triggers);
+    TEST_ASSERT_EQUAL(1, emergencyStop.stats().trips);
+    TEST_ASSERT_EQUAL(ESTOP_SOURCE_BUTTON_A, emergencyStop.stats().source);
+}
+
+void test_rearm_needs_released_inputs_and_enables_the_driver() {
+    std_srvs__srv__Trigger_Request req = {};
+    std_srvs__srv__Trigger_Response res;
+    estop_rearm_callback(&req, &res);
+    TEST_ASSERT_FALSE(res.success);
+    TEST_ASSERT_EQUAL_STRING("Not tripped", res.message.data);
+
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_A_PIN));
+    estop_rearm_callback(&req, &res);
+    TEST_ASSERT_FALSE(res.success);
+    TEST_ASSERT_EQUAL_STRING("E-stop input still active", res.message.data);
+
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    estop_rearm_callback(&req, &res);
+    TEST_ASSERT_TRUE(res.success);
+    TEST_ASSERT_TRUE(emergencyStop.rearmPending());
+    TEST_ASSERT_TRUE(emergencyStop.isLatched());
+
+    // The wheel stream writes one register per tick, the driver is enabled last
+    TEST_ASSERT_TRUE(serviceEmergencyStop());   // Trip event still waiting to be published
+    TEST_ASSERT_TRUE(emergencyStop.isLatched());
+    TEST_ASSERT_NOT_EQUAL(ENABLE_MOTOR, controlWord());
+    TEST_ASSERT_GREATER_THAN(1, tickUntilRearmed());
+    TEST_ASSERT_EQUAL(1, emergencyStop.stats().rearms);
+    TEST_ASSERT_EQUAL(ENABLE_MOTOR, controlWord());
+    TEST_ASSERT_EQUAL(0, target());
+    TEST_ASSERT_EQUAL(0, motorInhibit);
+    sendMotorCommands(0.5f, 0.0f);
+    TEST_ASSERT_NOT_EQUAL(0, target());
+}
+
+void test_trip_during_rearm_keeps_the_latch() {
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_A_PIN));
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    TEST_ASSERT_TRUE(requestEmergencyStopRearm());
+    serviceEmergencyStop();  // Starts the enable sequence
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_C_PIN));
+    TEST_ASSERT_EQUAL(-1, tickUntilRearmed());
+    TEST_ASSERT_FALSE(emergencyStop.rearmPending());
+    TEST_ASSERT_EQUAL(DISABLE_MOTOR, controlWord());
+    TEST_ASSERT_EQUAL(2, emergencyStop.stats().trips);
+}
+
+void test_glitch_on_button_a_is_ignored() {
+    // GPIO39 reports a falling edge while the button stays released
+    nativeSetPin(ESTOP_BUTTON_A_PIN, LOW);
+    nativeSetPin(ESTOP_BUTTON_A_PIN, HIGH);
+    unsigned long start = millis();
+    while (emergencyStop.stats().ignored == 0 && millis() - start < 100) {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL(1, emergencyStop.stats().ignored);
+    TEST_ASSERT_EQUAL(0, emergencyStop.stats().trips);
+    TEST_ASSERT_FALSE(emergencyStop.isLatched());
+    TEST_ASSERT_EQUAL(0, motorInhibit);
+    TEST_ASSERT_NOT_EQUAL(0, target());
+}
+
+void test_summary_format() {
+    TEST_ASSERT_TRUE(press(ESTOP_BUTTON_C_PIN));
+    char buf[ESTOP_BUFFER_SIZE];
+    emergencyStop.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "estop=tripped source=button_c trips=1 triggers=1 ignored=0 rearms=0 latency_us="));
+}
+
+int main() {
+    startEmergencyStopTask();
+    UNITY_BEGIN();
+    RUN_TEST(test_button_stops_and_disables_the_driver);
+    RUN_TEST(test_cmd_vel_and_supervisor_cannot_override_the_latch);
+    RUN_TEST(test_repeated_presses_count_as_one_trip);
+    RUN_TEST(test_rearm_needs_released_inputs_and_enables_the_driver);
+    RUN_TEST(test_trip_during_rearm_keeps_the_latch);
+    RUN_TEST(test_glitch_on_button_a_is_ignored);
+    RUN_TEST(test_summary_format);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unity.h>
+#include "FilterBank.h"
+
+static const float SAMPLE_HZ = 50.0f; // Sample rate the test responses are designed for
+
+// Drives a sine through axis 0 and measures the steady-state gain and phase
+// by correlating the output with sine and cosine at the same frequency
+static void measureResponse(FilterBank &bank, float freq_hz, float &gain, float &phase) {
+    const int settle = 2000;
+    const int cycles = 20;
+    const int samples = (int)(cycles * SAMPLE_HZ / freq_hz);
+    float in[FILTER_AXES] = {0};
+    float out[FILTER_AXES];
+    double re = 0.0, im = 0.0;
+    bank.reset();
+    for (int n = 0; n < settle + samples; n++) {
+        double w = 2.0 * M_PI * freq_hz * n / SAMPLE_HZ;
+        in[0] = (float)sin(w);
+        bank.process(in, out);
+        if (n >= settle) {
+            re += out[0] * sin(w);
+            im += out[0] * cos(w);
+        }
+    }
+    gain = (float)(2.0 * sqrt(re * re + im * im) / samples);
+    phase = (float)atan2(im, re);
+}
+
+// Frequency response of the configured sections computed from the coefficients
+static void analyticResponse(const BiquadCoefficients *sections, int count, float freq_hz, float &gain, float &phase) {
+    double w = 2.0 * M_PI * freq_hz / SAMPLE_HZ;
+    double re = 1.0, im = 0.0;
+    for (int i = 0; i < count; i++) {
+        const BiquadCoefficients &c = sections[i];
+        // H = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2) with z = e^{jw}
+        double nr = c.b0 + c.b1 * cos(w) + c.b2 * cos(2 * w);
+        double ni = -c.b1 * sin(w) - c.b2 * sin(2 * w);
+        double dr = 1.0 + c.a1 * cos(w) + c.a2 * cos(2 * w);
+        double di = -c.a1 * sin(w) - c.a2 * sin(2 * w);
+        double hr = (nr * dr + ni * di) / (dr * dr + di * di);
+        double hi = (ni * dr - nr * di) / (dr * dr + di * di);
+        double r = re * hr - im * hi;
+        im = re * hi + im * hr;
+        re = r;
+    }
+    gain = (float)sqrt(re * re + im * im);
+    phase = (float)atan2(im, re);
+}
+
+void test_butterworth_gain() {
+    FilterBank bank;
+    bank.configureAxis(0, SAMPLE_HZ, 10.0f, 4, 0.0f, 0.0f);
+    float gain, phase;
+
+    measureResponse(bank, 0.5f, gain, phase);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.0f, gain);
+
+    // -3 dB at the cutoff
+    measureResponse(bank, 10.0f, gain, phase);
+    TEST_ASSERT_FLOAT_WITHIN(0.03f, 0.7071f, gain);
+
+    // Fourth order roll-off well above the cutoff
+    measureResponse(bank, 20.0f, gain, phase);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.1f, gain);
+}
+
+void test_phase_matches_design() {
+    FilterBank bank;
+    bank.configureAxis(0, SAMPLE_HZ, 10.0f, 4, 0.0f, 0.0f);
+    BiquadCoefficients sections[2] = {
+        designLowPass(10.0f, SAMPLE_HZ, 0.54119610f),
+        designLowPass(10.0f, SAMPLE_HZ, 1.30656296f),
+    };
+    const float freqs[] = {1.0f, 2.0f, 5.0f, 8.0f};
+    for (float f : freqs) {
+        float gain, phase, expected_gain, expected_phase;
+        measureResponse(bank, f, gain, phase);
+        analyticResponse(sections, 2, f, expected_gain, expected_phase);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, expected_gain, gain);
+        TEST_ASSERT_FLOAT_WITHIN(0.02f, expected_phase, phase);
+    }
+}
+
+void test_less_lag_than_single_pole() {
+    // The previous filter: y += 0.1 * (x - y) at 50 Hz
+    const float f = 2.0f;
+    double w = 2.0 * M_PI * f / SAMPLE_HZ;
+    double ema_phase = -atan2(0.9 * sin(w), 1.0 - 0.9 * cos(w));
+
+    FilterBank bank;
+    bank.configureAxis(0, SAMPLE_HZ, 10.0f, 4, 0.0f, 0.0f);
+    float gain, phase;
+    measureResponse(bank, f, gain, phase);
+    TEST_ASSERT_GREATER_THAN_FLOAT((float)ema_phase, phase);
+}
+
+void test_notch_rejects_center() {
+    FilterBank bank;
+    bank.configureAxis(0, SAMPLE_HZ, 0.0f, 4, 15.0f, 2.0f);
+    float gain, phase;
+    measureResponse(bank, 15.0f, gain, phase);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.01f, gain);
+    measureResponse(bank, 2.0f, gain, phase);
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.0f, gain);
+}
+
+void test_axes_are_independent() {
+    FilterBank bank;
+    bank.configureAxis(0, SAMPLE_HZ, 2.0f, 2, 0.0f, 0.0f);
+    bank.configureAxis(5, SAMPLE_HZ, 20.0f, 2, 0.0f, 0.0f);
+    float in[FILTER_AXES] = {0};
+    float out[FILTER_AXES];
+    for (int n = 0; n < 3; n++) {
+        for (int axis = 0; axis < FILTER_AXES; axis++) {
+            in[axis] = 1.0f;
+        }
+        bank.process(in, out);
+    }
+    // Unconfigured axes pass through, the faster axis settles sooner
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, out[2]);
+    TEST_ASSERT_GREATER_THAN_FLOAT(out[0], out[5]);
+}
+
+void test_prime_avoids_transient() {
+    FilterBank bank;
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        bank.configureAxis(axis, SAMPLE_HZ, 5.0f, 4, 12.0f, 2.0f);
+    }
+    float in[FILTER_AXES] = {0.0f, 0.0f, 1.0f, 0.5f, -0.5f, 3.0f};
+    float out[FILTER_AXES];
+    bank.prime(in);
+    bank.process(in, out);
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, in[axis], out[axis]);
+    }
+}
+
+void test_cost_per_sample() {
+    FilterBank bank;
+    for (int axis = 0; axis < FILTER_AXES; axis++) {
+        bank.configureAxis(axis, SAMPLE_HZ, 10.0f, 4, 15.0f, 2.0f);
+    }
+    const int samples = 1000000;
+    float in[FILTER_AXES] = {0.1f, 0.2f, 1.0f, 0.3f, 0.4f, 0.5f};
+    float out[FILTER_AXES];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < samples; n++) {
+        in[0] = (float)(n & 7);
+        bank.process(in, out);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / samples;
+
+    char message[96];
+    snprintf(message, sizeof(message), "%.1f ns per 6-axis sample with 3 sections (out %.3f)", ns, out[0]);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN_DOUBLE(1000.0, ns);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_butterworth_gain);
+    RUN_TEST(test_phase_matches_design);
+    RUN_TEST(test_less_lag_than_single_pole);
+    RUN_TEST(test_notch_rejects_center);
+    RUN_TEST(test_axes_are_independent);
+    RUN_TEST(test_prime_avoids_transient);
+    RUN_TEST(test_cost_per_sample);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "ImuBatch.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static std::vector<std::vector<uint8_t>> batches; // Payloads published on /imu/raw_batch
+static int imu_messages;                           // Messages published on /imu/data_raw
+
+void setUp() {
+    batches.clear();
+    imu_messages = 0;
+    nativePublishHook = [](const rcl_publisher_t *pub, const void *msg) {
+        if (strcmp(pub->topic, "/imu/raw_batch") == 0) {
+            const std_msgs__msg__UInt8MultiArray *batch = (const std_msgs__msg__UInt8MultiArray *)msg;
+            batches.emplace_back(batch->data.data, batch->data.data + batch->data.size);
+        } else if (strcmp(pub->topic, "/imu/data_raw") == 0) {
+            imu_messages++;
+        }
+    };
+    rcl_node_t node;
+    initializeIMU(&node);
+    imuBatch.clear();
+    controlParams.imu_format = IMU_FORMAT_RAW_BATCH;
+    M5.IMU.accel[0] = 0.5f;
+    M5.IMU.accel[1] = -0.25f;
+    M5.IMU.accel[2] = 1.0f;
+    M5.IMU.gyro[0] = 100.0f;
+    M5.IMU.gyro[1] = -2000.0f;
+    M5.IMU.gyro[2] = 0.0f;
+}
+
+void tearDown() {
+    nativePublishHook = nullptr;
+    controlParams.imu_format = IMU_FORMAT;
+}
+
+static ImuBatchHeader headerOf(const std::vector<uint8_t> &batch) {
+    ImuBatchHeader header;
+    memcpy(&header, batch.data(), sizeof(header));
+    return header;
+}
+
+static ImuBatchSample sampleOf(const std::vector<uint8_t> &batch, size_t index) {
+    ImuBatchSample sample;
+    memcpy(&sample, batch.data() + sizeof(ImuBatchHeader) + index * sizeof(ImuBatchSample), sizeof(sample));
+    return sample;
+}
+
+void test_batch_carries_every_sample_in_counts() {
+    for (int i = 0; i < 4; i++) {
+        imu_sample_callback();
+        delay(2);
+    }
+    imu_publish_callback();
+
+    TEST_ASSERT_EQUAL(0, imu_messages);
+    TEST_ASSERT_EQUAL(1, batches.size());
+    TEST_ASSERT_EQUAL(sizeof(ImuBatchHeader) + 4 * sizeof(ImuBatchSample), batches[0].size());
+    ImuBatchHeader header = headerOf(batches[0]);
+    TEST_ASSERT_EQUAL(IMU_BATCH_VERSION, header.version);
+    TEST_ASSERT_EQUAL(4, header.count);
+    TEST_ASSERT_EQUAL(0, header.dropped);
+    TEST_ASSERT_EQUAL(8, header.accel_range_g);
+    TEST_ASSERT_EQUAL(2000, header.gyro_range_dps);
+    TEST_ASSERT_EQUAL(controlParams.imu_sample_period_ms * 1000, header.period_us);
+
+    uint32_t previous_age = UINT32_MAX;
+    for (int i = 0; i < 4; i++) {
+        ImuBatchSample sample = sampleOf(batches[0], i);
+        TEST_ASSERT_EQUAL_INT16(2048, sample.raw[0]);    // 0.5 g at 8 g full scale
+        TEST_ASSERT_EQUAL_INT16(-1024, sample.raw[1]);
+        TEST_ASSERT_EQUAL_INT16(4096, sample.raw[2]);
+        TEST_ASSERT_EQUAL_INT16(1638, sample.raw[3]);    // 100 deg/s at 2000 deg/s full scale
+        TEST_ASSERT_EQUAL_INT16(-32768, sample.raw[4]);
+        TEST_ASSERT_EQUAL_INT16(0, sample.raw[5]);
+        TEST_ASSERT_LESS_THAN(previous_age, sample.age_us); // Oldest sample first
+        previous_age = sample.age_us;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(6000u, sampleOf(batches[0], 0).age_us);
+}
+
+void test_sequence_and_dropped_samples() {
+    for (int i = 0; i < IMU_BATCH_MAX_SAMPLES + 3; i++) {
+        imu_sample_callback();
+    }
+    imu_publish_callback();
+    imu_sample_callback();
+    imu_publish_callback();
+
+    TEST_ASSERT_EQUAL(2, batches.size());
+    ImuBatchHeader first = headerOf(batches[0]);
+    ImuBatchHeader second = headerOf(batches[1]);
+    TEST_ASSERT_EQUAL(IMU_BATCH_MAX_SAMPLES, first.count);
+    TEST_ASSERT_EQUAL(3, first.dropped);
+    TEST_ASSERT_EQUAL(1, second.count);
+    TEST_ASSERT_EQUAL(0, second.dropped);
+    TEST_ASSERT_EQUAL(first.seq + 1, second.seq);
+    TEST_ASSERT_TRUE(second.stamp_ns > first.stamp_ns);
+}
+
+void test_filtered_format_is_unchanged() {
+    controlParams.imu_format = IMU_FORMAT_FILTERED;
+    imu_sample_callback();
+    imu_publish_callback();
+    TEST_ASSERT_EQUAL(1, imu_messages);
+    TEST_ASSERT_EQUAL(0, batches.size());
+    TEST_ASSERT_EQUAL(0, imuBatch.count()); // Samples are not collected for nobody
+}
+
+void test_calibration_is_sent_in_counts() {
+    int16_t offset[6] = {1, -2, 3, -4, 5, -6};
+    imuBatch.configure(4, 500, offset);
+    imu_sample_callback();
+    imu_publish_callback();
+    ImuBatchHeader header = headerOf(batches[0]);
+    TEST_ASSERT_EQUAL(4, header.accel_range_g);
+    TEST_ASSERT_EQUAL(500, header.gyro_range_dps);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(offset, header.offset, 6);
+}
+
+void test_full_batch_is_ten_times_denser() {
+    // CDR size of the filtered message: stamp, frame_id "imu", three vectors and three covariances
+    const size_t imu_message_bytes = 8 + 4 + 4 + (32 + 72) + (24 + 72) + (24 + 72);
+    const size_t batch_bytes_per_sample = IMU_BATCH_BUFFER_SIZE / IMU_BATCH_MAX_SAMPLES;
+    TEST_ASSERT_LESS_OR_EQUAL(imu_message_bytes / 10, batch_bytes_per_sample);
+    // Best-effort messages are not fragmented, a full batch must fit the 512-byte serial MTU
+    TEST_ASSERT_LESS_THAN(512u, IMU_BATCH_BUFFER_SIZE + 12u);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_carries_every_sample_in_counts);
+    RUN_TEST(test_sequence_and_dropped_samples);
+    RUN_TEST(test_filtered_format_is_unchanged);
+    RUN_TEST(test_calibration_is_sent_in_counts);
+    RUN_TEST(test_full_batch_is_ten_times_denser);
+    return UNITY_END();
+}
@@ -0,0 +1,195 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "LinkMonitor.h"
+
+static const uint32_t PING_US = 50000; // 20 Hz host pings
+static const uint32_t RTT_US = 4000;   // Round trip of the simulated link
+
+// Host that echoes back immediately, so every ping after the first carries an RTT
+static uint32_t ping(LinkMonitor &monitor, uint32_t seq, uint32_t now_us, uint32_t rtt_us = RTT_US) {
+    uint32_t hold = seq == 0 ? LINK_NO_ECHO : 0;
+    monitor.onPing(seq, now_us - rtt_us, hold, now_us);
+    return now_us + PING_US;
+}
+
+static LinkMonitor makeMonitor(uint32_t start_us) {
+    LinkMonitor monitor;
+    monitor.configure(LINK_MAX_RTT * 1000UL, LINK_MAX_LOSS * 10, LINK_TIMEOUT * 1000UL);
+    monitor.evaluate(start_us);
+    return monitor;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_clean_link() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    for (uint32_t seq = 0; seq < 20; seq++) {
+        t = ping(monitor, seq, t);
+    }
+    TEST_ASSERT_TRUE(monitor.evaluate(LINK_WINDOW * 1000UL));
+    const LinkWindowStats &w = monitor.stats();
+    TEST_ASSERT_EQUAL_UINT32(20, w.pings);
+    TEST_ASSERT_EQUAL_UINT32(0, w.lost);
+    TEST_ASSERT_EQUAL_UINT32(19, w.rtt_count);
+    TEST_ASSERT_EQUAL_UINT32(RTT_US, w.rtt_min_us);
+    TEST_ASSERT_EQUAL_UINT32(RTT_US, w.rtt_p99_us);
+    TEST_ASSERT_TRUE(monitor.isActive());
+    TEST_ASSERT_FALSE(monitor.isDegraded());
+}
+
+void test_loss_and_reorder() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    const uint32_t order[] = {0, 1, 2, 4, 3, 5, 8, 9}; // 3 late, 6 and 7 lost
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        t = ping(monitor, order[i], t);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    const LinkWindowStats &w = monitor.stats();
+    TEST_ASSERT_EQUAL_UINT32(8, w.pings);
+    TEST_ASSERT_EQUAL_UINT32(2, w.lost);
+    TEST_ASSERT_EQUAL_UINT32(1, w.reordered);
+    TEST_ASSERT_EQUAL_UINT16(200, w.loss_permille);
+    TEST_ASSERT_FALSE(monitor.isDegraded()); // Exactly at the limit
+}
+
+void test_heavy_loss_degrades_and_recovers() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    for (uint32_t seq = 0; seq < 20; seq += 2) {
+        t = ping(monitor, seq, t);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    TEST_ASSERT_TRUE(monitor.isDegraded());
+
+    t = LINK_WINDOW * 1000UL + 1000;
+    for (uint32_t seq = 20; seq < 40; seq++) {
+        t = ping(monitor, seq, t);
+    }
+    monitor.evaluate(2 * LINK_WINDOW * 1000UL);
+    TEST_ASSERT_FALSE(monitor.isDegraded());
+}
+
+void test_rtt_p99_and_hold() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    monitor.onPing(0, 0, LINK_NO_ECHO, t);
+    for (uint32_t seq = 1; seq <= 100; seq++) {
+        t += 5000;
+        uint32_t rtt = seq == 50 ? 300000 : 2000 + seq; // One outlier above LINK_MAX_RTT
+        // The host held the echo for 1 ms, which must not count as link time
+        monitor.onPing(seq, t - rtt - 1000, 1000, t);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    const LinkWindowStats &w = monitor.stats();
+    TEST_ASSERT_EQUAL_UINT32(100, w.rtt_count);
+    TEST_ASSERT_EQUAL_UINT32(2001, w.rtt_min_us);
+    TEST_ASSERT_EQUAL_UINT32(2100, w.rtt_p99_us);
+    TEST_ASSERT_FALSE(monitor.isDegraded()); // A single outlier stays above the 99th percentile
+}
+
+void test_slow_link_degrades() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    for (uint32_t seq = 0; seq < 20; seq++) {
+        t = ping(monitor, seq, t, (LINK_MAX_RTT + 50) * 1000UL);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    TEST_ASSERT_TRUE(monitor.isDegraded());
+}
+
+void test_rtt_overflow_keeps_largest() {
+    LinkMonitor monitor = makeMonitor(0);
+    uint32_t t = 1000;
+    monitor.onPing(0, 0, LINK_NO_ECHO, t);
+    for (uint32_t seq = 1; seq <= 4 * LINK_MAX_RTT_SAMPLES; seq++) {
+        t += 1000;
+        uint32_t rtt = seq % 50 == 0 ? 9000 : 1000; // 2% outliers, spread over the window
+        monitor.onPing(seq, t - rtt, 0, t);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    TEST_ASSERT_EQUAL_UINT32(4 * LINK_MAX_RTT_SAMPLES, monitor.stats().rtt_count);
+    TEST_ASSERT_EQUAL_UINT32(9000, monitor.stats().rtt_p99_us);
+}
+
+void test_ping_timeout() {
+    LinkMonitor monitor = makeMonitor(0);
+    ping(monitor, 0, 1000);
+    TEST_ASSERT_FALSE(monitor.evaluate(LINK_TIMEOUT * 1000UL / 2));
+    TEST_ASSERT_FALSE(monitor.isDegraded());
+    // Degraded as soon as the timeout expires, before the window closes
+    monitor.evaluate(LINK_TIMEOUT * 1000UL + 2000);
+    TEST_ASSERT_TRUE(monitor.isDegraded());
+}
+
+void test_inactive_is_never_degraded() {
+    LinkMonitor monitor = makeMonitor(0);
+    for (uint32_t t = 1; t <= 5; t++) {
+        monitor.evaluate(t * LINK_WINDOW * 1000UL);
+    }
+    TEST_ASSERT_FALSE(monitor.isActive());
+    TEST_ASSERT_FALSE(monitor.isDegraded());
+}
+
+void test_cmd_vel_gaps() {
+    LinkMonitor monitor = makeMonitor(0);
+    const uint32_t arrivals_ms[] = {0, 50, 100, 450, 500, 550, 900};
+    for (size_t i = 0; i < sizeof(arrivals_ms) / sizeof(arrivals_ms[0]); i++) {
+        monitor.onCmdVel(arrivals_ms[i] * 1000UL);
+    }
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    const LinkWindowStats &w = monitor.stats();
+    TEST_ASSERT_EQUAL_UINT32(7, w.cmd_vel_count);
+    TEST_ASSERT_EQUAL_UINT32(2, w.cmd_vel_gaps);
+    TEST_ASSERT_EQUAL_UINT32(350000, w.cmd_vel_gap_max_us);
+}
+
+void test_summary() {
+    LinkMonitor monitor = makeMonitor(0);
+    char buf[LINK_BUFFER_SIZE];
+    monitor.evaluate(LINK_WINDOW * 1000UL);
+    monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "link=inactive"));
+
+    uint32_t t = LINK_WINDOW * 1000UL + 1000;
+    for (uint32_t seq = 0; seq < 3; seq++) {
+        t = ping(monitor, seq, t);
+    }
+    monitor.evaluate(2 * LINK_WINDOW * 1000UL);
+    monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "link=ok pings=3 lost=0"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "rtt_p99_us=4000"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_link);
+    RUN_TEST(test_loss_and_reorder);
+    RUN_TEST(test_heavy_loss_degrades_and_recovers);
+    RUN_TEST(test_rtt_p99_and_hold);
+    RUN_TEST(test_slow_link_degrades);
+    RUN_TEST(test_rtt_overflow_keeps_largest);
+    RUN_TEST(test_ping_timeout);
+    RUN_TEST(test_inactive_is_never_degraded);
+    RUN_TEST(test_cmd_vel_gaps);
+    RUN_TEST(test_summary);
+    return UNITY_END();
+}
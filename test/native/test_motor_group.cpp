@@ -0,0 +1,240 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "MotorController.h"
+#include "MotorGroup.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const float SPEED_TOLERANCE = 0.01f; // Above the whole-RPM quantization of the speed register
+static const uint32_t FRAME_US = 868;       // MOTOR_FRAME_TX_US at 115200 baud
+
+static SimMotorDriver *driver;
+
+static const MotorConfig MECANUM[] = {
+    {1, 0.1f, 0.1f, -1.0f, 1.0f},
+    {2, 0.1f, -0.1f, 1.0f, 1.0f},
+    {3, -0.1f, 0.1f, -1.0f, -1.0f},
+    {4, -0.1f, -0.1f, 1.0f, -1.0f},
+};
+
+static int32_t target(uint8_t id) {
+    return driver->registerValue(id, TARGET_VELOCITY_DEC_ADDRESS);
+}
+
+static void runCycles(int cycles) {
+    for (int i = 0; i < cycles; i++) {
+        runMotorBusCycle(motorSerial, micros());
+    }
+}
+
+// Reports every target back as the measured speed
+static void echoTargets(MotorGroup &group) {
+    for (uint8_t i = 0; i < group.count(); i++) {
+        group.onReply(i, group.target(i), 0);
+    }
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    driver->setTimeConstant(0.0f); // Wheels reach their target by the next read
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+    motorInhibit = 0;
+    motorGroup = MotorGroup();
+    TEST_ASSERT_TRUE(initMotorGroup(motorSerial));
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_plan_interleaves_a_write_and_read_slot_per_driver() {
+    MotorGroup group;
+    TEST_ASSERT_TRUE(group.configure(MECANUM, 4, FRAME_US));
+    TEST_ASSERT_EQUAL(8, group.slotCount());
+    uint32_t offset = 0;
+    for (uint8_t s = 0; s < group.slotCount(); s++) {
+        const MotorSlot &slot = group.slot(s);
+        TEST_ASSERT_EQUAL(s % 2 == 0 ? MOTOR_SLOT_WRITE : MOTOR_SLOT_READ, slot.type);
+        TEST_ASSERT_EQUAL(s / 2, slot.motor);
+        TEST_ASSERT_EQUAL(offset, slot.offset_us);
+        offset += slot.length_us;
+    }
+    // The read slot holds the request, the driver latency and the reply
+    TEST_ASSERT_EQUAL(FRAME_US + MOTOR_BUS_GUARD_US, group.slot(0).length_us);
+    TEST_ASSERT_EQUAL(2 * FRAME_US + MOTOR_BUS_REPLY_LATENCY_US + MOTOR_BUS_GUARD_US, group.slot(1).length_us);
+    TEST_ASSERT_EQUAL(offset, group.cycleLength());
+    TEST_ASSERT_TRUE(group.fits(20000));
+    TEST_ASSERT_FALSE(group.fits(10000));
+}
+
+void test_configure_rejects_empty_and_oversized_groups() {
+    MotorConfig many[MOTOR_GROUP_MAX + 1];
+    memset(many, 0, sizeof(many));
+    MotorGroup group;
+    TEST_ASSERT_FALSE(group.configure(many, 0, FRAME_US));
+    TEST_ASSERT_FALSE(group.configure(many, MOTOR_GROUP_MAX + 1, FRAME_US));
+    TEST_ASSERT_EQUAL(0, group.count());
+    TEST_ASSERT_EQUAL(0, group.cycleLength());
+}
+
+void test_skid_layout_matches_the_wheel_boards() {
+    float linear = 0.4f, angular = 0.8f;
+    motorGroup.setTwist(linear, 0.0f, angular);
+    float left = -(linear - controlParams.wheel_distance * angular / 2);
+    float right = linear + controlParams.wheel_distance * angular / 2;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, left, motorGroup.target(0));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, right, motorGroup.target(1));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, left, motorGroup.target(2));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, right, motorGroup.target(3));
+}
+
+void test_estimate_inverts_mecanum_kinematics() {
+    MotorGroup group;
+    group.configure(MECANUM, 4, FRAME_US);
+    group.setTwist(0.3f, -0.2f, 0.5f);
+    echoTargets(group);
+    float vx, vy, wz;
+    TEST_ASSERT_TRUE(group.estimateTwist(vx, vy, wz));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.3f, vx);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, -0.2f, vy);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.5f, wz);
+
+    // Three answered wheels still determine the twist
+    group.onMiss(2);
+    TEST_ASSERT_TRUE(group.estimateTwist(vx, vy, wz));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.3f, vx);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, -0.2f, vy);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.5f, wz);
+}
+
+void test_estimate_of_a_skid_base_has_no_lateral_velocity() {
+    float vx, vy, wz;
+    TEST_ASSERT_FALSE(motorGroup.estimateTwist(vx, vy, wz));
+    motorGroup.setTwist(0.5f, 0.0f, -0.4f);
+    echoTargets(motorGroup);
+    TEST_ASSERT_TRUE(motorGroup.estimateTwist(vx, vy, wz));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.5f, vx);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, vy);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, -0.4f, wz);
+}
+
+static void sameSpeedKinematics(const MotorConfig *configs, uint8_t count,
+                                float vx, float vy, float wz, float *targets) {
+    (void)configs;
+    (void)vy;
+    (void)wz;
+    for (uint8_t i = 0; i < count; i++) {
+        targets[i] = vx;
+    }
+}
+
+void test_kinematics_hook_replaces_the_planar_model() {
+    motorGroup.setKinematics(sameSpeedKinematics);
+    motorGroup.setTwist(0.25f, 0.0f, 1.0f);
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        TEST_ASSERT_EQUAL_FLOAT(0.25f, motorGroup.target(i));
+    }
+    motorGroup.setKinematics(nullptr);
+    motorGroup.setTwist(0.25f, 0.0f, 0.0f);
+    TEST_ASSERT_EQUAL_FLOAT(-0.25f, motorGroup.target(0));
+}
+
+void test_bus_cycle_writes_and_reads_every_driver() {
+    sendMotorCommands(0.4f, 0.6f); // Routed to the group in bus builds
+    uint32_t start = micros();
+    runCycles(3);
+    TEST_ASSERT_GREATER_OR_EQUAL(3 * motorGroup.cycleLength(), micros() - start);
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        uint8_t id = motorGroup.config(i).id;
+        TEST_ASSERT_EQUAL((int32_t)velocityToDEC(motorGroup.target(i)), target(id));
+        const MotorFeedback &f = motorGroup.feedback(i);
+        TEST_ASSERT_TRUE(f.valid);
+        TEST_ASSERT_EQUAL(3, f.replies);
+        TEST_ASSERT_EQUAL(0, f.misses);
+        TEST_ASSERT_FLOAT_WITHIN(SPEED_TOLERANCE, motorGroup.target(i), f.speed);
+    }
+    float vx, vy, wz;
+    TEST_ASSERT_TRUE(motorGroup.estimateTwist(vx, vy, wz));
+    TEST_ASSERT_FLOAT_WITHIN(SPEED_TOLERANCE, 0.4f, vx);
+    TEST_ASSERT_FLOAT_WITHIN(10 * SPEED_TOLERANCE, 0.6f, wz);
+}
+
+void test_silent_driver_misses_without_shifting_the_others() {
+    driver->setOnline(3, false);
+    sendMotorTwist(0.3f, 0.0f, 0.0f);
+    runCycles(2);
+    TEST_ASSERT_FALSE(motorGroup.feedback(2).valid);
+    TEST_ASSERT_EQUAL(2, motorGroup.feedback(2).misses);
+    TEST_ASSERT_EQUAL(0, target(3));
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        if (i != 2) {
+            TEST_ASSERT_TRUE(motorGroup.feedback(i).valid);
+            TEST_ASSERT_FLOAT_WITHIN(SPEED_TOLERANCE, motorGroup.target(i), motorGroup.feedback(i).speed);
+        }
+    }
+    // One left wheel against two right ones, its quantization weighs more
+    float vx, vy, wz;
+    TEST_ASSERT_TRUE(motorGroup.estimateTwist(vx, vy, wz));
+    TEST_ASSERT_FLOAT_WITHIN(2 * SPEED_TOLERANCE, 0.3f, vx);
+}
+
+void test_inhibit_writes_zero_and_clears_the_targets() {
+    sendMotorTwist(0.5f, 0.0f, 0.0f);
+    runCycles(1);
+    TEST_ASSERT_NOT_EQUAL(0, target(4));
+    inhibitMotors(MOTOR_INHIBIT_LINK);
+    sendMotorTwist(0.5f, 0.0f, 0.0f);
+    runCycles(1);
+    for (uint8_t i = 0; i < motorGroup.count(); i++) {
+        TEST_ASSERT_EQUAL(0, target(motorGroup.config(i).id));
+    }
+    // Released wheels wait for the next command
+    releaseMotors(MOTOR_INHIBIT_LINK);
+    runCycles(1);
+    TEST_ASSERT_EQUAL(0, target(1));
+}
+
+void test_summary_format() {
+    runCycles(1);
+    char buf[MOTOR_GROUP_BUFFER_SIZE];
+    motorGroup.summarize(buf, sizeof(buf));
+    char expected[64];
+    snprintf(expected, sizeof(expected), "motors=4 cycle_us=%u id1=1/0 id2=1/0 id3=1/0 id4=1/0",
+             (unsigned)motorGroup.cycleLength());
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_plan_interleaves_a_write_and_read_slot_per_driver);
+    RUN_TEST(test_configure_rejects_empty_and_oversized_groups);
+    RUN_TEST(test_skid_layout_matches_the_wheel_boards);
+    RUN_TEST(test_estimate_inverts_mecanum_kinematics);
+    RUN_TEST(test_estimate_of_a_skid_base_has_no_lateral_velocity);
+    RUN_TEST(test_kinematics_hook_replaces_the_planar_model);
+    RUN_TEST(test_bus_cycle_writes_and_reads_every_driver);
+    RUN_TEST(test_silent_driver_misses_without_shifting_the_others);
+    RUN_TEST(test_inhibit_writes_zero_and_clears_the_targets);
+    RUN_TEST(test_summary_format);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include "MotorController.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static SimMotorDriver *driver;
+static std::vector<std::vector<uint8_t>> writes; // Frames written to motorSerial
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    auto driverWrite = motorSerial.onWrite;
+    writes.clear();
+    motorSerial.onWrite = [driverWrite](const uint8_t *buf, size_t len) {
+        writes.emplace_back(buf, buf + len);
+        driverWrite(buf, len);
+    };
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_init_verifies_every_register() {
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    TEST_ASSERT_EQUAL(MOTOR_INIT_OK, motorInitResult.error);
+    TEST_ASSERT_EQUAL(OPERATION_MODE_SPEED_CONTROL, driver->registerValue(MOTOR_ID, OPERATION_MODE_ADDRESS));
+    TEST_ASSERT_EQUAL(DISABLE_EMERGENCY_STOP, driver->registerValue(MOTOR_ID, EMERGENCY_STOP_ADDRESS));
+    TEST_ASSERT_EQUAL(ENABLE_MOTOR, driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS));
+
+    // Each step is the precomputed write followed by its read-back request
+    TEST_ASSERT_EQUAL(6, writes.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(OPERATION_MODE_FRAME.bytes, writes[0].data(), MOTOR_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(EMERGENCY_STOP_FRAME.bytes, writes[2].data(), MOTOR_FRAME_SIZE);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ENABLE_MOTOR_FRAME.bytes, writes[4].data(), MOTOR_FRAME_SIZE);
+    MotorFrame readBack = motorReadFrame<ControlWordRegister>(MOTOR_ID);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(readBack.bytes, writes[5].data(), MOTOR_FRAME_SIZE);
+
+    // Replies arrive immediately, so no step waits for the timeout
+    TEST_ASSERT_LESS_THAN_FLOAT(MOTOR_REPLY_TIMEOUT * 1000.0f, (float)motorInitResult.duration_us);
+}
+
+void test_init_retries_lost_frames() {
+    driver->dropNextFrames(2); // The first write and its read-back are lost
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    TEST_ASSERT_EQUAL(8, writes.size());
+    TEST_ASSERT_EQUAL(ENABLE_MOTOR, driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS));
+}
+
+void test_init_reports_timeout() {
+    driver->setOnline(false);
+    TEST_ASSERT_FALSE(initMotor(motorSerial, MOTOR_ID));
+    TEST_ASSERT_EQUAL(MOTOR_INIT_TIMEOUT, motorInitResult.error);
+    TEST_ASSERT_EQUAL(OPERATION_MODE_ADDRESS, motorInitResult.address);
+    TEST_ASSERT_EQUAL(MOTOR_INIT_ATTEMPTS, motorInitResult.attempts);
+    TEST_ASSERT_EQUAL(2 * MOTOR_INIT_ATTEMPTS, writes.size()); // Later steps are not attempted
+    // The timeout is counted in whole milliseconds, each wait may end up to 1 ms early
+    TEST_ASSERT_GREATER_OR_EQUAL(MOTOR_INIT_ATTEMPTS * (MOTOR_REPLY_TIMEOUT - 1) * 1000u, motorInitResult.duration_us);
+
+    char summary[128];
+    describeMotorInit(summary, sizeof(summary));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "motor_init=timeout"));
+    TEST_ASSERT_NOT_NULL(strstr(summary, "motor_init_register=0x7017"));
+}
+
+void test_init_reports_mismatch() {
+    driver->setRegister(MOTOR_ID, EMERGENCY_STOP_ADDRESS, 1);
+    driver->lockRegister(MOTOR_ID, EMERGENCY_STOP_ADDRESS); // Emergency stop stays latched
+    TEST_ASSERT_FALSE(initMotor(motorSerial, MOTOR_ID));
+    TEST_ASSERT_EQUAL(MOTOR_INIT_MISMATCH, motorInitResult.error);
+    TEST_ASSERT_EQUAL(EMERGENCY_STOP_ADDRESS, motorInitResult.address);
+    TEST_ASSERT_EQUAL(1, motorInitResult.read_value);
+    TEST_ASSERT_EQUAL(0, driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS)); // Never enabled
+}
+
+void test_receive_resynchronizes() {
+    // A stray byte ahead of a valid frame is skipped
+    MotorFrame frame = encodeMotorFrame(MOTOR_ID, READ_DEC_SUCCESS, ACTUAL_SPEED_DEC_ADDRESS, 42);
+    uint8_t stray = 0x5A;
+    motorSerial.injectRx(&stray, 1);
+    motorSerial.injectRx(frame.bytes, MOTOR_FRAME_SIZE);
+    uint8_t received[MOTOR_FRAME_SIZE];
+    TEST_ASSERT_TRUE(receiveMotorFrame(motorSerial, received, 1));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame.bytes, received, MOTOR_FRAME_SIZE);
+    TEST_ASSERT_FALSE(receiveMotorFrame(motorSerial, received, 1));
+}
+
+void test_speed_read_reports_a_missed_reply() {
+    float speed = 1.5f;
+    driver->setOnline(false);
+    TEST_ASSERT_FALSE(readSpeedData(motorSerial, MOTOR_ID, speed));
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, speed); // Left unchanged, not a measured stop
+
+    driver->setOnline(true);
+    TEST_ASSERT_TRUE(readSpeedData(motorSerial, MOTOR_ID, speed));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, speed);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_init_verifies_every_register);
+    RUN_TEST(test_init_retries_lost_frames);
+    RUN_TEST(test_init_reports_timeout);
+    RUN_TEST(test_init_reports_mismatch);
+    RUN_TEST(test_receive_resynchronizes);
+    RUN_TEST(test_speed_read_reports_a_missed_reply);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include "MotorController.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+// The runtime encoder MotorController::sendCommand used before the typed
+// register map: nine payload bytes followed by their 8-bit sum
+static void legacyEncode(byte motorID, uint16_t address, byte command, uint32_t data, uint8_t *frame) {
+    byte packet[] = {motorID, command, highByte(address), lowByte(address), ERROR_BYTE,
+                     (byte)(data >> 24), (byte)(data >> 16), (byte)(data >> 8), (byte)data};
+    byte checksum = 0;
+    for (size_t i = 0; i < sizeof(packet); i++) {
+        checksum += packet[i];
+    }
+    memcpy(frame, packet, sizeof(packet));
+    frame[sizeof(packet)] = checksum;
+}
+
+static void assertLegacy(const MotorFrame &frame, byte motorID, uint16_t address, byte command, uint32_t data) {
+    uint8_t expected[MOTOR_FRAME_SIZE];
+    legacyEncode(motorID, address, command, data, expected);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, frame.bytes, MOTOR_FRAME_SIZE);
+}
+
+// Every write to motorSerial, one entry per write() call
+static std::vector<std::vector<uint8_t>> writes;
+
+void setUp() {
+    writes.clear();
+    motorSerial.onWrite = [](const uint8_t *buf, size_t len) { writes.emplace_back(buf, buf + len); };
+    motorSerial.clearRx();
+}
+
+void tearDown() {}
+
+void test_constant_frames_match_legacy() {
+    assertLegacy(OPERATION_MODE_FRAME, MOTOR_ID, OPERATION_MODE_ADDRESS, MOTOR_SETUP_COMMAND, OPERATION_MODE_SPEED_CONTROL);
+    assertLegacy(EMERGENCY_STOP_FRAME, MOTOR_ID, EMERGENCY_STOP_ADDRESS, MOTOR_SETUP_COMMAND, DISABLE_EMERGENCY_STOP);
+    assertLegacy(ENABLE_MOTOR_FRAME, MOTOR_ID, CONTROL_WORD_ADDRESS, MOTOR_ENABLE_COMMAND, ENABLE_MOTOR);
+    assertLegacy(SPEED_READ_FRAME, MOTOR_ID, ACTUAL_SPEED_DEC_ADDRESS, READ_DEC_COMMAND, NO_DATA);
+}
+
+void test_constant_frames_are_compile_time() {
+    // Fails to build if the frames are not constant expressions
+    static_assert(SPEED_READ_FRAME.bytes[MOTOR_CHECKSUM_INDEX] == (uint8_t)(MOTOR_ID + READ_DEC_COMMAND + 0x70 + 0x77),
+                  "speed read checksum");
+    static_assert(ENABLE_MOTOR_FRAME.bytes[8] == ENABLE_MOTOR, "enable data byte");
+    TEST_ASSERT_EQUAL(MOTOR_FRAME_SIZE, sizeof(MotorFrame));
+}
+
+void test_velocity_frames_match_legacy() {
+    const int32_t values[] = {0, 1, -1, 1000, -1000, 123456789, -123456789, INT32_MAX, INT32_MIN};
+    for (byte id = 0; id < 4; id++) {
+        for (int32_t value : values) {
+            assertLegacy(motorWriteFrame<TargetVelocityRegister>(id, value),
+                         id, TARGET_VELOCITY_DEC_ADDRESS, VEL_SEND_COMMAND, (uint32_t)value);
+        }
+    }
+}
+
+void test_read_frames_match_legacy() {
+    for (byte id = 0; id < 4; id++) {
+        assertLegacy(motorReadFrame<ActualSpeedRegister>(id), id, ACTUAL_SPEED_DEC_ADDRESS, READ_DEC_COMMAND, NO_DATA);
+        assertLegacy(motorReadFrame<OperationModeRegister>(id), id, OPERATION_MODE_ADDRESS, READ_DEC_COMMAND, NO_DATA);
+    }
+}
+
+void test_velocity_command_is_one_write() {
+    sendMotorCommands(0.3f, 0.5f);
+    TEST_ASSERT_EQUAL(1, writes.size());
+    TEST_ASSERT_EQUAL(MOTOR_FRAME_SIZE, writes[0].size());
+
+    float wheelSpeed = -(0.3f - (controlParams.wheel_distance * 0.5f / 2)); // LEFT_WHEEL
+    uint8_t expected[MOTOR_FRAME_SIZE];
+    legacyEncode(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS, VEL_SEND_COMMAND, (int)velocityToDEC(wheelSpeed), expected);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, writes[0].data(), MOTOR_FRAME_SIZE);
+}
+
+void test_read_reply_decoding() {
+    uint8_t reply[MOTOR_FRAME_SIZE];
+    legacyEncode(MOTOR_ID, ACTUAL_SPEED_DEC_ADDRESS, READ_DEC_SUCCESS, (uint32_t)-4242, reply);
+    int32_t value = 0;
+    TEST_ASSERT_TRUE(decodeMotorReadReply<ActualSpeedRegister>(reply, MOTOR_ID, value));
+    TEST_ASSERT_EQUAL(-4242, value);
+
+    // Replies of another motor, register or command are rejected
+    TEST_ASSERT_FALSE(decodeMotorReadReply<ActualSpeedRegister>(reply, 0x02, value));
+    TEST_ASSERT_FALSE(decodeMotorReadReply<TargetVelocityRegister>(reply, MOTOR_ID, value));
+    legacyEncode(MOTOR_ID, ACTUAL_SPEED_DEC_ADDRESS, READ_DEC_COMMAND, 0, reply);
+    TEST_ASSERT_FALSE(decodeMotorReadReply<ActualSpeedRegister>(reply, MOTOR_ID, value));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_frames_match_legacy);
+    RUN_TEST(test_constant_frames_are_compile_time);
+    RUN_TEST(test_velocity_frames_match_legacy);
+    RUN_TEST(test_read_frames_match_legacy);
+    RUN_TEST(test_velocity_command_is_one_write);
+    RUN_TEST(test_read_reply_decoding);
+    return UNITY_END();
+}
@@ -0,0 +1,233 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unity.h>
+#include "MotorController.h"
+#include "MotorSupervisor.h"
+#include "ControlParameters.h"
+#include "FlightRecorder.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static SimMotorDriver *driver;
+static int events;
+
+// One wheel stream tick: the speed read drains the status replies, then the supervisor acts
+static void tick() {
+    float speed;
+    readSpeedData(motorSerial, MOTOR_ID, speed);
+    if (superviseMotor(motorSerial, MOTOR_ID)) {
+        events++;
+    }
+    delay(1);
+}
+
+// Ticks until the supervisor reaches health or timeout_ms passed
+static bool tickUntil(MotorHealth health, uint32_t timeout_ms) {
+    unsigned long start = millis();
+    while (millis() - start < timeout_ms) {
+        tick();
+        if (motorSupervisor.health() == health) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ticks until a fault was detected, the first recovery step is written in the same tick
+static bool tickUntilFault(uint32_t timeout_ms) {
+    unsigned long start = millis();
+    while (millis() - start < timeout_ms) {
+        tick();
+        if (motorSupervisor.stats().faults > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+    controlParams.motor_status_period_ms = 10;
+    controlParams.motor_retry_max_ms = MOTOR_RETRY_MAX;
+    motorSupervisor = MotorSupervisor();
+    motorRecovery.cancel();
+    flightRecorder.resume();
+    motorInhibit = 0;
+    events = 0;
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    motorSupervisor.start(true, micros());
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_healthy_driver_is_polled_without_events() {
+    for (int i = 0; i < 50; i++) {
+        tick();
+    }
+    TEST_ASSERT_EQUAL(MOTOR_HEALTH_OK, motorSupervisor.health());
+    TEST_ASSERT_EQUAL(0, events);
+    TEST_ASSERT_EQUAL(MOTOR_STATUS_ENABLED, motorSupervisor.stats().last_status);
+    TEST_ASSERT_EQUAL(0, motorSupervisor.stats().faults);
+}
+
+void test_overcurrent_recovers_in_place() {
+    sendMotorCommands(0.3f, 0.0f);
+    driver->injectFault(MOTOR_ID, MOTOR_FAULT_OVERCURRENT);
+
+    TEST_ASSERT_TRUE(tickUntilFault(100));
+    TEST_ASSERT_EQUAL(MOTOR_HEALTH_FAULT, motorSupervisor.health());
+    TEST_ASSERT_TRUE(motorRecovery.active());
+    TEST_ASSERT_TRUE((motorInhibit & MOTOR_INHIBIT_FAULT) != 0);
+    TEST_ASSERT_EQUAL(0, driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS));
+    TEST_ASSERT_TRUE(flightRecorder.isFrozen()); // History up to the fault is kept for a dump
+    TEST_ASSERT_TRUE(tickUntil(MOTOR_HEALTH_OK, 100));
+
+    const MotorSupervisorStats &stats = motorSupervisor.stats();
+    TEST_ASSERT_EQUAL(1, stats.faults);
+    TEST_ASSERT_EQUAL(1, stats.recoveries);
+    TEST_ASSERT_EQUAL(1, stats.attempts);
+    TEST_ASSERT_EQUAL(MOTOR_CAUSE_FAULT, stats.cause);
+    TEST_ASSERT_EQUAL_HEX32(MOTOR_FAULT_OVERCURRENT, stats.last_fault_code);
+    // Detection, one enable sequence and the confirming poll, far from a reboot
+    TEST_ASSERT_LESS_THAN(50000u, stats.last_downtime_us);
+    TEST_ASSERT_EQUAL(0, driver->registerValue(MOTOR_ID, FAULT_CODE_ADDRESS));
+    TEST_ASSERT_EQUAL(ENABLE_MOTOR, driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS));
+    TEST_ASSERT_EQUAL(0, motorInhibit);
+    TEST_ASSERT_EQUAL(3, events); // Detection, the enable sequence confirmed, then the confirming poll
+}
+
+void test_recovery_does_not_block_the_tick() {
+    driver->setOnline(false);
+    TEST_ASSERT_TRUE(tickUntilFault(200));
+    // Every attempt of the first step times out, none of them is waited for
+    uint32_t longest = 0;
+    for (int i = 0; i < 200 && motorRecovery.active(); i++) {
+        float speed;
+        readSpeedData(motorSerial, MOTOR_ID, speed);
+        uint32_t start = micros();
+        superviseMotor(motorSerial, MOTOR_ID);
+        uint32_t spent = micros() - start;
+        longest = spent > longest ? spent : longest;
+        delay(1);
+    }
+    TEST_ASSERT_LESS_THAN(MOTOR_REPLY_TIMEOUT * 1000u / 2, longest);
+    TEST_ASSERT_EQUAL(MOTOR_INIT_TIMEOUT, motorInitResult.error);
+    TEST_ASSERT_EQUAL(MOTOR_INIT_ATTEMPTS, motorInitResult.attempts);
+    TEST_ASSERT_EQUAL(OPERATION_MODE_ADDRESS, motorInitResult.address);
+    TEST_ASSERT_EQUAL(MOTOR_HEALTH_FAULT, motorSupervisor.health());
+}
+
+void test_emergency_stop_is_cleared() {
+    driver->setRegister(MOTOR_ID, EMERGENCY_STOP_ADDRESS, 1);
+    TEST_ASSERT_TRUE(tickUntilFault(100));
+    TEST_ASSERT_EQUAL(MOTOR_CAUSE_STOPPED, motorSupervisor.stats().cause);
+    TEST_ASSERT_TRUE(tickUntil(MOTOR_HEALTH_OK, 100));
+    TEST_ASSERT_EQUAL(DISABLE_EMERGENCY_STOP, driver->registerValue(MOTOR_ID, EMERGENCY_STOP_ADDRESS));
+}
+
+void test_permanent_fault_is_not_retried() {
+    driver->injectFault(MOTOR_ID, MOTOR_FAULT_ENCODER);
+    TEST_ASSERT_TRUE(tickUntil(MOTOR_HEALTH_FAILED, 100));
+    for (int i = 0; i < 50; i++) {
+        tick();
+    }
+    TEST_ASSERT_EQUAL(MOTOR_HEALTH_FAILED, motorSupervisor.health());
+    TEST_ASSERT_EQUAL(0, motorSupervisor.stats().attempts);
+    TEST_ASSERT_TRUE((motorInhibit & MOTOR_INHIBIT_FAULT) != 0);
+}
+
+void test_lost_driver_is_initialized_again() {
+    driver->setOnline(false);
+    // Detected after MOTOR_STATUS_TIMEOUT_POLLS unanswered polls
+    TEST_ASSERT_TRUE(tickUntilFault(200));
+    TEST_ASSERT_EQUAL(MOTOR_CAUSE_LOST, motorSupervisor.stats().cause);
+
+    // The driver restarts with its registers at their defaults
+    driver->setRegister(MOTOR_ID, OPERATION_MODE_ADDRESS, 0);
+    driver->setRegister(MOTOR_ID, CONTROL_WORD_ADDRESS, 0);
+    driver->setOnline(true);
+    TEST_ASSERT_TRUE(tickUntil(MOTOR_HEALTH_OK, 1000));
+    TEST_ASSERT_EQUAL(OPERATION_MODE_SPEED_CONTROL, driver->registerValue(MOTOR_ID, OPERATION_MODE_ADDRESS));
+    TEST_ASSERT_EQUAL(1, motorSupervisor.stats().recoveries);
+}
+
+void test_failed_boot_initialization_is_retried() {
+    motorSupervisor = MotorSupervisor();
+    driver->setRegister(MOTOR_ID, CONTROL_WORD_ADDRESS, 0);
+    motorSupervisor.start(false, micros());
+    TEST_ASSERT_TRUE(tickUntil(MOTOR_HEALTH_OK, 100));
+    TEST_ASSERT_EQUAL(MOTOR_CAUSE_INIT, motorSupervisor.stats().cause);
+    TEST_ASSERT_EQUAL(ENABLE_MOTOR, driver->registerValue(MOTOR_ID, CONTROL_WORD_ADDRESS));
+}
+
+void test_retry_delay_doubles_up_to_the_maximum() {
+    MotorSupervisor supervisor;
+    supervisor.configure(10000, 0, 80000);
+    supervisor.start(true, 0);
+    supervisor.onStatus(MOTOR_STATUS_FAULT, 0);
+    TEST_ASSERT_EQUAL(MOTOR_ACTION_ENABLE, supervisor.next(0)); // First attempt at once
+    supervisor.onRecovery(false, 0);
+
+    const uint32_t delays[] = {10000, 20000, 40000, 80000, 80000};
+    uint32_t now = 0;
+    for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        now += delays[i];
+        TEST_ASSERT_NOT_EQUAL(MOTOR_ACTION_ENABLE, supervisor.next(now - 1));
+        TEST_ASSERT_EQUAL(MOTOR_ACTION_ENABLE, supervisor.next(now));
+        supervisor.onRecovery(false, now);
+    }
+
+    // A successful attempt is released only by a healthy status reply
+    supervisor.onRecovery(true, now);
+    TEST_ASSERT_TRUE(supervisor.isStopped());
+    TEST_ASSERT_EQUAL(MOTOR_ACTION_POLL, supervisor.next(now));
+    supervisor.onStatus(MOTOR_STATUS_ENABLED, now + 500);
+    TEST_ASSERT_FALSE(supervisor.isStopped());
+    TEST_ASSERT_EQUAL(now + 500, supervisor.stats().last_downtime_us);
+    TEST_ASSERT_EQUAL(6, supervisor.stats().attempts);
+}
+
+void test_summary_format() {
+    MotorSupervisor supervisor;
+    supervisor.start(true, 0);
+    supervisor.onStatus(MOTOR_STATUS_FAULT, 0);
+    supervisor.onFaultCode(MOTOR_FAULT_OVERVOLTAGE, 0);
+    char buf[MOTOR_EVENT_BUFFER_SIZE];
+    supervisor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("motor=fault cause=fault status=0x0008 fault_code=0x0002 faults=1 recoveries=0 "
+                             "attempts=0 downtime_us=0 max_downtime_us=0", buf);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_healthy_driver_is_polled_without_events);
+    RUN_TEST(test_overcurrent_recovers_in_place);
+    RUN_TEST(test_recovery_does_not_block_the_tick);
+    RUN_TEST(test_emergency_stop_is_cleared);
+    RUN_TEST(test_permanent_fault_is_not_retried);
+    RUN_TEST(test_lost_driver_is_initialized_again);
+    RUN_TEST(test_failed_boot_initialization_is_retried);
+    RUN_TEST(test_retry_delay_doubles_up_to_the_maximum);
+    RUN_TEST(test_summary_format);
+    return UNITY_END();
+}
@@ -0,0 +1,210 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "RateCalibration.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const uint32_t FRAME_US = 868; // One motor frame at 115200 baud
+
+static SimMotorDriver *driver;
+static int rate_selections;
+
+// A board whose streams cost little besides the motor UART
+static RateMeasurements fastBoard() {
+    RateMeasurements m;
+    memset(&m, 0, sizeof(m));
+    m.motor_rtt_us = 1500;
+    m.imu_read_us = 400;
+    m.agent_rtt_us = 2000;
+    m.wheel_cpu_us = 200;
+    m.wheel_link_us = 500;
+    m.imu_cpu_us = 150;
+    m.imu_link_us = 400;
+    return m;
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    controlParams.imu_sample_period_ms = IMU_SAMPLE_PERIOD;
+    controlParams.imu_publish_period_ms = IMU_PUBLISH_PERIOD;
+    controlParams.wheel_period_ms = WHEEL_PERIOD;
+    controlParams.auto_rates = AUTO_RATES;
+    controlParams.rate_cpu_budget_pct = RATE_CPU_BUDGET;
+    controlParams.rate_link_budget_pct = RATE_LINK_BUDGET;
+    rate_selections = 0;
+    nativePublishHook = [](const rcl_publisher_t *pub, const void *msg) {
+        if (strcmp(pub->topic, "/left_wheel/rate_selection") == 0) {
+            rate_selections++;
+        }
+    };
+}
+
+void tearDown() {
+    nativePublishHook = nullptr;
+    nativeAgentEpochNanos = 0;
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_fast_uart_selects_the_fastest_level() {
+    RateCalibration calibration;
+    calibration.configure(RATE_CPU_BUDGET, RATE_LINK_BUDGET, 87, true); // 1 Mbaud
+    TEST_ASSERT_TRUE(calibration.select(fastBoard()));
+    const RateSelection &s = calibration.selection();
+    TEST_ASSERT_TRUE(s.within_budget);
+    TEST_ASSERT_EQUAL(0, s.level);
+    TEST_ASSERT_EQUAL(RATE_LIMIT_NONE, s.limit);
+    TEST_ASSERT_EQUAL(5, s.rates.wheel_ms);
+    TEST_ASSERT_EQUAL(2, s.rates.imu_sample_ms);
+    TEST_ASSERT_EQUAL(10, s.rates.imu_publish_ms);
+    // 200/5000 + 400/2000 + 150/10000
+    TEST_ASSERT_EQUAL(255, s.cpu_permille);
+}
+
+void test_motor_uart_limits_the_wheel_period() {
+    RateCalibration calibration;
+    calibration.configure(RATE_CPU_BUDGET, RATE_LINK_BUDGET, FRAME_US, true);
+    TEST_ASSERT_TRUE(calibration.select(fastBoard()));
+    const RateSelection &s = calibration.selection();
+    TEST_ASSERT_EQUAL(1, s.level);
+    TEST_ASSERT_EQUAL(RATE_LIMIT_MOTOR_BUS, s.limit);
+    TEST_ASSERT_EQUAL(10, s.rates.wheel_ms);
+    TEST_ASSERT_EQUAL(347, s.motor_permille);
+}
+
+void test_slow_driver_reply_limits_the_wheel_period() {
+    RateMeasurements m = fastBoard();
+    m.motor_rtt_us = 8000;
+    RateCalibration calibration;
+    calibration.configure(RATE_CPU_BUDGET, RATE_LINK_BUDGET, 87, true);
+    TEST_ASSERT_TRUE(calibration.select(m));
+    TEST_ASSERT_EQUAL(RATE_LIMIT_MOTOR_RTT, calibration.selection().limit);
+    TEST_ASSERT_EQUAL(20, calibration.selection().rates.wheel_ms);
+}
+
+void test_link_and_cpu_budgets() {
+    RateMeasurements m = fastBoard();
+    m.wheel_link_us = 6000;  // 60 % of the link at 10 ms
+    RateCalibration calibration;
+    calibration.configure(RATE_CPU_BUDGET, RATE_LINK_BUDGET, 87, true);
+    TEST_ASSERT_TRUE(calibration.select(m));
+    TEST_ASSERT_EQUAL(RATE_LIMIT_LINK, calibration.selection().limit);
+    TEST_ASSERT_EQUAL(20, calibration.selection().rates.wheel_ms);
+    TEST_ASSERT_LESS_THAN(501, calibration.selection().link_permille);
+
+    // The IMU read alone takes a quarter of the 2 ms sample period, more with a tighter budget
+    calibration.configure(20, RATE_LINK_BUDGET, 87, true);
+    TEST_ASSERT_TRUE(calibration.select(fastBoard()));
+    TEST_ASSERT_EQUAL(RATE_LIMIT_CPU, calibration.selection().limit);
+    TEST_ASSERT_EQUAL(1, calibration.selection().level);
+
+    // Without the IMU streams only the wheel counts
+    calibration.configure(20, RATE_LINK_BUDGET, 87, false);
+    TEST_ASSERT_TRUE(calibration.select(fastBoard()));
+    TEST_ASSERT_EQUAL(0, calibration.selection().level);
+}
+
+void test_over_budget_board_gets_the_slowest_level() {
+    RateMeasurements m = fastBoard();
+    m.wheel_link_us = 90000;
+    RateCalibration calibration;
+    calibration.configure(RATE_CPU_BUDGET, RATE_LINK_BUDGET, FRAME_US, true);
+    TEST_ASSERT_TRUE(calibration.select(m));
+    TEST_ASSERT_FALSE(calibration.selection().within_budget);
+    TEST_ASSERT_EQUAL(RATE_LEVEL_COUNT - 1, calibration.selection().level);
+    TEST_ASSERT_EQUAL(RATE_LIMIT_LINK, calibration.selection().limit);
+}
+
+void test_missing_measurement_selects_nothing() {
+    RateMeasurements m = fastBoard();
+    m.agent_rtt_us = 0;
+    RateCalibration calibration;
+    TEST_ASSERT_FALSE(calibration.select(m));
+    TEST_ASSERT_FALSE(calibration.selection().selected);
+    TEST_ASSERT_EQUAL(RATE_LIMIT_UNMEASURED, calibration.selection().limit);
+
+    char buf[RATE_BUFFER_SIZE];
+    calibration.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "rates=unchanged"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "limit=unmeasured"));
+}
+
+void test_boot_calibration_applies_and_publishes_the_rates() {
+    rcl_node_t node;
+    initializePublishers(&node);
+    initializeIMU(&node);
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    controlParams.wheel_period_ms = 50;
+    controlParams.imu_sample_period_ms = 20;
+    controlParams.imu_publish_period_ms = 100;
+    initializeStreams();
+    nativeAgentEpochNanos = 1700000000LL * 1000000000LL;
+
+    calibrateRates();
+
+    // The simulated driver answers at once, the 115200 baud UART sets the limit
+    const RateSelection &s = rateCalibration.selection();
+    TEST_ASSERT_TRUE(s.selected);
+    TEST_ASSERT_EQUAL(RATE_LIMIT_MOTOR_BUS, s.limit);
+    TEST_ASSERT_GREATER_THAN(0, rateCalibration.measurements().motor_rtt_us);
+    TEST_ASSERT_EQUAL(WHEEL_PERIOD, controlParams.wheel_period_ms);
+    TEST_ASSERT_EQUAL(IMU_SAMPLE_PERIOD, controlParams.imu_sample_period_ms);
+    TEST_ASSERT_EQUAL(IMU_PUBLISH_PERIOD, controlParams.imu_publish_period_ms);
+    TEST_ASSERT_EQUAL(WHEEL_PERIOD * 1000, controlStreams.period(STREAM_WHEEL));
+    TEST_ASSERT_EQUAL(1, rate_selections);
+    TEST_ASSERT_NOT_NULL(strstr(rate_selection_msg.data.data, "rates=selected"));
+}
+
+void test_boot_calibration_keeps_the_periods_without_agent() {
+    rcl_node_t node;
+    initializePublishers(&node);
+    initializeIMU(&node);
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    controlParams.wheel_period_ms = 50;
+    initializeStreams();
+
+    calibrateRates();
+
+    TEST_ASSERT_FALSE(rateCalibration.selection().selected);
+    TEST_ASSERT_EQUAL(50, controlParams.wheel_period_ms);
+    TEST_ASSERT_EQUAL(1, rate_selections);
+
+    // Disabled, nothing is measured or published
+    controlParams.auto_rates = 0;
+    calibrateRates();
+    TEST_ASSERT_EQUAL(1, rate_selections);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_uart_selects_the_fastest_level);
+    RUN_TEST(test_motor_uart_limits_the_wheel_period);
+    RUN_TEST(test_slow_driver_reply_limits_the_wheel_period);
+    RUN_TEST(test_link_and_cpu_budgets);
+    RUN_TEST(test_over_budget_board_gets_the_slowest_level);
+    RUN_TEST(test_missing_measurement_selects_nothing);
+    RUN_TEST(test_boot_calibration_applies_and_publishes_the_rates);
+    RUN_TEST(test_boot_calibration_keeps_the_periods_without_agent);
+    return UNITY_END();
+}
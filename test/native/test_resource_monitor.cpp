@@ -0,0 +1,133 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "ResourceMonitor.h"
+
+static const HeapSnapshot HEAP_OK = {120000, 90000, 60000};
+
+// Idle tasks of both cores plus two worker tasks, counters in microseconds
+static TaskSnapshot tasks[4];
+
+static void setTasks(uint32_t idle0, uint32_t idle1, uint32_t control, uint32_t housekeeping) {
+    tasks[0] = {1, "IDLE0", 0, true, idle0, 1000};
+    tasks[1] = {2, "IDLE1", 1, true, idle1, 1000};
+    tasks[2] = {3, "control", 1, false, control, 4096};
+    tasks[3] = {4, "housekeeping", 0, false, housekeeping, 4096};
+}
+
+void setUp() {
+    setTasks(0, 0, 0, 0);
+}
+
+void tearDown() {}
+
+void test_first_sample_has_no_loads() {
+    ResourceMonitor monitor;
+    monitor.update(tasks, 4, 1000000, HEAP_OK);
+    TEST_ASSERT_FALSE(monitor.hasLoads());
+    TEST_ASSERT_EQUAL(4, monitor.taskCount());
+    TEST_ASSERT_EQUAL(0, monitor.taskLoad(2));
+    TEST_ASSERT_EQUAL(0, monitor.warnings());
+}
+
+void test_loads_from_runtime_deltas() {
+    ResourceMonitor monitor;
+    monitor.update(tasks, 4, 0, HEAP_OK);
+    // One second: core 0 idle 70 %, core 1 idle 40 %, control 60 %, housekeeping 30 %
+    setTasks(700000, 400000, 600000, 300000);
+    monitor.update(tasks, 4, 1000000, HEAP_OK);
+    TEST_ASSERT_TRUE(monitor.hasLoads());
+    TEST_ASSERT_EQUAL(700, monitor.idleLoad(0));
+    TEST_ASSERT_EQUAL(400, monitor.idleLoad(1));
+    TEST_ASSERT_EQUAL(600, monitor.taskLoad(2));
+    TEST_ASSERT_EQUAL(300, monitor.taskLoad(3));
+    TEST_ASSERT_EQUAL(0, monitor.warnings());
+}
+
+void test_counter_wrap() {
+    ResourceMonitor monitor;
+    setTasks(0xFFFF0000u, 0, 0xFFFFF000u, 0);
+    monitor.update(tasks, 4, 0xFFFFFF00u, HEAP_OK);
+    setTasks(0xFFFF0000u + 500000, 500000, 0xFFFFF000u + 250000, 0);
+    monitor.update(tasks, 4, 0xFFFFFF00u + 1000000, HEAP_OK);
+    TEST_ASSERT_EQUAL(500, monitor.idleLoad(0));
+    TEST_ASSERT_EQUAL(250, monitor.taskLoad(2));
+}
+
+void test_warnings() {
+    ResourceMonitor monitor;
+    monitor.update(tasks, 4, 0, HEAP_OK);
+    // Core 1 saturated by the control task, which is also close to its stack limit
+    setTasks(800000, 100000, 900000, 100000);
+    tasks[2].stack_free_bytes = STACK_WARN_BYTES - 1;
+    HeapSnapshot low = {20000, HEAP_WARN_BYTES - 1, 8000};
+    monitor.update(tasks, 4, 1000000, low);
+    TEST_ASSERT_EQUAL(RESOURCE_WARN_STACK | RESOURCE_WARN_HEAP | RESOURCE_WARN_IDLE, monitor.warnings());
+
+    char buf[MONITOR_BUFFER_SIZE];
+    monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, " warn=stack,heap,idle"));
+    TEST_ASSERT_EQUAL('e', buf[strlen(buf) - 1]);
+}
+
+void test_new_task_has_no_load_until_next_sample() {
+    ResourceMonitor monitor;
+    monitor.update(tasks, 3, 0, HEAP_OK);
+    setTasks(500000, 500000, 500000, 400000);
+    monitor.update(tasks, 4, 1000000, HEAP_OK);
+    TEST_ASSERT_EQUAL(500, monitor.taskLoad(2));
+    TEST_ASSERT_EQUAL(0, monitor.taskLoad(3));
+    setTasks(1000000, 1000000, 1000000, 600000);
+    monitor.update(tasks, 4, 2000000, HEAP_OK);
+    TEST_ASSERT_EQUAL(200, monitor.taskLoad(3));
+}
+
+void test_summary_format() {
+    ResourceMonitor monitor;
+    TaskSnapshot timer = {5, "Tmr Svc", MONITOR_CORE_UNKNOWN, false, 0, 1500};
+    monitor.update(&timer, 1, 0, HEAP_OK);
+    char buf[MONITOR_BUFFER_SIZE];
+    size_t len = monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    TEST_ASSERT_EQUAL_STRING("heap_free=120000 heap_min=90000 heap_largest=60000 tasks=Tmr_Svc:-:1500 warn=none", buf);
+
+    timer.runtime = 12345;
+    monitor.update(&timer, 1, 1000000, HEAP_OK);
+    monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "tasks=Tmr_Svc:1.2:1500"));
+
+    monitor.setBootTime(2345);
+    monitor.summarize(buf, sizeof(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "heap_largest=60000 boot_ms=2345 idle_pct="));
+
+    // A short buffer is truncated, never overrun
+    char small[24];
+    len = monitor.summarize(small, sizeof(small));
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, len);
+    TEST_ASSERT_EQUAL(strlen(small), len);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_has_no_loads);
+    RUN_TEST(test_loads_from_runtime_deltas);
+    RUN_TEST(test_counter_wrap);
+    RUN_TEST(test_warnings);
+    RUN_TEST(test_new_task_has_no_load_until_next_sample);
+    RUN_TEST(test_summary_format);
+    return UNITY_END();
+}
@@ -0,0 +1,240 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+#include "SlipDetector.h"
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "VelocityEstimator.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const uint32_t TICK_US = 10000; // Default wheel stream period
+static std::vector<std::string> events; // Summaries published on the slip topic
+
+void setUp() {
+    events.clear();
+    nativePublishHook = [](const rcl_publisher_t *pub, const void *msg) {
+        if (strcmp(pub->topic, "/left_wheel/slip") == 0) {
+            const std_msgs__msg__String *summary = (const std_msgs__msg__String *)msg;
+            events.emplace_back(summary->data.data, summary->data.size);
+        }
+    };
+}
+
+void tearDown() {
+    nativePublishHook = nullptr;
+}
+
+static SlipDetector configured(float accel_limit) {
+    SlipDetector detector;
+    detector.configure(WHEEL_DISTANCE, SLIP_YAW_TOLERANCE, accel_limit);
+    return detector;
+}
+
+// Runs ticks with a fixed command and left wheel speed, returns the tick of the first event or -1
+static int runTicks(SlipDetector &detector, int ticks, float linear, float angular,
+                    float wheel_speed, float gyro_z, uint32_t &now_us) {
+    int first = -1;
+    for (int tick = 0; tick < ticks; tick++) {
+        detector.update(linear, angular, wheel_speed, gyro_z, now_us);
+        now_us += TICK_US;
+        if (detector.takeEvent() && first < 0) {
+            first = tick;
+        }
+    }
+    return first;
+}
+
+void test_consistent_drive_raises_no_event() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    TEST_ASSERT_EQUAL(-1, runTicks(detector, 50, 0.3f, 0.0f, 0.3f, 0.0f, now_us));
+
+    // Turning with the gyro agreeing
+    SlipDetector turning = configured(0.0f);
+    float left = 0.3f - 0.5f * WHEEL_DISTANCE / 2;
+    TEST_ASSERT_EQUAL(-1, runTicks(turning, 50, 0.3f, 0.5f, left, 0.5f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_NONE, turning.state());
+}
+
+void test_step_followed_by_the_wheel_is_not_slip() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    runTicks(detector, 1, 0.0f, 0.0f, 0.0f, 0.0f, now_us);
+    // The wheel follows a little slower than the model, the gyro stays consistent
+    float wheel = 0.0f;
+    for (int tick = 0; tick < 50; tick++) {
+        float alpha = TICK_US * 1e-6f / (MOTOR_RESPONSE_TIME * 1.2f + TICK_US * 1e-6f);
+        wheel += alpha * (0.5f - wheel);
+        detector.update(0.5f, 0.0f, wheel, 0.0f, now_us);
+        now_us += TICK_US;
+        TEST_ASSERT_FALSE(detector.takeEvent());
+    }
+}
+
+void test_stalled_wheel_is_detected_in_a_few_ticks() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    TEST_ASSERT_EQUAL(SLIP_DETECT_TICKS - 1, runTicks(detector, 10, 0.3f, 0.0f, 0.0f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_STALL, detector.state());
+    TEST_ASSERT_EQUAL(1, detector.stats().stalls);
+    TEST_ASSERT_EQUAL(0, detector.stats().slips);
+}
+
+void test_spinning_wheel_is_slip() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    // Driving straight, the left wheel spins at twice the speed and the base does not turn
+    TEST_ASSERT_EQUAL(SLIP_DETECT_TICKS - 1, runTicks(detector, 10, 0.3f, 0.0f, 0.6f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_YAW, detector.state());
+    TEST_ASSERT_EQUAL(1, detector.stats().slips);
+}
+
+void test_turn_without_yaw_is_slip() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    // Turning in place, the left wheel follows but the gyro sees no rotation
+    float left = -1.0f * WHEEL_DISTANCE / 2;
+    TEST_ASSERT_EQUAL(SLIP_DETECT_TICKS - 1, runTicks(detector, 10, 0.0f, 1.0f, left, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_YAW, detector.state());
+}
+
+void test_short_glitch_raises_no_event() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    TEST_ASSERT_EQUAL(-1, runTicks(detector, SLIP_DETECT_TICKS - 1, 0.3f, 0.0f, 0.0f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(-1, runTicks(detector, 1, 0.3f, 0.0f, 0.3f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(-1, runTicks(detector, SLIP_DETECT_TICKS - 1, 0.3f, 0.0f, 0.0f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_NONE, detector.state());
+}
+
+void test_event_clears_after_consistent_ticks() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    runTicks(detector, SLIP_DETECT_TICKS, 0.3f, 0.0f, 0.0f, 0.0f, now_us);
+    TEST_ASSERT_EQUAL(SLIP_STALL, detector.state());
+    TEST_ASSERT_EQUAL(SLIP_CLEAR_TICKS - 1, runTicks(detector, SLIP_CLEAR_TICKS + 5, 0.3f, 0.0f, 0.3f, 0.0f, now_us));
+    TEST_ASSERT_EQUAL(SLIP_NONE, detector.state());
+}
+
+void test_target_is_ramped_only_while_slipping() {
+    SlipDetector detector = configured(1.0f);
+    uint32_t now_us = 0;
+    TEST_ASSERT_EQUAL_FLOAT(0.4f, detector.limitTarget(0.0f, 0.4f, now_us));
+    runTicks(detector, SLIP_DETECT_TICKS, 0.0f, 1.0f, -0.1f, 0.0f, now_us);
+    TEST_ASSERT_EQUAL(SLIP_YAW, detector.state());
+
+    now_us += TICK_US;
+    float applied = detector.limitTarget(0.0f, 0.4f, now_us);
+    TEST_ASSERT_TRUE(applied > 0.0f && applied < 0.4f);
+    TEST_ASSERT_TRUE(detector.rampPending(applied));
+    TEST_ASSERT_EQUAL(1, detector.stats().clamped);
+
+    // One tick later the target has grown by the acceleration limit times the tick
+    now_us += TICK_US;
+    float next = detector.limitTarget(applied, detector.requestedTarget(), now_us);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.01f, next - applied);
+
+    // Slowing down passes at once, a reversal restarts from standstill
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, detector.limitTarget(next, 0.0f, now_us + TICK_US));
+    float reversed = detector.limitTarget(0.2f, -0.4f, now_us + 2 * TICK_US);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -0.01f, reversed);
+}
+
+void test_disabled_limit_passes_the_target() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    runTicks(detector, SLIP_DETECT_TICKS, 0.3f, 0.0f, 0.0f, 0.0f, now_us);
+    TEST_ASSERT_EQUAL_FLOAT(0.4f, detector.limitTarget(0.0f, 0.4f, now_us));
+    TEST_ASSERT_FALSE(detector.rampPending(0.4f));
+    TEST_ASSERT_EQUAL(0, detector.stats().clamped);
+}
+
+void test_summary_format() {
+    SlipDetector detector = configured(0.0f);
+    uint32_t now_us = 0;
+    runTicks(detector, SLIP_DETECT_TICKS, 0.3f, 0.0f, 0.0f, 0.0f, now_us);
+    char buf[SLIP_EVENT_BUFFER_SIZE];
+    detector.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("state=stall yaw_cmd=0.00 yaw_wheels=1.49 yaw_gyro=0.00 wheel_target=0.30 "
+                             "wheel_speed=0.00 slips=0 stalls=1 clamped=0", buf);
+}
+
+void test_wheel_stream_publishes_and_ramps() {
+    motorSerial.clearRx();
+    SimMotorDriver driver(motorSerial);
+    driver.setTimeConstant(0.0f);
+    controlParams.motor_reply_timeout_ms = MOTOR_REPLY_TIMEOUT;
+    controlParams.slip_accel_limit = 1.0f;
+    TEST_ASSERT_TRUE(initMotor(motorSerial, MOTOR_ID));
+    motorSupervisor.start(true, micros());
+    rcl_node_t node;
+    initializePublishers(&node);
+
+    // Turning in place while the IMU reports no rotation
+    geometry_msgs__msg__TwistStamped cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.twist.angular.z = 1.0f;
+    subscription_callback(&cmd);
+    for (int tick = 0; tick < SLIP_DETECT_TICKS + 2 && events.empty(); tick++) {
+        wheel_callback();
+        delay(2);
+    }
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_EQUAL_STRING("state=slip", events[0].substr(0, 10).c_str());
+
+    // The next command is ramped, the wheel stream continues the ramp
+    cmd.twist.linear.x = 0.5f;
+    subscription_callback(&cmd);
+    float requested = slipDetector.requestedTarget();
+    float first = commandedWheelSpeed;
+    TEST_ASSERT_TRUE(fabsf(first) < fabsf(requested));
+    wheel_callback();
+    delay(2);
+    wheel_callback();
+    TEST_ASSERT_TRUE(fabsf(commandedWheelSpeed) > fabsf(first));
+    TEST_ASSERT_TRUE(slipDetector.stats().clamped >= 2);
+
+    // A stop is passed through at once
+    memset(&cmd, 0, sizeof(cmd));
+    subscription_callback(&cmd);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, commandedWheelSpeed);
+    controlParams.slip_accel_limit = SLIP_ACCEL_LIMIT;
+    motorSerial.onWrite = nullptr;
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_consistent_drive_raises_no_event);
+    RUN_TEST(test_step_followed_by_the_wheel_is_not_slip);
+    RUN_TEST(test_stalled_wheel_is_detected_in_a_few_ticks);
+    RUN_TEST(test_spinning_wheel_is_slip);
+    RUN_TEST(test_turn_without_yaw_is_slip);
+    RUN_TEST(test_short_glitch_raises_no_event);
+    RUN_TEST(test_event_clears_after_consistent_ticks);
+    RUN_TEST(test_target_is_ramped_only_while_slipping);
+    RUN_TEST(test_disabled_limit_passes_the_target);
+    RUN_TEST(test_summary_format);
+    RUN_TEST(test_wheel_stream_publishes_and_ramps);
+    return UNITY_END();
+}
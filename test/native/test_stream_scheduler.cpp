@@ -0,0 +1,147 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unity.h>
+#include "StreamScheduler.h"
+
+// Run log shared by the test callbacks
+static uint32_t clock_us;
+static int runs_a, runs_b;
+static uint32_t last_a_us, last_b_us;
+
+static void streamA() { runs_a++; last_a_us = clock_us; }
+static void streamB() { runs_b++; last_b_us = clock_us; }
+
+void setUp() {
+    clock_us = 0;
+    runs_a = runs_b = 0;
+    last_a_us = last_b_us = 0;
+}
+
+void tearDown() {}
+
+// Polls every 100 us for duration_us, leaving the clock at the end time
+static void advance(StreamScheduler &scheduler, uint32_t duration_us) {
+    uint32_t end = clock_us + duration_us;
+    while (clock_us != end) {
+        scheduler.poll(clock_us);
+        clock_us += 100;
+    }
+}
+
+void test_independent_rates() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "a", 5000, 0, streamA);
+    scheduler.configureStream(1, "b", 10000, 2500, streamB);
+    scheduler.start(clock_us);
+    advance(scheduler, 1000000);
+    TEST_ASSERT_EQUAL(200, runs_a);
+    TEST_ASSERT_EQUAL(100, runs_b);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 200.0f, scheduler.achievedRate(0, clock_us));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 100.0f, scheduler.achievedRate(1, clock_us));
+    TEST_ASSERT_EQUAL(0, scheduler.stats(0).jitter_max_us);
+}
+
+void test_phase_offset_separates_streams() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "a", 10000, 0, streamA);
+    scheduler.configureStream(1, "b", 10000, 2500, streamB);
+    scheduler.start(clock_us);
+    for (int i = 0; i < 50; i++) {
+        advance(scheduler, 1000);
+        // Streams with the same period never run in the same poll
+        TEST_ASSERT_TRUE(runs_a == 0 || runs_b == 0 || last_a_us != last_b_us);
+    }
+    TEST_ASSERT_EQUAL(2500 + 4 * 10000, last_b_us);
+}
+
+void test_poll_returns_time_to_next_due() {
+    StreamScheduler scheduler;
+    TEST_ASSERT_EQUAL(STREAM_IDLE_WAIT, scheduler.poll(0));
+    scheduler.configureStream(0, "a", 5000, 0, streamA);
+    scheduler.configureStream(1, "b", 10000, 2500, streamB);
+    scheduler.start(0);
+    TEST_ASSERT_EQUAL(2500, scheduler.poll(0));
+    TEST_ASSERT_EQUAL(1, runs_a);
+    TEST_ASSERT_EQUAL(1500, scheduler.poll(1000));
+}
+
+void test_late_poll_skips_missed_slots() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "a", 5000, 0, streamA);
+    scheduler.start(0);
+    scheduler.poll(0);
+    // Stalled past two slots: one run, one missed slot, back on the grid
+    TEST_ASSERT_EQUAL(1000, scheduler.poll(14000));
+    TEST_ASSERT_EQUAL(2, runs_a);
+    TEST_ASSERT_EQUAL(1, scheduler.stats(0).missed);
+    TEST_ASSERT_EQUAL(9000, scheduler.stats(0).jitter_max_us);
+    scheduler.poll(15000);
+    TEST_ASSERT_EQUAL(3, runs_a);
+}
+
+void test_schedule_survives_clock_wrap() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "a", 5000, 0, streamA);
+    clock_us = 0xFFFFFFFFu - 20000 + 1;
+    scheduler.start(clock_us);
+    advance(scheduler, 50000);
+    TEST_ASSERT_EQUAL(10, runs_a);
+    TEST_ASSERT_EQUAL(0, scheduler.stats(0).missed);
+}
+
+void test_set_period_reschedules() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "a", 10000, 0, streamA);
+    scheduler.start(clock_us);
+    advance(scheduler, 100000);
+    scheduler.setPeriod(0, 5000);
+    scheduler.resetStats(clock_us);
+    advance(scheduler, 100000);
+    TEST_ASSERT_EQUAL(20, scheduler.stats(0).runs);
+    TEST_ASSERT_EQUAL(5000, scheduler.period(0));
+}
+
+void test_summary_lists_streams() {
+    StreamScheduler scheduler;
+    scheduler.configureStream(0, "imu", 5000, 0, streamA);
+    scheduler.configureStream(3, "wheel", 10000, 2500, streamB);
+    scheduler.start(clock_us);
+    advance(scheduler, 1000000);
+    char buf[256];
+    size_t len = scheduler.summarize(buf, sizeof(buf), clock_us);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    TEST_ASSERT_NOT_NULL(strstr(buf, "imu.rate_hz=200.0"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "wheel.rate_hz=100.0"));
+
+    // A short buffer is truncated, never overrun
+    char small[16];
+    len = scheduler.summarize(small, sizeof(small), clock_us);
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, len);
+    TEST_ASSERT_EQUAL(strlen(small), len);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_independent_rates);
+    RUN_TEST(test_phase_offset_separates_streams);
+    RUN_TEST(test_poll_returns_time_to_next_due);
+    RUN_TEST(test_late_poll_skips_missed_slots);
+    RUN_TEST(test_schedule_survives_clock_wrap);
+    RUN_TEST(test_set_period_reschedules);
+    RUN_TEST(test_summary_lists_streams);
+    return UNITY_END();
+}
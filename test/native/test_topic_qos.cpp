@@ -0,0 +1,245 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "ControlParameters.h"
+#include "IMUManager.h"
+#include "SimMotorDriver.h"
+#include "SubscriptionStats.h"
+#include "TopicQos.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static const int64_t AGENT_EPOCH_NS = 1700000000LL * 1000000000LL; // Agent clock at the first sync
+static const int64_t MS = 1000000LL;
+
+static SimMotorDriver *driver;
+
+static geometry_msgs__msg__TwistStamped makeCmdVel(double linear, int64_t stamp_ns) {
+    geometry_msgs__msg__TwistStamped cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.header.stamp.sec = (int32_t)(stamp_ns / 1000000000LL);
+    cmd.header.stamp.nanosec = (uint32_t)(stamp_ns % 1000000000LL);
+    cmd.twist.linear.x = linear;
+    return cmd;
+}
+
+// Reads a -D<name>=<value> limit of rmw_microxrcedds from the library build meta, -1 if missing
+static int metaLimit(const char *name) {
+    static char meta[4096];
+    FILE *file = fopen("tools/colcon.meta", "r"); // Relative to the project directory
+    if (file == NULL) {
+        return -1;
+    }
+    size_t length = fread(meta, 1, sizeof(meta) - 1, file);
+    fclose(file);
+    meta[length] = '\0';
+    char key[64];
+    snprintf(key, sizeof(key), "-D%s=", name);
+    const char *found = strstr(meta, key);
+    return found != NULL ? atoi(found + strlen(key)) : -1;
+}
+
+// Synchronizes with the agent once; a later sync would restart the agent clock behind accepted stamps
+static void syncClock() {
+    if (!rmw_uros_epoch_synchronized()) {
+        nativeAgentEpochNanos = AGENT_EPOCH_NS;
+        syncAgentTime();
+    }
+}
+
+static int32_t target() {
+    return driver->registerValue(MOTOR_ID, TARGET_VELOCITY_DEC_ADDRESS);
+}
+
+void setUp() {
+    motorSerial.clearRx();
+    driver = new SimMotorDriver(motorSerial);
+    motorInhibit = 0;
+}
+
+void tearDown() {
+    motorSerial.onWrite = nullptr;
+    delete driver;
+}
+
+void test_profiles_per_topic() {
+    rcl_node_t node;
+    initializePublishers(&node);
+    initializeSubscribers(&node);
+    initializeServices(&node);
+    initializeIMU(&node);
+
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_RELIABLE, cmd_vel_subscriber.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_HISTORY_KEEP_LAST, cmd_vel_subscriber.qos.history);
+    TEST_ASSERT_EQUAL(1, cmd_vel_subscriber.qos.depth);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, imu_publisher.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, vel_publisher.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, heartbeat_subscriber.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_RELIABLE, reboot_service.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, diagnostics_publisher.qos.reliability);
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, com_check_publisher.qos.reliability);
+    // The dump stays reliable, with a bounded wait while the session is held
+    TEST_ASSERT_EQUAL(RMW_QOS_POLICY_RELIABILITY_RELIABLE, flight_dump_publisher.qos.reliability);
+    TEST_ASSERT_EQUAL(FLIGHT_DUMP_PUBLISH_TIMEOUT, flight_dump_publisher.session_timeout);
+    TEST_ASSERT_TRUE(msg_sub.header.frame_id.capacity > 0);
+}
+
+void test_entities_fit_library_limits() {
+    rcl_node_t node;
+    memset(&nativeEntities, 0, sizeof(nativeEntities));
+    initializePublishers(&node);
+    initializeSubscribers(&node);
+    initializeServices(&node);
+    initializeIMU(&node);
+    initializeParameterServer(&node);
+
+    // RCCHECK stops at the first entity over a limit, leaving the rest uninitialized
+    int publishers = metaLimit("RMW_UXRCE_MAX_PUBLISHERS");
+    int subscriptions = metaLimit("RMW_UXRCE_MAX_SUBSCRIPTIONS");
+    int services = metaLimit("RMW_UXRCE_MAX_SERVICES");
+    TEST_ASSERT_TRUE(publishers > 0 && subscriptions > 0 && services > 0);
+    TEST_ASSERT_LESS_OR_EQUAL(publishers, nativeEntities.publishers);
+    TEST_ASSERT_LESS_OR_EQUAL(subscriptions, nativeEntities.subscriptions);
+    TEST_ASSERT_LESS_OR_EQUAL(services, nativeEntities.services);
+}
+
+void test_stamp_checks() {
+    SubscriptionStats stats("cmd_vel");
+    int64_t now = AGENT_EPOCH_NS;
+    TEST_ASSERT_EQUAL(STAMP_LATE, stats.checkStamp(now - 300 * MS, now, 200 * MS));
+    TEST_ASSERT_EQUAL(STAMP_ACCEPTED, stats.checkStamp(now - 50 * MS, now, 200 * MS));
+    TEST_ASSERT_EQUAL(STAMP_OUT_OF_ORDER, stats.checkStamp(now - 60 * MS, now, 200 * MS));
+    TEST_ASSERT_EQUAL(STAMP_OUT_OF_ORDER, stats.checkStamp(now - 50 * MS, now, 200 * MS)); // Duplicate
+    // Slightly ahead of the board clock is accepted
+    TEST_ASSERT_EQUAL(STAMP_ACCEPTED, stats.checkStamp(now + 5 * MS, now, 200 * MS));
+    TEST_ASSERT_EQUAL(-5 * MS, stats.lastAgeNs());
+    TEST_ASSERT_EQUAL(5, stats.received());
+    TEST_ASSERT_EQUAL(2, stats.dropped());
+    TEST_ASSERT_EQUAL(1, stats.late());
+}
+
+void test_unchecked_stamps_are_accepted() {
+    SubscriptionStats stats("cmd_vel");
+    // Unstamped sender, and a clock that is not synchronized yet
+    TEST_ASSERT_EQUAL(STAMP_ACCEPTED, stats.checkStamp(0, AGENT_EPOCH_NS, 200 * MS));
+    TEST_ASSERT_EQUAL(STAMP_ACCEPTED, stats.checkStamp(AGENT_EPOCH_NS - 900 * MS, 0, 200 * MS));
+    // A disabled bound accepts any age
+    TEST_ASSERT_EQUAL(STAMP_ACCEPTED, stats.checkStamp(AGENT_EPOCH_NS - 800 * MS, AGENT_EPOCH_NS, 0));
+    TEST_ASSERT_EQUAL(0, stats.late());
+    TEST_ASSERT_EQUAL(0, stats.dropped());
+}
+
+void test_summary() {
+    SubscriptionStats stats("heartbeat");
+    char buf[128];
+    stats.add(20, 2, 1);
+    stats.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("heartbeat.rx=20 heartbeat.dropped=2 heartbeat.late=1", buf);
+    stats.checkStamp(AGENT_EPOCH_NS - 3 * MS, AGENT_EPOCH_NS, 0);
+    stats.summarize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("heartbeat.rx=21 heartbeat.dropped=2 heartbeat.late=1 heartbeat.age_us=3000", buf);
+}
+
+void test_stale_cmd_vel_is_not_applied() {
+    syncClock();
+    TEST_ASSERT_TRUE(rmw_uros_epoch_synchronized());
+    uint32_t late = cmdVelStats.late();
+    uint32_t dropped = cmdVelStats.dropped();
+
+    // Queued during a link hiccup: older than the bound
+    geometry_msgs__msg__TwistStamped stale =
+        makeCmdVel(-0.3, rmw_uros_epoch_nanos() - (int64_t)(controlParams.cmd_vel_max_age_ms + 100) * MS);
+    subscription_callback(&stale);
+    TEST_ASSERT_EQUAL(0, target());
+    TEST_ASSERT_EQUAL(late + 1, cmdVelStats.late());
+
+    geometry_msgs__msg__TwistStamped fresh = makeCmdVel(0.3, rmw_uros_epoch_nanos() - 20 * MS);
+    subscription_callback(&fresh);
+    TEST_ASSERT_NOT_EQUAL(0, target());
+
+    // Replayed older command, the wheel is stopped instead of keeping the last command
+    subscription_callback(&fresh);
+    TEST_ASSERT_EQUAL(dropped + 1, cmdVelStats.dropped());
+    TEST_ASSERT_EQUAL(0, target());
+
+    geometry_msgs__msg__TwistStamped next = makeCmdVel(0.0, rmw_uros_epoch_nanos());
+    subscription_callback(&next);
+    TEST_ASSERT_EQUAL(0, target());
+}
+
+void test_stale_stop_is_applied() {
+    syncClock();
+    geometry_msgs__msg__TwistStamped fresh = makeCmdVel(0.3, rmw_uros_epoch_nanos());
+    subscription_callback(&fresh);
+    TEST_ASSERT_NOT_EQUAL(0, target());
+
+    geometry_msgs__msg__TwistStamped stale =
+        makeCmdVel(0.0, rmw_uros_epoch_nanos() - (int64_t)(controlParams.cmd_vel_max_age_ms + 100) * MS);
+    subscription_callback(&stale);
+    TEST_ASSERT_EQUAL(0, target());
+}
+
+void test_wheel_stops_without_new_cmd_vel() {
+    rcl_node_t node;
+    initializePublishers(&node);
+    syncClock();
+    controlParams.cmd_vel_timeout_ms = 20;
+
+    geometry_msgs__msg__TwistStamped fresh = makeCmdVel(0.3, rmw_uros_epoch_nanos());
+    subscription_callback(&fresh);
+    wheel_callback();
+    TEST_ASSERT_NOT_EQUAL(0, target());
+
+    // The sender went silent
+    delay(controlParams.cmd_vel_timeout_ms + 10);
+    wheel_callback();
+    TEST_ASSERT_EQUAL(0, target());
+    controlParams.cmd_vel_timeout_ms = CMD_VEL_TIMEOUT;
+}
+
+void test_slow_cmd_vel_sender_is_not_stopped() {
+    rcl_node_t node;
+    initializePublishers(&node);
+    syncClock();
+
+    // Slower than the stamp age bound, within the dead-man timeout
+    for (int i = 0; i < 3; i++) {
+        geometry_msgs__msg__TwistStamped fresh = makeCmdVel(0.3, rmw_uros_epoch_nanos());
+        subscription_callback(&fresh);
+        delay(controlParams.cmd_vel_max_age_ms + 50);
+        wheel_callback();
+        TEST_ASSERT_NOT_EQUAL(0, target());
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_profiles_per_topic);
+    RUN_TEST(test_entities_fit_library_limits);
+    RUN_TEST(test_stamp_checks);
+    RUN_TEST(test_unchecked_stamps_are_accepted);
+    RUN_TEST(test_summary);
+    RUN_TEST(test_stale_cmd_vel_is_not_applied);
+    RUN_TEST(test_stale_stop_is_applied);
+    RUN_TEST(test_wheel_stops_without_new_cmd_vel);
+    RUN_TEST(test_slow_cmd_vel_sender_is_not_stopped);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include "TransportBenchmark.h"
+
+static char summary[256];
+
+// Returns the value of key in the last summary, or -1 if it is missing
+static long summaryValue(const char *key) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    const char *found = strstr(summary, pattern);
+    return found ? strtol(found + strlen(pattern), NULL, 10) : -1;
+}
+
+void setUp() {
+    memset(summary, 0, sizeof(summary));
+}
+
+void tearDown() {}
+
+void test_rtt_statistics() {
+    TransportBenchmark bench;
+    bench.reset(0);
+    // 100 pings 1 ms apart, ping i takes (i + 1) * 10 us to come back
+    for (uint32_t i = 0; i < 100; i++) {
+        uint32_t seq = bench.nextPing(i * 1000);
+        TEST_ASSERT_EQUAL_UINT32(i, seq);
+        TEST_ASSERT_TRUE(bench.onEcho(seq, i * 1000 + (i + 1) * 10));
+    }
+    bench.summarize(summary, sizeof(summary), "serial", 100000);
+    TEST_ASSERT_EQUAL(0, strncmp(summary, "transport=serial ", 17));
+    TEST_ASSERT_EQUAL(100, summaryValue("sent"));
+    TEST_ASSERT_EQUAL(100, summaryValue("received"));
+    TEST_ASSERT_EQUAL(10, summaryValue("rtt_min_us"));
+    TEST_ASSERT_EQUAL(505, summaryValue("rtt_avg_us"));
+    TEST_ASSERT_EQUAL(1000, summaryValue("rtt_p99_us"));
+    TEST_ASSERT_EQUAL(1000, summaryValue("rtt_max_us"));
+    TEST_ASSERT_EQUAL(1000, summaryValue("echo_per_s")); // 100 echoes in 100 ms
+}
+
+void test_unknown_and_duplicate_echoes_are_rejected() {
+    TransportBenchmark bench;
+    uint32_t seq = bench.nextPing(0);
+    TEST_ASSERT_FALSE(bench.onEcho(seq + 1, 100)); // Never sent
+    TEST_ASSERT_TRUE(bench.onEcho(seq, 100));
+    TEST_ASSERT_FALSE(bench.onEcho(seq, 200));     // Already answered
+    bench.summarize(summary, sizeof(summary), "udp", 1000);
+    TEST_ASSERT_EQUAL(1, summaryValue("received"));
+    TEST_ASSERT_EQUAL(100, summaryValue("rtt_max_us"));
+}
+
+void test_late_echo_after_slot_reuse_is_rejected() {
+    TransportBenchmark bench;
+    uint32_t first = bench.nextPing(0);
+    // A full window later the slot of the first ping holds a newer one
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < BENCH_WINDOW; i++) {
+        last = bench.nextPing(10 + i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(first + BENCH_WINDOW, last);
+    TEST_ASSERT_FALSE(bench.onEcho(first, 5000));
+    TEST_ASSERT_TRUE(bench.onEcho(last, 5000));
+    bench.summarize(summary, sizeof(summary), "serial", 10000);
+    TEST_ASSERT_EQUAL(BENCH_WINDOW + 1, summaryValue("sent"));
+    TEST_ASSERT_EQUAL(1, summaryValue("received"));
+    TEST_ASSERT_EQUAL(5000 - (10 + BENCH_WINDOW - 1), summaryValue("rtt_min_us"));
+}
+
+void test_rtt_samples_are_capped_per_window() {
+    TransportBenchmark bench;
+    bench.reset(0);
+    // More echoes than the window holds, the later ones are counted but not sampled
+    for (uint32_t i = 0; i < BENCH_WINDOW + 10; i++) {
+        uint32_t seq = bench.nextPing(i * 100);
+        uint32_t rtt = i < BENCH_WINDOW ? 50 : 9000;
+        TEST_ASSERT_TRUE(bench.onEcho(seq, i * 100 + rtt));
+    }
+    bench.summarize(summary, sizeof(summary), "serial", 1000000);
+    TEST_ASSERT_EQUAL(BENCH_WINDOW + 10, summaryValue("received"));
+    TEST_ASSERT_EQUAL(50, summaryValue("rtt_max_us"));
+}
+
+void test_reset_starts_a_new_window() {
+    TransportBenchmark bench;
+    bench.reset(0);
+    uint32_t old_seq = bench.nextPing(0);
+    TEST_ASSERT_TRUE(bench.onEcho(bench.nextPing(0), 700));
+
+    bench.reset(BENCH_REPORT_INTERVAL * 1000UL);
+    // Pings of the previous window are not matched, numbering continues
+    TEST_ASSERT_FALSE(bench.onEcho(old_seq, BENCH_REPORT_INTERVAL * 1000UL + 10));
+    uint32_t seq = bench.nextPing(BENCH_REPORT_INTERVAL * 1000UL);
+    TEST_ASSERT_EQUAL_UINT32(2, seq);
+    TEST_ASSERT_TRUE(bench.onEcho(seq, BENCH_REPORT_INTERVAL * 1000UL + 300));
+    bench.summarize(summary, sizeof(summary), "serial", BENCH_REPORT_INTERVAL * 1000UL + 500000);
+    TEST_ASSERT_EQUAL(1, summaryValue("sent"));
+    TEST_ASSERT_EQUAL(1, summaryValue("received"));
+    TEST_ASSERT_EQUAL(300, summaryValue("rtt_max_us"));
+    TEST_ASSERT_EQUAL(2, summaryValue("echo_per_s"));
+}
+
+void test_micros_rollover() {
+    TransportBenchmark bench;
+    bench.reset(0xFFFFF000u);
+    uint32_t seq = bench.nextPing(0xFFFFFF00u);
+    TEST_ASSERT_TRUE(bench.onEcho(seq, 0x100));
+    bench.summarize(summary, sizeof(summary), "serial", 0x1000);
+    TEST_ASSERT_EQUAL(0x200, summaryValue("rtt_min_us"));
+    TEST_ASSERT_EQUAL(1000000 / 0x2000, summaryValue("echo_per_s"));
+}
+
+void test_empty_window_and_truncation() {
+    TransportBenchmark bench;
+    bench.reset(0);
+    size_t written = bench.summarize(summary, sizeof(summary), "framed_serial", 0);
+    TEST_ASSERT_EQUAL(strlen(summary), written);
+    TEST_ASSERT_EQUAL(0, summaryValue("rtt_p99_us"));
+    TEST_ASSERT_EQUAL(0, summaryValue("echo_per_s"));
+
+    char small[16];
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, bench.summarize(small, sizeof(small), "serial", 0));
+    TEST_ASSERT_EQUAL(sizeof(small) - 1, strlen(small));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_rtt_statistics);
+    RUN_TEST(test_unknown_and_duplicate_echoes_are_rejected);
+    RUN_TEST(test_late_echo_after_slot_reuse_is_rejected);
+    RUN_TEST(test_rtt_samples_are_capped_per_window);
+    RUN_TEST(test_reset_starts_a_new_window);
+    RUN_TEST(test_micros_rollover);
+    RUN_TEST(test_empty_window_and_truncation);
+    return UNITY_END();
+}
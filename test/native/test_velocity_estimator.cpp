@@ -0,0 +1,150 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <unity.h>
+#include "VelocityEstimator.h"
+
+static const float METERS_PER_COUNT = 2.0f * 3.14159265f * 0.055f / 4096.0f; // Default wheel, 4096 counts per turn
+static const uint32_t TICK_US = 10000; // Wheel stream period
+
+// Encoder of a wheel moving at a constant speed, positions truncated to whole counts
+static double true_counts;
+
+static int32_t advance(float velocity, uint32_t dt_us) {
+    true_counts += velocity / METERS_PER_COUNT * dt_us * 1e-6;
+    return (int32_t)floor(true_counts);
+}
+
+static VelocityEstimator makeEstimator() {
+    VelocityEstimator estimator;
+    estimator.configure(METERS_PER_COUNT, VELOCITY_PROCESS_NOISE, MOTOR_RESPONSE_TIME);
+    return estimator;
+}
+
+void setUp() {
+    true_counts = 0.0;
+}
+
+void tearDown() {}
+
+void test_first_sample_is_reference() {
+    VelocityEstimator estimator = makeEstimator();
+    TEST_ASSERT_FALSE(estimator.update(100, 0, 0.0f));
+    TEST_ASSERT_FALSE(estimator.isValid());
+    TEST_ASSERT_TRUE(estimator.update(100 + 410, 100000, 0.0f));
+    TEST_ASSERT_TRUE(estimator.isValid());
+}
+
+void test_converges_at_cruise_speed() {
+    VelocityEstimator estimator = makeEstimator();
+    uint32_t t = 0;
+    for (int i = 0; i < 200; i++, t += TICK_US) {
+        estimator.update(advance(0.5f, TICK_US), t, 0.5f);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.5f, estimator.velocity());
+    TEST_ASSERT_TRUE(estimator.variance() < 1e-4f);
+}
+
+void test_creep_speed() {
+    // 5 mm/s advances about 0.6 counts per tick, below one whole RPM (5.8 mm/s)
+    // so the speed register reports zero
+    VelocityEstimator estimator = makeEstimator();
+    uint32_t t = 0;
+    float sum = 0.0f;
+    for (int i = 0; i < 600; i++, t += TICK_US) {
+        estimator.update(advance(0.005f, TICK_US), t, 0.005f);
+        if (i >= 300) {
+            sum += estimator.velocity();
+            TEST_ASSERT_FLOAT_WITHIN(0.004f, 0.005f, estimator.velocity());
+        }
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 0.005f, sum / 300);
+}
+
+void test_command_prior_tracks_a_step() {
+    VelocityEstimator estimator = makeEstimator();
+    uint32_t t = 0;
+    for (int i = 0; i < 50; i++, t += TICK_US) {
+        estimator.update(advance(0.0f, TICK_US), t, 0.0f);
+    }
+    // The wheel follows the command with the modelled lag, the prior keeps the estimate close
+    float wheel = 0.0f;
+    for (int i = 0; i < 30; i++, t += TICK_US) {
+        float alpha = TICK_US * 1e-6f / (MOTOR_RESPONSE_TIME + TICK_US * 1e-6f);
+        wheel += alpha * (0.3f - wheel);
+        estimator.update(advance(wheel, TICK_US), t, 0.3f);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, wheel, estimator.velocity());
+}
+
+void test_stalled_wheel_is_not_hidden_by_the_prior() {
+    VelocityEstimator estimator = makeEstimator();
+    uint32_t t = 0;
+    for (int i = 0; i < 100; i++, t += TICK_US) {
+        estimator.update(advance(0.0f, TICK_US), t, 0.3f);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, estimator.velocity());
+}
+
+void test_missed_samples_grow_variance() {
+    VelocityEstimator estimator = makeEstimator();
+    uint32_t t = 0;
+    for (int i = 0; i < 100; i++, t += TICK_US) {
+        estimator.update(advance(0.2f, TICK_US), t, 0.2f);
+    }
+    float settled = estimator.variance();
+    estimator.predict(t + 5 * TICK_US, 0.2f);
+    TEST_ASSERT_TRUE(estimator.variance() > settled);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.2f, estimator.velocity());
+
+    // The next sample spans the whole gap with its exact timestamp
+    t += 5 * TICK_US;
+    TEST_ASSERT_TRUE(estimator.update(advance(0.2f, 6 * TICK_US), t, 0.2f));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.2f, estimator.velocity());
+}
+
+void test_long_gap_restarts() {
+    VelocityEstimator estimator = makeEstimator();
+    estimator.update(0, 0, 0.0f);
+    estimator.update(10, TICK_US, 0.0f);
+    TEST_ASSERT_FALSE(estimator.update(5000, TICK_US + ESTIMATOR_RESET_GAP + 1, 0.1f));
+    TEST_ASSERT_FALSE(estimator.isValid());
+    TEST_ASSERT_EQUAL_FLOAT(0.1f, estimator.velocity());
+}
+
+void test_position_and_clock_wrap() {
+    VelocityEstimator estimator = makeEstimator();
+    int32_t position = 0x7FFFFF00;
+    uint32_t t = 0xFFFFFFFFu - 5 * TICK_US;
+    for (int i = 0; i < 100; i++, t += TICK_US) {
+        estimator.update(position, t, 0.1f);
+        position = (int32_t)((uint32_t)position + 12); // About 0.1 m/s
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 12 * METERS_PER_COUNT / (TICK_US * 1e-6f), estimator.velocity());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_is_reference);
+    RUN_TEST(test_converges_at_cruise_speed);
+    RUN_TEST(test_creep_speed);
+    RUN_TEST(test_command_prior_tracks_a_step);
+    RUN_TEST(test_stalled_wheel_is_not_hidden_by_the_prior);
+    RUN_TEST(test_missed_samples_grow_variance);
+    RUN_TEST(test_long_gap_restarts);
+    RUN_TEST(test_position_and_clock_wrap);
+    return UNITY_END();
+}
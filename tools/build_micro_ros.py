@@ -0,0 +1,77 @@
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Rebuilds the micro-ROS static library with the entity limits of tools/colcon.meta.
+
+The precompiled micro_ros_arduino library allows 10 publishers and a single
+service, fewer than the node creates. PlatformIO runs this script before
+every firmware build; when tools/colcon.meta differs from the one the
+installed library was built with, it copies the file into the library and
+regenerates the ESP32 build with the micro-ROS static library builder image:
+
+    docker run --rm -v <libdeps>/micro_ros_arduino:/project \\
+        --env MICROROS_LIBRARY_FOLDER=extras \\
+        microros/micro_ros_static_library_builder:$MICRO_ROS_DISTRO -p esp32
+
+MICRO_ROS_DISTRO defaults to humble and must match the library branch.
+"""
+
+import hashlib
+import os
+import shutil
+import subprocess
+
+Import("env")  # noqa: F821, provided by PlatformIO
+
+META = os.path.join(env.subst("$PROJECT_DIR"), "tools", "colcon.meta")
+LIBRARY = os.path.join(env.subst("$PROJECT_LIBDEPS_DIR"), env.subst("$PIOENV"), "micro_ros_arduino")
+STAMP = os.path.join(LIBRARY, ".colcon_meta.sha1")  # Digest of the meta the library was built with
+DISTRO = os.environ.get("MICRO_ROS_DISTRO", "humble")
+
+
+def digest(path):
+    with open(path, "rb") as f:
+        return hashlib.sha1(f.read()).hexdigest()
+
+
+def built_digest():
+    try:
+        with open(STAMP) as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+
+def rebuild():
+    shutil.copyfile(META, os.path.join(LIBRARY, "extras", "library_generation", "colcon.meta"))
+    command = ["docker", "run", "--rm", "-v", LIBRARY + ":/project",
+               "--env", "MICROROS_LIBRARY_FOLDER=extras",
+               "microros/micro_ros_static_library_builder:" + DISTRO, "-p", "esp32"]
+    print("Rebuilding micro-ROS with %s: %s" % (META, " ".join(command)))
+    try:
+        return subprocess.call(command) == 0
+    except OSError as e:
+        print("Cannot run docker: %s" % e)
+        return False
+
+
+# Native envs do not install the library
+if os.path.isdir(LIBRARY):
+    wanted = digest(META)
+    if built_digest() != wanted:
+        if not rebuild():
+            print("micro-ROS library rebuild failed, the node would exceed the stock entity limits")
+            env.Exit(1)
+        with open(STAMP, "w") as f:
+            f.write(wanted + "\n")
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Records and decodes the raw data capture stream (CaptureStream.h).
+
+Reads COBS-framed records from the capture port, or from a file saved
+earlier with --raw, checks their CRC and sequence numbers, and writes one
+CSV or NPY file per record kind. Enable the capture first, for example:
+
+    ros2 param set /left_wheel_micro_ros_node capture_mask 7
+    python3 tools/capture_decode.py --port /dev/ttyUSB1 --seconds 30 --raw run.cap -o run
+    python3 tools/capture_decode.py --file run.cap -o run --format npy
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import time
+
+CAPTURE_BAUD_RATE = 2000000
+HEADER = struct.Struct('<BII')  # type, seq, timestamp_us
+
+# Record kinds: name, payload layout and column names
+RECORDS = {
+    1: ('imu', struct.Struct('<12f'),
+        ['ax', 'ay', 'az', 'gx', 'gy', 'gz',
+         'ax_filtered', 'ay_filtered', 'az_filtered', 'gx_filtered', 'gy_filtered', 'gz_filtered']),
+    2: ('motor_tx', struct.Struct('<10B'), [f'b{i}' for i in range(10)]),
+    3: ('motor_rx', struct.Struct('<10B'), [f'b{i}' for i in range(10)]),
+    4: ('tick', struct.Struct('<B'), ['stream']),
+}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(frame):
+            return None
+        out += frame[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    def __init__(self):
+        self.rows = {kind: [] for kind in RECORDS}
+        self.buffer = bytearray()
+        self.next_seq = None
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            end = self.buffer.find(b'\x00')
+            if end < 0:
+                return
+            frame = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if frame:
+                self.decode(frame)
+
+    def decode(self, frame):
+        raw = cobs_decode(frame)
+        # Log text sharing the USB port also ends up here and fails the CRC
+        if raw is None or len(raw) < HEADER.size + 2 or crc16(raw[:-2]) != struct.unpack('<H', raw[-2:])[0]:
+            self.bad += 1
+            return
+        kind, seq, timestamp_us = HEADER.unpack_from(raw)
+        payload = raw[HEADER.size:-2]
+        if kind not in RECORDS or len(payload) != RECORDS[kind][1].size:
+            self.bad += 1
+            return
+        if self.next_seq is not None and seq != self.next_seq:
+            self.lost += (seq - self.next_seq) & 0xFFFFFFFF
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+        self.frames += 1
+        self.rows[kind].append((seq, timestamp_us) + RECORDS[kind][1].unpack(payload))
+
+    def write(self, prefix, fmt):
+        for kind, rows in self.rows.items():
+            if not rows:
+                continue
+            name, _, columns = RECORDS[kind]
+            columns = ['seq', 'timestamp_us'] + columns
+            if fmt == 'npy':
+                import numpy as np
+                path = f'{prefix}_{name}.npy'
+                np.save(path, np.array(rows, dtype=[(c, 'f8') for c in columns]))
+            else:
+                path = f'{prefix}_{name}.csv'
+                with open(path, 'w', newline='') as f:
+                    writer = csv.writer(f)
+                    writer.writerow(columns)
+                    writer.writerows(rows)
+            print(f'{path}: {len(rows)} records')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='capture serial port')
+    source.add_argument('--file', help='raw capture saved with --raw')
+    parser.add_argument('--baud', type=int, default=CAPTURE_BAUD_RATE, help='baud rate of the port')
+    parser.add_argument('--seconds', type=float, default=10.0, help='recording time from the port')
+    parser.add_argument('--raw', help='also save the received bytes to this file')
+    parser.add_argument('-o', '--output', default='capture', help='output file prefix')
+    parser.add_argument('--format', choices=['csv', 'npy'], default='csv')
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    raw_file = open(args.raw, 'wb') if args.raw else None
+    if args.file:
+        with open(args.file, 'rb') as f:
+            decoder.feed(f.read())
+    else:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            end = time.monotonic() + args.seconds
+            while time.monotonic() < end:
+                data = port.read(65536)
+                if raw_file:
+                    raw_file.write(data)
+                decoder.feed(data)
+    if raw_file:
+        raw_file.close()
+
+    decoder.write(args.output, args.format)
+    print(f'frames={decoder.frames} lost={decoder.lost} bad={decoder.bad}')
+    if decoder.frames == 0:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,481 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fleet soak test: many simulated wheel nodes against one agent stand-in.
+//
+// The parent process is the agent stand-in. For every instance it forks a
+// child running the firmware logic of the native build (setupMicroROS, the
+// executor tasks, a SimMotorDriver on motorSerial) with its node in the
+// namespace /<prefix>NN. Each child talks to the parent over its own
+// SOCK_SEQPACKET socket, like a client session of the agent: subscriptions
+// keep their KEEP_LAST history depth, a full socket drops the outgoing message.
+// The parent drives cmd_vel and link pings to every instance, resolves the
+// published topic names in each node's namespace, and prints one JSON object
+// per instance and one summary per instance count:
+//
+//   pio run -e native_fleet_soak
+//   .pio/build/native_fleet_soak/program --instances 1,4,16,32 [--duration 10]
+//       [--cmd-rate 20] [--ping-rate 10] [--namespace robot]
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "IMUManager.h"
+#include "LinkMonitor.h"
+#include "SimMotorDriver.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+#define SOAK_NAME_SIZE 64 // Capacity of the topic and node names in a packet
+#define SOAK_WARMUP 2000 // Time for the instances to boot before measuring in milliseconds
+#define SOAK_DRAIN 200 // Wait for late echoes after the measurement in milliseconds
+
+// Packets between the agent stand-in and an instance
+enum SoakKind : uint8_t {
+    SOAK_HELLO = 0,    // Instance: node name and namespace after setupMicroROS
+    SOAK_CMD_VEL = 1,  // Agent: velocity command
+    SOAK_PING = 2,     // Agent: link ping for the heartbeat subscription
+    SOAK_PUBLISH = 3,  // Instance: one rcl_publish()
+};
+
+struct SoakPacket {
+    uint8_t kind;
+    uint32_t seq;                      // Sequence number of the sender, gaps are dropped packets
+    uint32_t rx_dropped;               // Instance: received messages pushed out of a history so far
+    int64_t sent_ns;                   // CLOCK_MONOTONIC at send, shared by every process on the host
+    char name[SOAK_NAME_SIZE];         // Topic as named by the firmware, or the node name
+    char ns[SOAK_NAME_SIZE];           // HELLO: node namespace
+    double linear_x;                   // CMD_VEL
+    double angular_z;
+    int32_t fields[LINK_PING_FIELDS];  // PING, and the echo of the heartbeat publisher
+};
+
+static int64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void copyName(char *dst, const char *src) {
+    snprintf(dst, SOAK_NAME_SIZE, "%s", src != NULL ? src : "");
+}
+
+// ---- Instance side, runs in the forked child ----
+
+static int client_fd = -1;
+static std::mutex client_lock;                                     // Inbox, the executor tasks take concurrently
+static std::map<std::string, std::deque<SoakPacket>> client_inbox; // Received messages per subscription topic
+static std::atomic<uint32_t> client_seq(0);
+static std::atomic<uint32_t> client_rx_dropped(0);
+
+static void clientSend(SoakPacket &packet) {
+    packet.seq = client_seq++;
+    packet.rx_dropped = client_rx_dropped;
+    packet.sent_ns = nowNanos();
+    send(client_fd, &packet, sizeof(packet), MSG_DONTWAIT); // A full socket drops it, the agent sees the gap
+}
+
+static void clientPublish(const rcl_publisher_t *publisher, const void *msg) {
+    SoakPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.kind = SOAK_PUBLISH;
+    copyName(packet.name, publisher->topic);
+    if (publisher == &heartbeat_publisher) {
+        const std_msgs__msg__Int32MultiArray *echo = (const std_msgs__msg__Int32MultiArray *)msg;
+        for (size_t i = 0; i < echo->data.size && i < LINK_PING_FIELDS; i++) {
+            packet.fields[i] = echo->data.data[i];
+        }
+    }
+    clientSend(packet);
+}
+
+// Moves received packets into the history of their subscription, then takes the oldest for topic
+static bool clientTake(const char *topic, void *msg) {
+    std::lock_guard<std::mutex> guard(client_lock);
+    SoakPacket packet;
+    while (recv(client_fd, &packet, sizeof(packet), MSG_DONTWAIT) == (ssize_t)sizeof(packet)) {
+        const rcl_subscription_t *sub = packet.kind == SOAK_CMD_VEL ? &cmd_vel_subscriber : &heartbeat_subscriber;
+        std::deque<SoakPacket> &history = client_inbox[sub->topic];
+        history.push_back(packet);
+        if (history.size() > std::max<size_t>(sub->qos.depth, 1)) {
+            history.pop_front(); // KEEP_LAST, the oldest message is lost
+            client_rx_dropped++;
+        }
+    }
+    std::map<std::string, std::deque<SoakPacket>>::iterator it = client_inbox.find(topic);
+    if (it == client_inbox.end() || it->second.empty()) {
+        return false;
+    }
+    packet = it->second.front();
+    it->second.pop_front();
+    if (packet.kind == SOAK_CMD_VEL) {
+        geometry_msgs__msg__TwistStamped *cmd = (geometry_msgs__msg__TwistStamped *)msg;
+        cmd->header.stamp.sec = 0; // Unchecked, the instances do not sync to an agent clock
+        cmd->header.stamp.nanosec = 0;
+        memset(&cmd->twist, 0, sizeof(cmd->twist));
+        cmd->twist.linear.x = packet.linear_x;
+        cmd->twist.angular.z = packet.angular_z;
+    } else {
+        std_msgs__msg__Int32MultiArray *ping = (std_msgs__msg__Int32MultiArray *)msg;
+        ping->data.size = std::min<size_t>(LINK_PING_FIELDS, ping->data.capacity);
+        memcpy(ping->data.data, packet.fields, ping->data.size * sizeof(int32_t));
+    }
+    return true;
+}
+
+static void runInstance(int fd, const std::string &ns, bool verbose) {
+    if (!verbose) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO); // Keep the firmware's debug output out of the report
+        close(null_fd);
+    }
+    client_fd = fd;
+    nativeNodeNamespace = ns.c_str();
+    nativePublishHook = clientPublish;
+    nativeTakeHook = clientTake;
+
+    SimMotorDriver driver(motorSerial);
+    initializeUART();
+    setupMicroROS();
+
+    SoakPacket hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.kind = SOAK_HELLO;
+    copyName(hello.name, node.name);
+    copyName(hello.ns, node.namespace_);
+    clientSend(hello);
+
+    startExecutorTasks();
+    for (;;) {
+        pause(); // The agent ends the instance with SIGTERM
+    }
+}
+
+// ---- Agent side ----
+
+struct Instance {
+    pid_t pid;
+    int fd;
+    std::string node;                        // Node name from the HELLO
+    std::string ns;                          // Node namespace from the HELLO
+    uint32_t next_seq;                       // Expected sequence number of the next packet
+    uint64_t received;                       // PUBLISH packets in the measurement
+    uint64_t gaps;                           // Packets the instance could not send
+    uint32_t rx_dropped;                     // Latest history drop count of the instance
+    uint32_t rx_dropped_start;               // rx_dropped when the measurement started
+    uint64_t velocity;                       // Velocity messages in the measurement
+    uint64_t cmd_sent;                       // cmd_vel sent in the measurement
+    uint64_t send_failures;                  // Agent sends refused by a full socket
+    uint32_t ping_seq;
+    std::map<uint32_t, int64_t> pings;       // Send time of the pings not echoed yet
+    uint64_t pings_sent;
+    std::vector<int64_t> rtt_ns;             // Ping to echo at the agent
+    std::vector<int64_t> latency_ns;         // rcl_publish() in the instance to the agent
+    std::set<std::string> topics;            // Topics as named by the firmware
+};
+
+static bool endsWith(const std::string &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Name resolution of ROS 2: absolute names ignore the namespace
+static std::string resolveName(const std::string &ns, const std::string &name) {
+    if (!name.empty() && name[0] == '/') {
+        return name;
+    }
+    std::string base = ns.empty() || ns == "/" ? "" : ns;
+    return base + "/" + name;
+}
+
+static int64_t percentile(std::vector<int64_t> &samples, int pct) {
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t index = (samples.size() * pct) / 100;
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+static void receive(Instance &inst, bool measuring) {
+    SoakPacket packet;
+    while (recv(inst.fd, &packet, sizeof(packet), MSG_DONTWAIT) == (ssize_t)sizeof(packet)) {
+        int64_t now = nowNanos();
+        if (packet.seq != inst.next_seq && measuring) {
+            inst.gaps += packet.seq - inst.next_seq;
+        }
+        inst.next_seq = packet.seq + 1;
+        inst.rx_dropped = packet.rx_dropped;
+        if (packet.kind == SOAK_HELLO) {
+            inst.node = packet.name;
+            inst.ns = packet.ns;
+            continue;
+        }
+        std::string topic = packet.name;
+        inst.topics.insert(topic);
+        if (!measuring) {
+            continue;
+        }
+        inst.received++;
+        inst.latency_ns.push_back(now - packet.sent_ns);
+        if (endsWith(topic, "/velocity")) {
+            inst.velocity++;
+        } else if (endsWith(topic, "/heartbeat_response")) {
+            std::map<uint32_t, int64_t>::iterator it = inst.pings.find((uint32_t)packet.fields[LINK_ECHO_SEQ]);
+            if (it != inst.pings.end()) {
+                inst.rtt_ns.push_back(now - it->second);
+                inst.pings.erase(it);
+            }
+        }
+    }
+}
+
+static void sendToInstance(Instance &inst, SoakPacket &packet) {
+    packet.sent_ns = nowNanos();
+    if (send(inst.fd, &packet, sizeof(packet), MSG_DONTWAIT) != (ssize_t)sizeof(packet)) {
+        inst.send_failures++;
+    }
+}
+
+static void sendCmdVel(Instance &inst, uint64_t tick) {
+    SoakPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.kind = SOAK_CMD_VEL;
+    packet.seq = (uint32_t)tick;
+    packet.linear_x = 0.5 * ((tick % 20) - 10) / 10.0; // Sweeps the wheel through both directions
+    packet.angular_z = 0.2;
+    sendToInstance(inst, packet);
+    inst.cmd_sent++;
+}
+
+static void sendPing(Instance &inst, int64_t last_echo_ns) {
+    SoakPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.kind = SOAK_PING;
+    packet.seq = inst.ping_seq;
+    int64_t now = nowNanos();
+    packet.fields[LINK_PING_SEQ] = (int32_t)inst.ping_seq;
+    packet.fields[LINK_PING_HOST_STAMP] = (int32_t)(now / 1000);
+    packet.fields[LINK_PING_HOLD] = last_echo_ns > 0 ? (int32_t)((now - last_echo_ns) / 1000) : 0;
+    inst.pings[inst.ping_seq++] = now;
+    inst.pings_sent++;
+    sendToInstance(inst, packet);
+}
+
+// Runs count instances for duration_ms and prints the report lines
+static bool runFleet(int count, int duration_ms, int cmd_rate, int ping_rate, const std::string &prefix, bool verbose) {
+    std::vector<Instance> fleet(count);
+    for (int i = 0; i < count; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+            perror("socketpair");
+            return false;
+        }
+        char ns[SOAK_NAME_SIZE] = "";
+        if (!prefix.empty()) {
+            snprintf(ns, sizeof(ns), "/%s%02d", prefix.c_str(), i + 1);
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return false;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            for (int j = 0; j < i; j++) {
+                close(fleet[j].fd);
+            }
+            runInstance(fds[1], ns, verbose);
+            _exit(0);
+        }
+        close(fds[1]);
+        Instance &inst = fleet[i];
+        inst.pid = pid;
+        inst.fd = fds[0];
+        inst.next_seq = 0;
+        inst.received = inst.gaps = inst.velocity = inst.cmd_sent = inst.send_failures = inst.pings_sent = 0;
+        inst.rx_dropped = inst.rx_dropped_start = 0;
+        inst.ping_seq = 0;
+    }
+
+    std::vector<struct pollfd> polls(count);
+    for (int i = 0; i < count; i++) {
+        polls[i].fd = fleet[i].fd;
+        polls[i].events = POLLIN;
+    }
+
+    int64_t start = nowNanos();
+    int64_t measure_start = start + (int64_t)SOAK_WARMUP * 1000000LL;
+    int64_t measure_end = measure_start + (int64_t)duration_ms * 1000000LL;
+    int64_t cmd_period = cmd_rate > 0 ? 1000000000LL / cmd_rate : 0;
+    int64_t ping_period = ping_rate > 0 ? 1000000000LL / ping_rate : 0;
+    int64_t next_cmd = start;
+    int64_t next_ping = measure_start;
+    int64_t last_echo_ns = 0;
+    uint64_t cmd_tick = 0;
+    bool measuring = false;
+
+    for (;;) {
+        int64_t now = nowNanos();
+        if (!measuring && now >= measure_start) {
+            measuring = true;
+            for (Instance &inst : fleet) {
+                inst.rx_dropped_start = inst.rx_dropped;
+            }
+        }
+        if (now >= measure_end + (int64_t)SOAK_DRAIN * 1000000LL) {
+            break;
+        }
+        bool sending = now < measure_end;
+        if (sending && cmd_period > 0 && now >= next_cmd) {
+            for (Instance &inst : fleet) {
+                sendCmdVel(inst, cmd_tick);
+            }
+            cmd_tick++;
+            next_cmd += cmd_period;
+        }
+        if (sending && measuring && ping_period > 0 && now >= next_ping) {
+            for (Instance &inst : fleet) {
+                sendPing(inst, last_echo_ns);
+            }
+            last_echo_ns = now;
+            next_ping += ping_period;
+        }
+
+        int64_t next = std::min(cmd_period > 0 ? next_cmd : INT64_MAX, ping_period > 0 ? next_ping : INT64_MAX);
+        int timeout_ms = (int)std::max<int64_t>(0, std::min<int64_t>(next - nowNanos(), 10000000LL) / 1000000LL);
+        if (poll(polls.data(), polls.size(), timeout_ms) > 0) {
+            for (int i = 0; i < count; i++) {
+                if (polls[i].revents & POLLIN) {
+                    receive(fleet[i], measuring && nowNanos() < measure_end);
+                }
+            }
+        }
+    }
+
+    for (Instance &inst : fleet) {
+        kill(inst.pid, SIGTERM);
+        waitpid(inst.pid, NULL, 0);
+        close(inst.fd);
+    }
+
+    // Resolved names shared by several instances reach the same DDS topic
+    std::map<std::string, std::set<int>> resolved;
+    std::map<std::string, int> node_names;
+    double seconds = duration_ms / 1000.0;
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        Instance &inst = fleet[i];
+        for (const std::string &topic : inst.topics) {
+            resolved[resolveName(inst.ns, topic)].insert(i);
+        }
+        node_names[resolveName(inst.ns, inst.node)]++;
+        total += inst.received;
+        uint64_t lost_pings = inst.pings.size();
+        printf("{\"instances\":%d,\"instance\":%d,\"node\":\"%s\",\"publish_per_s\":%.1f,\"velocity_hz\":%.1f,"
+               "\"latency_p50_us\":%lld,\"latency_p99_us\":%lld,\"latency_max_us\":%lld,"
+               "\"rtt_p50_us\":%lld,\"rtt_p99_us\":%lld,\"pings\":%llu,\"pings_lost\":%llu,"
+               "\"cmd_vel\":%llu,\"dropped_out\":%llu,\"dropped_in\":%u,\"agent_send_failures\":%llu}\n",
+               count, i + 1, resolveName(inst.ns, inst.node).c_str(), inst.received / seconds,
+               inst.velocity / seconds, (long long)(percentile(inst.latency_ns, 50) / 1000),
+               (long long)(percentile(inst.latency_ns, 99) / 1000), (long long)(percentile(inst.latency_ns, 100) / 1000),
+               (long long)(percentile(inst.rtt_ns, 50) / 1000), (long long)(percentile(inst.rtt_ns, 99) / 1000),
+               (unsigned long long)inst.pings_sent, (unsigned long long)lost_pings,
+               (unsigned long long)inst.cmd_sent, (unsigned long long)inst.gaps,
+               (unsigned)(inst.rx_dropped - inst.rx_dropped_start), (unsigned long long)inst.send_failures);
+    }
+    size_t shared = 0;
+    std::string example;
+    for (const auto &entry : resolved) {
+        if (entry.second.size() > 1) {
+            shared++;
+            if (example.empty()) {
+                example = entry.first;
+            }
+        }
+    }
+    size_t duplicate_nodes = 0;
+    for (const auto &entry : node_names) {
+        duplicate_nodes += entry.second > 1 ? entry.second : 0;
+    }
+    printf("{\"instances\":%d,\"summary\":true,\"publish_per_s\":%.1f,\"topics\":%zu,\"shared_topics\":%zu,"
+           "\"shared_example\":\"%s\",\"duplicate_nodes\":%zu}\n",
+           count, total / seconds, resolved.size(), shared, example.c_str(), duplicate_nodes);
+    fflush(stdout);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> counts = {1, 2, 4, 8};
+    int duration_ms = 10000;
+    int cmd_rate = 20;
+    int ping_rate = 10;
+    std::string prefix = "robot";
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--instances" && i + 1 < argc) {
+            counts.clear();
+            for (char *tok = strtok(argv[++i], ","); tok; tok = strtok(NULL, ",")) {
+                counts.push_back(atoi(tok));
+            }
+        } else if (arg == "--duration" && i + 1 < argc) {
+            duration_ms = (int)(atof(argv[++i]) * 1000);
+        } else if (arg == "--cmd-rate" && i + 1 < argc) {
+            cmd_rate = atoi(argv[++i]);
+        } else if (arg == "--ping-rate" && i + 1 < argc) {
+            ping_rate = atoi(argv[++i]);
+        } else if (arg == "--namespace" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else {
+            fprintf(stderr, "usage: %s [--instances 1,2,4,8] [--duration s] [--cmd-rate hz] [--ping-rate hz] "
+                            "[--namespace prefix] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (duration_ms <= 0) {
+        fprintf(stderr, "duration must be positive\n");
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // An instance that died shows as missing traffic
+    for (int count : counts) {
+        if (count <= 0 || !runFleet(count, duration_ms, cmd_rate, ping_rate, prefix, verbose)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Requests a flight recorder dump from a wheel board and writes it to a file.
+
+The file is the FlightDumpHeader followed by the records, the format read by
+the native_replay build (tools/flight_replay.cpp).
+
+    python3 tools/flight_dump.py --wheel left_wheel -o left_wheel.frc
+"""
+
+import argparse
+import struct
+
+import rclpy
+from rclpy.node import Node
+from std_msgs.msg import UInt8MultiArray
+from std_srvs.srv import Trigger
+
+HEADER = struct.Struct('<IHHI')  # magic, version, record_size, record_count
+MAGIC = 0x31435246
+
+
+class FlightDump(Node):
+    def __init__(self, wheel):
+        super().__init__('flight_dump')
+        self.data = bytearray()
+        self.expected = None
+        self.create_subscription(
+            UInt8MultiArray, f'/{wheel}/flight_recorder', self.on_chunk, 10)
+        self.client = self.create_client(Trigger, f'/{wheel}/dump_flight_recorder')
+
+    def on_chunk(self, msg):
+        chunk = bytes(msg.data)
+        if not self.data:
+            magic, _, record_size, record_count = HEADER.unpack_from(chunk)
+            if magic != MAGIC:
+                self.get_logger().warn('Ignoring chunk without dump header')
+                return
+            self.expected = HEADER.size + record_size * record_count
+        self.data.extend(chunk)
+
+    def done(self):
+        return self.expected is not None and len(self.data) >= self.expected
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--wheel', default='left_wheel', help='wheel suffix of the board')
+    parser.add_argument('-o', '--output', required=True, help='dump file to write')
+    parser.add_argument('--timeout', type=float, default=30.0, help='seconds to wait for the dump')
+    args = parser.parse_args()
+
+    rclpy.init()
+    node = FlightDump(args.wheel)
+    if not node.client.wait_for_service(timeout_sec=args.timeout):
+        raise SystemExit('dump service not available')
+    future = node.client.call_async(Trigger.Request())
+    rclpy.spin_until_future_complete(node, future, timeout_sec=args.timeout)
+    if future.result() is not None:
+        node.get_logger().info(future.result().message)
+
+    deadline = node.get_clock().now().nanoseconds + int(args.timeout * 1e9)
+    while not node.done() and node.get_clock().now().nanoseconds < deadline:
+        rclpy.spin_once(node, timeout_sec=0.1)
+
+    if not node.done():
+        raise SystemExit(f'incomplete dump: {len(node.data)} of {node.expected} bytes')
+    with open(args.output, 'wb') as f:
+        f.write(node.data[:node.expected])
+    node.get_logger().info(f'Wrote {node.expected} bytes to {args.output}')
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,250 @@
+/* Copyright 2024 Taisyu Shibata
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a flight recorder dump through the control logic in a native build.
+//
+// cmd_vel records call subscription_callback, control ticks run the recorded
+// control stream with the IMU sample and motor replies it saw queued first. Every frame the
+// replayed firmware writes to motorSerial is compared with the recorded TX
+// frame, except the status polls of the motor supervisor, and the recorded timing
+// of ticks and cmd_vel handling is summarized.
+//
+//   pio run -e native_replay
+//   .pio/build/native_replay/program left_wheel.frc [--realtime] [--speed 0.5]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "MotorController.h"
+#include "RosCommunications.h"
+#include "IMUManager.h"
+#include "FlightRecorder.h"
+
+IMUManager imuManager; // Normally defined in SystemManager.cpp, which is not built natively
+
+static int64_t nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void printFrame(const char *label, const uint8_t *frame) {
+    printf("%s", label);
+    for (int i = 0; i < 10; i++) {
+        printf(" %02X", frame[i]);
+    }
+    printf("\n");
+}
+
+static bool loadDump(const char *path, std::vector<FlightRecord> &records) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    FlightDumpHeader hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, file) == 1 && hdr.magic == FLIGHT_DUMP_MAGIC &&
+              hdr.version == FLIGHT_DUMP_VERSION && hdr.record_size == sizeof(FlightRecord);
+    if (ok) {
+        records.resize(hdr.record_count);
+        ok = fread(records.data(), sizeof(FlightRecord), hdr.record_count, file) == hdr.record_count;
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "%s: not a flight recorder dump of version %d\n", path, FLIGHT_DUMP_VERSION);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    bool realtime = false;
+    double speed = 1.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") {
+            realtime = true;
+        } else if (arg == "--speed" && i + 1 < argc) {
+            realtime = true;
+            speed = atof(argv[++i]);
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || speed <= 0.0) {
+        fprintf(stderr, "usage: %s DUMP [--realtime] [--speed FACTOR]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<FlightRecord> records;
+    if (!loadDump(path, records)) {
+        return 1;
+    }
+    if (records.empty()) {
+        printf("empty dump\n");
+        return 0;
+    }
+
+    // The replayed firmware must not overwrite what is being replayed
+    flightRecorder.freeze();
+
+    // Collect the frames the replayed firmware writes to the motor
+    std::deque<std::vector<uint8_t>> written;
+    std::vector<uint8_t> partial;
+    motorSerial.onWrite = [&](const uint8_t *buf, size_t len) {
+        partial.insert(partial.end(), buf, buf + len);
+        while (partial.size() >= 10) {
+            written.emplace_back(partial.begin(), partial.begin() + 10);
+            partial.erase(partial.begin(), partial.begin() + 10);
+        }
+    };
+
+    // Register the control streams so ticks can run them by slot
+    initializeStreams();
+
+    uint32_t ticks = 0, cmd_vels = 0, matched = 0, mismatched = 0, errors = 0;
+    uint32_t stream_ticks[MAX_STREAMS] = {0}, last_tick_us[MAX_STREAMS] = {0};
+    uint32_t tick_min_us[MAX_STREAMS], tick_max_us[MAX_STREAMS] = {0};
+    uint64_t tick_sum_us[MAX_STREAMS] = {0};
+    for (int id = 0; id < MAX_STREAMS; id++) {
+        tick_min_us[id] = UINT32_MAX;
+    }
+    uint32_t cmd_vel_us = 0, cmd_to_tx_max_us = 0;
+    bool replaying = false;
+    const uint32_t first_us = records.front().timestamp_us;
+    const int64_t start_us = nowMicros();
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const FlightRecord &rec = records[i];
+        if (realtime) {
+            int64_t due = start_us + (int64_t)((rec.timestamp_us - first_us) / speed);
+            int64_t wait = due - nowMicros();
+            if (wait > 0) {
+                delayMicroseconds((unsigned int)wait);
+            }
+        }
+
+        switch (rec.type) {
+        case FLIGHT_CMD_VEL: {
+            float values[2];
+            memcpy(values, rec.data, sizeof(values));
+            // Recorded commands already passed the staleness check, a zero stamp skips it
+            geometry_msgs__msg__TwistStamped cmd;
+            memset(&cmd, 0, sizeof(cmd));
+            cmd.twist.linear.x = values[0];
+            cmd.twist.angular.z = values[1];
+            subscription_callback(&cmd);
+            cmd_vels++;
+            cmd_vel_us = rec.timestamp_us;
+            replaying = true;
+            break;
+        }
+        case FLIGHT_CONTROL_TICK: {
+            uint8_t stream = rec.data[0];
+            if (!controlStreams.isConfigured(stream)) {
+                printf("t=%u us: tick of unknown stream %u\n", rec.timestamp_us - first_us, stream);
+                break;
+            }
+
+            // Queue the IMU sample and motor replies the device saw during this tick
+            motorSerial.clearRx();
+            for (size_t j = i + 1; j < records.size(); j++) {
+                const FlightRecord &next = records[j];
+                if (next.type == FLIGHT_CONTROL_TICK || next.type == FLIGHT_CMD_VEL) {
+                    break;
+                }
+                if (next.type == FLIGHT_MOTOR_RX) {
+                    motorSerial.injectRx(next.data, 10);
+                } else if (next.type == FLIGHT_IMU) {
+                    int16_t raw[6];
+                    memcpy(raw, next.data, sizeof(raw));
+                    for (int axis = 0; axis < 3; axis++) {
+                        M5.IMU.accel[axis] = raw[axis] / 1000.0f;
+                        M5.IMU.gyro[axis] = raw[axis + 3] / 10.0f;
+                    }
+                }
+            }
+            if (stream_ticks[stream] > 0) {
+                uint32_t interval = rec.timestamp_us - last_tick_us[stream];
+                tick_min_us[stream] = interval < tick_min_us[stream] ? interval : tick_min_us[stream];
+                tick_max_us[stream] = interval > tick_max_us[stream] ? interval : tick_max_us[stream];
+                tick_sum_us[stream] += interval;
+            }
+            last_tick_us[stream] = rec.timestamp_us;
+            controlStreams.run(stream);
+            stream_ticks[stream]++;
+            ticks++;
+            replaying = true;
+            break;
+        }
+        case FLIGHT_MOTOR_TX:
+            if (!replaying) {
+                break; // Frame of an event that started before the oldest record
+            }
+            if (memcmp(rec.data, STATUS_READ_FRAME.bytes, 10) == 0 ||
+                memcmp(rec.data, FAULT_CODE_READ_FRAME.bytes, 10) == 0) {
+                break; // Status polls follow the wall clock of the motor supervisor, which is not replayed
+            }
+            if (cmd_vel_us != 0) {
+                uint32_t latency = rec.timestamp_us - cmd_vel_us;
+                cmd_to_tx_max_us = latency > cmd_to_tx_max_us ? latency : cmd_to_tx_max_us;
+                cmd_vel_us = 0;
+            }
+            if (written.empty()) {
+                mismatched++;
+                printf("t=%u us: recorded frame not produced by replay\n", rec.timestamp_us - first_us);
+                printFrame("  recorded:", rec.data);
+            } else if (memcmp(written.front().data(), rec.data, 10) != 0) {
+                mismatched++;
+                printf("t=%u us: frame differs\n", rec.timestamp_us - first_us);
+                printFrame("  recorded:", rec.data);
+                printFrame("  replayed:", written.front().data());
+                written.pop_front();
+            } else {
+                matched++;
+                written.pop_front();
+            }
+            break;
+        case FLIGHT_EXEC_ERROR: {
+            int32_t code;
+            memcpy(&code, &rec.data[1], sizeof(code));
+            printf("t=%u us: error source=%u code=%d\n", rec.timestamp_us - first_us, rec.data[0], code);
+            errors++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    printf("records=%zu span_us=%u cmd_vel=%u ticks=%u errors=%u\n", records.size(),
+           records.back().timestamp_us - first_us, cmd_vels, ticks, errors);
+    for (int id = 0; id < MAX_STREAMS; id++) {
+        if (stream_ticks[id] < 2) {
+            continue;
+        }
+        printf("tick_interval_us[%s] min=%u avg=%u max=%u\n", controlStreams.name(id), tick_min_us[id],
+               (uint32_t)(tick_sum_us[id] / (stream_ticks[id] - 1)), tick_max_us[id]);
+    }
+    printf("cmd_vel_to_tx_max_us=%u tx_frames matched=%u mismatched=%u unreplayed=%zu\n",
+           cmd_to_tx_max_us, matched, mismatched, written.size());
+    return mismatched == 0 ? 0 : 1;
+}
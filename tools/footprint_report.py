@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Compares flash, RAM and boot time of the full and headless builds.
+
+The size command builds each PlatformIO env and records its flash and static
+RAM use. The boot command waits for the resource summary of a flashed board
+(boot_ms, heap_free and heap_min of /<wheel>/resource_usage) and records it
+under the env name. Both print the comparison of everything recorded so far:
+
+    python3 tools/footprint_report.py size left_wheel headless_left_wheel
+    pio run -e left_wheel -t upload
+    python3 tools/footprint_report.py boot left_wheel --wheel left_wheel
+    pio run -e headless_left_wheel -t upload
+    python3 tools/footprint_report.py boot headless_left_wheel --wheel left_wheel
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+# Usage lines printed by PlatformIO after a build
+USAGE = re.compile(r'^(RAM|Flash):.*\(used (\d+) bytes from (\d+) bytes\)', re.MULTILINE)
+FIELDS = ('flash', 'ram', 'boot_ms', 'heap_free', 'heap_min')
+
+
+def load(path):
+    if os.path.exists(path):
+        with open(path) as f:
+            return json.load(f)
+    return {}
+
+
+def save(path, results):
+    with open(path, 'w') as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+
+
+def measure_size(env):
+    out = subprocess.run(['pio', 'run', '-e', env], capture_output=True, text=True)
+    if out.returncode != 0:
+        sys.exit(f'{env}: build failed\n{out.stdout[-2000:]}{out.stderr[-2000:]}')
+    usage = {kind: int(used) for kind, used, _ in USAGE.findall(out.stdout)}
+    if 'Flash' not in usage or 'RAM' not in usage:
+        sys.exit(f'{env}: no size summary in the build output')
+    return {'flash': usage['Flash'], 'ram': usage['RAM']}
+
+
+def measure_boot(wheel, timeout):
+    import rclpy
+    from rclpy.qos import qos_profile_sensor_data
+    from std_msgs.msg import String
+
+    rclpy.init()
+    node = rclpy.create_node('footprint_report')
+    found = {}
+
+    def on_summary(msg):
+        values = dict(item.split('=', 1) for item in msg.data.split() if '=' in item)
+        if 'boot_ms' in values:
+            for key in ('boot_ms', 'heap_free', 'heap_min'):
+                found[key] = int(values[key])
+
+    node.create_subscription(String, f'/{wheel}/resource_usage', on_summary, qos_profile_sensor_data)
+    try:
+        end = node.get_clock().now().nanoseconds + int(timeout * 1e9)
+        while not found and node.get_clock().now().nanoseconds < end:
+            rclpy.spin_once(node, timeout_sec=0.5)
+    finally:
+        node.destroy_node()
+        rclpy.shutdown()
+    if not found:
+        sys.exit(f'No resource summary with boot_ms on /{wheel}/resource_usage')
+    return found
+
+
+def report(results):
+    envs = sorted(results)
+    print(f'{"env":<40}' + ''.join(f'{field:>12}' for field in FIELDS))
+    for env in envs:
+        row = results[env]
+        print(f'{env:<40}' + ''.join(f'{row.get(field, "-"):>12}' for field in FIELDS))
+    # Headless against its full build
+    for env in envs:
+        full = env[len('headless_'):] if env.startswith('headless_') else None
+        if full not in results:
+            continue
+        deltas = []
+        for field in FIELDS:
+            a, b = results[full].get(field), results[env].get(field)
+            deltas.append(f'{b - a:+d}' if a is not None and b is not None else '-')
+        print(f'{env + " - " + full:<40}' + ''.join(f'{d:>12}' for d in deltas))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--out', default='footprint.json', help='file keeping the measurements')
+    sub = parser.add_subparsers(dest='command', required=True)
+    size = sub.add_parser('size', help='build envs and record their flash and RAM use')
+    size.add_argument('envs', nargs='+', help='PlatformIO envs')
+    boot = sub.add_parser('boot', help='record the boot time and heap of the flashed board')
+    boot.add_argument('env', help='env flashed on the board')
+    boot.add_argument('--wheel', default='left_wheel', help='wheel suffix of the board')
+    boot.add_argument('--timeout', type=float, default=30.0, help='seconds to wait for a summary')
+    args = parser.parse_args()
+
+    results = load(args.out)
+    if args.command == 'size':
+        for env in args.envs:
+            results.setdefault(env, {}).update(measure_size(env))
+    else:
+        results.setdefault(args.env, {}).update(measure_boot(args.wheel, args.timeout))
+    save(args.out, results)
+    report(results)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Republishes the raw IMU batches of the left wheel board as sensor_msgs/Imu.
+
+With the imu_format parameter set to 1 the board publishes the raw counts of
+every IMU sample on /imu/raw_batch (std_msgs/UInt8MultiArray, layout in
+include/ImuBatch.h) instead of one filtered sensor_msgs/Imu per publish. This
+node scales and calibrates each sample and publishes it on /imu/data_raw with
+the time it was taken. Lost batches and samples dropped on the board are
+logged every second. For example:
+
+    ros2 param set /left_wheel_micro_ros_node imu_format 1
+    python3 tools/imu_batch_converter.py
+"""
+
+import argparse
+import math
+import struct
+
+import rclpy
+from rclpy.node import Node
+from rclpy.qos import qos_profile_sensor_data
+from sensor_msgs.msg import Imu
+from std_msgs.msg import UInt8MultiArray
+
+BATCH_VERSION = 1  # IMU_BATCH_VERSION
+HEADER = struct.Struct('<BBHHHIIq6hI')  # ImuBatchHeader
+SAMPLE = struct.Struct('<I6h')  # ImuBatchSample
+FULL_SCALE_COUNTS = 32768.0  # IMU_BATCH_FULL_SCALE_COUNTS
+GRAVITY = 9.81  # GRAVITY of the firmware, m/s^2 per g
+DEG2RAD = math.pi / 180.0
+
+
+def decode_batch(data):
+    """Returns (header dict, [(age_us, raw[6]), ...]) or None for a malformed batch."""
+    if len(data) < HEADER.size:
+        return None
+    (version, count, dropped, accel_range, gyro_range, seq, period_us,
+     stamp_ns, *rest) = HEADER.unpack_from(data, 0)
+    offset = rest[:6]
+    if version != BATCH_VERSION or len(data) < HEADER.size + count * SAMPLE.size:
+        return None
+    header = {'count': count, 'dropped': dropped, 'accel_range_g': accel_range,
+              'gyro_range_dps': gyro_range, 'seq': seq, 'period_us': period_us,
+              'stamp_ns': stamp_ns, 'offset': offset}
+    samples = []
+    for i in range(count):
+        age_us, *raw = SAMPLE.unpack_from(data, HEADER.size + i * SAMPLE.size)
+        samples.append((age_us, raw))
+    return header, samples
+
+
+class ImuBatchConverter(Node):
+    def __init__(self, args):
+        super().__init__('imu_batch_converter')
+        self.frame_id = args.frame_id
+        self.calibrate = not args.no_calibration
+        self.accel_covariance = args.accel_covariance
+        self.gyro_covariance = args.gyro_covariance
+        self.last_seq = None
+        self.batches = self.samples = self.lost = self.dropped = self.malformed = 0
+        self.pub = self.create_publisher(Imu, args.output, qos_profile_sensor_data)
+        self.create_subscription(UInt8MultiArray, args.input, self.on_batch, qos_profile_sensor_data)
+        self.create_timer(1.0, self.report)
+
+    def on_batch(self, msg):
+        decoded = decode_batch(bytes(msg.data))
+        if decoded is None:
+            self.malformed += 1
+            return
+        header, samples = decoded
+        if self.last_seq is not None:
+            gap = (header['seq'] - self.last_seq - 1) & 0xFFFFFFFF
+            if gap < 1000:  # Larger jumps are a board restart
+                self.lost += gap
+        self.last_seq = header['seq']
+        self.batches += 1
+        self.dropped += header['dropped']
+
+        accel_scale = header['accel_range_g'] / FULL_SCALE_COUNTS * GRAVITY
+        gyro_scale = header['gyro_range_dps'] / FULL_SCALE_COUNTS * DEG2RAD
+        offset = header['offset'] if self.calibrate else (0,) * 6
+        for age_us, raw in samples:
+            imu = Imu()
+            stamp_ns = header['stamp_ns'] - age_us * 1000
+            imu.header.stamp.sec = stamp_ns // 1000000000
+            imu.header.stamp.nanosec = stamp_ns % 1000000000
+            imu.header.frame_id = self.frame_id
+            imu.orientation_covariance[0] = -1.0  # No orientation estimate
+            imu.linear_acceleration.x = (raw[0] - offset[0]) * accel_scale
+            imu.linear_acceleration.y = (raw[1] - offset[1]) * accel_scale
+            imu.linear_acceleration.z = (raw[2] - offset[2]) * accel_scale
+            imu.angular_velocity.x = (raw[3] - offset[3]) * gyro_scale
+            imu.angular_velocity.y = (raw[4] - offset[4]) * gyro_scale
+            imu.angular_velocity.z = (raw[5] - offset[5]) * gyro_scale
+            for i in (0, 4, 8):
+                imu.linear_acceleration_covariance[i] = self.accel_covariance
+                imu.angular_velocity_covariance[i] = self.gyro_covariance
+            self.pub.publish(imu)
+            self.samples += 1
+
+    def report(self):
+        self.get_logger().info(
+            f'batches={self.batches} samples={self.samples} lost_batches={self.lost} '
+            f'dropped_samples={self.dropped} malformed={self.malformed}')
+        self.batches = self.samples = self.lost = self.dropped = self.malformed = 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--input', default='/imu/raw_batch', help='batch topic of the board')
+    parser.add_argument('--output', default='/imu/data_raw', help='sensor_msgs/Imu topic to publish')
+    parser.add_argument('--frame-id', default='imu', help='frame_id of the published messages')
+    parser.add_argument('--no-calibration', action='store_true',
+                        help='publish the counts without the calibration offsets of the board')
+    parser.add_argument('--accel-covariance', type=float, default=0.2,
+                        help='diagonal linear acceleration covariance')
+    parser.add_argument('--gyro-covariance', type=float, default=0.05,
+                        help='diagonal angular velocity covariance')
+    args = parser.parse_args()
+
+    rclpy.init()
+    node = ImuBatchConverter(args)
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        node.destroy_node()
+        rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Host side of the link quality monitor.
+
+Sends sequence-numbered pings on /<wheel>/heartbeat, measures the round trip
+from the echoes on /<wheel>/heartbeat_response and prints the summaries the
+board publishes on /<wheel>/link_quality. Each ping carries the board stamp
+of the latest echo and how long the host held it, so the board measures the
+same round trip on its own clock. For example:
+
+    python3 tools/link_monitor.py --wheel left_wheel --rate 20
+"""
+
+import argparse
+import time
+
+import rclpy
+from rclpy.node import Node
+from rclpy.qos import qos_profile_sensor_data
+from std_msgs.msg import Int32MultiArray, String
+
+NO_ECHO = -1  # 0xFFFFFFFF on the board: no echo has been received yet
+INT32_MASK = 0xFFFFFFFF
+
+
+def to_int32(value):
+    value &= INT32_MASK
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def host_us():
+    return time.monotonic_ns() // 1000
+
+
+class LinkMonitorHost(Node):
+    def __init__(self, wheel, rate):
+        super().__init__('link_monitor_host')
+        self.seq = 0
+        self.echo_board_stamp = 0
+        self.echo_received_us = None
+        self.rtts = []
+        # Pings are best effort on the board so losses are measured, not retransmitted
+        self.ping_pub = self.create_publisher(
+            Int32MultiArray, f'/{wheel}/heartbeat', qos_profile_sensor_data)
+        self.create_subscription(
+            Int32MultiArray, f'/{wheel}/heartbeat_response', self.on_echo, qos_profile_sensor_data)
+        self.create_subscription(String, f'/{wheel}/link_quality', self.on_quality, qos_profile_sensor_data)
+        self.create_timer(1.0 / rate, self.send_ping)
+        self.create_timer(1.0, self.report)
+
+    def send_ping(self):
+        now = host_us()
+        if self.echo_received_us is None:
+            hold = NO_ECHO
+        else:
+            hold = to_int32(now - self.echo_received_us)
+        msg = Int32MultiArray()
+        msg.data = [to_int32(self.seq), to_int32(now), self.echo_board_stamp, hold]
+        self.ping_pub.publish(msg)
+        self.seq += 1
+
+    def on_echo(self, msg):
+        now = host_us()
+        if len(msg.data) < 3:
+            return
+        self.rtts.append(((now - msg.data[1]) & INT32_MASK) / 1000.0)
+        self.echo_board_stamp = msg.data[2]
+        self.echo_received_us = now
+
+    def on_quality(self, msg):
+        self.get_logger().info(f'board: {msg.data}')
+
+    def report(self):
+        if not self.rtts:
+            self.get_logger().info('host: no echoes')
+            return
+        rtts = sorted(self.rtts)
+        p99 = rtts[min(len(rtts) - 1, int(len(rtts) * 0.99))]
+        self.get_logger().info(
+            f'host: echoes={len(rtts)} rtt_min_ms={rtts[0]:.2f} '
+            f'rtt_avg_ms={sum(rtts) / len(rtts):.2f} rtt_p99_ms={p99:.2f}')
+        self.rtts = []
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--wheel', default='left_wheel', help='wheel suffix of the board')
+    parser.add_argument('--rate', type=float, default=20.0, help='pings per second')
+    args = parser.parse_args()
+
+    rclpy.init()
+    node = LinkMonitorHost(args.wheel, args.rate)
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        node.destroy_node()
+        rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
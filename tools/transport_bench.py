@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Copyright 2024 Taisyu Shibata
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Host side of the transport benchmark (build flag -DTRANSPORT_BENCHMARK).
+
+Echoes /<wheel>/bench_ping back on /<wheel>/bench_echo and records the
+summaries the board publishes on /<wheel>/bench_result. Run it next to a
+micro-ROS agent on Linux, for example:
+
+    ros2 run micro_ros_agent micro_ros_agent udp4 --port 8888
+    ros2 run micro_ros_agent micro_ros_agent serial --dev /dev/ttyUSB0 -b 921600
+    python3 tools/transport_bench.py --wheel left_wheel --csv bench.csv
+"""
+
+import argparse
+import csv
+import os
+
+import rclpy
+from rclpy.node import Node
+from rclpy.qos import qos_profile_sensor_data
+from std_msgs.msg import Int32, String
+
+
+class TransportBenchEcho(Node):
+    def __init__(self, wheel, csv_path):
+        super().__init__('transport_bench_echo')
+        self.csv_path = csv_path
+        self.echo_pub = self.create_publisher(
+            Int32, f'/{wheel}/bench_echo', qos_profile_sensor_data)
+        self.create_subscription(
+            Int32, f'/{wheel}/bench_ping', self.on_ping, qos_profile_sensor_data)
+        self.create_subscription(
+            String, f'/{wheel}/bench_result', self.on_result, 10)
+
+    def on_ping(self, msg):
+        self.echo_pub.publish(msg)
+
+    def on_result(self, msg):
+        self.get_logger().info(msg.data)
+        if not self.csv_path:
+            return
+        # The board reports key=value pairs, one window per message
+        row = dict(field.split('=', 1) for field in msg.data.split())
+        new_file = not os.path.exists(self.csv_path)
+        with open(self.csv_path, 'a', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=list(row.keys()))
+            if new_file:
+                writer.writeheader()
+            writer.writerow(row)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--wheel', default='left_wheel', help='wheel suffix of the board')
+    parser.add_argument('--csv', default=None, help='append summaries to this CSV file')
+    args = parser.parse_args()
+
+    rclpy.init()
+    node = TransportBenchEcho(args.wheel, args.csv)
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        node.destroy_node()
+        rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()